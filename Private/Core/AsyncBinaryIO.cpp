@@ -0,0 +1,257 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Core/AsyncBinaryIO.h"
+#include "Core/GSAsync.h"
+
+using namespace GS;
+
+
+WriteBehindBinaryWriter::WriteBehindBinaryWriter(IBinaryWriter& TargetWriter, size_t BufferBytes)
+	: target_writer(TargetWriter)
+{
+	buffer_size = (BufferBytes > 0) ? BufferBytes : DefaultBufferBytes;
+	buffers[0].resize(buffer_size);
+	buffers[1].resize(buffer_size);
+}
+
+WriteBehindBinaryWriter::~WriteBehindBinaryWriter()
+{
+	Flush();
+	wait_for_pending_write();
+	gs_debug_assert(write_failed == false || write_failure_reported);		// errors are lost if Wait() was not called before destruction
+}
+
+void WriteBehindBinaryWriter::wait_for_pending_write()
+{
+	if (write_task_pending)
+	{
+		GS::Parallel::WaitForTask(write_task);
+		write_task = TaskContainer();
+		write_task_pending = false;
+	}
+}
+
+void WriteBehindBinaryWriter::launch_write(int BufferIndex, size_t NumBytes)
+{
+	gs_debug_assert(write_task_pending == false);
+	write_task = GS::Parallel::StartTask([this, BufferIndex, NumBytes]()
+	{
+		if (write_failed) return;		// do not write past a failed write
+		if (target_writer.WriteBytes(buffers[BufferIndex].raw_pointer(), NumBytes) == false)
+		{
+			write_failed = true;
+			task_errors.AppendError((uint32_t)EGSStandardErrors::FileIO_WriteFailed, EGSErrorLevel::Error, "WriteBehindBinaryWriter: write to target failed");
+		}
+	}, "WriteBehindBinaryWriter");
+	write_task_pending = true;
+}
+
+bool WriteBehindBinaryWriter::WriteBytes(const void* WriteBuffer, size_t ByteCount)
+{
+	const uint8_t* CurPtr = (const uint8_t*)WriteBuffer;
+	while (ByteCount > 0)
+	{
+		size_t CopyBytes = buffer_size - active_used;
+		CopyBytes = (ByteCount < CopyBytes) ? ByteCount : CopyBytes;
+		memcpy_s(buffers[active_buffer].raw_pointer(active_used), buffer_size - active_used, CurPtr, CopyBytes);
+		active_used += CopyBytes;
+		CurPtr += CopyBytes;
+		ByteCount -= CopyBytes;
+
+		if (active_used == buffer_size)
+			Flush();
+	}
+	// a failure is only visible here once the task that hit it has completed
+	return !(write_task_pending == false && write_failed);
+}
+
+bool WriteBehindBinaryWriter::Flush()
+{
+	if (active_used == 0) return true;
+
+	// previous buffer must finish writing before it can be reused
+	wait_for_pending_write();
+	launch_write(active_buffer, active_used);
+	active_buffer = 1 - active_buffer;
+	active_used = 0;
+	return !write_failed;
+}
+
+bool WriteBehindBinaryWriter::Wait(GSErrorSet* ErrorsOut)
+{
+	Flush();
+	wait_for_pending_write();
+
+	bool bOK = !write_failed;
+	if (ErrorsOut != nullptr) {
+		for (GSError& Error : task_errors.Errors)
+			ErrorsOut->AppendError(std::move(Error));
+	}
+	task_errors.Errors.clear();
+	write_failure_reported = write_failure_reported || (bOK == false);
+	return bOK;
+}
+
+void WriteBehindBinaryWriter::ResetWriteFailure()
+{
+	wait_for_pending_write();
+	write_failed = false;
+	write_failure_reported = false;
+}
+
+
+
+
+
+PrefetchBinaryReader::PrefetchBinaryReader(IBinaryReader& Source, size_t ChunkBytes, int NumPrefetchChunks)
+	: source_reader(Source)
+{
+	chunk_size = (ChunkBytes > 0) ? ChunkBytes : DefaultChunkBytes;
+	// one chunk is being consumed while NumPrefetchChunks are fetched
+	int NumChunks = ((NumPrefetchChunks > 0) ? NumPrefetchChunks : 1) + 1;
+	chunks.resize(NumChunks);
+	for (Chunk& Chunk : chunks)
+		Chunk.Data.resize(chunk_size);
+
+	launch_fetches();
+}
+
+PrefetchBinaryReader::~PrefetchBinaryReader()
+{
+	wait_for_all_fetches();
+}
+
+void PrefetchBinaryReader::launch_fetches()
+{
+	// launch fetches for all chunk slots not holding the chunk currently being consumed
+	size_t NumChunks = chunks.size();
+	size_t MaxLaunchChunk = consume_chunk + NumChunks - ((consume_started) ? 1 : 0);
+	while (reached_end == false && next_launch_chunk < MaxLaunchChunk)
+	{
+		Chunk& Slot = chunks[next_launch_chunk % NumChunks];
+		gs_debug_assert(Slot.bFetchPending == false);
+		Slot.bFetchPending = true;
+		Slot.FetchTask = GS::Parallel::StartTask([this]()
+		{
+			// chunk sequence indices are claimed under the lock, so the source is read strictly in order
+			// even if the tasks execute out-of-order
+			std::lock_guard<std::mutex> Lock(source_lock);
+			Chunk& FetchSlot = chunks[next_fetch_chunk % chunks.size()];
+			next_fetch_chunk++;
+
+			FetchSlot.NumBytes = 0;
+			FetchSlot.bEndOfSource = source_exhausted;
+			if (source_exhausted || read_failed) return;
+
+			FetchSlot.NumBytes = source_reader.ReadAvailableBytes(FetchSlot.Data.raw_pointer(), chunk_size);
+			if (FetchSlot.NumBytes < chunk_size)
+			{
+				source_exhausted = FetchSlot.bEndOfSource = true;
+				if (source_reader.IsEndOfFile() == false)
+				{
+					read_failed = true;
+					task_errors.AppendError((uint32_t)EGSStandardErrors::FileIO_ReadFailed, EGSErrorLevel::Error, "PrefetchBinaryReader: read from source failed");
+				}
+			}
+		}, "PrefetchBinaryReader");
+		next_launch_chunk++;
+	}
+}
+
+bool PrefetchBinaryReader::begin_next_chunk()
+{
+	if (consume_started)
+		consume_chunk++;
+	consume_started = true;
+	consume_offset = 0;
+
+	// wait for the chunk to arrive, and then refill the slot that was just released
+	Chunk& Slot = chunks[consume_chunk % chunks.size()];
+	if (Slot.bFetchPending)
+	{
+		GS::Parallel::WaitForTask(Slot.FetchTask);
+		Slot.FetchTask = TaskContainer();
+		Slot.bFetchPending = false;
+	}
+	reached_end = reached_end || Slot.bEndOfSource;
+	launch_fetches();
+	return Slot.NumBytes > 0;
+}
+
+size_t PrefetchBinaryReader::ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount)
+{
+	uint8_t* CurPtr = (uint8_t*)ToBuffer;
+	size_t NumRead = 0;
+	while (NumRead < MaxByteCount)
+	{
+		const Chunk* CurChunk = (consume_started) ? &chunks[consume_chunk % chunks.size()] : nullptr;
+		if (CurChunk == nullptr || consume_offset == CurChunk->NumBytes)
+		{
+			if ((CurChunk != nullptr && CurChunk->bEndOfSource) || begin_next_chunk() == false)
+			{
+				is_eof = true;
+				break;
+			}
+			continue;
+		}
+
+		size_t CopyBytes = CurChunk->NumBytes - consume_offset;
+		CopyBytes = (MaxByteCount - NumRead < CopyBytes) ? (MaxByteCount - NumRead) : CopyBytes;
+		memcpy_s(CurPtr, MaxByteCount - NumRead, CurChunk->Data.raw_pointer(consume_offset), CopyBytes);
+		consume_offset += CopyBytes;
+		CurPtr += CopyBytes;
+		NumRead += CopyBytes;
+	}
+	return NumRead;
+}
+
+bool PrefetchBinaryReader::ReadBytes(void* ToBuffer, size_t ByteCount)
+{
+	return ReadAvailableBytes(ToBuffer, ByteCount) == ByteCount;
+}
+
+bool PrefetchBinaryReader::IsEndOfFile() const
+{
+	return is_eof;
+}
+
+void PrefetchBinaryReader::wait_for_all_fetches()
+{
+	for (Chunk& Slot : chunks)
+	{
+		if (Slot.bFetchPending)
+		{
+			GS::Parallel::WaitForTask(Slot.FetchTask);
+			Slot.FetchTask = TaskContainer();
+			Slot.bFetchPending = false;
+		}
+	}
+}
+
+void PrefetchBinaryReader::SetPosition(size_t offset)
+{
+	wait_for_all_fetches();
+	source_reader.SetPosition(offset);
+
+	consume_chunk = consume_offset = 0;
+	consume_started = false;
+	next_launch_chunk = next_fetch_chunk = 0;
+	reached_end = is_eof = source_exhausted = false;
+	for (Chunk& Slot : chunks) {
+		Slot.NumBytes = 0;
+		Slot.bEndOfSource = false;
+	}
+	launch_fetches();
+}
+
+bool PrefetchBinaryReader::Wait(GSErrorSet* ErrorsOut)
+{
+	wait_for_all_fetches();
+
+	bool bOK = !read_failed;
+	if (ErrorsOut != nullptr) {
+		for (GSError& Error : task_errors.Errors)
+			ErrorsOut->AppendError(std::move(Error));
+	}
+	task_errors.Errors.clear();
+	return bOK;
+}
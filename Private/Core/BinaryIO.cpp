@@ -1,5 +1,23 @@
 // Copyright Gradientspace Corp. All Rights Reserved.
 #include "Core/BinaryIO.h"
+#include "Core/gs_debug.h"
+
+#ifdef __linux__
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <stdlib.h>
+#elif defined(GS_EMBEDDED_UE_BUILD)
+	#include "Windows/AllowWindowsPlatformTypes.h"
+	#include <windows.h>
+	#include "Windows/HideWindowsPlatformTypes.h"
+	#include <malloc.h>
+#else
+	#ifndef WIN32_LEAN_AND_MEAN
+	#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+	#include <malloc.h>
+#endif
 
 using namespace GS;
 
@@ -21,12 +39,18 @@ void StreamBinaryReader::SetPosition(size_t offset)
 	in_stream.seekg(offset, std::ios::beg);
 }
 
-bool StreamBinaryReader::ReadBytes(void* ToBuffer, int ByteCount)
+bool StreamBinaryReader::ReadBytes(void* ToBuffer, size_t ByteCount)
 {
-	in_stream.read((char*)ToBuffer, ByteCount);
+	in_stream.read((char*)ToBuffer, (std::streamsize)ByteCount);
 	return in_stream.good();
 }
 
+size_t StreamBinaryReader::ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount)
+{
+	in_stream.read((char*)ToBuffer, (std::streamsize)MaxByteCount);
+	return (size_t)in_stream.gcount();
+}
+
 
 
 
@@ -73,12 +97,106 @@ void FileBinaryReader::SetPosition(size_t offset)
 	in_stream.seekg(offset, std::ios::beg);
 }
 
-bool FileBinaryReader::ReadBytes(void* ToBuffer, int ByteCount)
+bool FileBinaryReader::ReadBytes(void* ToBuffer, size_t ByteCount)
 {
-	in_stream.read((char*)ToBuffer, ByteCount);
+	in_stream.read((char*)ToBuffer, (std::streamsize)ByteCount);
 	return in_stream.good();
 }
 
+size_t FileBinaryReader::ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount)
+{
+	in_stream.read((char*)ToBuffer, (std::streamsize)MaxByteCount);
+	return (size_t)in_stream.gcount();
+}
+
+
+
+
+
+MappedFileBinaryReader::MappedFileBinaryReader()
+{
+}
+
+MappedFileBinaryReader MappedFileBinaryReader::OpenFile(const std::string& FilePath, size_t ReadAheadBytes)
+{
+	MappedFileBinaryReader Result;
+	if (Result.mapped_file.Open(FilePath))
+	{
+		Result.mapped_file.AdviseSequential();
+		Result.read_ahead_bytes = ReadAheadBytes;
+		Result.update_read_ahead();
+	}
+	return Result;
+}
+
+bool MappedFileBinaryReader::operator!() const
+{
+	return !mapped_file.IsOpen();
+}
+
+bool MappedFileBinaryReader::IsOpen() const
+{
+	return mapped_file.IsOpen();
+}
+
+void MappedFileBinaryReader::CloseFile()
+{
+	mapped_file.Close();
+	read_position = prefetched_until = 0;
+	is_eof = false;
+}
+
+bool MappedFileBinaryReader::IsEndOfFile() const
+{
+	return is_eof;
+}
+
+void MappedFileBinaryReader::SetPosition(size_t offset)
+{
+	read_position = (offset < mapped_file.GetSize()) ? offset : mapped_file.GetSize();
+	prefetched_until = read_position;
+	is_eof = false;
+	update_read_ahead();
+}
+
+bool MappedFileBinaryReader::ReadBytes(void* ToBuffer, size_t ByteCount)
+{
+	return ReadAvailableBytes(ToBuffer, ByteCount) == ByteCount;
+}
+
+size_t MappedFileBinaryReader::ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount)
+{
+	size_t FileSize = mapped_file.GetSize();
+	size_t Available = FileSize - read_position;
+	size_t CopyBytes = (MaxByteCount <= Available) ? MaxByteCount : Available;
+	if (CopyBytes > 0)
+		memcpy_s(ToBuffer, MaxByteCount, mapped_file.GetData() + read_position, CopyBytes);
+	read_position += CopyBytes;
+
+	if (CopyBytes < MaxByteCount) 
+		is_eof = true;
+	else
+		update_read_ahead();
+	return CopyBytes;
+}
+
+const_buffer_view<uint8_t> MappedFileBinaryReader::MapRange(size_t Offset, size_t Length) const
+{
+	return mapped_file.MapRange(Offset, Length);
+}
+
+void MappedFileBinaryReader::update_read_ahead()
+{
+	// issue next prefetch once the read position is halfway through the previously-prefetched window
+	if (read_ahead_bytes == 0 || read_position + read_ahead_bytes/2 < prefetched_until)
+		return;
+	size_t PrefetchStart = (prefetched_until > read_position) ? prefetched_until : read_position;
+	if (PrefetchStart >= mapped_file.GetSize())
+		return;
+	mapped_file.PrefetchRange(PrefetchStart, read_ahead_bytes);
+	prefetched_until = PrefetchStart + read_ahead_bytes;
+}
+
 
 
 
@@ -89,9 +207,9 @@ StreamBinaryWriter::StreamBinaryWriter(std::ostream& stream)
 {
 }
 
-bool StreamBinaryWriter::WriteBytes(const void* WriteBuffer, int ByteCount)
+bool StreamBinaryWriter::WriteBytes(const void* WriteBuffer, size_t ByteCount)
 {
-	out_stream.write((const char*)WriteBuffer, ByteCount);
+	out_stream.write((const char*)WriteBuffer, (std::streamsize)ByteCount);
 	return (out_stream.good());
 }
 
@@ -129,8 +247,250 @@ void FileBinaryWriter::CloseFile()
 	out_stream.close();
 }
 
-bool FileBinaryWriter::WriteBytes(const void* WriteBuffer, int ByteCount)
+bool FileBinaryWriter::WriteBytes(const void* WriteBuffer, size_t ByteCount)
 {
-	out_stream.write((const char*)WriteBuffer, ByteCount);
+	out_stream.write((const char*)WriteBuffer, (std::streamsize)ByteCount);
 	return (out_stream.good());
 }
+
+
+
+
+
+namespace GSLocal
+{
+	static uint8_t* allocate_aligned_buffer(size_t NumBytes, size_t Alignment)
+	{
+#ifdef __linux__
+		void* Memory = nullptr;
+		return (posix_memalign(&Memory, Alignment, NumBytes) == 0) ? (uint8_t*)Memory : nullptr;
+#else
+		return (uint8_t*)_aligned_malloc(NumBytes, Alignment);
+#endif
+	}
+	static void free_aligned_buffer(uint8_t* Memory)
+	{
+#ifdef __linux__
+		free(Memory);
+#else
+		_aligned_free(Memory);
+#endif
+	}
+}
+
+
+AlignedFileBinaryWriter::AlignedFileBinaryWriter()
+{
+}
+
+AlignedFileBinaryWriter::~AlignedFileBinaryWriter()
+{
+	CloseFile();
+}
+
+AlignedFileBinaryWriter::AlignedFileBinaryWriter(AlignedFileBinaryWriter&& moved)
+{
+	move_from(moved);
+}
+
+AlignedFileBinaryWriter& AlignedFileBinaryWriter::operator=(AlignedFileBinaryWriter&& moved)
+{
+	if (this != &moved)
+	{
+		CloseFile();
+		move_from(moved);
+	}
+	return *this;
+}
+
+void AlignedFileBinaryWriter::move_from(AlignedFileBinaryWriter& moved)
+{
+	file_handle = moved.file_handle;
+	buffer = moved.buffer;
+	buffer_size = moved.buffer_size;
+	buffer_used = moved.buffer_used;
+	total_bytes = moved.total_bytes;
+	use_direct_io = moved.use_direct_io;
+	write_failed = moved.write_failed;
+
+	moved.file_handle = -1;
+	moved.buffer = nullptr;
+	moved.buffer_size = moved.buffer_used = moved.total_bytes = 0;
+}
+
+AlignedFileBinaryWriter AlignedFileBinaryWriter::OpenFile(const std::string& FilePath, size_t BufferBytes, bool bUseDirectIO)
+{
+	AlignedFileBinaryWriter Result;
+
+	size_t NumBlocks = (BufferBytes + BlockAlignment - 1) / BlockAlignment;
+	Result.buffer_size = ((NumBlocks > 0) ? NumBlocks : 1) * BlockAlignment;
+	Result.buffer = GSLocal::allocate_aligned_buffer(Result.buffer_size, BlockAlignment);
+	if (Result.buffer == nullptr)
+		return Result;
+
+#ifdef __linux__
+	int Flags = O_WRONLY | O_CREAT | O_TRUNC;
+	int fd = -1;
+	if (bUseDirectIO) {
+		fd = ::open(FilePath.c_str(), Flags | O_DIRECT, 0644);
+		Result.use_direct_io = (fd >= 0);
+	}
+	if (fd < 0)		// direct IO is not supported on all filesystems, fall back to buffered IO
+		fd = ::open(FilePath.c_str(), Flags, 0644);
+	Result.file_handle = (intptr_t)fd;
+#else
+	DWORD Flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+	HANDLE hFile = INVALID_HANDLE_VALUE;
+	if (bUseDirectIO) {
+		hFile = ::CreateFileA(FilePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, Flags | FILE_FLAG_NO_BUFFERING, nullptr);
+		Result.use_direct_io = (hFile != INVALID_HANDLE_VALUE);
+	}
+	if (hFile == INVALID_HANDLE_VALUE)
+		hFile = ::CreateFileA(FilePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, Flags, nullptr);
+	Result.file_handle = (hFile != INVALID_HANDLE_VALUE) ? (intptr_t)hFile : -1;
+#endif
+
+	return Result;
+}
+
+bool AlignedFileBinaryWriter::operator!() const
+{
+	return !IsOpen();
+}
+
+bool AlignedFileBinaryWriter::IsOpen() const
+{
+	return file_handle != -1;
+}
+
+bool AlignedFileBinaryWriter::write_to_file(const void* Data, size_t NumBytes)
+{
+	const uint8_t* CurPtr = (const uint8_t*)Data;
+	while (NumBytes > 0 && write_failed == false)
+	{
+#ifdef __linux__
+		ssize_t Written = ::write((int)file_handle, CurPtr, NumBytes);
+		if (Written <= 0) {
+			write_failed = true;
+			break;
+		}
+#else
+		// WriteFile byte count is 32-bit, so write in 1GB chunks
+		DWORD ChunkBytes = (DWORD)((NumBytes < ((size_t)1 << 30)) ? NumBytes : ((size_t)1 << 30));
+		DWORD Written = 0;
+		if (::WriteFile((HANDLE)file_handle, CurPtr, ChunkBytes, &Written, nullptr) == FALSE || Written == 0) {
+			write_failed = true;
+			break;
+		}
+#endif
+		CurPtr += Written;
+		NumBytes -= (size_t)Written;
+	}
+	return !write_failed;
+}
+
+bool AlignedFileBinaryWriter::WriteBytes(const void* WriteBuffer, size_t ByteCount)
+{
+	if (!IsOpen() || write_failed) return false;
+
+	// large writes can skip the buffer, except in direct-IO mode where the source memory must be aligned
+	if (use_direct_io == false && buffer_used == 0 && ByteCount >= buffer_size)
+	{
+		total_bytes += ByteCount;
+		return write_to_file(WriteBuffer, ByteCount);
+	}
+
+	const uint8_t* CurPtr = (const uint8_t*)WriteBuffer;
+	while (ByteCount > 0)
+	{
+		size_t CopyBytes = buffer_size - buffer_used;
+		CopyBytes = (ByteCount < CopyBytes) ? ByteCount : CopyBytes;
+		memcpy_s(buffer + buffer_used, buffer_size - buffer_used, CurPtr, CopyBytes);
+		buffer_used += CopyBytes;
+		total_bytes += CopyBytes;
+		CurPtr += CopyBytes;
+		ByteCount -= CopyBytes;
+
+		if (buffer_used == buffer_size)
+		{
+			if (write_to_file(buffer, buffer_size) == false)
+				return false;
+			buffer_used = 0;
+		}
+	}
+	return true;
+}
+
+bool AlignedFileBinaryWriter::Flush()
+{
+	if (!IsOpen() || write_failed) return false;
+	if (buffer_used == 0) return true;
+
+	size_t FlushBytes = (use_direct_io) ? (buffer_used - (buffer_used % BlockAlignment)) : buffer_used;
+	if (FlushBytes > 0)
+	{
+		if (write_to_file(buffer, FlushBytes) == false)
+			return false;
+		size_t Remaining = buffer_used - FlushBytes;
+		if (Remaining > 0)
+			memmove(buffer, buffer + FlushBytes, Remaining);
+		buffer_used = Remaining;
+	}
+	return true;
+}
+
+bool AlignedFileBinaryWriter::finish_direct_io_tail()
+{
+	if (buffer_used == 0) return true;
+
+#ifdef __linux__
+	// turn off O_DIRECT for the final unaligned write
+	int Flags = ::fcntl((int)file_handle, F_GETFL);
+	if (Flags == -1 || ::fcntl((int)file_handle, F_SETFL, Flags & ~O_DIRECT) == -1) {
+		write_failed = true;
+		return false;
+	}
+	bool bOK = write_to_file(buffer, buffer_used);
+#else
+	// write a padded full block and then truncate the file to the actual size
+	size_t PaddedBytes = ((buffer_used + BlockAlignment - 1) / BlockAlignment) * BlockAlignment;
+	memset(buffer + buffer_used, 0, PaddedBytes - buffer_used);
+	bool bOK = write_to_file(buffer, PaddedBytes);
+	if (bOK) {
+		LARGE_INTEGER EndPosition;
+		EndPosition.QuadPart = (LONGLONG)total_bytes;
+		bOK = ::SetFilePointerEx((HANDLE)file_handle, EndPosition, nullptr, FILE_BEGIN) != FALSE
+			&& ::SetEndOfFile((HANDLE)file_handle) != FALSE;
+		write_failed = write_failed || !bOK;
+	}
+#endif
+	buffer_used = 0;
+	return bOK;
+}
+
+bool AlignedFileBinaryWriter::CloseFile()
+{
+	bool bOK = true;
+	if (IsOpen())
+	{
+		bOK = Flush();
+		if (bOK && use_direct_io)
+			bOK = finish_direct_io_tail();
+#ifdef __linux__
+		bOK = (::close((int)file_handle) == 0) && bOK;
+#else
+		bOK = (::CloseHandle((HANDLE)file_handle) != FALSE) && bOK;
+#endif
+		file_handle = -1;
+	}
+	release();
+	return bOK && !write_failed;
+}
+
+void AlignedFileBinaryWriter::release()
+{
+	if (buffer != nullptr)
+		GSLocal::free_aligned_buffer(buffer);
+	buffer = nullptr;
+	buffer_size = buffer_used = 0;
+}
@@ -0,0 +1,226 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Core/ContentHash.h"
+#include "Core/ParallelFor.h"
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	// XXH64 primes
+	static constexpr uint64_t Prime1 = 11400714785074694791ULL;
+	static constexpr uint64_t Prime2 = 14029467366897019727ULL;
+	static constexpr uint64_t Prime3 = 1609587929392839161ULL;
+	static constexpr uint64_t Prime4 = 9650029242287828579ULL;
+	static constexpr uint64_t Prime5 = 2870177450012600261ULL;
+
+	// seed offset used for the second half of the 128-bit hash
+	static constexpr uint64_t HighSeedOffset = 0x9E3779B97F4A7C15ULL;
+
+	// fixed chunk size for parallel hashing, changing this changes all hash values
+	static constexpr size_t HashChunkBytes = 256 * 1024;
+
+	static inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	static inline uint64_t read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+	static inline uint32_t read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+	static inline uint64_t round(uint64_t acc, uint64_t input)
+	{
+		acc += input * Prime2;
+		acc = rotl(acc, 31);
+		return acc * Prime1;
+	}
+	static inline uint64_t merge_round(uint64_t acc, uint64_t val)
+	{
+		acc ^= round(0, val);
+		return acc * Prime1 + Prime4;
+	}
+	static inline uint64_t avalanche(uint64_t h)
+	{
+		h ^= h >> 33; h *= Prime2;
+		h ^= h >> 29; h *= Prime3;
+		h ^= h >> 32;
+		return h;
+	}
+}
+
+
+std::string ContentHash128::ToHexString() const
+{
+	static const char* Digits = "0123456789abcdef";
+	std::string Result(32, '0');
+	for (int k = 0; k < 16; ++k) {
+		Result[15 - k] = Digits[(High >> (4*k)) & 0xF];
+		Result[31 - k] = Digits[(Low >> (4*k)) & 0xF];
+	}
+	return Result;
+}
+
+
+ContentHasher::ContentHasher(uint64_t Seed)
+{
+	Reset(Seed);
+}
+
+void ContentHasher::Reset(uint64_t Seed)
+{
+	using namespace GSLocal;
+	seed = Seed;
+	lanes[0] = Seed + Prime1 + Prime2;
+	lanes[1] = Seed + Prime2;
+	lanes[2] = Seed;
+	lanes[3] = Seed - Prime1;
+	total_bytes = 0;
+	num_pending = 0;
+}
+
+void ContentHasher::AppendBytes(const void* Data, size_t NumBytes)
+{
+	using namespace GSLocal;
+	const uint8_t* p = (const uint8_t*)Data;
+	total_bytes += NumBytes;
+
+	// complete a pending stripe
+	if (num_pending > 0)
+	{
+		size_t FillBytes = 32 - num_pending;
+		FillBytes = (NumBytes < FillBytes) ? NumBytes : FillBytes;
+		memcpy(pending + num_pending, p, FillBytes);
+		num_pending += (uint32_t)FillBytes;
+		p += FillBytes;
+		NumBytes -= FillBytes;
+		if (num_pending < 32) return;
+
+		for (int k = 0; k < 4; ++k)
+			lanes[k] = round(lanes[k], read64(pending + 8*k));
+		num_pending = 0;
+	}
+
+	// process full 32-byte stripes
+	uint64_t v0 = lanes[0], v1 = lanes[1], v2 = lanes[2], v3 = lanes[3];
+	const uint8_t* end = p + NumBytes;
+	while (p + 32 <= end)
+	{
+		v0 = round(v0, read64(p));
+		v1 = round(v1, read64(p + 8));
+		v2 = round(v2, read64(p + 16));
+		v3 = round(v3, read64(p + 24));
+		p += 32;
+	}
+	lanes[0] = v0; lanes[1] = v1; lanes[2] = v2; lanes[3] = v3;
+
+	if (p < end)
+	{
+		num_pending = (uint32_t)(end - p);
+		memcpy(pending, p, num_pending);
+	}
+}
+
+uint64_t ContentHasher::finalize(const uint64_t* lane_order, uint64_t seed_offset) const
+{
+	using namespace GSLocal;
+	uint64_t h;
+	if (total_bytes >= 32)
+	{
+		h = rotl(lanes[lane_order[0]], 1) + rotl(lanes[lane_order[1]], 7) + rotl(lanes[lane_order[2]], 12) + rotl(lanes[lane_order[3]], 18);
+		for (int k = 0; k < 4; ++k)
+			h = merge_round(h, lanes[lane_order[k]]);
+		h += seed_offset;
+	}
+	else
+	{
+		h = seed + seed_offset + Prime5;
+	}
+	h += total_bytes;
+
+	const uint8_t* p = pending;
+	const uint8_t* end = pending + num_pending;
+	while (p + 8 <= end) {
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * Prime1 + Prime4;
+		p += 8;
+	}
+	if (p + 4 <= end) {
+		h ^= (uint64_t)read32(p) * Prime1;
+		h = rotl(h, 23) * Prime2 + Prime3;
+		p += 4;
+	}
+	while (p < end) {
+		h ^= (*p) * Prime5;
+		h = rotl(h, 11) * Prime1;
+		p++;
+	}
+	return avalanche(h);
+}
+
+uint64_t ContentHasher::Finalize64() const
+{
+	static const uint64_t LaneOrder[4] = { 0, 1, 2, 3 };
+	return finalize(LaneOrder, 0);
+}
+
+ContentHash128 ContentHasher::Finalize128() const
+{
+	static const uint64_t HighLaneOrder[4] = { 2, 3, 0, 1 };
+	ContentHash128 Result;
+	Result.Low = Finalize64();
+	Result.High = finalize(HighLaneOrder, GSLocal::HighSeedOffset);
+	return Result;
+}
+
+
+
+ContentHash128 GS::ComputeContentHash(const void* Data, size_t NumBytes)
+{
+	using namespace GSLocal;
+	if (NumBytes <= HashChunkBytes)
+	{
+		ContentHasher Hasher;
+		if (NumBytes > 0)
+			Hasher.AppendBytes(Data, NumBytes);
+		return Hasher.Finalize128();
+	}
+
+	const uint8_t* Bytes = (const uint8_t*)Data;
+	size_t NumChunks = (NumBytes + HashChunkBytes - 1) / HashChunkBytes;
+	unsafe_vector<ContentHash128> ChunkHashes;
+	ChunkHashes.resize(NumChunks);
+	ParallelFor((uint32_t)NumChunks, [&](uint32_t ChunkIndex)
+	{
+		size_t Start = (size_t)ChunkIndex * HashChunkBytes;
+		size_t Count = (Start + HashChunkBytes <= NumBytes) ? HashChunkBytes : (NumBytes - Start);
+		ContentHasher Hasher;
+		Hasher.AppendBytes(Bytes + Start, Count);
+		ChunkHashes[ChunkIndex] = Hasher.Finalize128();
+	});
+
+	ContentHasher Combined;
+	Combined.AppendValue<uint64_t>((uint64_t)NumBytes);
+	Combined.AppendBytes(ChunkHashes.raw_pointer(), NumChunks * sizeof(ContentHash128));
+	return Combined.Finalize128();
+}
+
+
+ContentHash128 GS::ComputeContentHash(size_t NumElements, size_t ElementsPerChunk,
+	FunctionRef<void(size_t StartIndex, size_t Count, ContentHasher& Hasher)> AppendElementsFunc)
+{
+	ElementsPerChunk = (ElementsPerChunk > 0) ? ElementsPerChunk : 1;
+	size_t NumChunks = (NumElements + ElementsPerChunk - 1) / ElementsPerChunk;
+	unsafe_vector<ContentHash128> ChunkHashes;
+	ChunkHashes.resize(NumChunks);
+	ParallelFor((uint32_t)NumChunks, [&](uint32_t ChunkIndex)
+	{
+		size_t Start = (size_t)ChunkIndex * ElementsPerChunk;
+		size_t Count = (Start + ElementsPerChunk <= NumElements) ? ElementsPerChunk : (NumElements - Start);
+		ContentHasher Hasher;
+		AppendElementsFunc(Start, Count, Hasher);
+		ChunkHashes[ChunkIndex] = Hasher.Finalize128();
+	});
+
+	ContentHasher Combined;
+	Combined.AppendValue<uint64_t>((uint64_t)NumElements);
+	Combined.AppendValue<uint64_t>((uint64_t)ElementsPerChunk);
+	if (NumChunks > 0)
+		Combined.AppendBytes(ChunkHashes.raw_pointer(), NumChunks * sizeof(ContentHash128));
+	return Combined.Finalize128();
+}
@@ -0,0 +1,282 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Core/DerivedDataCache.h"
+#include "Core/BinaryIO.h"
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	struct DiskCacheFileHeader
+	{
+		uint32_t Magic = 0x44445347;		// 'GSDD'
+		uint32_t Version = 1;
+		ContentHash128 Key;
+		uint64_t DataBytes = 0;
+	};
+
+	static const char* DiskCacheFileExtension = ".gsdd";
+
+	// Temporary file name for a write of DiskPath. A random per-process value and a per-write counter
+	// make the name unique across threads and processes that write the same key concurrently.
+	static std::string MakeUniqueTempPath(const std::string& DiskPath)
+	{
+		static const uint64_t ProcessSalt = ((uint64_t)std::random_device{}() << 32) ^ (uint64_t)std::random_device{}();
+		static std::atomic<uint64_t> WriteCounter{ 0 };
+		char Suffix[64];
+		std::snprintf(Suffix, sizeof(Suffix), ".%016llx.%llu.tmp", (unsigned long long)ProcessSalt, (unsigned long long)WriteCounter++);
+		return DiskPath + Suffix;
+	}
+}
+
+
+DerivedDataCache::DerivedDataCache(size_t MaxMemoryBytes, const std::string& DiskCacheDirectory)
+{
+	max_memory_bytes = MaxMemoryBytes;
+	disk_directory = DiskCacheDirectory;
+}
+
+void DerivedDataCache::SetDiskCacheDirectory(const std::string& DiskCacheDirectory)
+{
+	std::lock_guard<std::mutex> Lock(cache_lock);
+	disk_directory = DiskCacheDirectory;
+}
+
+std::string DerivedDataCache::GetDiskCacheDirectory() const
+{
+	std::lock_guard<std::mutex> Lock(cache_lock);
+	return disk_directory;
+}
+
+void DerivedDataCache::SetMaxMemoryBytes(size_t MaxMemoryBytes)
+{
+	std::lock_guard<std::mutex> Lock(cache_lock);
+	max_memory_bytes = MaxMemoryBytes;
+	evict_to_limit();
+}
+
+size_t DerivedDataCache::GetMemoryBytes() const
+{
+	std::lock_guard<std::mutex> Lock(cache_lock);
+	return memory_bytes;
+}
+
+int DerivedDataCache::GetMemoryEntryCount() const
+{
+	std::lock_guard<std::mutex> Lock(cache_lock);
+	return (int)entry_map.size();
+}
+
+
+bool DerivedDataCache::Get(const ContentHash128& Key, FunctionRef<bool(ISerializer& Serializer)> RestoreFunc)
+{
+	BlobPtr Data;
+	{
+		std::lock_guard<std::mutex> Lock(cache_lock);
+		Data = find_memory(Key);
+	}
+	if (!Data)
+	{
+		Data = read_disk(Key);
+		if (!Data)
+			return false;
+		std::lock_guard<std::mutex> Lock(cache_lock);
+		insert_memory(Key, Data);
+	}
+
+	// the blob is shared with the cache and may be evicted concurrently, so restore from a copy
+	MemorySerializer Serializer;
+	Serializer.InitializeMemory(Data->size(), Data->data());
+	Serializer.BeginRead();
+	return RestoreFunc(Serializer);
+}
+
+
+bool DerivedDataCache::Put(const ContentHash128& Key, FunctionRef<bool(ISerializer& Serializer)> StoreFunc)
+{
+	MemorySerializer Serializer;
+	Serializer.BeginWrite();
+	if (StoreFunc(Serializer) == false)
+		return false;
+
+	size_t NumBytes = 0;
+	const uint8_t* Buffer = Serializer.GetBuffer(NumBytes);
+	SharedPtr<std::vector<uint8_t>> Data = MakeSharedPtr<std::vector<uint8_t>>(Buffer, Buffer + NumBytes);
+
+	bool bOK = write_disk(Key, *Data);
+
+	std::lock_guard<std::mutex> Lock(cache_lock);
+	insert_memory(Key, Data);
+	return bOK;
+}
+
+
+bool DerivedDataCache::Contains(const ContentHash128& Key) const
+{
+	std::string DiskPath;
+	{
+		std::lock_guard<std::mutex> Lock(cache_lock);
+		if (entry_map.find(Key) != entry_map.end())
+			return true;
+		if (disk_directory.empty())
+			return false;
+		DiskPath = get_disk_path(disk_directory, Key);
+	}
+	FileBinaryReader Reader = FileBinaryReader::OpenFile(DiskPath);
+	return Reader.IsOpen();
+}
+
+
+void DerivedDataCache::Remove(const ContentHash128& Key)
+{
+	std::string DiskPath;
+	{
+		std::lock_guard<std::mutex> Lock(cache_lock);
+		auto found = entry_map.find(Key);
+		if (found != entry_map.end())
+		{
+			memory_bytes -= found->second->Data->size();
+			lru_list.erase(found->second);
+			entry_map.erase(found);
+		}
+		if (disk_directory.empty())
+			return;
+		DiskPath = get_disk_path(disk_directory, Key);
+	}
+	std::remove(DiskPath.c_str());
+}
+
+
+void DerivedDataCache::ClearMemory()
+{
+	std::lock_guard<std::mutex> Lock(cache_lock);
+	lru_list.clear();
+	entry_map.clear();
+	memory_bytes = 0;
+}
+
+
+
+DerivedDataCache::BlobPtr DerivedDataCache::find_memory(const ContentHash128& Key)
+{
+	auto found = entry_map.find(Key);
+	if (found == entry_map.end())
+		return BlobPtr();
+	// move to front of LRU list
+	lru_list.splice(lru_list.begin(), lru_list, found->second);
+	return found->second->Data;
+}
+
+void DerivedDataCache::insert_memory(const ContentHash128& Key, BlobPtr Data)
+{
+	auto found = entry_map.find(Key);
+	if (found != entry_map.end())
+	{
+		memory_bytes -= found->second->Data->size();
+		lru_list.erase(found->second);
+		entry_map.erase(found);
+	}
+
+	// entries larger than the entire cache are not kept in memory
+	if (Data->size() > max_memory_bytes)
+		return;
+
+	lru_list.push_front(CacheEntry{ Key, Data });
+	entry_map[Key] = lru_list.begin();
+	memory_bytes += Data->size();
+	evict_to_limit();
+}
+
+void DerivedDataCache::evict_to_limit()
+{
+	while (memory_bytes > max_memory_bytes && lru_list.empty() == false)
+	{
+		const CacheEntry& Oldest = lru_list.back();
+		memory_bytes -= Oldest.Data->size();
+		entry_map.erase(Oldest.Key);
+		lru_list.pop_back();
+	}
+}
+
+
+std::string DerivedDataCache::get_disk_path(const std::string& Directory, const ContentHash128& Key) const
+{
+	std::string Path = Directory;
+	if (Path.empty() == false && Path.back() != '/' && Path.back() != '\\')
+		Path += '/';
+	Path += Key.ToHexString();
+	Path += GSLocal::DiskCacheFileExtension;
+	return Path;
+}
+
+DerivedDataCache::BlobPtr DerivedDataCache::read_disk(const ContentHash128& Key) const
+{
+	std::string DiskPath;
+	{
+		std::lock_guard<std::mutex> Lock(cache_lock);
+		if (disk_directory.empty())
+			return BlobPtr();
+		DiskPath = get_disk_path(disk_directory, Key);
+	}
+
+	FileBinaryReader Reader = FileBinaryReader::OpenFile(DiskPath);
+	if (!Reader)
+		return BlobPtr();
+
+	GSLocal::DiskCacheFileHeader ExpectedHeader, Header;
+	if (Reader.ReadBytes(&Header, sizeof(Header)) == false
+		|| Header.Magic != ExpectedHeader.Magic || Header.Version != ExpectedHeader.Version || Header.Key != Key)
+		return BlobPtr();
+
+	// a corrupt or truncated file is a cache miss, and must not be trusted for the allocation size
+	std::error_code FileSizeError;
+	uint64_t FileBytes = (uint64_t)std::filesystem::file_size(DiskPath, FileSizeError);
+	if (FileSizeError || FileBytes < sizeof(Header) || Header.DataBytes != FileBytes - sizeof(Header))
+		return BlobPtr();
+
+	SharedPtr<std::vector<uint8_t>> Data = MakeSharedPtr<std::vector<uint8_t>>();
+	Data->resize((size_t)Header.DataBytes);
+	if (Header.DataBytes > 0 && Reader.ReadBytes(Data->data(), Data->size()) == false)
+		return BlobPtr();
+	return Data;
+}
+
+bool DerivedDataCache::write_disk(const ContentHash128& Key, const std::vector<uint8_t>& Data) const
+{
+	std::string DiskPath;
+	{
+		std::lock_guard<std::mutex> Lock(cache_lock);
+		if (disk_directory.empty())
+			return true;
+		DiskPath = get_disk_path(disk_directory, Key);
+	}
+
+	// write to a temporary file and then rename, so that readers never see a partially-written file
+	std::string TempPath = GSLocal::MakeUniqueTempPath(DiskPath);
+	bool bOK = false;
+	{
+		FileBinaryWriter Writer = FileBinaryWriter::OpenFile(TempPath);
+		if (!Writer)
+			return false;
+		GSLocal::DiskCacheFileHeader Header;
+		Header.Key = Key;
+		Header.DataBytes = Data.size();
+		bOK = Writer.WriteBytes(&Header, sizeof(Header));
+		bOK = bOK && (Data.size() == 0 || Writer.WriteBytes(Data.data(), Data.size()));
+		Writer.CloseFile();
+	}
+	if (bOK)
+	{
+		// rename does not replace existing files on all platforms
+		std::remove(DiskPath.c_str());
+		bOK = (std::rename(TempPath.c_str(), DiskPath.c_str()) == 0);
+	}
+	if (!bOK)
+		std::remove(TempPath.c_str());
+	return bOK;
+}
@@ -0,0 +1,202 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Core/MemoryMappedFile.h"
+
+#ifdef __linux__
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#elif defined(GS_EMBEDDED_UE_BUILD)
+	#include "Windows/AllowWindowsPlatformTypes.h"
+	#include <windows.h>
+	#include "Windows/HideWindowsPlatformTypes.h"
+#else
+	#ifndef WIN32_LEAN_AND_MEAN
+	#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#endif
+
+using namespace GS;
+
+
+MemoryMappedFile::MemoryMappedFile()
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	Close();
+}
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& moved)
+{
+	move_from(moved);
+}
+
+MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& moved)
+{
+	if (this != &moved)
+	{
+		Close();
+		move_from(moved);
+	}
+	return *this;
+}
+
+void MemoryMappedFile::move_from(MemoryMappedFile& moved)
+{
+	MappedData = moved.MappedData;
+	FileSize = moved.FileSize;
+	bIsOpen = moved.bIsOpen;
+	FileHandle = moved.FileHandle;
+	MappingHandle = moved.MappingHandle;
+
+	moved.MappedData = nullptr;
+	moved.FileSize = 0;
+	moved.bIsOpen = false;
+	moved.FileHandle = -1;
+	moved.MappingHandle = 0;
+}
+
+
+#ifdef __linux__
+
+bool MemoryMappedFile::Open(const std::string& FilePath)
+{
+	Close();
+
+	int fd = ::open(FilePath.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat FileStats;
+	if (::fstat(fd, &FileStats) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	FileHandle = (intptr_t)fd;
+	FileSize = (size_t)FileStats.st_size;
+	if (FileSize > 0)
+	{
+		void* MappedPtr = ::mmap(nullptr, FileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (MappedPtr == MAP_FAILED) {
+			::close(fd);
+			FileHandle = -1;
+			FileSize = 0;
+			return false;
+		}
+		MappedData = (const uint8_t*)MappedPtr;
+	}
+	bIsOpen = true;
+	return true;
+}
+
+void MemoryMappedFile::Close()
+{
+	if (MappedData != nullptr)
+		::munmap((void*)MappedData, FileSize);
+	if (FileHandle >= 0)
+		::close((int)FileHandle);
+
+	MappedData = nullptr;
+	FileSize = 0;
+	FileHandle = -1;
+	bIsOpen = false;
+}
+
+void MemoryMappedFile::PrefetchRange(size_t Offset, size_t Length) const
+{
+	if (MappedData == nullptr || Offset >= FileSize) return;
+	Length = (Offset + Length > FileSize) ? (FileSize - Offset) : Length;
+
+	// madvise requires page-aligned start address
+	size_t PageSize = (size_t)::sysconf(_SC_PAGESIZE);
+	size_t AlignedOffset = Offset - (Offset % PageSize);
+	::madvise((void*)(MappedData + AlignedOffset), Length + (Offset - AlignedOffset), MADV_WILLNEED);
+}
+
+void MemoryMappedFile::AdviseSequential() const
+{
+	if (MappedData != nullptr)
+		::madvise((void*)MappedData, FileSize, MADV_SEQUENTIAL);
+}
+
+#else	// Windows
+
+bool MemoryMappedFile::Open(const std::string& FilePath)
+{
+	Close();
+
+	HANDLE hFile = ::CreateFileA(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, 
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER Size;
+	if (::GetFileSizeEx(hFile, &Size) == FALSE) {
+		::CloseHandle(hFile);
+		return false;
+	}
+
+	FileHandle = (intptr_t)hFile;
+	FileSize = (size_t)Size.QuadPart;
+	if (FileSize > 0)
+	{
+		HANDLE hMapping = ::CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* MappedPtr = (hMapping != nullptr) ? ::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (MappedPtr == nullptr) {
+			if (hMapping != nullptr) ::CloseHandle(hMapping);
+			::CloseHandle(hFile);
+			FileHandle = -1;
+			FileSize = 0;
+			return false;
+		}
+		MappingHandle = (intptr_t)hMapping;
+		MappedData = (const uint8_t*)MappedPtr;
+	}
+	bIsOpen = true;
+	return true;
+}
+
+void MemoryMappedFile::Close()
+{
+	if (MappedData != nullptr)
+		::UnmapViewOfFile((LPCVOID)MappedData);
+	if (MappingHandle != 0)
+		::CloseHandle((HANDLE)MappingHandle);
+	if (FileHandle != -1)
+		::CloseHandle((HANDLE)FileHandle);
+
+	MappedData = nullptr;
+	FileSize = 0;
+	MappingHandle = 0;
+	FileHandle = -1;
+	bIsOpen = false;
+}
+
+void MemoryMappedFile::PrefetchRange(size_t Offset, size_t Length) const
+{
+	if (MappedData == nullptr || Offset >= FileSize) return;
+	Length = (Offset + Length > FileSize) ? (FileSize - Offset) : Length;
+
+	WIN32_MEMORY_RANGE_ENTRY Range;
+	Range.VirtualAddress = (PVOID)(MappedData + Offset);
+	Range.NumberOfBytes = Length;
+	::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &Range, 0);
+}
+
+void MemoryMappedFile::AdviseSequential() const
+{
+	// file was opened with FILE_FLAG_SEQUENTIAL_SCAN
+}
+
+#endif
+
+
+const_buffer_view<uint8_t> MemoryMappedFile::MapRange(size_t Offset, size_t Length) const
+{
+	if (MappedData == nullptr || Offset >= FileSize)
+		return const_buffer_view<uint8_t>();
+	Length = (Offset + Length > FileSize) ? (FileSize - Offset) : Length;
+	return const_buffer_view<uint8_t>(MappedData + Offset, Length);
+}
@@ -0,0 +1,67 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Core/ParallelSort.h"
+#include "Core/ParallelFor.h"
+#include "Math/GSMath.h"
+
+#include <algorithm>
+
+using namespace GS;
+
+
+void GS::ParallelRadixSortUpper32(unsafe_vector<uint64_t>& Keys, int NumKeyBits, bool bParallel)
+{
+	static constexpr int32_t SortBlockSize = 16 * 1024;
+
+	int32_t N = (int32_t)Keys.size();
+	NumKeyBits = GS::Clamp(NumKeyBits, 0, 32);
+	// use digits of at most 11 bits, split evenly across the passes (eg 2x11 bits for 22-bit keys rather than 3x8)
+	int NumPasses = (NumKeyBits + 10) / 11;
+	if (N <= 1 || NumPasses == 0)
+		return;
+	int DigitBits = (NumKeyBits + NumPasses - 1) / NumPasses;
+	int NumDigits = 1 << DigitBits;
+	uint64_t DigitMask = (uint64_t)(NumDigits - 1);
+
+	unsafe_vector<uint64_t> Temp;
+	Temp.resize(N);
+	uint64_t* Src = Keys.raw_pointer();
+	uint64_t* Dst = Temp.raw_pointer();
+	int32_t NumBlocks = (N + SortBlockSize - 1) / SortBlockSize;
+	unsafe_vector<int32_t> BlockCounts;
+	BlockCounts.resize((size_t)NumBlocks * NumDigits);
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+
+	for (int Pass = 0; Pass < NumPasses; ++Pass)
+	{
+		int Shift = 32 + DigitBits * Pass;
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t* Counts = &BlockCounts[(size_t)BlockIndex * NumDigits];
+			for (int b = 0; b < NumDigits; ++b)
+				Counts[b] = 0;
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * SortBlockSize, N);
+			for (int32_t i = (int32_t)BlockIndex * SortBlockSize; i < BlockEnd; ++i)
+				Counts[(Src[i] >> Shift) & DigitMask]++;
+		}, Flags);
+
+		// convert counts to offsets, in (digit, block) order so the sort is stable
+		int32_t Offset = 0;
+		for (int b = 0; b < NumDigits; ++b) {
+			for (int32_t Block = 0; Block < NumBlocks; ++Block) {
+				int32_t Count = BlockCounts[(size_t)Block * NumDigits + b];
+				BlockCounts[(size_t)Block * NumDigits + b] = Offset;
+				Offset += Count;
+			}
+		}
+
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t* Offsets = &BlockCounts[(size_t)BlockIndex * NumDigits];
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * SortBlockSize, N);
+			for (int32_t i = (int32_t)BlockIndex * SortBlockSize; i < BlockEnd; ++i)
+				Dst[Offsets[(Src[i] >> Shift) & DigitMask]++] = Src[i];
+		}, Flags);
+		GS::SwapTemp(Src, Dst);
+	}
+	if (Src != Keys.raw_pointer())
+		std::copy(Src, Src + N, Keys.raw_pointer());
+}
@@ -136,3 +136,79 @@ bool FileTextReader::ReadLine(char* ToBuffer, int MaxCount)
 	char* Result = fgets(ToBuffer, MaxCount, FilePtr);
 	return (Result != nullptr);
 }
+
+
+
+
+
+MappedTextReader::MappedTextReader()
+{
+}
+
+MappedTextReader MappedTextReader::OpenFile(const std::string& FilePath)
+{
+	MappedTextReader Result;
+	if (Result.mapped_file.Open(FilePath))
+		Result.mapped_file.AdviseSequential();
+	return Result;
+}
+
+bool MappedTextReader::IsEndOfFile() const
+{
+	return read_position >= mapped_file.GetSize();
+}
+
+bool MappedTextReader::operator!() const
+{
+	return !mapped_file.IsOpen();
+}
+
+bool MappedTextReader::IsOpen() const
+{
+	return mapped_file.IsOpen();
+}
+
+void MappedTextReader::CloseFile()
+{
+	mapped_file.Close();
+	read_position = 0;
+}
+
+std::string_view MappedTextReader::GetText() const
+{
+	return (mapped_file.GetData() != nullptr) ?
+		std::string_view((const char*)mapped_file.GetData(), mapped_file.GetSize()) : std::string_view();
+}
+
+void MappedTextReader::SetPosition(size_t Position)
+{
+	read_position = (Position < mapped_file.GetSize()) ? Position : mapped_file.GetSize();
+}
+
+bool MappedTextReader::ReadLine(std::string_view& LineOut)
+{
+	size_t FileSize = mapped_file.GetSize();
+	if (read_position >= FileSize) return false;
+
+	const char* Text = (const char*)mapped_file.GetData();
+	const char* LineStart = Text + read_position;
+	const char* LineEnd = (const char*)memchr(LineStart, '\n', FileSize - read_position);
+	size_t LineLength = (LineEnd != nullptr) ? (size_t)(LineEnd - LineStart) : (FileSize - read_position);
+	read_position += LineLength + ((LineEnd != nullptr) ? 1 : 0);
+
+	if (LineLength > 0 && LineStart[LineLength-1] == '\r')
+		LineLength--;
+	LineOut = std::string_view(LineStart, LineLength);
+	return true;
+}
+
+bool MappedTextReader::ReadLine(char* ToBuffer, int MaxCount)
+{
+	std::string_view Line;
+	if (MaxCount <= 0 || ReadLine(Line) == false) return false;
+	size_t CopyCount = (Line.size() < (size_t)(MaxCount-1)) ? Line.size() : (size_t)(MaxCount-1);
+	if (CopyCount > 0)
+		memcpy_s(ToBuffer, MaxCount, Line.data(), CopyCount);
+	ToBuffer[CopyCount] = 0;
+	return true;
+}
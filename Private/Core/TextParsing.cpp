@@ -0,0 +1,29 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Core/TextParsing.h"
+
+using namespace GS;
+
+
+void GS::TextParsing::SplitIntoLineChunks(std::string_view Text, size_t TargetChunkBytes, unsafe_vector<std::string_view>& ChunksOut)
+{
+	ChunksOut.clear();
+	TargetChunkBytes = (TargetChunkBytes > 0) ? TargetChunkBytes : 1;
+
+	const char* Data = Text.data();
+	size_t N = Text.size();
+	size_t ChunkStart = 0;
+	while (ChunkStart < N)
+	{
+		size_t ChunkEnd = ChunkStart + TargetChunkBytes;
+		if (ChunkEnd >= N) {
+			ChunkEnd = N;
+		}
+		else {
+			// extend chunk to include the rest of the current line
+			const char* LineEnd = (const char*)memchr(Data + ChunkEnd, '\n', N - ChunkEnd);
+			ChunkEnd = (LineEnd != nullptr) ? (size_t)(LineEnd - Data) + 1 : N;
+		}
+		ChunksOut.add(Text.substr(ChunkStart, ChunkEnd - ChunkStart));
+		ChunkStart = ChunkEnd;
+	}
+}
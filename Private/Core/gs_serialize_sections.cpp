@@ -0,0 +1,165 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Core/gs_serialize_sections.h"
+#include "Core/gs_debug.h"
+
+using namespace GS;
+
+
+struct SectionDirectoryVersions
+{
+	static constexpr uint32_t CurrentVersionNumber = 1;
+};
+
+
+bool SerializeSectionDirectory::StoreSections(
+	GS::ISerializer& Serializer,
+	const uint32_t* SectionIDs, int NumSections,
+	SectionFunc StoreSectionFunc)
+{
+	gs_debug_assert(NumSections > 0 && NumSections <= 32);
+	GS::SerializationVersion CurrentVersion(SectionDirectoryVersions::CurrentVersionNumber);
+	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
+
+	uint32_t NumStoredSections = (uint32_t)NumSections;
+	bOK = bOK && Serializer.WriteValue<uint32_t>("NumSections", NumStoredSections);
+	bOK = bOK && Serializer.WriteData("SectionIDs", SectionIDs, sizeof(uint32_t) * NumSections);
+
+	// each section is serialized into a temporary buffer and then written as a single block,
+	// so that its size is known when reading and it can be skipped without parsing it
+	MemorySerializer SectionSerializer;
+	for (int k = 0; k < NumSections && bOK; ++k)
+	{
+		SectionSerializer.BeginWrite();
+		bOK = StoreSectionFunc(SectionIDs[k], SectionSerializer);
+
+		size_t NumBytes = 0;
+		const uint8_t* SectionData = SectionSerializer.GetBuffer(NumBytes);
+		bOK = bOK && Serializer.WriteValue<uint32_t>("SectionID", SectionIDs[k]);
+		bOK = bOK && Serializer.WriteValue<size_t>("SectionBytes", NumBytes);
+		if (NumBytes > 0)
+			bOK = bOK && Serializer.WriteData("SectionData", SectionData, NumBytes);
+	}
+	return bOK;
+}
+
+
+bool SerializeSectionDirectory::read_section(GS::ISerializer& Serializer, Section& SectionInfo, bool bRestore, SectionFunc RestoreSectionFunc)
+{
+	uint32_t StoredSectionID = 0;
+	size_t NumBytes = 0;
+	bool bOK = Serializer.ReadValue<uint32_t>("SectionID", StoredSectionID);
+	bOK = bOK && (StoredSectionID == SectionInfo.SectionID);
+	bOK = bOK && Serializer.ReadValue<size_t>("SectionBytes", NumBytes);
+	if (!bOK || NumBytes == 0)
+	{
+		SectionInfo.bRestored = bOK && bRestore;
+		return bOK;
+	}
+
+	if (bRestore)
+	{
+		MemorySerializer SectionSerializer;
+		SectionSerializer.InitializeMemory(NumBytes);
+		size_t BufferBytes = 0;
+		uint8_t* SectionData = SectionSerializer.GetWritableBuffer(BufferBytes);
+		bOK = Serializer.ReadData("SectionData", NumBytes, SectionData);
+		SectionSerializer.BeginRead();
+		bOK = bOK && RestoreSectionFunc(SectionInfo.SectionID, SectionSerializer);
+		SectionInfo.bRestored = bOK;
+	}
+	else
+	{
+		bOK = Serializer.SkipData("SectionData", NumBytes);
+	}
+	return bOK;
+}
+
+
+bool SerializeSectionDirectory::RestoreSections(
+	GS::ISerializer& Serializer,
+	uint32_t RequestedSections,
+	bool bAllowDeferred,
+	SectionFunc RestoreSectionFunc)
+{
+	Sections.clear();
+
+	GS::SerializationVersion Version;
+	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
+	gs_debug_assert(Version.Version == SectionDirectoryVersions::CurrentVersionNumber);
+
+	uint32_t NumSections = 0;
+	bOK = bOK && Serializer.ReadValue<uint32_t>("NumSections", NumSections);
+	bOK = bOK && (NumSections > 0 && NumSections <= 32);
+	if (!bOK) return false;
+
+	uint32_t SectionIDs[32];
+	bOK = Serializer.ReadData("SectionIDs", sizeof(uint32_t) * NumSections, SectionIDs);
+
+	bool bCanDefer = bAllowDeferred && Serializer.SupportsSeek();
+	for (uint32_t k = 0; k < NumSections && bOK; ++k)
+	{
+		Section NewSection;
+		NewSection.SectionID = SectionIDs[k];
+		bool bRestore = (SectionIDs[k] & RequestedSections) != 0;
+		if (!bRestore && bCanDefer)
+		{
+			NewSection.bDeferred = true;
+			NewSection.ReadPosition = Serializer.GetReadPosition();
+		}
+		bOK = read_section(Serializer, NewSection, bRestore, RestoreSectionFunc);
+		Sections.add(NewSection);
+	}
+	return bOK;
+}
+
+
+bool SerializeSectionDirectory::RestoreDeferredSections(
+	GS::ISerializer& Serializer,
+	uint32_t RequestedSections,
+	SectionFunc RestoreSectionFunc)
+{
+	if ((GetDeferredSections() & RequestedSections) == 0) 
+		return true;
+	if (Serializer.SupportsSeek() == false) 
+		return false;
+
+	size_t InitialPosition = Serializer.GetReadPosition();
+	bool bOK = true;
+	for (Section& DeferredSection : Sections)
+	{
+		if (DeferredSection.bDeferred == false || (DeferredSection.SectionID & RequestedSections) == 0) 
+			continue;
+
+		bOK = bOK && Serializer.SetReadPosition(DeferredSection.ReadPosition);
+		bOK = bOK && read_section(Serializer, DeferredSection, true, RestoreSectionFunc);
+		if (bOK) 
+			DeferredSection.bDeferred = false;
+	}
+	Serializer.SetReadPosition(InitialPosition);
+	return bOK;
+}
+
+
+uint32_t SerializeSectionDirectory::GetStoredSections() const
+{
+	uint32_t Mask = 0;
+	for (const Section& Info : Sections)
+		Mask |= Info.SectionID;
+	return Mask;
+}
+
+uint32_t SerializeSectionDirectory::GetRestoredSections() const
+{
+	uint32_t Mask = 0;
+	for (const Section& Info : Sections)
+		Mask |= (Info.bRestored) ? Info.SectionID : 0;
+	return Mask;
+}
+
+uint32_t SerializeSectionDirectory::GetDeferredSections() const
+{
+	uint32_t Mask = 0;
+	for (const Section& Info : Sections)
+		Mask |= (Info.bDeferred) ? Info.SectionID : 0;
+	return Mask;
+}
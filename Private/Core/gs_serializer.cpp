@@ -19,6 +19,12 @@ bool ISerializer::ReadBoolean(const char* key, bool& bValue)
 	return bOK;
 }
 
+bool ISerializer::SkipData(const char* key, size_t num_bytes)
+{
+	std::vector<uint8_t> temp_buffer((num_bytes > 0) ? num_bytes : 1);
+	return ReadData(key, num_bytes, &temp_buffer[0]);
+}
+
 bool ISerializer::WriteVersion(const char* key, const SerializationVersion& Version)
 {
 	return WriteData(key, &Version.Packed, sizeof(size_t));
@@ -92,16 +98,17 @@ void MemorySerializer::BeginRead()
 	is_reading = true;
 }
 
-bool MemorySerializer::ReadData(const char* key, size_t num_bytes, void* buffer)
+const uint8_t* MemorySerializer::read_record_header(const char* key, size_t num_bytes)
 {
 	gs_debug_assert(is_reading == true);
 
-	gs_debug_assert(buffer != nullptr);
-	if (buffer == nullptr) return false;
-
-	uint8_t* cur_ptr = &data[read_index];
+	size_t header_bytes = sizeof(size_t) + 1 + sizeof(size_t);
+	if (read_index + header_bytes > data.size()) {
+		gs_debug_assert(false);
+		return nullptr;
+	}
 
-	// TODO: check that we are staying in size of data
+	const uint8_t* cur_ptr = &data[read_index];
 
 	// read key length
 	size_t key_len = 0;
@@ -109,6 +116,8 @@ bool MemorySerializer::ReadData(const char* key, size_t num_bytes, void* buffer)
 	cur_ptr += sizeof(size_t);
 	read_index += sizeof(size_t);
 	gs_debug_assert(key_len > 0 && key_len < 128);
+	if (key_len >= 128 || read_index + key_len + 1 + sizeof(size_t) > data.size()) 
+		return nullptr;
 
 	// read key
 	char key_buffer[128];
@@ -120,7 +129,7 @@ bool MemorySerializer::ReadData(const char* key, size_t num_bytes, void* buffer)
 	if (validate_keys)
 	{
 		gs_debug_assert(key_bytes == key_len);
-		for (int k = 0; k < key_bytes; ++k)
+		for (size_t k = 0; k < key_bytes; ++k)
 		{
 			gs_debug_assert(key_buffer[k] == key[k]);
 		}
@@ -139,14 +148,40 @@ bool MemorySerializer::ReadData(const char* key, size_t num_bytes, void* buffer)
 	read_index += sizeof(size_t);
 
 	gs_debug_assert(bytes_len == num_bytes);
+	if (bytes_len != num_bytes || read_index + num_bytes > data.size())
+		return nullptr;
+
+	return cur_ptr;
+}
+
+bool MemorySerializer::ReadData(const char* key, size_t num_bytes, void* buffer)
+{
+	gs_debug_assert(buffer != nullptr);
+	if (buffer == nullptr) return false;
+
+	const uint8_t* cur_ptr = read_record_header(key, num_bytes);
+	if (cur_ptr == nullptr) return false;
 
 	// read data
 	memcpy_s(buffer, num_bytes, cur_ptr, num_bytes);
-	cur_ptr += num_bytes;
 	read_index += num_bytes;
 
-	// any final checks?
+	return true;
+}
 
+bool MemorySerializer::SkipData(const char* key, size_t num_bytes)
+{
+	const uint8_t* cur_ptr = read_record_header(key, num_bytes);
+	if (cur_ptr == nullptr) return false;
+	read_index += num_bytes;
+	return true;
+}
+
+bool MemorySerializer::SetReadPosition(size_t Position)
+{
+	gs_debug_assert(is_reading == true);
+	if (is_reading == false || Position > data.size()) return false;
+	read_index = Position;
 	return true;
 }
 
@@ -1,12 +1,15 @@
 // Copyright Gradientspace Corp. All Rights Reserved.
 #include "Core/packed_int_lists.h"
 
+#include <string>
+
 using namespace GS;
 
 void packed_int_lists::Initialize(int NumListIDs, int ListSizeEstimate, size_t KnownExactTotalListItems)
 {
 	ListPointers.initialize(NumListIDs, -1);
 	PackedLists.resize(0);
+	NumUnusedElements = 0;
 	if (KnownExactTotalListItems > 0)
 		PackedLists.reserve(KnownExactTotalListItems + (size_t)NumListIDs);
 	else if (ListSizeEstimate > 0)
@@ -46,6 +49,62 @@ int packed_int_lists::AppendList(int NumItems, const int* Items)
 }
 
 
+void packed_int_lists::ReplaceList(int ListID, const_buffer_view<int> Items)
+{
+	int NumItems = (int)Items.size();
+	int ListIndex = ListPointers[ListID];
+	if (ListIndex >= 0 && NumItems <= PackedLists[ListIndex] && NumItems > 0)
+	{
+		NumUnusedElements += PackedLists[ListIndex] - NumItems;
+		PackedLists[ListIndex] = NumItems;
+		for (int k = 0; k < NumItems; ++k)
+			PackedLists[ListIndex + 1 + k] = Items[k];
+		return;
+	}
+	RemoveList(ListID);
+	if (NumItems > 0)
+		AppendList(ListID, Items);
+}
+
+void packed_int_lists::RemoveList(int ListID)
+{
+	int ListIndex = ListPointers[ListID];
+	if (ListIndex >= 0) {
+		NumUnusedElements += PackedLists[ListIndex] + 1;
+		ListPointers[ListID] = -1;
+	}
+}
+
+void packed_int_lists::GrowLists(int NumListIDs)
+{
+	for (int ListID = (int)ListPointers.size(); ListID < NumListIDs; ++ListID)
+		ListPointers.add(-1);
+}
+
+void packed_int_lists::Compact()
+{
+	if (NumUnusedElements == 0)
+		return;
+	unsafe_vector<int> NewPackedLists;
+	NewPackedLists.reserve(PackedLists.size() - NumUnusedElements);
+	int NumListIDs = (int)ListPointers.size();
+	for (int ListID = 0; ListID < NumListIDs; ++ListID)
+	{
+		int ListIndex = ListPointers[ListID];
+		if (ListIndex < 0)
+			continue;
+		ListPointers[ListID] = (int)NewPackedLists.size();
+		int NumItems = PackedLists[ListIndex];
+		for (int k = 0; k <= NumItems; ++k)
+			NewPackedLists.add(PackedLists[ListIndex + k]);
+	}
+	// unsafe_vector move-assignment does not free existing storage, so release the old lists first
+	PackedLists.clear(true);
+	PackedLists = std::move(NewPackedLists);
+	NumUnusedElements = 0;
+}
+
+
 const_buffer_view<int> packed_int_lists::GetListView(int ListID) const
 {
 	int ListIndex = ListPointers[ListID];
@@ -54,3 +113,27 @@ const_buffer_view<int> packed_int_lists::GetListView(int ListID) const
 	const int* ptr = PackedLists.raw_pointer(ListIndex);
 	return const_buffer_view<int>(ptr + 1, ptr[0]);
 }
+
+
+
+bool packed_int_lists::Store(GS::ISerializer& Serializer, const char* custom_key) const
+{
+	static constexpr uint32_t CurrentVersionNumber = 1;
+	GS::SerializationVersion CurrentVersion(CurrentVersionNumber);
+	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
+	std::string KeyPrefix = (custom_key != nullptr) ? custom_key : "";
+	bOK = bOK && ListPointers.Store(Serializer, (KeyPrefix + "ListPointers").c_str());
+	bOK = bOK && PackedLists.Store(Serializer, (KeyPrefix + "PackedLists").c_str());
+	return bOK;
+}
+
+bool packed_int_lists::Restore(GS::ISerializer& Serializer, const char* custom_key)
+{
+	GS::SerializationVersion Version;
+	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
+	std::string KeyPrefix = (custom_key != nullptr) ? custom_key : "";
+	bOK = bOK && ListPointers.Restore(Serializer, (KeyPrefix + "ListPointers").c_str());
+	bOK = bOK && PackedLists.Restore(Serializer, (KeyPrefix + "PackedLists").c_str());
+	NumUnusedElements = 0;
+	return bOK;
+}
@@ -0,0 +1,108 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Intersection/GSRayBatch.h"
+
+#include <algorithm>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	// spread the low 10 bits of x so that there are two zero bits between each bit
+	inline uint32_t morton3_spread_bits10(uint32_t x)
+	{
+		x &= 0x3FF;
+		x = (x | (x << 16)) & 0x030000FF;
+		x = (x | (x << 8)) & 0x0300F00F;
+		x = (x | (x << 4)) & 0x030C30C3;
+		x = (x | (x << 2)) & 0x09249249;
+		return x;
+	}
+
+	inline uint32_t quantize_unit(double Value, uint32_t MaxValue)
+	{
+		double Clamped = GS::Clamp(Value, 0.0, 1.0);
+		return (uint32_t)(Clamped * (double)MaxValue + 0.5);
+	}
+}
+
+
+void GS::RayBatch::Clear()
+{
+	Rays.clear(true);
+	MaxDistances.clear(true);
+	SourceIndices.clear(true);
+	OriginX.clear(true); OriginY.clear(true); OriginZ.clear(true);
+	InvDirX.clear(true); InvDirY.clear(true); InvDirZ.clear(true);
+	OriginBounds = AxisBox3d::Empty();
+}
+
+
+void GS::RayBatch::Initialize(const_buffer_view<Ray3d> InputRays, double MaxDistance, bool bSortForCoherence)
+{
+	initialize_internal(InputRays, nullptr, MaxDistance, bSortForCoherence);
+}
+
+void GS::RayBatch::Initialize(const_buffer_view<Ray3d> InputRays, const_buffer_view<double> InputMaxDistances, bool bSortForCoherence)
+{
+	gs_debug_assert(InputMaxDistances.size() == InputRays.size());
+	initialize_internal(InputRays, &InputMaxDistances[0], 0.0, bSortForCoherence);
+}
+
+
+void GS::RayBatch::initialize_internal(const_buffer_view<Ray3d> InputRays, const double* InputMaxDistances, double ConstantMaxDistance, bool bSortForCoherence)
+{
+	Clear();
+	int NumRays = (int)InputRays.size();
+	if (NumRays == 0)
+		return;
+
+	for (int k = 0; k < NumRays; ++k)
+		OriginBounds.Contain(InputRays[k].Origin);
+
+	SourceIndices.resize(NumRays);
+	if (bSortForCoherence && NumRays > 1)
+	{
+		// sort key is (octant, direction morton code, origin morton code) in the upper 32 bits, and ray index in the lower 32 bits
+		Vector3d OriginMin = OriginBounds.Min;
+		double OriginScale = GS::Max(OriginBounds.DimensionX(), GS::Max(OriginBounds.DimensionY(), OriginBounds.DimensionZ()));
+		OriginScale = (OriginScale > 0) ? (1.0 / OriginScale) : 0.0;
+		unsafe_vector<uint64_t> SortKeys;
+		SortKeys.resize(NumRays);
+		for (int k = 0; k < NumRays; ++k)
+		{
+			const Ray3d& Ray = InputRays[k];
+			uint32_t Octant = (Ray.Direction.X < 0 ? 1 : 0) | (Ray.Direction.Y < 0 ? 2 : 0) | (Ray.Direction.Z < 0 ? 4 : 0);
+			uint32_t DirCode = 0, OriginCode = 0;
+			for (int j = 0; j < 3; ++j) {
+				DirCode |= GSLocal::morton3_spread_bits10(GSLocal::quantize_unit(GS::Abs(Ray.Direction[j]), 15)) << j;
+				OriginCode |= GSLocal::morton3_spread_bits10(GSLocal::quantize_unit((Ray.Origin[j] - OriginMin[j]) * OriginScale, 31)) << j;
+			}
+			uint32_t Code = (Octant << 27) | (DirCode << 15) | OriginCode;
+			SortKeys[k] = ((uint64_t)Code << 32) | (uint64_t)k;
+		}
+		std::sort(SortKeys.raw_pointer(), SortKeys.raw_pointer() + NumRays);
+		for (int k = 0; k < NumRays; ++k)
+			SourceIndices[k] = (int32_t)(SortKeys[k] & 0xFFFFFFFF);
+	}
+	else
+	{
+		for (int k = 0; k < NumRays; ++k)
+			SourceIndices[k] = k;
+	}
+
+	Rays.resize(NumRays);
+	MaxDistances.resize(NumRays);
+	OriginX.resize(NumRays); OriginY.resize(NumRays); OriginZ.resize(NumRays);
+	InvDirX.resize(NumRays); InvDirY.resize(NumRays); InvDirZ.resize(NumRays);
+	for (int k = 0; k < NumRays; ++k)
+	{
+		int32_t SourceIndex = SourceIndices[k];
+		const Ray3d& Ray = InputRays[SourceIndex];
+		Rays[k] = Ray;
+		MaxDistances[k] = (InputMaxDistances != nullptr) ? InputMaxDistances[SourceIndex] : ConstantMaxDistance;
+		PreparedRay3f Prepared(Ray);
+		OriginX[k] = Prepared.Origin[0]; OriginY[k] = Prepared.Origin[1]; OriginZ[k] = Prepared.Origin[2];
+		InvDirX[k] = Prepared.InvDirection[0]; InvDirY[k] = Prepared.InvDirection[1]; InvDirZ[k] = Prepared.InvDirection[2];
+	}
+}
@@ -2,6 +2,17 @@
 #include "Intersection/GSRayBoxIntersection.h"
 #include "Math/GSMath.h"
 
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GS_RAYBOX_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define GS_RAYBOX_AVX 1
+#include <immintrin.h>
+#endif
+
 using namespace GS;
 
 
@@ -87,3 +98,160 @@ bool GS::ComputeRayBoxIntersection(const Ray3d& Ray, const GS::AxisBox3d& Box,
 
 	return true;
 }
+
+
+
+
+namespace GSLocal
+{
+	// relative padding of far slab distances, 1 + 2*gamma(3) as in PBRT, so that rounding in the
+	// slab computations can't cull a box that the ray touches
+	static constexpr float RayBoxFarPadding = 1.0f + 2.0f * (3.0f * std::numeric_limits<float>::epsilon() * 0.5f) / (1.0f - 3.0f * std::numeric_limits<float>::epsilon() * 0.5f);
+}
+
+
+template<int Width>
+uint32_t GS::TestRayWideBoxIntersection(const PreparedRay3f& Ray, const WideAxisBox3f<Width>& Boxes, float MaxDistance, float* EntryDistOut)
+{
+	// near/far planes are selected by direction sign, so empty lanes (Min > Max) always fail
+	const float* NearX = (Ray.InvDirection[0] >= 0) ? Boxes.MinX : Boxes.MaxX;
+	const float* FarX = (Ray.InvDirection[0] >= 0) ? Boxes.MaxX : Boxes.MinX;
+	const float* NearY = (Ray.InvDirection[1] >= 0) ? Boxes.MinY : Boxes.MaxY;
+	const float* FarY = (Ray.InvDirection[1] >= 0) ? Boxes.MaxY : Boxes.MinY;
+	const float* NearZ = (Ray.InvDirection[2] >= 0) ? Boxes.MinZ : Boxes.MaxZ;
+	const float* FarZ = (Ray.InvDirection[2] >= 0) ? Boxes.MaxZ : Boxes.MinZ;
+
+#if defined(GS_RAYBOX_AVX)
+	if constexpr (Width == 8)
+	{
+		__m256 OX = _mm256_set1_ps(Ray.Origin[0]), OY = _mm256_set1_ps(Ray.Origin[1]), OZ = _mm256_set1_ps(Ray.Origin[2]);
+		__m256 IX = _mm256_set1_ps(Ray.InvDirection[0]), IY = _mm256_set1_ps(Ray.InvDirection[1]), IZ = _mm256_set1_ps(Ray.InvDirection[2]);
+		__m256 TNear = _mm256_setzero_ps(), TFar = _mm256_set1_ps(MaxDistance);
+		TNear = _mm256_max_ps(TNear, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(NearX), OX), IX));
+		TNear = _mm256_max_ps(TNear, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(NearY), OY), IY));
+		TNear = _mm256_max_ps(TNear, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(NearZ), OZ), IZ));
+		TFar = _mm256_min_ps(TFar, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(FarX), OX), IX));
+		TFar = _mm256_min_ps(TFar, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(FarY), OY), IY));
+		TFar = _mm256_min_ps(TFar, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(FarZ), OZ), IZ));
+		TFar = _mm256_mul_ps(TFar, _mm256_set1_ps(GSLocal::RayBoxFarPadding));
+		if (EntryDistOut != nullptr)
+			_mm256_storeu_ps(EntryDistOut, TNear);
+		return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(TNear, TFar, _CMP_LE_OQ));
+	}
+#endif
+	uint32_t Mask = 0;
+#if defined(GS_RAYBOX_SSE)
+	__m128 OX = _mm_set1_ps(Ray.Origin[0]), OY = _mm_set1_ps(Ray.Origin[1]), OZ = _mm_set1_ps(Ray.Origin[2]);
+	__m128 IX = _mm_set1_ps(Ray.InvDirection[0]), IY = _mm_set1_ps(Ray.InvDirection[1]), IZ = _mm_set1_ps(Ray.InvDirection[2]);
+	__m128 Padding = _mm_set1_ps(GSLocal::RayBoxFarPadding);
+	for (int k = 0; k < Width; k += 4)
+	{
+		__m128 TNear = _mm_setzero_ps(), TFar = _mm_set1_ps(MaxDistance);
+		TNear = _mm_max_ps(TNear, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(NearX + k), OX), IX));
+		TNear = _mm_max_ps(TNear, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(NearY + k), OY), IY));
+		TNear = _mm_max_ps(TNear, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(NearZ + k), OZ), IZ));
+		TFar = _mm_min_ps(TFar, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(FarX + k), OX), IX));
+		TFar = _mm_min_ps(TFar, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(FarY + k), OY), IY));
+		TFar = _mm_min_ps(TFar, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(FarZ + k), OZ), IZ));
+		TFar = _mm_mul_ps(TFar, Padding);
+		if (EntryDistOut != nullptr)
+			_mm_storeu_ps(EntryDistOut + k, TNear);
+		Mask |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(TNear, TFar)) << k;
+	}
+#else
+	for (int k = 0; k < Width; ++k)
+	{
+		float TNear = 0, TFar = MaxDistance;
+		TNear = GS::Max(TNear, (NearX[k] - Ray.Origin[0]) * Ray.InvDirection[0]);
+		TNear = GS::Max(TNear, (NearY[k] - Ray.Origin[1]) * Ray.InvDirection[1]);
+		TNear = GS::Max(TNear, (NearZ[k] - Ray.Origin[2]) * Ray.InvDirection[2]);
+		TFar = GS::Min(TFar, (FarX[k] - Ray.Origin[0]) * Ray.InvDirection[0]);
+		TFar = GS::Min(TFar, (FarY[k] - Ray.Origin[1]) * Ray.InvDirection[1]);
+		TFar = GS::Min(TFar, (FarZ[k] - Ray.Origin[2]) * Ray.InvDirection[2]);
+		TFar *= GSLocal::RayBoxFarPadding;
+		if (EntryDistOut != nullptr)
+			EntryDistOut[k] = TNear;
+		if (TNear <= TFar)
+			Mask |= (1u << k);
+	}
+#endif
+	return Mask;
+}
+
+
+template<int Width>
+uint32_t GS::TestRayPacketBoxIntersection(const RayPacket3f<Width>& Packet, const AxisBox3f& Box, float* EntryDistOut)
+{
+	// direction signs vary per lane, so slab distances are ordered with min/max. PreparedRay3f inverse
+	// directions are finite, so there are no NaNs here.
+	if (Box.Min.X > Box.Max.X || Box.Min.Y > Box.Max.Y || Box.Min.Z > Box.Max.Z)
+		return 0;
+
+#if defined(GS_RAYBOX_AVX)
+	if constexpr (Width == 8)
+	{
+		__m256 TNear = _mm256_setzero_ps(), TFar = _mm256_loadu_ps(Packet.MaxDistance);
+		const float* Origins[3] = { Packet.OriginX, Packet.OriginY, Packet.OriginZ };
+		const float* InvDirs[3] = { Packet.InvDirX, Packet.InvDirY, Packet.InvDirZ };
+		for (int j = 0; j < 3; ++j)
+		{
+			__m256 O = _mm256_loadu_ps(Origins[j]), I = _mm256_loadu_ps(InvDirs[j]);
+			__m256 T0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(Box.Min[j]), O), I);
+			__m256 T1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(Box.Max[j]), O), I);
+			TNear = _mm256_max_ps(TNear, _mm256_min_ps(T0, T1));
+			TFar = _mm256_min_ps(TFar, _mm256_max_ps(T0, T1));
+		}
+		TFar = _mm256_mul_ps(TFar, _mm256_set1_ps(GSLocal::RayBoxFarPadding));
+		if (EntryDistOut != nullptr)
+			_mm256_storeu_ps(EntryDistOut, TNear);
+		return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(TNear, TFar, _CMP_LE_OQ));
+	}
+#endif
+	uint32_t Mask = 0;
+#if defined(GS_RAYBOX_SSE)
+	__m128 MinX = _mm_set1_ps(Box.Min.X), MinY = _mm_set1_ps(Box.Min.Y), MinZ = _mm_set1_ps(Box.Min.Z);
+	__m128 MaxX = _mm_set1_ps(Box.Max.X), MaxY = _mm_set1_ps(Box.Max.Y), MaxZ = _mm_set1_ps(Box.Max.Z);
+	__m128 Padding = _mm_set1_ps(GSLocal::RayBoxFarPadding);
+	for (int k = 0; k < Width; k += 4)
+	{
+		__m128 OX = _mm_loadu_ps(Packet.OriginX + k), IX = _mm_loadu_ps(Packet.InvDirX + k);
+		__m128 OY = _mm_loadu_ps(Packet.OriginY + k), IY = _mm_loadu_ps(Packet.InvDirY + k);
+		__m128 OZ = _mm_loadu_ps(Packet.OriginZ + k), IZ = _mm_loadu_ps(Packet.InvDirZ + k);
+		__m128 TX0 = _mm_mul_ps(_mm_sub_ps(MinX, OX), IX), TX1 = _mm_mul_ps(_mm_sub_ps(MaxX, OX), IX);
+		__m128 TY0 = _mm_mul_ps(_mm_sub_ps(MinY, OY), IY), TY1 = _mm_mul_ps(_mm_sub_ps(MaxY, OY), IY);
+		__m128 TZ0 = _mm_mul_ps(_mm_sub_ps(MinZ, OZ), IZ), TZ1 = _mm_mul_ps(_mm_sub_ps(MaxZ, OZ), IZ);
+		__m128 TNear = _mm_max_ps(_mm_max_ps(_mm_setzero_ps(), _mm_min_ps(TX0, TX1)), _mm_max_ps(_mm_min_ps(TY0, TY1), _mm_min_ps(TZ0, TZ1)));
+		__m128 TFar = _mm_min_ps(_mm_min_ps(_mm_loadu_ps(Packet.MaxDistance + k), _mm_max_ps(TX0, TX1)), _mm_min_ps(_mm_max_ps(TY0, TY1), _mm_max_ps(TZ0, TZ1)));
+		TFar = _mm_mul_ps(TFar, Padding);
+		if (EntryDistOut != nullptr)
+			_mm_storeu_ps(EntryDistOut + k, TNear);
+		Mask |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(TNear, TFar)) << k;
+	}
+#else
+	const float* Origins[3] = { Packet.OriginX, Packet.OriginY, Packet.OriginZ };
+	const float* InvDirs[3] = { Packet.InvDirX, Packet.InvDirY, Packet.InvDirZ };
+	for (int k = 0; k < Width; ++k)
+	{
+		float TNear = 0, TFar = Packet.MaxDistance[k];
+		for (int j = 0; j < 3; ++j) {
+			float T0 = (Box.Min[j] - Origins[j][k]) * InvDirs[j][k];
+			float T1 = (Box.Max[j] - Origins[j][k]) * InvDirs[j][k];
+			TNear = GS::Max(TNear, GS::Min(T0, T1));
+			TFar = GS::Min(TFar, GS::Max(T0, T1));
+		}
+		TFar *= GSLocal::RayBoxFarPadding;
+		if (EntryDistOut != nullptr)
+			EntryDistOut[k] = TNear;
+		if (TNear <= TFar)
+			Mask |= (1u << k);
+	}
+#endif
+	return Mask;
+}
+
+
+// explicit instantiation
+template GRADIENTSPACECORE_API uint32_t GS::TestRayWideBoxIntersection<4>(const PreparedRay3f&, const WideAxisBox3f<4>&, float, float*);
+template GRADIENTSPACECORE_API uint32_t GS::TestRayWideBoxIntersection<8>(const PreparedRay3f&, const WideAxisBox3f<8>&, float, float*);
+template GRADIENTSPACECORE_API uint32_t GS::TestRayPacketBoxIntersection<4>(const RayPacket3f<4>&, const AxisBox3f&, float*);
+template GRADIENTSPACECORE_API uint32_t GS::TestRayPacketBoxIntersection<8>(const RayPacket3f<8>&, const AxisBox3f&, float*);
@@ -1,6 +1,7 @@
 // Copyright Gradientspace Corp. All Rights Reserved.
 
 #include "Mesh/DenseMesh.h"
+#include "Math/GSMath.h"
 
 using namespace GS;
 
@@ -17,26 +18,97 @@ DenseMesh::DenseMesh()
 void DenseMesh::Clear()
 {
 	Positions.clear();
+	PositionsF.clear();
 
 	Triangles.clear();
 	TriGroups.clear();
 	TriMaterialIndexes.clear();
-	TriVertexNormals.clear();
-	TriVertexUVs.clear();
-	TriVertexColors.clear();
+	DiscardNormals();
+	DiscardUVs();
+	DiscardColors();
+
+	RestoredSections.Reset();
 }
 
 
 void DenseMesh::Resize(int VertexCount, int TriangleCount)
 {
-	Positions.resize(VertexCount);
+	if (bFloatPositions)
+		PositionsF.resize(VertexCount);
+	else
+		Positions.resize(VertexCount);
 
 	Triangles.resize(TriangleCount);
 	TriGroups.resize(TriangleCount);
 	TriMaterialIndexes.resize(TriangleCount);
-	TriVertexNormals.resize(TriangleCount);
-	TriVertexUVs.resize(TriangleCount);
-	TriVertexColors.resize(TriangleCount);
+
+	// optional attributes are only resized if they are enabled
+	if (bHasNormals)
+		TriVertexNormals.resize(TriangleCount);
+	for (int k = 0; k < NumUVSets; ++k)
+		TriVertexUVs[k].resize(TriangleCount);
+	if (bHasColors)
+		TriVertexColors.resize(TriangleCount);
+}
+
+
+void DenseMesh::SetFloatPositions(bool bEnable)
+{
+	if (bEnable == bFloatPositions) return;
+
+	int NumVertices = GetVertexCount();
+	if (bEnable) {
+		PositionsF.resize(NumVertices);
+		for (int k = 0; k < NumVertices; ++k)
+			PositionsF[k] = (Vector3f)Positions[k];
+		Positions.clear();
+	} else {
+		Positions.resize(NumVertices);
+		for (int k = 0; k < NumVertices; ++k)
+			Positions[k] = (Vector3d)PositionsF[k];
+		PositionsF.clear();
+	}
+	bFloatPositions = bEnable;
+}
+
+
+void DenseMesh::EnableNormals()
+{
+	if (bHasNormals) return;
+	TriVertexNormals.resize_init(GetTriangleCount(), TriVtxNormals(Vector3f::Zero()));
+	bHasNormals = true;
+}
+
+void DenseMesh::DiscardNormals()
+{
+	TriVertexNormals.clear();
+	bHasNormals = false;
+}
+
+
+void DenseMesh::SetNumUVSets(int NumSets)
+{
+	gs_debug_assert(NumSets >= 0 && NumSets <= MaxUVSets);
+	NumSets = GS::Clamp(NumSets, 0, MaxUVSets);
+	for (int k = NumSets; k < NumUVSets; ++k)
+		TriVertexUVs[k].clear();
+	for (int k = NumUVSets; k < NumSets; ++k)
+		TriVertexUVs[k].resize_init(GetTriangleCount(), TriVtxUVs(Vector2f::Zero()));
+	NumUVSets = NumSets;
+}
+
+
+void DenseMesh::EnableColors()
+{
+	if (bHasColors) return;
+	TriVertexColors.resize_init(GetTriangleCount(), TriVtxColors(Color4b::White()));
+	bHasColors = true;
+}
+
+void DenseMesh::DiscardColors()
+{
+	TriVertexColors.clear();
+	bHasColors = false;
 }
 
 
@@ -45,7 +117,12 @@ void DenseMesh::Resize(int VertexCount, int TriangleCount)
 
 struct DenseMeshVersions
 {
-	static constexpr uint32_t CurrentVersionNumber = 1;
+	static constexpr uint32_t Version1 = 1;
+	//! version 2 stores each attribute buffer in a separate section, see SerializeSectionDirectory
+	static constexpr uint32_t Version2 = 2;
+	//! version 3 only stores enabled attributes, and adds float positions and multiple UV sets
+	static constexpr uint32_t Version3 = 3;
+	static constexpr uint32_t CurrentVersionNumber = Version3;
 };
 
 struct DenseMeshHeaderV1
@@ -54,50 +131,158 @@ struct DenseMeshHeaderV1
 	uint32_t TriangleCount = 0;
 };
 
+static const uint32_t DenseMeshStoredSections[] = {
+	(uint32_t)EDenseMeshSections::Positions,
+	(uint32_t)EDenseMeshSections::Triangles,
+	(uint32_t)EDenseMeshSections::TriGroups,
+	(uint32_t)EDenseMeshSections::TriMaterialIndexes,
+	(uint32_t)EDenseMeshSections::TriVertexNormals,
+	(uint32_t)EDenseMeshSections::TriVertexUVs,
+	(uint32_t)EDenseMeshSections::TriVertexColors
+};
+
 bool DenseMesh::Store(GS::ISerializer& Serializer) const
 {
 	GS::SerializationVersion CurrentVersion(DenseMeshVersions::CurrentVersionNumber);
 	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
 
 	DenseMeshHeaderV1 Header;
-	Header.VertexCount = (uint32_t)Positions.size();
+	Header.VertexCount = (uint32_t)GetVertexCount();
 	Header.TriangleCount = (uint32_t)Triangles.size();
 	bOK = bOK && Serializer.WriteValue<DenseMeshHeaderV1>("DenseMesh", Header);
 
-	bOK = bOK && Positions.Store(Serializer, "Positions");
-	bOK = bOK && Triangles.Store(Serializer, "Triangles");
-	bOK = bOK && TriGroups.Store(Serializer, "TriGroups");
-	bOK = bOK && TriMaterialIndexes.Store(Serializer, "TriMaterialIndexes");
-	bOK = bOK && TriVertexNormals.Store(Serializer, "TriVertexNormals");
-	bOK = bOK && TriVertexUVs.Store(Serializer, "TriVertexUVs");
-	bOK = bOK && TriVertexColors.Store(Serializer, "TriVertexColors");
+	bOK = bOK && SerializeSectionDirectory::StoreSections(Serializer, DenseMeshStoredSections, 7,
+		[&](uint32_t SectionID, GS::ISerializer& SectionSerializer)
+	{
+		// disabled attributes are stored as an empty buffer
+		switch ((EDenseMeshSections)SectionID)
+		{
+			case EDenseMeshSections::Positions: {
+				bool bSectionOK = SectionSerializer.WriteValue<uint32_t>("FloatPositions", (bFloatPositions) ? 1 : 0);
+				return bSectionOK && ((bFloatPositions) ? PositionsF.Store(SectionSerializer, "Positions") : Positions.Store(SectionSerializer, "Positions"));
+			}
+			case EDenseMeshSections::Triangles: return Triangles.Store(SectionSerializer, "Triangles");
+			case EDenseMeshSections::TriGroups: return TriGroups.Store(SectionSerializer, "TriGroups");
+			case EDenseMeshSections::TriMaterialIndexes: return TriMaterialIndexes.Store(SectionSerializer, "TriMaterialIndexes");
+			case EDenseMeshSections::TriVertexNormals: {
+				bool bSectionOK = SectionSerializer.WriteValue<uint32_t>("HasNormals", (bHasNormals) ? 1 : 0);
+				return bSectionOK && TriVertexNormals.Store(SectionSerializer, "TriVertexNormals");
+			}
+			case EDenseMeshSections::TriVertexUVs: {
+				bool bSectionOK = SectionSerializer.WriteValue<uint32_t>("NumUVSets", (uint32_t)NumUVSets);
+				for (int k = 0; k < NumUVSets; ++k)
+					bSectionOK = bSectionOK && TriVertexUVs[k].Store(SectionSerializer, "TriVertexUVs");
+				return bSectionOK;
+			}
+			case EDenseMeshSections::TriVertexColors: {
+				bool bSectionOK = SectionSerializer.WriteValue<uint32_t>("HasColors", (bHasColors) ? 1 : 0);
+				return bSectionOK && TriVertexColors.Store(SectionSerializer, "TriVertexColors");
+			}
+			default: return false;
+		}
+	});
 
 	return bOK;
 }
 
 bool DenseMesh::Restore(GS::ISerializer& Serializer)
 {
+	return Restore(Serializer, DenseMeshRestoreOptions());
+}
+
+bool DenseMesh::Restore(GS::ISerializer& Serializer, const DenseMeshRestoreOptions& Options)
+{
+	Clear();
+	bFloatPositions = false;
+
 	GS::SerializationVersion Version;
 	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
-	gs_debug_assert(Version.Version == DenseMeshVersions::CurrentVersionNumber);
+	gs_debug_assert(Version.Version >= DenseMeshVersions::Version1 && Version.Version <= DenseMeshVersions::Version3);
+	RestoredVersion = Version.Version;
 
 	DenseMeshHeaderV1 Header;
 	bOK = bOK && Serializer.ReadValue<DenseMeshHeaderV1>("DenseMesh", Header);
 
-	bOK = bOK && Positions.Restore(Serializer, "Positions");
-	bOK = bOK && Triangles.Restore(Serializer, "Triangles");
-	bOK = bOK && TriGroups.Restore(Serializer, "TriGroups");
-	bOK = bOK && TriMaterialIndexes.Restore(Serializer, "TriMaterialIndexes");
-	bOK = bOK && TriVertexNormals.Restore(Serializer, "TriVertexNormals");
-	bOK = bOK && TriVertexUVs.Restore(Serializer, "TriVertexUVs");
-	bOK = bOK && TriVertexColors.Restore(Serializer, "TriVertexColors");
-
-	gs_debug_assert(Positions.size() == Header.VertexCount);
-	gs_debug_assert(Triangles.size() == Header.TriangleCount);
-	gs_debug_assert(TriGroups.size() == Header.TriangleCount);
-	gs_debug_assert(TriVertexNormals.size() == Header.TriangleCount);
-	gs_debug_assert(TriVertexUVs.size() == Header.TriangleCount);
-	gs_debug_assert(TriVertexColors.size() == Header.TriangleCount);
+	if (bOK && Version.Version == DenseMeshVersions::Version1)
+	{
+		// V1 has no section directory, all sections are always restored
+		bOK = bOK && Positions.Restore(Serializer, "Positions");
+		bOK = bOK && Triangles.Restore(Serializer, "Triangles");
+		bOK = bOK && TriGroups.Restore(Serializer, "TriGroups");
+		bOK = bOK && TriMaterialIndexes.Restore(Serializer, "TriMaterialIndexes");
+		bOK = bOK && TriVertexNormals.Restore(Serializer, "TriVertexNormals");
+		bOK = bOK && TriVertexUVs[0].Restore(Serializer, "TriVertexUVs");
+		bOK = bOK && TriVertexColors.Restore(Serializer, "TriVertexColors");
+		bHasNormals = bHasColors = true;
+		NumUVSets = 1;
+
+		gs_debug_assert(Positions.size() == Header.VertexCount);
+		gs_debug_assert(Triangles.size() == Header.TriangleCount);
+		gs_debug_assert(TriGroups.size() == Header.TriangleCount);
+		gs_debug_assert(TriVertexNormals.size() == Header.TriangleCount);
+		gs_debug_assert(TriVertexUVs[0].size() == Header.TriangleCount);
+		gs_debug_assert(TriVertexColors.size() == Header.TriangleCount);
+		return bOK;
+	}
+
+	bOK = bOK && RestoredSections.RestoreSections(Serializer, (uint32_t)Options.Sections, Options.bAllowDeferredSections,
+		[&](uint32_t SectionID, GS::ISerializer& SectionSerializer) { return restore_section(SectionID, SectionSerializer); });
 
+	gs_debug_assert(!HasSections(EDenseMeshSections::Positions) || GetVertexCount() == (int)Header.VertexCount);
+	gs_debug_assert(!HasSections(EDenseMeshSections::Triangles) || Triangles.size() == Header.TriangleCount);
 	return bOK;
 }
+
+bool DenseMesh::RestoreDeferredSections(GS::ISerializer& Serializer, EDenseMeshSections Sections)
+{
+	return RestoredSections.RestoreDeferredSections(Serializer, (uint32_t)Sections,
+		[&](uint32_t SectionID, GS::ISerializer& SectionSerializer) { return restore_section(SectionID, SectionSerializer); });
+}
+
+bool DenseMesh::HasSections(EDenseMeshSections Sections) const
+{
+	// if nothing was restored the mesh was constructed directly, and all sections are available
+	if (RestoredSections.Sections.size() == 0) 
+		return true;
+	uint32_t Restored = RestoredSections.GetRestoredSections();
+	return ((uint32_t)Sections & Restored) == (uint32_t)Sections;
+}
+
+EDenseMeshSections DenseMesh::GetDeferredSections() const
+{
+	return (EDenseMeshSections)RestoredSections.GetDeferredSections();
+}
+
+bool DenseMesh::restore_section(uint32_t SectionID, GS::ISerializer& SectionSerializer)
+{
+	// V2 always stores all attributes, V3 stores flags/counts before the attribute buffers
+	bool bV3 = (RestoredVersion >= DenseMeshVersions::Version3);
+	uint32_t StoredFlag = 1;
+	switch ((EDenseMeshSections)SectionID)
+	{
+		case EDenseMeshSections::Positions:
+			if (bV3 && SectionSerializer.ReadValue<uint32_t>("FloatPositions", StoredFlag) == false) return false;
+			// positions are restored in the stored precision
+			bFloatPositions = bV3 && (StoredFlag != 0);
+			return (bFloatPositions) ? PositionsF.Restore(SectionSerializer, "Positions") : Positions.Restore(SectionSerializer, "Positions");
+		case EDenseMeshSections::Triangles: return Triangles.Restore(SectionSerializer, "Triangles");
+		case EDenseMeshSections::TriGroups: return TriGroups.Restore(SectionSerializer, "TriGroups");
+		case EDenseMeshSections::TriMaterialIndexes: return TriMaterialIndexes.Restore(SectionSerializer, "TriMaterialIndexes");
+		case EDenseMeshSections::TriVertexNormals:
+			if (bV3 && SectionSerializer.ReadValue<uint32_t>("HasNormals", StoredFlag) == false) return false;
+			bHasNormals = (StoredFlag != 0);
+			return TriVertexNormals.Restore(SectionSerializer, "TriVertexNormals");
+		case EDenseMeshSections::TriVertexUVs:
+			if (bV3 && SectionSerializer.ReadValue<uint32_t>("NumUVSets", StoredFlag) == false) return false;
+			if (StoredFlag > (uint32_t)MaxUVSets) return false;
+			NumUVSets = (int)StoredFlag;
+			for (int k = 0; k < NumUVSets; ++k)
+				if (TriVertexUVs[k].Restore(SectionSerializer, "TriVertexUVs") == false) return false;
+			return true;
+		case EDenseMeshSections::TriVertexColors:
+			if (bV3 && SectionSerializer.ReadValue<uint32_t>("HasColors", StoredFlag) == false) return false;
+			bHasColors = (StoredFlag != 0);
+			return TriVertexColors.Restore(SectionSerializer, "TriVertexColors");
+		default: return false;
+	}
+}
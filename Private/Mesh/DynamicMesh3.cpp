@@ -0,0 +1,770 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Mesh/DynamicMesh3.h"
+#include "Mesh/DenseMesh.h"
+#include "Mesh/MeshTypes.h"
+#include "Math/GSMath.h"
+#include "Core/gs_debug.h"
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	// return the vertex of TriVertices that is not VertexA or VertexB
+	static int DynMeshFindTriOtherVtx(int VertexA, int VertexB, const Index3i& TriVertices)
+	{
+		for (int j = 0; j < 3; ++j)
+			if (TriVertices[j] != VertexA && TriVertices[j] != VertexB)
+				return TriVertices[j];
+		return DynamicMesh3::InvalidID;
+	}
+
+	// swap VertexA and VertexB if needed so that (VertexA,VertexB) has the same orientation as TriVertices
+	static void DynMeshOrientTriEdge(int& VertexA, int& VertexB, const Index3i& TriVertices)
+	{
+		for (int j = 0; j < 3; ++j) {
+			if (TriVertices[j] == VertexA) {
+				if (TriVertices[(j + 1) % 3] != VertexB)
+					std::swap(VertexA, VertexB);
+				return;
+			}
+		}
+	}
+
+	static void DynMeshReplaceTriVertex(Index3i& TriVertices, int OldVertexID, int NewVertexID)
+	{
+		for (int j = 0; j < 3; ++j)
+			if (TriVertices[j] == OldVertexID)
+				TriVertices[j] = NewVertexID;
+	}
+}
+
+
+DynamicMesh3::DynamicMesh3()
+{
+}
+
+
+void DynamicMesh3::Clear()
+{
+	Positions.clear(true);
+	VertexRefCounts.clear();
+	VertexEdges.Clear();
+	Triangles.clear(true);
+	TriangleEdges.clear(true);
+	TriangleRefCounts.clear();
+	TriangleGroups.clear(true);
+	bHasTriangleGroups = false;
+	Edges.clear(true);
+	EdgeRefCounts.clear();
+}
+
+
+void DynamicMesh3::EnableTriangleGroups(int InitialGroup)
+{
+	if (bHasTriangleGroups)
+		return;
+	TriangleGroups.initialize(MaxTriangleID(), InitialGroup);
+	bHasTriangleGroups = true;
+}
+
+void DynamicMesh3::DiscardTriangleGroups()
+{
+	TriangleGroups.clear(true);
+	bHasTriangleGroups = false;
+}
+
+
+void DynamicMesh3::Copy(const DenseMesh& Mesh, bool bCopyGroups, unsafe_vector<int>* SkippedTrianglesOut)
+{
+	Clear();
+	int NumVertices = Mesh.GetVertexCount();
+	int NumTriangles = Mesh.GetTriangleCount();
+	Positions.reserve(NumVertices);
+	for (int VertexID = 0; VertexID < NumVertices; ++VertexID)
+		AppendVertex(Mesh.GetPosition(VertexID));
+
+	bool bGroups = bCopyGroups && Mesh.HasSections(EDenseMeshSections::TriGroups);
+	if (bGroups)
+		EnableTriangleGroups(0);
+	Triangles.reserve(NumTriangles);
+	TriangleEdges.reserve(NumTriangles);
+	for (int TriIndex = 0; TriIndex < NumTriangles; ++TriIndex)
+	{
+		int TriangleID = AppendTriangle(Mesh.GetTriangle(TriIndex), (bGroups) ? Mesh.GetTriGroup(TriIndex) : 0);
+		if (TriangleID < 0 && SkippedTrianglesOut != nullptr)
+			SkippedTrianglesOut->add(TriIndex);
+	}
+	VertexEdges.Compact();
+}
+
+
+void DynamicMesh3::ExtractCompactMesh(DenseMesh& MeshOut, unsafe_vector<int>* VertexMapOut, unsafe_vector<int>* TriangleMapOut) const
+{
+	unsafe_vector<int> LocalVertexMap;
+	unsafe_vector<int>& VertexMap = (VertexMapOut != nullptr) ? *VertexMapOut : LocalVertexMap;
+	VertexMap.initialize(MaxVertexID(), InvalidID);
+	if (TriangleMapOut != nullptr)
+		TriangleMapOut->initialize(MaxTriangleID(), InvalidID);
+
+	MeshOut.Clear();
+	MeshOut.Resize(VertexCount(), TriangleCount());
+	int VertexIndex = 0;
+	for (int VertexID = 0; VertexID < MaxVertexID(); ++VertexID) {
+		if (IsVertex(VertexID)) {
+			VertexMap[VertexID] = VertexIndex;
+			MeshOut.SetPosition(VertexIndex++, Positions[VertexID]);
+		}
+	}
+	int TriIndex = 0;
+	for (int TriangleID = 0; TriangleID < MaxTriangleID(); ++TriangleID)
+	{
+		if (IsTriangle(TriangleID) == false)
+			continue;
+		const Index3i& TriV = Triangles[TriangleID];
+		MeshOut.SetTriangle(TriIndex, Index3i(VertexMap[TriV.A], VertexMap[TriV.B], VertexMap[TriV.C]));
+		MeshOut.SetTriGroup(TriIndex, (bHasTriangleGroups) ? TriangleGroups[TriangleID] : 0);
+		if (TriangleMapOut != nullptr)
+			(*TriangleMapOut)[TriangleID] = TriIndex;
+		TriIndex++;
+	}
+}
+
+
+int DynamicMesh3::AppendVertex(const Vector3d& Position)
+{
+	int VertexID = VertexRefCounts.allocate();
+	if (VertexID == (int)Positions.size())
+		Positions.add(Position);
+	else
+		Positions[VertexID] = Position;
+	VertexEdges.GrowLists(VertexID + 1);
+	return VertexID;
+}
+
+
+int DynamicMesh3::AppendTriangle(const Index3i& TriVertices, int Group)
+{
+	if (IsVertex(TriVertices.A) == false || IsVertex(TriVertices.B) == false || IsVertex(TriVertices.C) == false)
+		return InvalidID;
+	if (TriVertices.A == TriVertices.B || TriVertices.B == TriVertices.C || TriVertices.C == TriVertices.A)
+		return InvalidID;
+
+	Index3i ExistingEdges;
+	for (int j = 0; j < 3; ++j) {
+		ExistingEdges[j] = FindEdge(TriVertices[j], TriVertices[(j + 1) % 3]);
+		if (ExistingEdges[j] != InvalidID && IsBoundaryEdge(ExistingEdges[j]) == false)
+			return NonManifoldID;
+	}
+
+	int TriangleID = allocate_triangle(TriVertices, Group);
+	Index3i TriEdges;
+	for (int j = 0; j < 3; ++j)
+	{
+		VertexRefCounts.increment(TriVertices[j]);
+		if (ExistingEdges[j] != InvalidID) {
+			Edges[ExistingEdges[j]].Triangles.B = TriangleID;
+			TriEdges[j] = ExistingEdges[j];
+		}
+		else
+			TriEdges[j] = add_edge(TriVertices[j], TriVertices[(j + 1) % 3], TriangleID);
+	}
+	TriangleEdges[TriangleID] = TriEdges;
+	return TriangleID;
+}
+
+
+EDynamicMeshResult DynamicMesh3::RemoveTriangle(int TriangleID, bool bRemoveIsolatedVertices)
+{
+	if (IsTriangle(TriangleID) == false)
+		return EDynamicMeshResult::Failed_NotATriangle;
+
+	Index3i TriV = Triangles[TriangleID];
+	Index3i TriE = TriangleEdges[TriangleID];
+	for (int j = 0; j < 3; ++j)
+	{
+		replace_edge_triangle(TriE[j], TriangleID, InvalidID);
+		if (Edges[TriE[j]].Triangles.A == InvalidID)
+			remove_edge(TriE[j]);
+	}
+	TriangleRefCounts.decrement(TriangleID);
+	for (int j = 0; j < 3; ++j)
+	{
+		VertexRefCounts.decrement(TriV[j]);
+		if (bRemoveIsolatedVertices && VertexRefCounts.refcount(TriV[j]) == 1)
+			remove_isolated_vertex(TriV[j]);
+	}
+	return EDynamicMeshResult::Ok;
+}
+
+
+EDynamicMeshResult DynamicMesh3::RemoveVertex(int VertexID, bool bRemoveIsolatedVertices)
+{
+	if (IsVertex(VertexID) == false)
+		return EDynamicMeshResult::Failed_NotAVertex;
+
+	InlineIndexList32 VertexTris;
+	EnumerateVertexTriangles(VertexID, [&](int TriangleID) { VertexTris.AddValue(TriangleID); });
+	for (int k = 0; k < VertexTris.Size(); ++k)
+		RemoveTriangle(VertexTris[k], bRemoveIsolatedVertices);
+	if (IsVertex(VertexID))
+		remove_isolated_vertex(VertexID);
+	return EDynamicMeshResult::Ok;
+}
+
+
+int DynamicMesh3::FindEdge(int VertexA, int VertexB) const
+{
+	if (VertexEdges.HasList(VertexA) == false)
+		return InvalidID;
+	Index2i EdgeV(GS::Min(VertexA, VertexB), GS::Max(VertexA, VertexB));
+	int NumEdges;
+	const int* VtxEdges = VertexEdges.GetListItemsUnsafe(VertexA, NumEdges);
+	for (int k = 0; k < NumEdges; ++k)
+		if (Edges[VtxEdges[k]].Vertices == EdgeV)
+			return VtxEdges[k];
+	return InvalidID;
+}
+
+int DynamicMesh3::FindEdgeFromTri(int VertexA, int VertexB, int TriangleID) const
+{
+	const Index3i& TriV = Triangles[TriangleID];
+	for (int j = 0; j < 3; ++j)
+	{
+		int NextV = TriV[(j + 1) % 3];
+		if ((TriV[j] == VertexA && NextV == VertexB) || (TriV[j] == VertexB && NextV == VertexA))
+			return TriangleEdges[TriangleID][j];
+	}
+	return InvalidID;
+}
+
+int DynamicMesh3::FindTriangle(int VertexA, int VertexB, int VertexC) const
+{
+	int EdgeID = FindEdge(VertexA, VertexB);
+	if (EdgeID == InvalidID)
+		return InvalidID;
+	const Index2i& EdgeT = Edges[EdgeID].Triangles;
+	for (int TriangleID : { EdgeT.A, EdgeT.B })
+		if (TriangleID != InvalidID && Triangles[TriangleID].Contains(VertexC))
+			return TriangleID;
+	return InvalidID;
+}
+
+
+bool DynamicMesh3::IsBoundaryVertex(int VertexID) const
+{
+	if (VertexEdges.HasList(VertexID) == false)
+		return false;
+	for (int EdgeID : VertexEdges.GetListView(VertexID))
+		if (Edges[EdgeID].Triangles.B == InvalidID)
+			return true;
+	return false;
+}
+
+Index3i DynamicMesh3::GetTriNeighbourTris(int TriangleID) const
+{
+	const Index3i& TriE = TriangleEdges[TriangleID];
+	return Index3i(
+		Edges[TriE.A].Triangles.GetOtherValue(TriangleID),
+		Edges[TriE.B].Triangles.GetOtherValue(TriangleID),
+		Edges[TriE.C].Triangles.GetOtherValue(TriangleID));
+}
+
+int DynamicMesh3::GetEdgeOpposingV(int EdgeID, int TriangleID) const
+{
+	const Index2i& EdgeV = Edges[EdgeID].Vertices;
+	return GSLocal::DynMeshFindTriOtherVtx(EdgeV.A, EdgeV.B, Triangles[TriangleID]);
+}
+
+
+void DynamicMesh3::EnumerateVertexEdges(int VertexID, FunctionRef<void(int EdgeID)> EdgeFunc) const
+{
+	if (VertexEdges.HasList(VertexID) == false)
+		return;
+	for (int EdgeID : VertexEdges.GetListView(VertexID))
+		EdgeFunc(EdgeID);
+}
+
+void DynamicMesh3::EnumerateVertexVertices(int VertexID, FunctionRef<void(int NbrVertexID)> VertexFunc) const
+{
+	if (VertexEdges.HasList(VertexID) == false)
+		return;
+	for (int EdgeID : VertexEdges.GetListView(VertexID))
+		VertexFunc(Edges[EdgeID].Vertices.GetOtherValue(VertexID));
+}
+
+void DynamicMesh3::EnumerateVertexTriangles(int VertexID, FunctionRef<void(int TriangleID)> TriangleFunc) const
+{
+	if (VertexEdges.HasList(VertexID) == false)
+		return;
+	// each triangle at the vertex has exactly one edge that starts at the vertex
+	for (int EdgeID : VertexEdges.GetListView(VertexID))
+	{
+		const Index2i& EdgeT = Edges[EdgeID].Triangles;
+		for (int TriangleID : { EdgeT.A, EdgeT.B })
+		{
+			if (TriangleID == InvalidID)
+				continue;
+			const Index3i& TriV = Triangles[TriangleID];
+			for (int j = 0; j < 3; ++j)
+				if (TriV[j] == VertexID && TriangleEdges[TriangleID][j] == EdgeID)
+					TriangleFunc(TriangleID);
+		}
+	}
+}
+
+
+Vector3d DynamicMesh3::ComputeTriNormal(int TriangleID) const
+{
+	const Index3i& TriV = Triangles[TriangleID];
+	return GS::Normal(Positions[TriV.A], Positions[TriV.B], Positions[TriV.C]);
+}
+
+Vector3d DynamicMesh3::ComputeTriCentroid(int TriangleID) const
+{
+	const Index3i& TriV = Triangles[TriangleID];
+	return (Positions[TriV.A] + Positions[TriV.B] + Positions[TriV.C]) / 3.0;
+}
+
+
+
+EDynamicMeshResult DynamicMesh3::SplitEdge(int EdgeID, EdgeSplitInfo& SplitInfo, double SplitT)
+{
+	if (IsEdge(EdgeID) == false)
+		return EDynamicMeshResult::Failed_NotAnEdge;
+
+	Index2i EdgeV = Edges[EdgeID].Vertices;
+	int t0 = Edges[EdgeID].Triangles.A, t1 = Edges[EdgeID].Triangles.B;
+	Index3i T0V = Triangles[t0];
+	int a = EdgeV.A, b = EdgeV.B;
+	GSLocal::DynMeshOrientTriEdge(a, b, T0V);
+	int c = GSLocal::DynMeshFindTriOtherVtx(a, b, T0V);
+	int ebc = FindEdgeFromTri(b, c, t0);
+	int d = InvalidID, ebd = InvalidID;
+	if (t1 != InvalidID) {
+		d = GSLocal::DynMeshFindTriOtherVtx(a, b, Triangles[t1]);
+		ebd = FindEdgeFromTri(b, d, t1);
+	}
+
+	int f = AppendVertex(GS::Lerp(Positions[EdgeV.A], Positions[EdgeV.B], SplitT));
+
+	// the original edge becomes (a,f)
+	replace_edge_vertex(EdgeID, b, f);
+	remove_vertex_edge(b, EdgeID);
+	add_vertex_edge(f, EdgeID);
+
+	// t0 (a,b,c) becomes (a,f,c), and new triangle t2 is (f,b,c)
+	GSLocal::DynMeshReplaceTriVertex(Triangles[t0], b, f);
+	int t2 = allocate_triangle(Index3i(f, b, c), GetTriangleGroup(t0));
+	replace_edge_triangle(ebc, t0, t2);
+	int efb = add_edge(f, b, t2);
+	int efc = add_edge(f, c, t0, t2);
+	replace_tri_edge(t0, ebc, efc);
+	TriangleEdges[t2] = Index3i(efb, ebc, efc);
+	VertexRefCounts.increment(f, 2);
+	VertexRefCounts.increment(c);
+
+	// t1 (b,a,d) becomes (f,a,d), and new triangle t3 is (b,f,d)
+	int t3 = InvalidID, efd = InvalidID;
+	if (t1 != InvalidID)
+	{
+		GSLocal::DynMeshReplaceTriVertex(Triangles[t1], b, f);
+		t3 = allocate_triangle(Index3i(b, f, d), GetTriangleGroup(t1));
+		replace_edge_triangle(ebd, t1, t3);
+		Edges[efb].Triangles.B = t3;
+		efd = add_edge(f, d, t1, t3);
+		replace_tri_edge(t1, ebd, efd);
+		TriangleEdges[t3] = Index3i(efb, efd, ebd);
+		VertexRefCounts.increment(f, 2);
+		VertexRefCounts.increment(d);
+	}
+
+	SplitInfo.OriginalEdge = EdgeID;
+	SplitInfo.OriginalVertices = Index2i(a, b);
+	SplitInfo.OtherVertices = Index2i(c, d);
+	SplitInfo.OriginalTriangles = Index2i(t0, t1);
+	SplitInfo.NewVertex = f;
+	SplitInfo.NewTriangles = Index2i(t2, t3);
+	SplitInfo.NewEdges = Index3i(efb, efc, efd);
+	return EDynamicMeshResult::Ok;
+}
+
+
+EDynamicMeshResult DynamicMesh3::FlipEdge(int EdgeID, EdgeFlipInfo& FlipInfo)
+{
+	if (IsEdge(EdgeID) == false)
+		return EDynamicMeshResult::Failed_NotAnEdge;
+	if (IsBoundaryEdge(EdgeID))
+		return EDynamicMeshResult::Failed_IsBoundaryEdge;
+
+	int a = Edges[EdgeID].Vertices.A, b = Edges[EdgeID].Vertices.B;
+	int t0 = Edges[EdgeID].Triangles.A, t1 = Edges[EdgeID].Triangles.B;
+	GSLocal::DynMeshOrientTriEdge(a, b, Triangles[t0]);
+	int c = GSLocal::DynMeshFindTriOtherVtx(a, b, Triangles[t0]);
+	int d = GSLocal::DynMeshFindTriOtherVtx(a, b, Triangles[t1]);
+	if (c == d)
+		return EDynamicMeshResult::Failed_InvalidNeighbourhood;
+	if (FindEdge(c, d) != InvalidID)
+		return EDynamicMeshResult::Failed_FlippedEdgeExists;
+
+	int ebc = FindEdgeFromTri(b, c, t0), eca = FindEdgeFromTri(c, a, t0);
+	int ead = FindEdgeFromTri(a, d, t1), edb = FindEdgeFromTri(d, b, t1);
+
+	// (a,b,c),(b,a,d) become (c,d,b),(d,c,a)
+	Triangles[t0] = Index3i(c, d, b);
+	Triangles[t1] = Index3i(d, c, a);
+	TriangleEdges[t0] = Index3i(EdgeID, edb, ebc);
+	TriangleEdges[t1] = Index3i(EdgeID, eca, ead);
+	replace_edge_triangle(eca, t0, t1);
+	replace_edge_triangle(edb, t1, t0);
+
+	Edges[EdgeID].Vertices = Index2i(GS::Min(c, d), GS::Max(c, d));
+	remove_vertex_edge(a, EdgeID);
+	remove_vertex_edge(b, EdgeID);
+	add_vertex_edge(c, EdgeID);
+	add_vertex_edge(d, EdgeID);
+	VertexRefCounts.decrement(a);
+	VertexRefCounts.decrement(b);
+	VertexRefCounts.increment(c);
+	VertexRefCounts.increment(d);
+
+	FlipInfo.EdgeID = EdgeID;
+	FlipInfo.OriginalVertices = Index2i(a, b);
+	FlipInfo.OpposingVertices = Index2i(c, d);
+	FlipInfo.Triangles = Index2i(t0, t1);
+	return EDynamicMeshResult::Ok;
+}
+
+
+EDynamicMeshResult DynamicMesh3::CollapseEdge(int KeepVertexID, int RemoveVertexID, EdgeCollapseInfo& CollapseInfo, double CollapseT)
+{
+	int a = RemoveVertexID, b = KeepVertexID;
+	if (IsVertex(a) == false || IsVertex(b) == false)
+		return EDynamicMeshResult::Failed_NotAVertex;
+	int eab = FindEdge(a, b);
+	if (eab == InvalidID)
+		return EDynamicMeshResult::Failed_NotAnEdge;
+
+	int t0 = Edges[eab].Triangles.A, t1 = Edges[eab].Triangles.B;
+	bool bIsBoundary = (t1 == InvalidID);
+	int c = GSLocal::DynMeshFindTriOtherVtx(a, b, Triangles[t0]);
+	int d = (bIsBoundary) ? InvalidID : GSLocal::DynMeshFindTriOtherVtx(a, b, Triangles[t1]);
+
+	// collapsing an interior edge between two boundary vertices would pinch the mesh
+	if (bIsBoundary == false && IsBoundaryVertex(a) && IsBoundaryVertex(b))
+		return EDynamicMeshResult::Failed_InvalidNeighbourhood;
+
+	// link condition: the only vertices connected to both a and b must be c and d
+	int NumSharedNbrs = 0;
+	for (int EdgeID : VertexEdges.GetListView(a)) {
+		int NbrV = Edges[EdgeID].Vertices.GetOtherValue(a);
+		if (NbrV != b && FindEdge(NbrV, b) != InvalidID)
+			NumSharedNbrs++;
+	}
+	if (NumSharedNbrs != ((bIsBoundary) ? 1 : 2))
+		return EDynamicMeshResult::Failed_InvalidNeighbourhood;
+
+	// edges (a,c),(a,d) are removed, and the triangles across them are connected to (b,c),(b,d) instead
+	int eac = FindEdgeFromTri(a, c, t0), ebc = FindEdgeFromTri(b, c, t0);
+	int tc = Edges[eac].Triangles.GetOtherValue(t0);
+	int ead = InvalidID, ebd = InvalidID, td = InvalidID;
+	if (bIsBoundary == false) {
+		ead = FindEdgeFromTri(a, d, t1);
+		ebd = FindEdgeFromTri(b, d, t1);
+		td = Edges[ead].Triangles.GetOtherValue(t1);
+		if (tc != InvalidID && tc == td)
+			return EDynamicMeshResult::Failed_CollapseTetrahedron;
+	}
+	// if both other edges of a removed triangle are boundary edges, the collapse would leave an edge with no triangles
+	if (tc == InvalidID && Edges[ebc].Triangles.GetOtherValue(t0) == InvalidID)
+		return EDynamicMeshResult::Failed_CollapseTriangle;
+	if (bIsBoundary == false && td == InvalidID && Edges[ebd].Triangles.GetOtherValue(t1) == InvalidID)
+		return EDynamicMeshResult::Failed_CollapseTriangle;
+
+	Positions[b] = GS::Lerp(Positions[b], Positions[a], CollapseT);
+
+	// move the other triangles and edges of a to b
+	InlineIndexList32 MoveTris, MoveEdges;
+	EnumerateVertexTriangles(a, [&](int TriangleID) {
+		if (TriangleID != t0 && TriangleID != t1) MoveTris.AddValue(TriangleID);
+	});
+	for (int k = 0; k < MoveTris.Size(); ++k) {
+		GSLocal::DynMeshReplaceTriVertex(Triangles[MoveTris[k]], a, b);
+		VertexRefCounts.increment(b);
+	}
+	for (int EdgeID : VertexEdges.GetListView(a))
+		if (EdgeID != eab && EdgeID != eac && EdgeID != ead) MoveEdges.AddValue(EdgeID);
+	for (int k = 0; k < MoveEdges.Size(); ++k) {
+		replace_edge_vertex(MoveEdges[k], a, b);
+		add_vertex_edge(b, MoveEdges[k]);
+	}
+
+	replace_edge_triangle(ebc, t0, tc);
+	if (tc != InvalidID)
+		replace_tri_edge(tc, eac, ebc);
+	if (bIsBoundary == false) {
+		replace_edge_triangle(ebd, t1, td);
+		if (td != InvalidID)
+			replace_tri_edge(td, ead, ebd);
+	}
+
+	// remove the collapsed edge, the edges (a,c),(a,d), the triangles of the edge, and a
+	remove_vertex_edge(b, eab);
+	EdgeRefCounts.decrement(eab);
+	remove_vertex_edge(c, eac);
+	EdgeRefCounts.decrement(eac);
+	TriangleRefCounts.decrement(t0);
+	VertexRefCounts.decrement(b);
+	VertexRefCounts.decrement(c);
+	if (bIsBoundary == false) {
+		remove_vertex_edge(d, ead);
+		EdgeRefCounts.decrement(ead);
+		TriangleRefCounts.decrement(t1);
+		VertexRefCounts.decrement(b);
+		VertexRefCounts.decrement(d);
+	}
+	VertexEdges.RemoveList(a);
+	VertexRefCounts.decrement(a, VertexRefCounts.refcount(a));
+
+	CollapseInfo.KeptVertex = b;
+	CollapseInfo.RemovedVertex = a;
+	CollapseInfo.OpposingVertices = Index2i(c, d);
+	CollapseInfo.bIsBoundary = bIsBoundary;
+	CollapseInfo.CollapsedEdge = eab;
+	CollapseInfo.RemovedTriangles = Index2i(t0, t1);
+	CollapseInfo.RemovedEdges = Index2i(eac, ead);
+	CollapseInfo.KeptEdges = Index2i(ebc, ebd);
+	return EDynamicMeshResult::Ok;
+}
+
+
+EDynamicMeshResult DynamicMesh3::PokeTriangle(int TriangleID, const Vector3d& BaryCoords, PokeTriangleInfo& PokeInfo)
+{
+	if (IsTriangle(TriangleID) == false)
+		return EDynamicMeshResult::Failed_NotATriangle;
+
+	Index3i TriV = Triangles[TriangleID];
+	Index3i TriE = TriangleEdges[TriangleID];
+	int a = TriV.A, b = TriV.B, c = TriV.C;
+	int f = AppendVertex(BaryCoords.X * Positions[a] + BaryCoords.Y * Positions[b] + BaryCoords.Z * Positions[c]);
+
+	// (a,b,c) becomes (a,b,f), (b,c,f), (c,a,f)
+	int Group = GetTriangleGroup(TriangleID);
+	Triangles[TriangleID] = Index3i(a, b, f);
+	int t1 = allocate_triangle(Index3i(b, c, f), Group);
+	int t2 = allocate_triangle(Index3i(c, a, f), Group);
+	replace_edge_triangle(TriE.B, TriangleID, t1);
+	replace_edge_triangle(TriE.C, TriangleID, t2);
+	int eaf = add_edge(a, f, TriangleID, t2);
+	int ebf = add_edge(b, f, TriangleID, t1);
+	int ecf = add_edge(c, f, t1, t2);
+	TriangleEdges[TriangleID] = Index3i(TriE.A, ebf, eaf);
+	TriangleEdges[t1] = Index3i(TriE.B, ecf, ebf);
+	TriangleEdges[t2] = Index3i(TriE.C, eaf, ecf);
+	VertexRefCounts.increment(f, 3);
+	VertexRefCounts.increment(a);
+	VertexRefCounts.increment(b);
+	VertexRefCounts.increment(c);
+
+	PokeInfo.OriginalTriangle = TriangleID;
+	PokeInfo.TriVertices = TriV;
+	PokeInfo.NewVertex = f;
+	PokeInfo.NewTriangles = Index2i(t1, t2);
+	PokeInfo.NewEdges = Index3i(eaf, ebf, ecf);
+	return EDynamicMeshResult::Ok;
+}
+
+
+
+bool DynamicMesh3::CheckValidity(bool bAssertOnFailure) const
+{
+	bool bValid = true;
+	auto Check = [&](bool bCondition) {
+		if (bCondition == false && bAssertOnFailure)
+			gs_debug_assert(false);
+		bValid = bValid && bCondition;
+	};
+
+	unsafe_vector<int> VertexTriCounts;
+	VertexTriCounts.initialize(MaxVertexID(), 0);
+	for (int TriangleID = 0; TriangleID < MaxTriangleID(); ++TriangleID)
+	{
+		if (IsTriangle(TriangleID) == false)
+			continue;
+		const Index3i& TriV = Triangles[TriangleID];
+		const Index3i& TriE = TriangleEdges[TriangleID];
+		for (int j = 0; j < 3; ++j)
+		{
+			Check(IsVertex(TriV[j]) && TriV[j] != TriV[(j + 1) % 3]);
+			if (IsVertex(TriV[j]))
+				VertexTriCounts[TriV[j]]++;
+			Check(IsEdge(TriE[j]));
+			if (IsEdge(TriE[j])) {
+				const Edge& Edge = Edges[TriE[j]];
+				Check(Edge.Vertices == Index2i(GS::Min(TriV[j], TriV[(j + 1) % 3]), GS::Max(TriV[j], TriV[(j + 1) % 3])));
+				Check(Edge.Triangles.A == TriangleID || Edge.Triangles.B == TriangleID);
+			}
+		}
+		Check(FindEdge(TriV.A, TriV.B) == TriE.A);
+	}
+
+	int NumEdges = 0;
+	for (int EdgeID = 0; EdgeID < MaxEdgeID(); ++EdgeID)
+	{
+		if (IsEdge(EdgeID) == false)
+			continue;
+		NumEdges++;
+		const Edge& Edge = Edges[EdgeID];
+		Check(Edge.Vertices.A < Edge.Vertices.B && IsVertex(Edge.Vertices.A) && IsVertex(Edge.Vertices.B));
+		Check(IsTriangle(Edge.Triangles.A));
+		Check(Edge.Triangles.B == InvalidID || (IsTriangle(Edge.Triangles.B) && Edge.Triangles.B != Edge.Triangles.A));
+		for (int TriangleID : { Edge.Triangles.A, Edge.Triangles.B }) {
+			if (IsTriangle(TriangleID))
+				Check(TriangleEdges[TriangleID].Contains(EdgeID));
+		}
+		for (int VertexID : { Edge.Vertices.A, Edge.Vertices.B }) {
+			bool bFound = false;
+			EnumerateVertexEdges(VertexID, [&](int VtxEdgeID) { bFound = bFound || (VtxEdgeID == EdgeID); });
+			Check(bFound);
+		}
+	}
+	Check(NumEdges == EdgeCount());
+
+	int NumVertices = 0;
+	for (int VertexID = 0; VertexID < MaxVertexID(); ++VertexID)
+	{
+		if (IsVertex(VertexID) == false) {
+			Check(VertexID >= VertexEdges.NumLists() || VertexEdges.HasList(VertexID) == false);
+			continue;
+		}
+		NumVertices++;
+		Check(VertexRefCounts.refcount(VertexID) == VertexTriCounts[VertexID] + 1);
+		int NumVtxEdges = 0;
+		EnumerateVertexEdges(VertexID, [&](int EdgeID) {
+			Check(IsEdge(EdgeID) && Edges[EdgeID].Vertices.Contains(VertexID));
+			NumVtxEdges++;
+		});
+		int NumVtxTris = 0;
+		EnumerateVertexTriangles(VertexID, [&](int) { NumVtxTris++; });
+		Check(NumVtxTris == VertexTriCounts[VertexID]);
+	}
+	Check(NumVertices == VertexCount());
+
+	return bValid;
+}
+
+
+
+int DynamicMesh3::allocate_triangle(const Index3i& TriVertices, int Group)
+{
+	int TriangleID = TriangleRefCounts.allocate();
+	if (TriangleID == (int)Triangles.size()) {
+		Triangles.add(TriVertices);
+		TriangleEdges.add(Index3i(InvalidID, InvalidID, InvalidID));
+		if (bHasTriangleGroups)
+			TriangleGroups.add(Group);
+	}
+	else {
+		Triangles[TriangleID] = TriVertices;
+		TriangleEdges[TriangleID] = Index3i(InvalidID, InvalidID, InvalidID);
+		if (bHasTriangleGroups)
+			TriangleGroups[TriangleID] = Group;
+	}
+	return TriangleID;
+}
+
+int DynamicMesh3::add_edge(int VertexA, int VertexB, int TriangleA, int TriangleB)
+{
+	int EdgeID = EdgeRefCounts.allocate();
+	Edge NewEdge{ Index2i(GS::Min(VertexA, VertexB), GS::Max(VertexA, VertexB)), Index2i(TriangleA, TriangleB) };
+	if (EdgeID == (int)Edges.size())
+		Edges.add(NewEdge);
+	else
+		Edges[EdgeID] = NewEdge;
+	add_vertex_edge(VertexA, EdgeID);
+	add_vertex_edge(VertexB, EdgeID);
+	return EdgeID;
+}
+
+void DynamicMesh3::remove_edge(int EdgeID)
+{
+	remove_vertex_edge(Edges[EdgeID].Vertices.A, EdgeID);
+	remove_vertex_edge(Edges[EdgeID].Vertices.B, EdgeID);
+	Edges[EdgeID].Vertices = Index2i(InvalidID, InvalidID);
+	EdgeRefCounts.decrement(EdgeID);
+}
+
+void DynamicMesh3::add_vertex_edge(int VertexID, int EdgeID)
+{
+	// the list is copied as ReplaceList() may append to the packed storage
+	InlineIndexList32 NewEdges;
+	if (VertexEdges.HasList(VertexID)) {
+		int NumEdges;
+		const int* VtxEdges = VertexEdges.GetListItemsUnsafe(VertexID, NumEdges);
+		for (int k = 0; k < NumEdges; ++k)
+			NewEdges.AddValue(VtxEdges[k]);
+	}
+	NewEdges.AddValue(EdgeID);
+	VertexEdges.ReplaceList(VertexID, NewEdges.GetBufferView());
+	compact_vertex_edges_if_needed();
+}
+
+void DynamicMesh3::remove_vertex_edge(int VertexID, int EdgeID)
+{
+	InlineIndexList32 NewEdges;
+	int NumEdges;
+	const int* VtxEdges = VertexEdges.GetListItemsUnsafe(VertexID, NumEdges);
+	for (int k = 0; k < NumEdges; ++k)
+		if (VtxEdges[k] != EdgeID) NewEdges.AddValue(VtxEdges[k]);
+	gs_debug_assert(NewEdges.Size() == NumEdges - 1);
+	if (NewEdges.Size() > 0)
+		VertexEdges.ReplaceList(VertexID, NewEdges.GetBufferView());
+	else
+		VertexEdges.RemoveList(VertexID);
+}
+
+void DynamicMesh3::replace_edge_triangle(int EdgeID, int OldTriangleID, int NewTriangleID)
+{
+	Index2i& EdgeT = Edges[EdgeID].Triangles;
+	if (EdgeT.A == OldTriangleID) {
+		if (NewTriangleID == InvalidID) {
+			EdgeT.A = EdgeT.B;
+			EdgeT.B = InvalidID;
+		} else
+			EdgeT.A = NewTriangleID;
+	}
+	else if (EdgeT.B == OldTriangleID)
+		EdgeT.B = NewTriangleID;
+}
+
+void DynamicMesh3::replace_edge_vertex(int EdgeID, int OldVertexID, int NewVertexID)
+{
+	Index2i& EdgeV = Edges[EdgeID].Vertices;
+	if (EdgeV.A == OldVertexID)
+		EdgeV.A = NewVertexID;
+	else if (EdgeV.B == OldVertexID)
+		EdgeV.B = NewVertexID;
+	if (EdgeV.A > EdgeV.B)
+		std::swap(EdgeV.A, EdgeV.B);
+}
+
+void DynamicMesh3::replace_tri_edge(int TriangleID, int OldEdgeID, int NewEdgeID)
+{
+	Index3i& TriE = TriangleEdges[TriangleID];
+	for (int j = 0; j < 3; ++j)
+		if (TriE[j] == OldEdgeID)
+			TriE[j] = NewEdgeID;
+}
+
+void DynamicMesh3::remove_isolated_vertex(int VertexID)
+{
+	gs_debug_assert(VertexRefCounts.refcount(VertexID) == 1);
+	VertexEdges.RemoveList(VertexID);
+	VertexRefCounts.decrement(VertexID);
+}
+
+void DynamicMesh3::compact_vertex_edges_if_needed()
+{
+	if (VertexEdges.NumUnusedElements > 1024 && VertexEdges.NumUnusedElements > VertexEdges.NumListElements() / 2)
+		VertexEdges.Compact();
+}
@@ -0,0 +1,204 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Mesh/MeshConnectedComponents.h"
+#include "Mesh/MeshTopology.h"
+#include "Core/ConcurrentUnionFind.h"
+#include "Core/gs_debug.h"
+#include "Core/ParallelFor.h"
+#include "Core/ParallelSort.h"
+#include "Math/GSMath.h"
+
+#include <atomic>
+#include <bit>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	static constexpr int32_t ComponentsBlockSize = 16 * 1024;
+
+	// run BlockFunc(Start, End) over blocks of [0,Num) with GS::ParallelFor
+	static void ForEachComponentsBlock(int32_t Num, bool bParallel, FunctionRef<void(int32_t Start, int32_t End)> BlockFunc)
+	{
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		int32_t NumBlocks = (Num + ComponentsBlockSize - 1) / ComponentsBlockSize;
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t Start = (int32_t)BlockIndex * ComponentsBlockSize;
+			BlockFunc(Start, GS::Min(Start + ComponentsBlockSize, Num));
+		}, Flags);
+	}
+}
+
+
+void MeshConnectedComponents::Clear()
+{
+	ComponentIDs.clear(true);
+	ComponentOffsets.clear(true);
+	ComponentElements.clear(true);
+}
+
+
+void MeshConnectedComponents::BuildTriangleComponents(
+	const MeshTopology& Topology,
+	int NumTriangleIDs,
+	FunctionRef<bool(int TriangleID)> IsTriangleValidFunc,
+	bool bParallel)
+{
+	gs_debug_assert(NumTriangleIDs == 0 || Topology.HasTriNeighbours());
+	bool bHasTriEdges = Topology.HasTriEdges();
+
+	ConcurrentUnionFind UnionFind;
+	UnionFind.Initialize(NumTriangleIDs);
+	GSLocal::ForEachComponentsBlock(NumTriangleIDs, bParallel, [&](int32_t Start, int32_t End) {
+		for (int32_t TriangleID = Start; TriangleID < End; ++TriangleID)
+		{
+			if (IsTriangleValidFunc(TriangleID) == false)
+				continue;
+			const Index3i& TriNbrs = Topology.TriNeighbours[TriangleID];
+			for (int j = 0; j < 3; ++j)
+			{
+				// only union each manifold pair once, from the smaller TriangleID
+				if (TriNbrs[j] > TriangleID)
+					UnionFind.Union(TriangleID, TriNbrs[j]);
+				else if (TriNbrs[j] == -2 && bHasTriEdges) {
+					const MeshTopology::Edge& Edge = Topology.Edges[Topology.TriEdges[TriangleID][j]];
+					for (int OtherTriID : Topology.NonManifoldEdgeTriLists.GetListView(Edge.TriInfo.B))
+						if (OtherTriID > TriangleID) UnionFind.Union(TriangleID, OtherTriID);
+				}
+			}
+		}
+	});
+
+	BuildFromUnionFind(UnionFind, NumTriangleIDs, IsTriangleValidFunc, nullptr, bParallel);
+}
+
+
+void MeshConnectedComponents::BuildTriangleComponents(
+	int NumVertexIDs,
+	int NumTriangleIDs,
+	FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
+	bool bParallel)
+{
+	// union the vertices of each triangle, then each triangle is in the set of its first vertex
+	unsafe_vector<int> TriFirstVertex;
+	TriFirstVertex.resize(NumTriangleIDs);
+	ConcurrentUnionFind UnionFind;
+	UnionFind.Initialize(NumVertexIDs);
+	GSLocal::ForEachComponentsBlock(NumTriangleIDs, bParallel, [&](int32_t Start, int32_t End) {
+		for (int32_t TriangleID = Start; TriangleID < End; ++TriangleID)
+		{
+			Index3i TriV;
+			if (GetTriangleFunc(TriangleID, TriV) == false) {
+				TriFirstVertex[TriangleID] = -1;
+				continue;
+			}
+			TriFirstVertex[TriangleID] = TriV.A;
+			UnionFind.Union(TriV.A, TriV.B);
+			UnionFind.Union(TriV.A, TriV.C);
+		}
+	});
+
+	BuildFromUnionFind(UnionFind, NumTriangleIDs,
+		[&](int TriangleID) { return TriFirstVertex[TriangleID] >= 0; },
+		[&](int TriangleID) { return TriFirstVertex[TriangleID]; },
+		bParallel);
+}
+
+
+void MeshConnectedComponents::BuildTriangleComponents(
+	const ConstMeshView2d& Mesh,
+	bool bParallel)
+{
+	BuildTriangleComponents(Mesh.GetNumVertexIDs(), Mesh.GetNumTriangleIDs(),
+		[&](int TriangleID, Index3i& TriVertices) {
+			if (Mesh.IsValidTriangleID(TriangleID) == false) return false;
+			TriVertices = Mesh.GetTriangle(TriangleID);
+			return true;
+		}, bParallel);
+}
+
+
+void MeshConnectedComponents::BuildFromUnionFind(
+	ConcurrentUnionFind& UnionFind,
+	int NumElements,
+	FunctionRef<bool(int ElementID)> IsElementValidFunc,
+	FunctionRef<int(int ElementID)> ElementToUnionFindFunc,
+	bool bParallel)
+{
+	// find the set root of each element, and the smallest element in each set. ComponentIDs temporarily stores the roots.
+	ComponentIDs.resize(NumElements);
+	unsafe_vector<int> RootMinElement;
+	RootMinElement.initialize(UnionFind.NumElements(), (int)NumElements);
+	GSLocal::ForEachComponentsBlock(NumElements, bParallel, [&](int32_t Start, int32_t End) {
+		for (int32_t ElementID = Start; ElementID < End; ++ElementID)
+		{
+			if (IsElementValidFunc(ElementID) == false) {
+				ComponentIDs[ElementID] = -1;
+				continue;
+			}
+			int Root = UnionFind.Find( (ElementToUnionFindFunc) ? ElementToUnionFindFunc(ElementID) : ElementID );
+			ComponentIDs[ElementID] = Root;
+			std::atomic_ref<int> MinElement(RootMinElement[Root]);
+			int CurMin = MinElement.load(std::memory_order_relaxed);
+			while (ElementID < CurMin && MinElement.compare_exchange_weak(CurMin, ElementID, std::memory_order_relaxed) == false)
+				;
+		}
+	});
+
+	// number the components in order of their smallest element, via a prefix sum over blocks
+	int32_t NumBlocks = (NumElements + GSLocal::ComponentsBlockSize - 1) / GSLocal::ComponentsBlockSize;
+	unsafe_vector<int> BlockOffsets;
+	BlockOffsets.initialize(NumBlocks + 1, 0);
+	GSLocal::ForEachComponentsBlock(NumElements, bParallel, [&](int32_t Start, int32_t End) {
+		int Count = 0;
+		for (int32_t ElementID = Start; ElementID < End; ++ElementID)
+			Count += (ComponentIDs[ElementID] >= 0 && RootMinElement[ComponentIDs[ElementID]] == ElementID) ? 1 : 0;
+		BlockOffsets[Start / GSLocal::ComponentsBlockSize + 1] = Count;
+	});
+	for (int32_t k = 0; k < NumBlocks; ++k)
+		BlockOffsets[k + 1] += BlockOffsets[k];
+	int NumComponents = BlockOffsets[NumBlocks];
+
+	// the smallest element of each set assigns the ComponentID of its root
+	unsafe_vector<int> RootComponentIDs;
+	RootComponentIDs.resize(UnionFind.NumElements());
+	GSLocal::ForEachComponentsBlock(NumElements, bParallel, [&](int32_t Start, int32_t End) {
+		int ComponentID = BlockOffsets[Start / GSLocal::ComponentsBlockSize];
+		for (int32_t ElementID = Start; ElementID < End; ++ElementID) {
+			int Root = ComponentIDs[ElementID];
+			if (Root >= 0 && RootMinElement[Root] == ElementID)
+				RootComponentIDs[Root] = ComponentID++;
+		}
+	});
+	GSLocal::ForEachComponentsBlock(NumElements, bParallel, [&](int32_t Start, int32_t End) {
+		for (int32_t ElementID = Start; ElementID < End; ++ElementID) {
+			int Root = ComponentIDs[ElementID];
+			if (Root >= 0)
+				ComponentIDs[ElementID] = RootComponentIDs[Root];
+		}
+	});
+
+	// CSR membership lists. A stable sort of (ComponentID, ElementID) keys keeps elements in increasing order.
+	unsafe_vector<uint64_t> SortKeys;
+	SortKeys.resize(NumElements);
+	int NumValidElements = 0;
+	for (int32_t ElementID = 0; ElementID < NumElements; ++ElementID)
+		if (ComponentIDs[ElementID] >= 0)
+			SortKeys[NumValidElements++] = ((uint64_t)ComponentIDs[ElementID] << 32) | (uint64_t)(uint32_t)ElementID;
+	SortKeys.resize(NumValidElements);
+	int NumKeyBits = GS::Max(1, (int)std::bit_width((uint32_t)NumComponents));
+	ParallelRadixSortUpper32(SortKeys, NumKeyBits, bParallel);
+
+	ComponentElements.resize(NumValidElements);
+	ComponentOffsets.initialize(NumComponents + 1, 0);
+	GSLocal::ForEachComponentsBlock(NumValidElements, bParallel, [&](int32_t Start, int32_t End) {
+		for (int32_t k = Start; k < End; ++k) {
+			ComponentElements[k] = (int)(uint32_t)SortKeys[k];
+			int ComponentID = (int)(SortKeys[k] >> 32);
+			if (k == 0 || (int)(SortKeys[k - 1] >> 32) != ComponentID)
+				ComponentOffsets[ComponentID] = k;
+		}
+	});
+	ComponentOffsets[NumComponents] = NumValidElements;
+}
@@ -0,0 +1,346 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Mesh/MeshConversion.h"
+#include "Mesh/PolyMesh.h"
+#include "Mesh/DenseMesh.h"
+#include "Mesh/PolygonTriangulation.h"
+#include "Core/FunctionRef.h"
+#include "Core/ParallelFor.h"
+#include "Core/ParallelSort.h"
+#include "Math/GSMath.h"
+
+#include <algorithm>
+#include <bit>
+#include <type_traits>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	static constexpr int32_t ConversionBlockSize = 16 * 1024;
+
+	static int32_t NumConversionBlocks(int32_t Num)
+	{
+		return (Num + ConversionBlockSize - 1) / ConversionBlockSize;
+	}
+
+	// run BlockFunc(BlockIndex, Start, End) over blocks of [0,Num) with GS::ParallelFor
+	static void ForEachConversionBlock(int32_t Num, bool bParallel, FunctionRef<void(int32_t BlockIndex, int32_t Start, int32_t End)> BlockFunc)
+	{
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		GS::ParallelFor(NumConversionBlocks(Num), [&](uint32_t BlockIndex) {
+			int32_t Start = (int32_t)BlockIndex * ConversionBlockSize;
+			BlockFunc((int32_t)BlockIndex, Start, GS::Min(Start + ConversionBlockSize, Num));
+		}, Flags);
+	}
+
+
+	// Corner values are welded by sorting the corners of each vertex on their value. Components are compared as
+	// integer keys so that the order is a strict weak order even if values contain NaN. +0 and -0 compare
+	// equal, so they are mapped to the same key.
+	static uint32_t WeldComponentKey(float Value) { return (Value == 0.0f) ? 0u : std::bit_cast<uint32_t>(Value); }
+	static uint32_t WeldComponentKey(uint8_t Value) { return Value; }
+
+	template<typename ValueType>
+	static bool WeldValueLess(const ValueType& A, const ValueType& B)
+	{
+		constexpr int NumComponents = (int)(sizeof(ValueType) / sizeof(A[0]));
+		for (int k = 0; k < NumComponents; ++k) {
+			uint32_t KeyA = WeldComponentKey(A[k]), KeyB = WeldComponentKey(B[k]);
+			if (KeyA != KeyB)
+				return KeyA < KeyB;
+		}
+		return false;
+	}
+
+	// Assign an element index to each triangle corner, so that corners of the same vertex with equal values share
+	// an element. SortedCorners are (VertexID << 32 | Corner) keys sorted by VertexID, so the corners of each vertex
+	// are a contiguous run. Each block handles the runs that start in the block, first to count the unique values of
+	// each block, and then (after a prefix sum) to assign element indices and write the unique values. Runs are
+	// sorted by value to find equal values, so a vertex with k corners takes O(k log k) time.
+	template<typename ValueType, typename GetValueFuncType>
+	static void WeldCornerValues(
+		const unsafe_vector<uint64_t>& SortedCorners,
+		const GetValueFuncType& GetCornerValue,
+		unsafe_vector<ValueType>& ElementsOut,
+		unsafe_vector<int>& CornerElementsOut,
+		bool bParallel)
+	{
+		int32_t NumCorners = (int32_t)SortedCorners.size();
+		auto CornerVertex = [&](int32_t i) { return (int32_t)(SortedCorners[i] >> 32); };
+		auto CornerIndex = [&](int32_t i) { return (int32_t)(SortedCorners[i] & 0xFFFFFFFF); };
+
+		// calls RunFunc(RunStart, RunEnd) for each run that starts in [Start,End)
+		auto ForEachRun = [&](int32_t Start, int32_t End, auto&& RunFunc) {
+			int32_t i = Start;
+			while (i > 0 && i < End && CornerVertex(i) == CornerVertex(i - 1))
+				i++;
+			while (i < End) {
+				int32_t RunStart = i;
+				do {
+					i++;
+				} while (i < NumCorners && CornerVertex(i) == CornerVertex(RunStart));
+				RunFunc(RunStart, i);
+			}
+		};
+
+		struct RunRecord
+		{
+			ValueType Value;
+			int32_t Record;
+		};
+
+		// for each record, the index of the first record in its run with an equal value. After the second
+		// pass, leader records store their element index instead.
+		unsafe_vector<int32_t> RecordLeaders;
+		RecordLeaders.resize(NumCorners);
+		int32_t NumBlocks = NumConversionBlocks(NumCorners);
+		unsafe_vector<int32_t> BlockOffsets;
+		BlockOffsets.resize(NumBlocks + 1);
+		BlockOffsets[0] = 0;
+		ForEachConversionBlock(NumCorners, bParallel, [&](int32_t BlockIndex, int32_t Start, int32_t End) {
+			int32_t NumUnique = 0;
+			unsafe_vector<RunRecord> RunRecords;
+			ForEachRun(Start, End, [&](int32_t RunStart, int32_t RunEnd) {
+				int32_t RunLength = RunEnd - RunStart;
+				RunRecords.resize(RunLength);
+				for (int32_t k = 0; k < RunLength; ++k)
+					RunRecords[k] = RunRecord{ GetCornerValue(CornerIndex(RunStart + k)), RunStart + k };
+				// sorting on (value, record) puts the first record of each set of equal values at the start of its group
+				std::sort(RunRecords.raw_pointer(), RunRecords.raw_pointer() + RunLength, [](const RunRecord& A, const RunRecord& B) {
+					return WeldValueLess(A.Value, B.Value) || (!WeldValueLess(B.Value, A.Value) && A.Record < B.Record);
+				});
+				int32_t GroupStart = 0;
+				for (int32_t k = 0; k < RunLength; ++k) {
+					if (WeldValueLess(RunRecords[GroupStart].Value, RunRecords[k].Value))
+						GroupStart = k;
+					const RunRecord& Leader = RunRecords[GroupStart];
+					int32_t i = RunRecords[k].Record;
+					RecordLeaders[i] = (RunRecords[k].Value == Leader.Value) ? Leader.Record : i;	// NaN values are never welded
+					NumUnique += (RecordLeaders[i] == i) ? 1 : 0;
+				}
+			});
+			BlockOffsets[BlockIndex + 1] = NumUnique;
+		});
+		for (int32_t b = 0; b < NumBlocks; ++b)
+			BlockOffsets[b + 1] += BlockOffsets[b];
+
+		ElementsOut.resize(BlockOffsets[NumBlocks]);
+		CornerElementsOut.resize(NumCorners);
+		ForEachConversionBlock(NumCorners, bParallel, [&](int32_t BlockIndex, int32_t Start, int32_t End) {
+			int32_t NextElement = BlockOffsets[BlockIndex];
+			ForEachRun(Start, End, [&](int32_t RunStart, int32_t RunEnd) {
+				for (int32_t i = RunStart; i < RunEnd; ++i) {
+					int32_t Corner = CornerIndex(i);
+					int32_t Leader = RecordLeaders[i];
+					if (Leader == i) {
+						ElementsOut[NextElement] = GetCornerValue(Corner);
+						RecordLeaders[i] = NextElement++;
+						CornerElementsOut[Corner] = RecordLeaders[i];
+					} else {
+						CornerElementsOut[Corner] = RecordLeaders[Leader];	// leader is earlier in the run, so already has its element index
+					}
+				}
+			});
+		});
+	}
+}
+
+
+void GS::ConvertPolyMeshToDenseMesh(
+	const PolyMesh& MeshIn,
+	DenseMesh& MeshOut,
+	const PolyMeshToDenseMeshOptions& Options,
+	unsafe_vector<int>* TriangleToFaceMapOut)
+{
+	using namespace GSLocal;
+	int NumVertices = MeshIn.GetVertexCount();
+	int NumFaces = MeshIn.GetFaceCount();
+	bool bParallel = Options.bParallel;
+
+	// count triangles of each block of faces, and prefix-sum to get the first triangle of each block
+	int32_t NumFaceBlocks = NumConversionBlocks(NumFaces);
+	unsafe_vector<int32_t> BlockOffsets;
+	BlockOffsets.resize(NumFaceBlocks + 1);
+	BlockOffsets[0] = 0;
+	ForEachConversionBlock(NumFaces, bParallel, [&](int32_t BlockIndex, int32_t Start, int32_t End) {
+		int32_t NumBlockTriangles = 0;
+		for (int32_t FaceIndex = Start; FaceIndex < End; ++FaceIndex)
+			NumBlockTriangles += GS::Max(MeshIn.GetFaceVertexCount(FaceIndex) - 2, 0);
+		BlockOffsets[BlockIndex + 1] = NumBlockTriangles;
+	});
+	for (int32_t b = 0; b < NumFaceBlocks; ++b)
+		BlockOffsets[b + 1] += BlockOffsets[b];
+	int NumTriangles = BlockOffsets[NumFaceBlocks];
+
+	MeshOut.Clear();
+	MeshOut.Resize(NumVertices, NumTriangles);
+	if (TriangleToFaceMapOut != nullptr)
+		TriangleToFaceMapOut->resize(NumTriangles);
+
+	ForEachConversionBlock(NumVertices, bParallel, [&](int32_t, int32_t Start, int32_t End) {
+		for (int32_t VertexIndex = Start; VertexIndex < End; ++VertexIndex)
+			MeshOut.SetPosition(VertexIndex, MeshIn.GetPosition(VertexIndex));
+	});
+
+	// optional attributes must be enabled before the parallel pass, as lazy allocation is not thread-safe
+	bool bNormals = Options.bCopyNormals && Options.NormalSet >= 0 && Options.NormalSet < MeshIn.GetNumNormalSets();
+	if (bNormals)
+		MeshOut.EnableNormals();
+	int NumUVSets = (Options.bCopyUVs) ? GS::Min(MeshIn.GetNumUVSets(), DenseMesh::MaxUVSets) : 0;
+	MeshOut.SetNumUVSets(NumUVSets);
+	bool bColors = Options.bCopyColors && Options.ColorSet >= 0 && Options.ColorSet < MeshIn.GetNumColorSets();
+	if (bColors)
+		MeshOut.EnableColors();
+
+	// TriGroups is an RLE buffer that is expanded on the first non-constant value, which is not thread-safe.
+	// So if the groups are not constant, the buffer is expanded here by setting a different value for the first
+	// triangle, which is overwritten in the parallel pass below.
+	bool bGroups = Options.GroupSet >= 0 && Options.GroupSet < MeshIn.GetNumFaceGroupSets();
+	int ConstantGroup = (bGroups && NumFaces > 0) ? MeshIn.GetFaceGroup(0, Options.GroupSet) : 0;
+	MeshOut.SetConstantTriGroup(ConstantGroup);
+	if (bGroups && NumTriangles > 0) {
+		for (int FaceIndex = 1; FaceIndex < NumFaces; ++FaceIndex) {
+			if (MeshIn.GetFaceGroup(FaceIndex, Options.GroupSet) != ConstantGroup) {
+				MeshOut.SetTriGroup(0, ConstantGroup + 1);
+				break;
+			}
+		}
+	}
+
+	ForEachConversionBlock(NumFaces, bParallel, [&](int32_t BlockIndex, int32_t Start, int32_t End) {
+		int TriIndex = BlockOffsets[BlockIndex];
+		unsafe_vector<Index3i> FaceTriangles;
+		for (int32_t FaceIndex = Start; FaceIndex < End; ++FaceIndex)
+		{
+			const PolyMesh::Face& Face = MeshIn.GetFace(FaceIndex);
+			int NumFaceVertices = MeshIn.GetFaceVertexCount(Face);
+			if (NumFaceVertices < 3) continue;
+			if ((int)FaceTriangles.size() < NumFaceVertices - 2)
+				FaceTriangles.resize(NumFaceVertices - 2);
+			int NumFaceTriangles = TriangulatePolyMeshFace(MeshIn, FaceIndex, FaceTriangles.raw_pointer());
+			int FaceGroup = (bGroups) ? MeshIn.GetFaceGroup(FaceIndex, Options.GroupSet) : 0;
+			for (int j = 0; j < NumFaceTriangles; ++j)
+			{
+				const Index3i& FaceVertexIndices = FaceTriangles[j];
+				MeshOut.SetTriangle(TriIndex, Index3i(MeshIn.GetFaceVertex(Face, FaceVertexIndices.A),
+					MeshIn.GetFaceVertex(Face, FaceVertexIndices.B), MeshIn.GetFaceVertex(Face, FaceVertexIndices.C)));
+				MeshOut.SetTriGroup(TriIndex, FaceGroup);
+				if (bNormals) {
+					TriVtxNormals Normals;
+					for (int k = 0; k < 3; ++k)
+						Normals[k] = MeshIn.GetFaceVertexNormal(Face, FaceVertexIndices[k], Options.NormalSet);
+					MeshOut.SetTriVtxNormals(TriIndex, Normals);
+				}
+				for (int UVSet = 0; UVSet < NumUVSets; ++UVSet) {
+					TriVtxUVs UVs;
+					for (int k = 0; k < 3; ++k)
+						UVs[k] = (Vector2f)MeshIn.GetFaceVertexUV(Face, FaceVertexIndices[k], UVSet);
+					MeshOut.SetTriVtxUVs(TriIndex, UVs, UVSet);
+				}
+				if (bColors) {
+					TriVtxColors Colors;
+					for (int k = 0; k < 3; ++k) {
+						int ColorIndex = MeshIn.GetFaceVertexColorIndex(Face, FaceVertexIndices[k], Options.ColorSet);
+						Colors[k] = (ColorIndex == -1) ? Color4b::White() : Color4b(MeshIn.GetColor(ColorIndex, Options.ColorSet));
+					}
+					MeshOut.SetTriVtxColors(TriIndex, Colors);
+				}
+				if (TriangleToFaceMapOut != nullptr)
+					(*TriangleToFaceMapOut)[TriIndex] = FaceIndex;
+				TriIndex++;
+			}
+		}
+		gs_debug_assert(TriIndex == BlockOffsets[BlockIndex + 1]);
+	});
+}
+
+
+
+void GS::ConvertDenseMeshToPolyMesh(
+	const DenseMesh& MeshIn,
+	PolyMesh& MeshOut,
+	const DenseMeshToPolyMeshOptions& Options)
+{
+	using namespace GSLocal;
+	int NumVertices = MeshIn.GetVertexCount();
+	int NumTriangles = MeshIn.GetTriangleCount();
+	bool bParallel = Options.bParallel;
+
+	MeshOut.Clear();
+	MeshOut.SetNumGroupSets(1);
+	MeshOut.AddVertices(NumVertices);
+	ForEachConversionBlock(NumVertices, bParallel, [&](int32_t, int32_t Start, int32_t End) {
+		for (int32_t VertexIndex = Start; VertexIndex < End; ++VertexIndex)
+			MeshOut.SetPosition(VertexIndex, MeshIn.GetPosition(VertexIndex));
+	});
+
+	// triangle i is face i
+	MeshOut.AddTriangles(NumTriangles, 0, true);
+	ForEachConversionBlock(NumTriangles, bParallel, [&](int32_t, int32_t Start, int32_t End) {
+		for (int32_t TriIndex = Start; TriIndex < End; ++TriIndex) {
+			MeshOut.SetTriangle(TriIndex, MeshIn.GetTriangle(TriIndex));
+			MeshOut.SetFaceGroup(TriIndex, MeshIn.GetTriGroup(TriIndex));
+		}
+	});
+
+	bool bNormals = Options.bCopyNormals && MeshIn.HasNormals();
+	int NumUVSets = (Options.bCopyUVs) ? GS::Min(MeshIn.GetNumUVSets(), PolyMeshUVs::MaxSets) : 0;
+	bool bColors = Options.bCopyColors && MeshIn.HasColors();
+	if (!bNormals && NumUVSets == 0 && !bColors)
+		return;
+
+	// sort triangle corners by vertex, so corners of each vertex can be welded independently
+	unsafe_vector<uint64_t> SortedCorners;
+	int32_t NumCorners = 3 * NumTriangles;
+	SortedCorners.resize(NumCorners);
+	ForEachConversionBlock(NumTriangles, bParallel, [&](int32_t, int32_t Start, int32_t End) {
+		for (int32_t TriIndex = Start; TriIndex < End; ++TriIndex) {
+			const Index3i& Tri = MeshIn.GetTriangle(TriIndex);
+			for (int32_t j = 0; j < 3; ++j)
+				SortedCorners[3 * TriIndex + j] = ((uint64_t)(uint32_t)Tri[j] << 32) | (uint64_t)(3 * TriIndex + j);
+		}
+	});
+	GS::ParallelRadixSortUpper32(SortedCorners, (int)std::bit_width((uint32_t)GS::Max(NumVertices, 1)), bParallel);
+
+	// weld the corner values of an attribute, add a new attribute set for the unique values and set the triangle element indices
+	unsafe_vector<int> CornerElements;
+	auto WeldAttribute = [&](PolyMesh::EAttributeType AttribType, auto&& GetCornerValue, auto&& AddSetFunc, auto&& SetElementFunc)
+	{
+		using ValueType = std::decay_t<decltype(GetCornerValue(0))>;
+		unsafe_vector<ValueType> Elements;
+		WeldCornerValues(SortedCorners, GetCornerValue, Elements, CornerElements, bParallel);
+		int SetIndex = AddSetFunc(Elements.size());
+		if (SetIndex < 0) return;
+		ForEachConversionBlock((int32_t)Elements.size(), bParallel, [&](int32_t, int32_t Start, int32_t End) {
+			for (int32_t k = Start; k < End; ++k)
+				SetElementFunc(k, Elements[k], SetIndex);
+		});
+		ForEachConversionBlock(NumTriangles, bParallel, [&](int32_t, int32_t Start, int32_t End) {
+			for (int32_t TriIndex = Start; TriIndex < End; ++TriIndex) {
+				Index3i ElementTri(CornerElements[3 * TriIndex], CornerElements[3 * TriIndex + 1], CornerElements[3 * TriIndex + 2]);
+				MeshOut.InitializeFaceAttributes(TriIndex, AttribType, &ElementTri, SetIndex);
+			}
+		});
+	};
+
+	if (bNormals) {
+		WeldAttribute(PolyMesh::EAttributeType::Normal,
+			[&](int32_t Corner) { return MeshIn.GetTriVtxNormals(Corner / 3)[Corner % 3]; },
+			[&](size_t NumElements) { return MeshOut.AddNormalSet(NumElements); },
+			[&](int Index, const Vector3f& Normal, int SetIndex) { MeshOut.SetNormal(Index, Normal, SetIndex); });
+	}
+	for (int UVSet = 0; UVSet < NumUVSets; ++UVSet) {
+		WeldAttribute(PolyMesh::EAttributeType::UV,
+			[&](int32_t Corner) { return MeshIn.GetTriVtxUVs(Corner / 3, UVSet)[Corner % 3]; },
+			[&](size_t NumElements) { return MeshOut.AddUVSet(NumElements); },
+			[&](int Index, const Vector2f& UV, int SetIndex) { MeshOut.SetUV(Index, (Vector2d)UV, SetIndex); });
+	}
+	if (bColors) {
+		WeldAttribute(PolyMesh::EAttributeType::Color,
+			[&](int32_t Corner) { return MeshIn.GetTriVtxColors(Corner / 3)[Corner % 3]; },
+			[&](size_t NumElements) { return MeshOut.AddColorSet(NumElements); },
+			[&](int Index, const Color4b& Color, int SetIndex) { MeshOut.SetColor(Index, (Vector4f)Color, SetIndex); });
+	}
+}
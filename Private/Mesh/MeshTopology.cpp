@@ -4,7 +4,13 @@
 #include "Core/gs_debug.h"
 #include "Mesh/MeshTypes.h"
 #include "Core/dynamic_buffer.h"
+#include "Core/DerivedDataCache.h"
+#include "Core/ParallelFor.h"
+#include "Core/ParallelSort.h"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <vector>
 
 using namespace GS;
@@ -57,45 +63,6 @@ namespace GS
 	}
 
 
-	// build per-vertex triangle-one-rings from edges information
-	void BuildVertexTriangles(
-		int NumVertexIDs,
-		const packed_int_lists& VertexEdges,
-		const unsafe_vector<MeshTopology::Edge>& Edges,
-		packed_int_lists& VertexTriangles)
-	{
-		VertexTriangles.Initialize(NumVertexIDs, 0, VertexEdges.NumListElements());
-		unsafe_vector<int> OneRingTrisTmp;
-		for (int VertexID = 0; VertexID < NumVertexIDs; ++VertexID)
-		{
-			if (VertexEdges.HasList(VertexID) == false)
-				continue;
-			int NumEdges;
-			const int* OneRingEdges = VertexEdges.GetListItemsUnsafe(VertexID, NumEdges);
-			OneRingTrisTmp.reserve(NumEdges);
-			for (int k = 0; k < NumEdges; ++k) {
-				int eid = OneRingEdges[k];
-				const MeshTopology::Edge& Edge = Edges[eid];
-
-				if (Edge.TriInfo.A == -1)
-				{
-					// nonmanifold, todo
-					gs_debug_assert(false);
-				}
-				else
-				{
-					OneRingTrisTmp.add_unique(Edge.TriInfo.A);
-					if (Edge.TriInfo.B >= 0)
-						OneRingTrisTmp.add_unique(Edge.TriInfo.B);
-				}
-			}
-
-			VertexTriangles.AppendList(VertexID, (int)OneRingTrisTmp.size(), OneRingTrisTmp.raw_pointer());
-			OneRingTrisTmp.clear();
-		}
-	}
-
-
 	// build per-vertex vertex-one-rings from computed sets of per-vertex triangles
 	void BuildVertexVertices(
 		int NumVertexIDs, 
@@ -131,194 +98,554 @@ namespace GS
 	}
 
 
-	// build per-vertex vertex-one-rings from edges information
-	void BuildVertexVertices(
-		int NumVertexIDs,
-		const packed_int_lists& VertexEdges,
-		const unsafe_vector<MeshTopology::Edge>& Edges,
-		packed_int_lists& VertexVertices)
+	static constexpr int32_t TopologyBlockSize = 16 * 1024;
+
+	// initialize Lists with NumLists lists, where list k has ListSizeFunc(k) items (or no list if the size is 0),
+	// then call FillFunc to write the items of each non-empty list. The list layout is the same as calling
+	// AppendList() in ListID order. Both functions are called in parallel, and FillFunc is called after all ListSizeFunc calls.
+	void BuildPackedListsParallel(
+		packed_int_lists& Lists, int NumLists,
+		FunctionRef<int(int ListID)> ListSizeFunc,
+		FunctionRef<void(int ListID, int* ItemsOut)> FillFunc,
+		bool bParallel)
 	{
-		VertexVertices.Initialize(NumVertexIDs, 0, VertexEdges.NumListElements());
-		unsafe_vector<int> OneRingVertsTmp;
-		for (int VertexID = 0; VertexID < NumVertexIDs; ++VertexID)
-		{
-			if (VertexEdges.HasList(VertexID) == false)
-				continue;
-			int NumEdges;
-			const int* OneRingEdges = VertexEdges.GetListItemsUnsafe(VertexID, NumEdges);
-			OneRingVertsTmp.resize(NumEdges);
-			int j = 0;
-			for (int k = 0; k < NumEdges; ++k) {
-				int eid = OneRingEdges[k];
-				const MeshTopology::Edge& Edge = Edges[eid];
-				int VertB = Edge.Vertices.GetOtherValue(VertexID);
-				gs_debug_assert(VertB != VertexID);
-				OneRingVertsTmp[j++] = VertB;
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		int32_t NumBlocks = (NumLists + TopologyBlockSize - 1) / TopologyBlockSize;
+		unsafe_vector<int64_t> BlockOffsets;
+		BlockOffsets.resize(NumBlocks + 1);
+		BlockOffsets[0] = 0;
+		Lists.ListPointers.resize(NumLists);
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumLists);
+			int64_t BlockSize = 0;
+			for (int32_t k = (int32_t)BlockIndex * TopologyBlockSize; k < BlockEnd; ++k) {
+				int Size = ListSizeFunc(k);
+				Lists.ListPointers[k] = Size;
+				BlockSize += (Size > 0) ? (Size + 1) : 0;
 			}
+			BlockOffsets[BlockIndex + 1] = BlockSize;
+		}, Flags);
+		for (int32_t b = 0; b < NumBlocks; ++b)
+			BlockOffsets[b + 1] += BlockOffsets[b];
 
-			VertexVertices.AppendList(VertexID, (int)OneRingVertsTmp.size(), OneRingVertsTmp.raw_pointer());
-		}
+		Lists.PackedLists.resize(BlockOffsets[NumBlocks]);
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumLists);
+			int Offset = (int)BlockOffsets[BlockIndex];
+			for (int32_t k = (int32_t)BlockIndex * TopologyBlockSize; k < BlockEnd; ++k) {
+				int Size = Lists.ListPointers[k];
+				if (Size == 0) {
+					Lists.ListPointers[k] = -1;
+					continue;
+				}
+				Lists.ListPointers[k] = Offset;
+				Lists.PackedLists[Offset] = Size;
+				FillFunc(k, Lists.PackedLists.raw_pointer(Offset + 1));
+				Offset += Size + 1;
+			}
+		}, Flags);
 	}
 
 
-
-	void BuildTriNeighbours(
-		int NumTriangleIDs,
+	// Sort-based construction of Edges, VertexEdges and NonManifoldEdgeTriLists, and the EdgeID of each triangle
+	// corner-edge (TriEdgeIDsOut[3*TriangleID+j] is the edge (TriV[j],TriV[j+1])). 
+	// The output is the same as inserting the edges of each triangle one at a time, in TriangleID order:
+	// EdgeIDs are assigned in order of first occurrence, nonmanifold ListIDs in order of the third occurrence,
+	// and triangle lists are in TriangleID order. To do this in parallel, (MinV,MaxV,occurrence) records are
+	// sorted so each edge is a contiguous run, and IDs are assigned by prefix sums over occurrences.
+	// VertexEdges are skipped if bBuildVertexEdges is false.
+	void BuildEdgesSorted(
+		int NumVertexIDs, int NumTriangleIDs,
 		FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
-		const MeshTopology& Topology,
-		unsafe_vector<Index3i>& TriNeighbours,
-		packed_int_lists& NonManifoldTriTriLists)
+		MeshTopology& Topology,
+		unsafe_vector<Index3i>& TrianglesOut,
+		unsafe_vector<int>& TriEdgeIDsOut,
+		bool bBuildVertexEdges,
+		bool bParallel)
 	{
-		gs_debug_assert(Topology.HasVertexEdges());
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		int NumVertexBits = (int)std::bit_width((uint32_t)GS::Max(NumVertexIDs, 1));
 
-		TriNeighbours.initialize(NumTriangleIDs, Index3i(-1, -1, -1));
+		// fetch triangles, invalid triangles are stored as (-1,-1,-1)
+		unsafe_vector<Index3i>& Triangles = TrianglesOut;
+		Triangles.resize(NumTriangleIDs);
+		int32_t NumTriBlocks = (NumTriangleIDs + TopologyBlockSize - 1) / TopologyBlockSize;
+		unsafe_vector<int32_t> BlockOffsets;
+		BlockOffsets.resize(NumTriBlocks + 1);
+		BlockOffsets[0] = 0;
+		GS::ParallelFor(NumTriBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumTriangleIDs);
+			int32_t Count = 0;
+			for (int32_t TriangleID = (int32_t)BlockIndex * TopologyBlockSize; TriangleID < BlockEnd; ++TriangleID) {
+				Index3i TriV;
+				bool bValid = GetTriangleFunc(TriangleID, TriV) && TriV.A >= 0 && TriV.B >= 0 && TriV.C >= 0;
+				Triangles[TriangleID] = (bValid) ? TriV : Index3i(-1, -1, -1);
+				Count += (bValid) ? 1 : 0;
+			}
+			BlockOffsets[BlockIndex + 1] = Count;
+		}, Flags);
+		for (int32_t b = 0; b < NumTriBlocks; ++b)
+			BlockOffsets[b + 1] += BlockOffsets[b];
 
-		for (int TriangleID = 0; TriangleID < NumTriangleIDs; ++TriangleID)
-		{
-			Index3i TriV;
-			if (!GetTriangleFunc(TriangleID, TriV))
-				continue;
+		auto GetOccurrenceEdge = [&](uint32_t Occurrence) {
+			const Index3i& TriV = Triangles[Occurrence / 3];
+			int j = (int)(Occurrence % 3);
+			int VertA = TriV[j], VertB = TriV[(j + 1) % 3];
+			return (VertA < VertB) ? Index2i(VertA, VertB) : Index2i(VertB, VertA);
+		};
 
-			Index3i TriNbrs(-1, -1, -1);
-			for (int j = 0; j < 3; ++j) {
-				int VertA = TriV[j], VertB = TriV[(j + 1) % 3];
-				int EdgeID = Topology.FindEdgeID(VertA, VertB);
-				if (EdgeID < 0)
-					continue;		// edge doesn't exist
-				const MeshTopology::Edge& Edge = Topology.Edges[EdgeID];
-				if (Edge.IsManifold() == false)
-				{
-					gs_debug_assert(false);
-					// extract tri list and encode index here
-					TriNbrs[j] = -2;
-					continue;
+		// occurrence records (MinV,Occurrence), radix-sorted by MinV. Then each MinV group is sorted by
+		// (MaxV,Occurrence), which is a small sort as the groups are (roughly) vertex one-rings.
+		int32_t NumRecords = 3 * BlockOffsets[NumTriBlocks];
+		unsafe_vector<uint64_t> Records;
+		Records.resize(NumRecords);
+		GS::ParallelFor(NumTriBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumTriangleIDs);
+			int32_t WriteIndex = 3 * BlockOffsets[BlockIndex];
+			for (int32_t TriangleID = (int32_t)BlockIndex * TopologyBlockSize; TriangleID < BlockEnd; ++TriangleID) {
+				if (Triangles[TriangleID].A < 0) continue;
+				for (uint32_t j = 0; j < 3; ++j) {
+					uint32_t Occurrence = 3 * (uint32_t)TriangleID + j;
+					Records[WriteIndex++] = ((uint64_t)GetOccurrenceEdge(Occurrence).A << 32) | Occurrence;
 				}
+			}
+		}, Flags);
+		GS::ParallelRadixSortUpper32(Records, NumVertexBits, bParallel);
 
-				int OtherT = Edge.TriInfo.GetOtherValue(TriangleID);
-				gs_debug_assert(OtherT != TriangleID);
-				TriNbrs[j] = OtherT;
+		unsafe_vector<int32_t> RecordMinV;
+		RecordMinV.resize(NumRecords);
+		int32_t NumRecordBlocks = (NumRecords + TopologyBlockSize - 1) / TopologyBlockSize;
+		GS::ParallelFor(NumRecordBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumRecords);
+			for (int32_t i = (int32_t)BlockIndex * TopologyBlockSize; i < BlockEnd; ++i) {
+				uint32_t Occurrence = (uint32_t)(Records[i] & 0xFFFFFFFF);
+				RecordMinV[i] = (int32_t)(Records[i] >> 32);
+				Records[i] = ((uint64_t)GetOccurrenceEdge(Occurrence).B << 32) | Occurrence;
 			}
+		}, Flags);
+		// sort groups that start in each block (a group may extend past the end of the block)
+		GS::ParallelFor(NumRecordBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumRecords);
+			int32_t i = (int32_t)BlockIndex * TopologyBlockSize;
+			while (i > 0 && i < BlockEnd && RecordMinV[i] == RecordMinV[i - 1])
+				i++;
+			while (i < BlockEnd) {
+				int32_t GroupEnd = i + 1;
+				while (GroupEnd < NumRecords && RecordMinV[GroupEnd] == RecordMinV[i])
+					GroupEnd++;
+				if (GroupEnd - i > 1)
+					std::sort(Records.raw_pointer(i), Records.raw_pointer(GroupEnd));
+				i = GroupEnd;
+			}
+		}, Flags);
 
-			TriNeighbours[TriangleID] = TriNbrs;
+		auto GetRecordEdge = [&](int32_t i) { return Index2i(RecordMinV[i], (int)(Records[i] >> 32)); };
+		auto GetRecordOccurrence = [&](int32_t i) { return (uint32_t)(Records[i] & 0xFFFFFFFF); };
+
+		// find runs of equal edges, each run is one edge
+		auto IsRunStart = [&](int32_t i) {
+			return i == 0 || GetRecordEdge(i) != GetRecordEdge(i - 1);
+		};
+		BlockOffsets.resize(NumRecordBlocks + 1);
+		BlockOffsets[0] = 0;
+		GS::ParallelFor(NumRecordBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumRecords);
+			int32_t Count = 0;
+			for (int32_t i = (int32_t)BlockIndex * TopologyBlockSize; i < BlockEnd; ++i)
+				Count += IsRunStart(i) ? 1 : 0;
+			BlockOffsets[BlockIndex + 1] = Count;
+		}, Flags);
+		for (int32_t b = 0; b < NumRecordBlocks; ++b)
+			BlockOffsets[b + 1] += BlockOffsets[b];
+		int32_t NumEdges = BlockOffsets[NumRecordBlocks];
+		unsafe_vector<int32_t> RunStarts;
+		RunStarts.resize(NumEdges + 1);
+		RunStarts[NumEdges] = NumRecords;
+		GS::ParallelFor(NumRecordBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumRecords);
+			int32_t WriteIndex = BlockOffsets[BlockIndex];
+			for (int32_t i = (int32_t)BlockIndex * TopologyBlockSize; i < BlockEnd; ++i) {
+				if (IsRunStart(i))
+					RunStarts[WriteIndex++] = i;
+			}
+		}, Flags);
+
+		// flag the first occurrence of each edge, and the third occurrence of nonmanifold edges
+		static constexpr uint8_t FirstOccurrenceFlag = 1, ThirdOccurrenceFlag = 2;
+		int32_t NumOccurrences = 3 * NumTriangleIDs;
+		unsafe_vector<uint8_t> OccurrenceFlags;
+		OccurrenceFlags.initialize(NumOccurrences, (uint8_t)0);
+		int32_t NumEdgeBlocks = (NumEdges + TopologyBlockSize - 1) / TopologyBlockSize;
+		unsafe_vector<int32_t> BlockNonManifoldCounts;
+		BlockNonManifoldCounts.initialize(NumEdgeBlocks, 0);
+		GS::ParallelFor(NumEdgeBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumEdges);
+			for (int32_t r = (int32_t)BlockIndex * TopologyBlockSize; r < BlockEnd; ++r) {
+				OccurrenceFlags[GetRecordOccurrence(RunStarts[r])] |= FirstOccurrenceFlag;
+				if (RunStarts[r + 1] - RunStarts[r] > 2) {
+					OccurrenceFlags[GetRecordOccurrence(RunStarts[r] + 2)] |= ThirdOccurrenceFlag;
+					BlockNonManifoldCounts[BlockIndex]++;
+				}
+			}
+		}, Flags);
+		int32_t NumNonManifold = 0;
+		for (int32_t Count : BlockNonManifoldCounts)
+			NumNonManifold += Count;
+
+		// assign EdgeIDs and nonmanifold ListIDs in occurrence order. The EdgeID is written to the first
+		// occurrence of each edge, and the ListID to the third occurrence of each nonmanifold edge.
+		unsafe_vector<int>& TriEdgeIDs = TriEdgeIDsOut;
+		TriEdgeIDs.initialize(NumOccurrences, -1);
+		unsafe_vector<int> OccurrenceListIDs;
+		if (NumNonManifold > 0)
+			OccurrenceListIDs.initialize(NumOccurrences, -1);
+		int32_t NumOccBlocks = (NumOccurrences + TopologyBlockSize - 1) / TopologyBlockSize;
+		unsafe_vector<Index2i> OccBlockOffsets;
+		OccBlockOffsets.resize(NumOccBlocks + 1);
+		OccBlockOffsets[0] = Index2i(0, 0);
+		GS::ParallelFor(NumOccBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumOccurrences);
+			Index2i Counts(0, 0);
+			for (int32_t o = (int32_t)BlockIndex * TopologyBlockSize; o < BlockEnd; ++o) {
+				Counts.A += (OccurrenceFlags[o] & FirstOccurrenceFlag) ? 1 : 0;
+				Counts.B += (OccurrenceFlags[o] & ThirdOccurrenceFlag) ? 1 : 0;
+			}
+			OccBlockOffsets[BlockIndex + 1] = Counts;
+		}, Flags);
+		for (int32_t b = 0; b < NumOccBlocks; ++b)
+			OccBlockOffsets[b + 1] = Index2i(OccBlockOffsets[b + 1].A + OccBlockOffsets[b].A, OccBlockOffsets[b + 1].B + OccBlockOffsets[b].B);
+		GS::ParallelFor(NumOccBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumOccurrences);
+			Index2i NextIDs = OccBlockOffsets[BlockIndex];
+			for (int32_t o = (int32_t)BlockIndex * TopologyBlockSize; o < BlockEnd; ++o) {
+				if (OccurrenceFlags[o] & FirstOccurrenceFlag)
+					TriEdgeIDs[o] = NextIDs.A++;
+				if (OccurrenceFlags[o] & ThirdOccurrenceFlag)
+					OccurrenceListIDs[o] = NextIDs.B++;
+			}
+		}, Flags);
+		OccurrenceFlags.clear(true);
+
+		// fill Edges from runs, and set EdgeIDs for the other occurrences of each edge
+		Topology.Edges.resize(NumEdges);
+		unsafe_vector<int32_t> NonManifoldRuns;
+		NonManifoldRuns.resize(NumNonManifold);
+		GS::ParallelFor(NumEdgeBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumEdges);
+			for (int32_t r = (int32_t)BlockIndex * TopologyBlockSize; r < BlockEnd; ++r) {
+				int32_t Start = RunStarts[r], Count = RunStarts[r + 1] - RunStarts[r];
+				uint32_t FirstOccurrence = GetRecordOccurrence(Start);
+				int EdgeID = TriEdgeIDs[FirstOccurrence];
+				MeshTopology::Edge& Edge = Topology.Edges[EdgeID];
+				Edge.Vertices = GetRecordEdge(Start);
+				if (Count <= 2) {
+					Edge.TriInfo = Index2i((int)(FirstOccurrence / 3), (Count == 2) ? (int)(GetRecordOccurrence(Start + 1) / 3) : -1);
+				}
+				else {
+					int ListID = OccurrenceListIDs[GetRecordOccurrence(Start + 2)];
+					Edge.TriInfo = Index2i(-1, ListID);
+					NonManifoldRuns[ListID] = r;
+				}
+				for (int32_t i = Start + 1; i < Start + Count; ++i)
+					TriEdgeIDs[GetRecordOccurrence(i)] = EdgeID;
+			}
+		}, Flags);
+
+		Topology.NonManifoldEdgeTriLists.Clear();
+		if (NumNonManifold > 0)
+		{
+			BuildPackedListsParallel(Topology.NonManifoldEdgeTriLists, NumNonManifold,
+				[&](int ListID) { int32_t r = NonManifoldRuns[ListID]; return (int)(RunStarts[r + 1] - RunStarts[r]); },
+				[&](int ListID, int* ItemsOut) {
+					int32_t r = NonManifoldRuns[ListID];
+					for (int32_t i = RunStarts[r]; i < RunStarts[r + 1]; ++i)
+						*ItemsOut++ = (int)(GetRecordOccurrence(i) / 3);
+				}, bParallel);
 		}
+		Records.clear(true);
+		RecordMinV.clear(true);
+		RunStarts.clear(true);
+
+		Topology.VertexEdges.Clear();
+		if (bBuildVertexEdges == false)
+			return;
+
+		// VertexEdges lists are the edges at each vertex in EdgeID order. Emit (vertex, EdgeID) records
+		// in EdgeID order and stable-sort them by vertex, then each vertex's edges are a contiguous range.
+		unsafe_vector<uint64_t> VertexEdgeRecords;
+		VertexEdgeRecords.resize(2 * (size_t)NumEdges);
+		GS::ParallelFor(NumEdgeBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumEdges);
+			for (int32_t EdgeID = (int32_t)BlockIndex * TopologyBlockSize; EdgeID < BlockEnd; ++EdgeID) {
+				const Index2i& EdgeV = Topology.Edges[EdgeID].Vertices;
+				VertexEdgeRecords[2 * EdgeID] = ((uint64_t)EdgeV.A << 32) | (uint32_t)EdgeID;
+				VertexEdgeRecords[2 * EdgeID + 1] = ((uint64_t)EdgeV.B << 32) | (uint32_t)EdgeID;
+			}
+		}, Flags);
+		GS::ParallelRadixSortUpper32(VertexEdgeRecords, NumVertexBits, bParallel);
+
+		int32_t NumVertexEdgeRecords = 2 * NumEdges;
+		unsafe_vector<int32_t> VertexStarts;
+		VertexStarts.resize((size_t)NumVertexIDs + 1);
+		int32_t NumVERecordBlocks = (NumVertexEdgeRecords + TopologyBlockSize - 1) / TopologyBlockSize;
+		GS::ParallelFor(NumVERecordBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumVertexEdgeRecords);
+			for (int32_t i = (int32_t)BlockIndex * TopologyBlockSize; i < BlockEnd; ++i) {
+				int64_t VertexID = (int64_t)(VertexEdgeRecords[i] >> 32);
+				int64_t PrevVertexID = (i > 0) ? (int64_t)(VertexEdgeRecords[i - 1] >> 32) : -1;
+				for (int64_t v = PrevVertexID + 1; v <= VertexID; ++v)
+					VertexStarts[v] = i;
+			}
+		}, Flags);
+		int64_t LastVertexID = (NumVertexEdgeRecords > 0) ? (int64_t)(VertexEdgeRecords[NumVertexEdgeRecords - 1] >> 32) : -1;
+		for (int64_t v = LastVertexID + 1; v <= (int64_t)NumVertexIDs; ++v)
+			VertexStarts[v] = NumVertexEdgeRecords;
 
+		BuildPackedListsParallel(Topology.VertexEdges, NumVertexIDs,
+			[&](int VertexID) { return (int)(VertexStarts[VertexID + 1] - VertexStarts[VertexID]); },
+			[&](int VertexID, int* ItemsOut) {
+				for (int32_t i = VertexStarts[VertexID]; i < VertexStarts[VertexID + 1]; ++i)
+					*ItemsOut++ = (int)(uint32_t)VertexEdgeRecords[i];
+			}, bParallel);
 	}
 
 
-	void BuildVertexEdges(
-		int NumVertexIDs, int NumTriangleIDs,
-		FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
-		MeshTopology& Topology)
+	// collect the unique triangles of the (manifold) edges at a vertex, in edge order. UniqueTrisOut must
+	// have space for twice the number of edges at the vertex. Returns the number of triangles.
+	int CollectVertexEdgeTriangles(
+		int VertexID,
+		const packed_int_lists& VertexEdges,
+		const unsafe_vector<MeshTopology::Edge>& Edges,
+		int* UniqueTrisOut)
 	{
-		unsafe_vector<InlineIndexList> VertEdgeSets;
-		VertEdgeSets.resize(NumVertexIDs);
-
-		// todo it would be nice to have a variant of packed_int_lists that is based on linkedlist...
-		unsafe_vector<InlineIndexList> NonManifoldTriLists;
-
-		// look up edge in VertexEdgeSets
-		auto FindEdgeID = [&](int VertexA, int VertexB) {
-			if (VertexB < VertexA)
-				GS::SwapTemp(VertexA, VertexB);
-			InlineIndexList& VertEdgeList = VertEdgeSets[VertexA];
-			int NumVertEdges = VertEdgeList.Size();
-			const int* KnownEdges = VertEdgeList.GetBuffer();
-			for (int j = 0; j < NumVertEdges; ++j) {
-				int eid = KnownEdges[j];
-				if (Topology.Edges[eid].Vertices.A == VertexA && Topology.Edges[eid].Vertices.B == VertexB)
-					return eid;
-			}
-			return -1;
+		if (VertexEdges.HasList(VertexID) == false)
+			return 0;
+		int NumEdges;
+		const int* OneRingEdges = VertexEdges.GetListItemsUnsafe(VertexID, NumEdges);
+		int NumTris = 0;
+		auto AddUnique = [&](int TriangleID) {
+			for (int j = 0; j < NumTris; ++j)
+				if (UniqueTrisOut[j] == TriangleID) return;
+			UniqueTrisOut[NumTris++] = TriangleID;
 		};
+		for (int k = 0; k < NumEdges; ++k) {
+			const MeshTopology::Edge& Edge = Edges[OneRingEdges[k]];
+			if (Edge.TriInfo.A == -1)
+				continue;		// nonmanifold, todo
+			AddUnique(Edge.TriInfo.A);
+			if (Edge.TriInfo.B >= 0)
+				AddUnique(Edge.TriInfo.B);
+		}
+		return NumTris;
+	}
 
-		int TotalVertEdgeCount = 0;
-		int TotalNonManifoldTriCount = 0;
-		for (int TriangleID = 0; TriangleID < NumTriangleIDs; ++TriangleID)
-		{
-			Index3i TriVerts;
-			if (!GetTriangleFunc(TriangleID, TriVerts))
-				continue;
-			if (TriVerts.A < 0 || TriVerts.B < 0 || TriVerts.C < 0)		// catch invalid triangles
-				continue;
 
-			for (int j = 0; j < 3; ++j)
+	// build per-vertex triangle-one-rings from edges information
+	void BuildVertexTriangles(
+		int NumVertexIDs,
+		const packed_int_lists& VertexEdges,
+		const unsafe_vector<MeshTopology::Edge>& Edges,
+		packed_int_lists& VertexTriangles,
+		bool bParallel)
+	{
+		// Collect the one-ring triangles of each vertex into a scratch buffer. Each edge has at most 
+		// two triangles, so a vertex needs at most twice the space of its VertexEdges list.
+		unsafe_vector<int> OneRingTris;
+		OneRingTris.resize(2 * VertexEdges.PackedLists.size());
+		BuildPackedListsParallel(VertexTriangles, NumVertexIDs,
+			[&](int VertexID) {
+				if (VertexEdges.HasList(VertexID) == false)
+					return 0;
+				int* UniqueTris = OneRingTris.raw_pointer(2 * (size_t)VertexEdges.ListPointers[VertexID]);
+				return CollectVertexEdgeTriangles(VertexID, VertexEdges, Edges, UniqueTris);
+			},
+			[&](int VertexID, int* ItemsOut) {
+				const int* UniqueTris = OneRingTris.raw_pointer(2 * (size_t)VertexEdges.ListPointers[VertexID]);
+				int NumTris = VertexTriangles.GetListSizeUnsafe(VertexID);
+				for (int k = 0; k < NumTris; ++k)
+					ItemsOut[k] = UniqueTris[k];
+			}, bParallel);
+	}
+
+
+	// build per-vertex vertex-one-rings from edges information
+	void BuildVertexVertices(
+		int NumVertexIDs,
+		const packed_int_lists& VertexEdges,
+		const unsafe_vector<MeshTopology::Edge>& Edges,
+		packed_int_lists& VertexVertices,
+		bool bParallel)
+	{
+		BuildPackedListsParallel(VertexVertices, NumVertexIDs,
+			[&](int VertexID) { return VertexEdges.HasList(VertexID) ? VertexEdges.GetListSizeUnsafe(VertexID) : 0; },
+			[&](int VertexID, int* ItemsOut) {
+				int NumEdges;
+				const int* OneRingEdges = VertexEdges.GetListItemsUnsafe(VertexID, NumEdges);
+				for (int k = 0; k < NumEdges; ++k)
+					ItemsOut[k] = Edges[OneRingEdges[k]].Vertices.GetOtherValue(VertexID);
+			}, bParallel);
+	}
+
+
+	void BuildTriNeighbours(
+		const unsafe_vector<Index3i>& Triangles,
+		const unsafe_vector<int>& TriEdgeIDs,
+		const unsafe_vector<MeshTopology::Edge>& Edges,
+		unsafe_vector<Index3i>& TriNeighbours,
+		bool bParallel)
+	{
+		int32_t NumTriangleIDs = (int32_t)Triangles.size();
+		TriNeighbours.resize(NumTriangleIDs);
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		int32_t NumBlocks = (NumTriangleIDs + TopologyBlockSize - 1) / TopologyBlockSize;
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumTriangleIDs);
+			for (int32_t TriangleID = (int32_t)BlockIndex * TopologyBlockSize; TriangleID < BlockEnd; ++TriangleID)
 			{
-				int VertA = TriVerts[j], VertB = TriVerts[(j+1)%3];
-				if ( VertB < VertA )
-					GS::SwapTemp(VertA, VertB);
-				int FoundEdgeID = FindEdgeID(VertA, VertB);
-				if (FoundEdgeID >= 0)
+				Index3i TriNbrs(-1, -1, -1);
+				if (Triangles[TriangleID].A >= 0)
 				{
-					MeshTopology::Edge& Edge = Topology.Edges[FoundEdgeID];
-					if (Edge.TriInfo.A == -1) {
-						int ListID = Edge.TriInfo.B;
-						NonManifoldTriLists[ListID].AddValue(TriangleID);
-						TotalNonManifoldTriCount++;
-					}
-					else if (Edge.TriInfo.B != -1) {
-						// needs to become nonmanifold
-						int ListID = (int)NonManifoldTriLists.size();
-						NonManifoldTriLists.resize(NonManifoldTriLists.size() + 1);
-						NonManifoldTriLists[ListID].AddValue(Edge.TriInfo.A);
-						NonManifoldTriLists[ListID].AddValue(Edge.TriInfo.B);
-						NonManifoldTriLists[ListID].AddValue(TriangleID);
-						TotalNonManifoldTriCount += 3;
-						Edge.TriInfo.A = -1;
-						Edge.TriInfo.B = ListID;
+					for (int j = 0; j < 3; ++j) {
+						const MeshTopology::Edge& Edge = Edges[TriEdgeIDs[3 * TriangleID + j]];
+						// todo: encode index of nonmanifold tri list here
+						TriNbrs[j] = (Edge.IsManifold()) ? Edge.TriInfo.GetOtherValue(TriangleID) : -2;
 					}
-					else
-						Edge.TriInfo.B = TriangleID;
 				}
-				else 
+				TriNeighbours[TriangleID] = TriNbrs;
+			}
+		}, Flags);
+	}
+
+
+	// build CornerOpposites from the per-corner EdgeIDs, and pick a corner for each vertex
+	void BuildCornerTable(
+		int NumVertexIDs,
+		const unsafe_vector<Index3i>& Triangles,
+		const unsafe_vector<int>& TriEdgeIDs,
+		const unsafe_vector<MeshTopology::Edge>& Edges,
+		unsafe_vector<int>& CornerOpposites,
+		unsafe_vector<int>& VertexCorners,
+		bool bParallel)
+	{
+		int32_t NumTriangleIDs = (int32_t)Triangles.size();
+		CornerOpposites.resize(3 * (size_t)NumTriangleIDs);
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		int32_t NumBlocks = (NumTriangleIDs + TopologyBlockSize - 1) / TopologyBlockSize;
+
+		// each triangle writes its own corners. Edge (TriV[j],TriV[j+1]) is opposite corner j+2, and is only
+		// connected if it is manifold and the other triangle has the edge in the opposite direction.
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumTriangleIDs);
+			for (int32_t TriangleID = (int32_t)BlockIndex * TopologyBlockSize; TriangleID < BlockEnd; ++TriangleID)
+			{
+				const Index3i& TriV = Triangles[TriangleID];
+				for (int j = 0; j < 3; ++j)
 				{
-					MeshTopology::Edge NewEdge{ Index2i(VertA, VertB), Index2i{TriangleID, -1} };
-					int NewEdgeID = (int)Topology.Edges.add(NewEdge);
-					gs_debug_assert(NewEdgeID < Topology.Edges.size());
-					VertEdgeSets[VertA].AddValue(NewEdgeID);
-					VertEdgeSets[VertB].AddValue(NewEdgeID);
-					TotalVertEdgeCount += 2;
+					int OppCorner = -1;
+					if (TriV.A >= 0)
+					{
+						int EdgeID = TriEdgeIDs[3 * TriangleID + j];
+						const MeshTopology::Edge& Edge = Edges[EdgeID];
+						int OtherTriID = Edge.TriInfo.GetOtherValue(TriangleID);
+						if (Edge.IsManifold() && OtherTriID >= 0 && OtherTriID != TriangleID)
+						{
+							const Index3i& OtherTriV = Triangles[OtherTriID];
+							for (int k = 0; k < 3; ++k) {
+								if (TriEdgeIDs[3 * OtherTriID + k] == EdgeID && OtherTriV[k] == TriV[(j + 1) % 3] && OtherTriV[(k + 1) % 3] == TriV[j])
+									OppCorner = 3 * OtherTriID + (k + 2) % 3;
+							}
+						}
+					}
+					CornerOpposites[3 * TriangleID + (j + 2) % 3] = OppCorner;
 				}
 			}
-		}
+		}, Flags);
 
-		Topology.VertexEdges.Initialize(NumVertexIDs, 0, TotalVertEdgeCount);
+		// VertexCorners[v] is the smallest corner at v that starts a fan (ie the edge to its previous vertex is not
+		// connected), or the smallest corner at v if there are none. This is an atomic min over (IsInterior, Corner) keys.
+		static constexpr uint32_t InteriorCornerBit = 0x80000000u;
+		unsafe_vector<uint32_t> VertexCornerKeys;
+		VertexCornerKeys.initialize(NumVertexIDs, 0xFFFFFFFFu);
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * TopologyBlockSize, NumTriangleIDs);
+			for (int32_t TriangleID = (int32_t)BlockIndex * TopologyBlockSize; TriangleID < BlockEnd; ++TriangleID)
+			{
+				const Index3i& TriV = Triangles[TriangleID];
+				if (TriV.A < 0)
+					continue;
+				for (int j = 0; j < 3; ++j) {
+					int Corner = 3 * TriangleID + j;
+					uint32_t Key = (uint32_t)Corner | ((CornerOpposites[MeshTopology::PrevCorner(Corner)] >= 0) ? InteriorCornerBit : 0);
+					std::atomic_ref<uint32_t> VertexKey(VertexCornerKeys[TriV[j]]);
+					uint32_t CurKey = VertexKey.load(std::memory_order_relaxed);
+					while (Key < CurKey && VertexKey.compare_exchange_weak(CurKey, Key, std::memory_order_relaxed) == false)
+						;
+				}
+			}
+		}, Flags);
+		VertexCorners.resize(NumVertexIDs);
 		for (int VertexID = 0; VertexID < NumVertexIDs; ++VertexID) {
-			if (VertEdgeSets[VertexID].Size() > 0)
-				Topology.VertexEdges.AppendList(VertexID, VertEdgeSets[VertexID].Size(), VertEdgeSets[VertexID].GetBuffer());
-		}
-
-		if (NonManifoldTriLists.size() > 0)
-		{
-			Topology.NonManifoldEdgeTriLists.Initialize((int)NonManifoldTriLists.size(), 0, TotalNonManifoldTriCount);
-			for (int ListID = 0; ListID < NonManifoldTriLists.size(); ++ListID)
-				Topology.NonManifoldEdgeTriLists.AppendList(ListID, NonManifoldTriLists[ListID].Size(), NonManifoldTriLists[ListID].GetBuffer());
+			uint32_t Key = VertexCornerKeys[VertexID];
+			VertexCorners[VertexID] = (Key == 0xFFFFFFFFu) ? -1 : (int)(Key & ~InteriorCornerBit);
 		}
 	}
 
-
 }
 
 
 
+struct MeshTopologyVersions
+{
+	static constexpr uint32_t CurrentVersionNumber = 3;
+	// version 2 adds CornerOpposites and VertexCorners, version 3 adds TriEdges and FreeEdgeIDs
+};
+
+
 void MeshTopology::Build(
 	int NumVertexIDs,
-	FunctionRef<bool(int)> IsVertexValidFunc,
+	[[maybe_unused]] FunctionRef<bool(int)> IsVertexValidFunc,
 	int NumTriangleIDs,
 	FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
-	EMeshTopologyTypes WhichParts)
+	EMeshTopologyTypes WhichParts,
+	bool bParallel)
 {
-	if (WhichParts & EMeshTopologyTypes::VertexEdges) {
-		BuildVertexEdges(NumVertexIDs, NumTriangleIDs, GetTriangleFunc, *this);
+	FreeEdgeIDs.clear(true);
+	bool bBuildVertexEdges = (WhichParts & EMeshTopologyTypes::VertexEdges);
+	bool bBuildCornerTable = (WhichParts & EMeshTopologyTypes::CornerTable);
+	if (bBuildVertexEdges || bBuildCornerTable) {
+		unsafe_vector<Index3i> Triangles;
+		unsafe_vector<int> TriEdgeIDs;
+		BuildEdgesSorted(NumVertexIDs, NumTriangleIDs, GetTriangleFunc, *this, Triangles, TriEdgeIDs, bBuildVertexEdges, bParallel);
 
-		if (WhichParts & EMeshTopologyTypes::VertexTriangles)
-			BuildVertexTriangles(NumVertexIDs, VertexEdges, Edges, VertexTriangles);
-		if (WhichParts & EMeshTopologyTypes::VertexVertices)
-			BuildVertexVertices(NumVertexIDs, VertexEdges, Edges, VertexVertices);
-		if (WhichParts & EMeshTopologyTypes::TriangleNeighbours)
-			BuildTriNeighbours(NumTriangleIDs, GetTriangleFunc, *this, this->TriNeighbours, this->NonManifoldTriTriLists);
+		if (bBuildCornerTable)
+			BuildCornerTable(NumVertexIDs, Triangles, TriEdgeIDs, Edges, CornerOpposites, VertexCorners, bParallel);
 
+		if (bBuildVertexEdges)
+		{
+			if (WhichParts & EMeshTopologyTypes::VertexTriangles)
+				BuildVertexTriangles(NumVertexIDs, VertexEdges, Edges, VertexTriangles, bParallel);
+			if (WhichParts & EMeshTopologyTypes::VertexVertices)
+				BuildVertexVertices(NumVertexIDs, VertexEdges, Edges, VertexVertices, bParallel);
+			if (WhichParts & EMeshTopologyTypes::TriangleNeighbours)
+				BuildTriNeighbours(Triangles, TriEdgeIDs, Edges, TriNeighbours, bParallel);
+			if (WhichParts & EMeshTopologyTypes::TriangleEdges) {
+				TriEdges.resize(NumTriangleIDs);
+				std::copy(TriEdgeIDs.raw_pointer(), TriEdgeIDs.raw_pointer() + 3 * (size_t)NumTriangleIDs, (int*)TriEdges.raw_pointer());
+			}
+		}
+		else
+		{
+			// edges were only needed to build the corner table
+			Edges.clear(true);
+			NonManifoldEdgeTriLists.Clear();
+		}
 	}
-	else {
+	
+	if (bBuildVertexEdges == false && (WhichParts & (EMeshTopologyTypes::VertexTriangles | EMeshTopologyTypes::VertexVertices | EMeshTopologyTypes::TriangleNeighbours)) ) {
 		dynamic_buffer<InlineIndexList> VertTriSets;
 		size_t VertTriSetsTotalCount = 0;
 		BuildPerVertexTriangleSets(NumVertexIDs, NumTriangleIDs, GetTriangleFunc, VertTriSets, VertTriSetsTotalCount);
@@ -339,6 +666,397 @@ void MeshTopology::Build(
 
 
 
+ContentHash128 MeshTopology::MakeCacheKey(
+	const ContentHash128& MeshHash, int NumVertexIDs, int NumTriangleIDs, EMeshTopologyTypes WhichParts)
+{
+	ContentHasher Hasher;
+	Hasher.AppendString("MeshTopology");
+	Hasher.AppendValue<uint32_t>(MeshTopologyVersions::CurrentVersionNumber);
+	Hasher.AppendHash(MeshHash);
+	Hasher.AppendValue<int32_t>(NumVertexIDs);
+	Hasher.AppendValue<int32_t>(NumTriangleIDs);
+	Hasher.AppendValue<uint8_t>((uint8_t)WhichParts);
+	return Hasher.Finalize128();
+}
+
+bool MeshTopology::BuildCached(
+	DerivedDataCache& Cache,
+	const ContentHash128& MeshHash,
+	int NumVertexIDs,
+	FunctionRef<bool(int)> IsVertexValidFunc,
+	int NumTriangleIDs,
+	FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
+	EMeshTopologyTypes WhichParts,
+	bool bParallel)
+{
+	ContentHash128 CacheKey = MakeCacheKey(MeshHash, NumVertexIDs, NumTriangleIDs, WhichParts);
+	return Cache.GetOrBuild(CacheKey, *this, [&]() {
+		Clear();
+		Build(NumVertexIDs, IsVertexValidFunc, NumTriangleIDs, GetTriangleFunc, WhichParts, bParallel);
+	});
+}
+
+
+bool MeshTopology::UpdateTriangles(
+	int NumVertexIDs,
+	int NumTriangleIDs,
+	const_buffer_view<int> ChangedTriangleIDs,
+	FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc)
+{
+	if (HasVertexEdges() == false || HasTriEdges() == false)
+		return false;
+
+	// grow per-vertex and per-triangle arrays for new IDs
+	bool bHasVertexTriangles = HasVertexTriangles(), bHasVertexVertices = HasVertexVertices();
+	bool bHasTriNeighbours = HasTriNeighbours(), bHasCornerTable = HasCornerTable();
+	for (int TriangleID = (int)TriEdges.size(); TriangleID < NumTriangleIDs; ++TriangleID) {
+		TriEdges.add(Index3i(-1, -1, -1));
+		if (bHasTriNeighbours)
+			TriNeighbours.add(Index3i(-1, -1, -1));
+		if (bHasCornerTable) {
+			CornerOpposites.add(-1); CornerOpposites.add(-1); CornerOpposites.add(-1);
+		}
+	}
+	VertexEdges.GrowLists(NumVertexIDs);
+	if (bHasVertexTriangles)
+		VertexTriangles.GrowLists(NumVertexIDs);
+	if (bHasVertexVertices)
+		VertexVertices.GrowLists(NumVertexIDs);
+	for (int VertexID = (int)VertexCorners.size(); bHasCornerTable && VertexID < NumVertexIDs; ++VertexID)
+		VertexCorners.add(-1);
+
+	unsafe_vector<int> ChangedTris;
+	ChangedTris.initialize(ChangedTriangleIDs.size(), ChangedTriangleIDs);
+	std::sort(ChangedTris.raw_pointer(), ChangedTris.raw_pointer() + ChangedTris.size());
+	int NumChanged = (int)(std::unique(ChangedTris.raw_pointer(), ChangedTris.raw_pointer() + ChangedTris.size()) - ChangedTris.raw_pointer());
+	ChangedTris.resize(NumChanged);
+
+	// old triangle vertices are recovered from the triangle edges: vertex j is shared by edges j and j+2
+	unsafe_vector<int> AffectedVertices;
+	unsafe_vector<Index3i> NewTris;
+	NewTris.resize(NumChanged);
+	for (int k = 0; k < NumChanged; ++k)
+	{
+		int TriangleID = ChangedTris[k];
+		const Index3i& TriE = TriEdges[TriangleID];
+		if (TriE.A >= 0) {
+			for (int j = 0; j < 3; ++j) {
+				const Index2i& EdgeV = Edges[TriE[j]].Vertices, PrevEdgeV = Edges[TriE[(j + 2) % 3]].Vertices;
+				AffectedVertices.add(PrevEdgeV.Contains(EdgeV.A) ? EdgeV.A : EdgeV.B);
+			}
+		}
+		Index3i TriV;
+		bool bValid = GetTriangleFunc(TriangleID, TriV) && TriV.A >= 0 && TriV.B >= 0 && TriV.C >= 0;
+		NewTris[k] = (bValid) ? TriV : Index3i(-1, -1, -1);
+		if (bValid) {
+			AffectedVertices.add(TriV.A); AffectedVertices.add(TriV.B); AffectedVertices.add(TriV.C);
+		}
+	}
+	std::sort(AffectedVertices.raw_pointer(), AffectedVertices.raw_pointer() + AffectedVertices.size());
+	int NumAffectedVertices = (int)(std::unique(AffectedVertices.raw_pointer(), AffectedVertices.raw_pointer() + AffectedVertices.size()) - AffectedVertices.raw_pointer());
+	AffectedVertices.resize(NumAffectedVertices);
+	auto GetVertexSlot = [&](int VertexID) {
+		return (int)(std::lower_bound(AffectedVertices.raw_pointer(), AffectedVertices.raw_pointer() + NumAffectedVertices, VertexID) - AffectedVertices.raw_pointer());
+	};
+
+	// triangles whose neighbours may have changed
+	unsafe_vector<int> AffectedTris;
+	for (int TriangleID : ChangedTris)
+		AffectedTris.add(TriangleID);
+	unsafe_vector<int> TriListTmp;
+
+	// remove the old triangles from their edges, and free edges that have no triangles left
+	for (int TriangleID : ChangedTris)
+	{
+		const Index3i TriE = TriEdges[TriangleID];
+		if (TriE.A < 0)
+			continue;
+		for (int j = 0; j < 3; ++j)
+		{
+			int EdgeID = TriE[j];
+			Edge& Edge = Edges[EdgeID];
+			if (Edge.IsFree())
+				continue;
+			if (Edge.IsManifold())
+			{
+				if (Edge.TriInfo.B >= 0)
+					AffectedTris.add(Edge.TriInfo.GetOtherValue(TriangleID));
+				if (Edge.TriInfo.A == TriangleID)
+					Edge.TriInfo = Index2i(Edge.TriInfo.B, -1);
+				else if (Edge.TriInfo.B == TriangleID)
+					Edge.TriInfo.B = -1;
+			}
+			else
+			{
+				int ListID = Edge.TriInfo.B;
+				TriListTmp.clear(false);
+				for (int OtherTriID : NonManifoldEdgeTriLists.GetListView(ListID)) {
+					if (OtherTriID != TriangleID) {
+						TriListTmp.add(OtherTriID);
+						AffectedTris.add(OtherTriID);
+					}
+				}
+				if (TriListTmp.size() <= 2) {
+					NonManifoldEdgeTriLists.RemoveList(ListID);
+					Edge.TriInfo = Index2i(TriListTmp.size() > 0 ? TriListTmp[0] : -1, TriListTmp.size() > 1 ? TriListTmp[1] : -1);
+				}
+				else
+					NonManifoldEdgeTriLists.ReplaceList(ListID, TriListTmp.get_view());
+			}
+			if (Edge.TriInfo.A == -1 && Edge.TriInfo.B == -1) {
+				Edge.Vertices = Index2i(-1, -1);
+				FreeEdgeIDs.add(EdgeID);
+			}
+		}
+		TriEdges[TriangleID] = Index3i(-1, -1, -1);
+	}
+
+	// new edges are linked into per-affected-vertex lists, so they can be found before VertexEdges is updated
+	unsafe_vector<int> NewEdgeListHeads;
+	NewEdgeListHeads.initialize(NumAffectedVertices, -1);
+	unsafe_vector<Index2i> NewEdgeListNodes;		// (EdgeID, next node)
+	auto FindEdgeID = [&](int VertexA, int VertexB) {
+		Index2i EdgeV(GS::Min(VertexA, VertexB), GS::Max(VertexA, VertexB));
+		// old edges are validated against Edges, as they may have been freed or reused
+		if (EdgeV.A < VertexEdges.NumLists() && VertexEdges.HasList(EdgeV.A)) {
+			for (int EdgeID : VertexEdges.GetListView(EdgeV.A))
+				if (Edges[EdgeID].Vertices == EdgeV) return EdgeID;
+		}
+		for (int Node = NewEdgeListHeads[GetVertexSlot(EdgeV.A)]; Node >= 0; Node = NewEdgeListNodes[Node].B)
+			if (Edges[NewEdgeListNodes[Node].A].Vertices == EdgeV) return NewEdgeListNodes[Node].A;
+		return -1;
+	};
+
+	// add the new triangles to existing edges, or create new edges
+	for (int k = 0; k < NumChanged; ++k)
+	{
+		int TriangleID = ChangedTris[k];
+		const Index3i& TriV = NewTris[k];
+		if (TriV.A < 0)
+			continue;
+		Index3i TriE;
+		for (int j = 0; j < 3; ++j)
+		{
+			int VertA = TriV[j], VertB = TriV[(j + 1) % 3];
+			int EdgeID = FindEdgeID(VertA, VertB);
+			if (EdgeID >= 0)
+			{
+				Edge& Edge = Edges[EdgeID];
+				if (Edge.IsManifold() && Edge.TriInfo.B == -1) {
+					AffectedTris.add(Edge.TriInfo.A);
+					Edge.TriInfo.B = TriangleID;
+				}
+				else if (Edge.IsManifold()) {
+					// needs to become nonmanifold
+					AffectedTris.add(Edge.TriInfo.A);
+					AffectedTris.add(Edge.TriInfo.B);
+					int NewList[3] = { Edge.TriInfo.A, Edge.TriInfo.B, TriangleID };
+					Edge.TriInfo = Index2i(-1, NonManifoldEdgeTriLists.AppendList(3, NewList));
+				}
+				else {
+					TriListTmp.clear(false);
+					for (int OtherTriID : NonManifoldEdgeTriLists.GetListView(Edge.TriInfo.B)) {
+						TriListTmp.add(OtherTriID);
+						AffectedTris.add(OtherTriID);
+					}
+					TriListTmp.add(TriangleID);
+					NonManifoldEdgeTriLists.ReplaceList(Edge.TriInfo.B, TriListTmp.get_view());
+				}
+			}
+			else
+			{
+				int NewEdgeID = -1;
+				if (FreeEdgeIDs.pop_back(NewEdgeID) == false)
+					NewEdgeID = (int)Edges.add(Edge());
+				Edges[NewEdgeID] = Edge{ Index2i(GS::Min(VertA, VertB), GS::Max(VertA, VertB)), Index2i(TriangleID, -1) };
+				for (int VertexID : { VertA, VertB }) {
+					int Slot = GetVertexSlot(VertexID);
+					NewEdgeListNodes.add(Index2i(NewEdgeID, NewEdgeListHeads[Slot]));
+					NewEdgeListHeads[Slot] = (int)NewEdgeListNodes.size() - 1;
+				}
+				EdgeID = NewEdgeID;
+			}
+			TriE[j] = EdgeID;
+		}
+		TriEdges[TriangleID] = TriE;
+	}
+
+	// rewrite the one-rings of the affected vertices. VertexEdges lists are kept in EdgeID order.
+	unsafe_vector<int> ListTmp;
+	for (int Slot = 0; Slot < NumAffectedVertices; ++Slot)
+	{
+		int VertexID = AffectedVertices[Slot];
+		ListTmp.clear(false);
+		if (VertexEdges.HasList(VertexID)) {
+			for (int EdgeID : VertexEdges.GetListView(VertexID))
+				if (Edges[EdgeID].Vertices.Contains(VertexID)) ListTmp.add(EdgeID);
+		}
+		for (int Node = NewEdgeListHeads[Slot]; Node >= 0; Node = NewEdgeListNodes[Node].B)
+			ListTmp.add(NewEdgeListNodes[Node].A);
+		std::sort(ListTmp.raw_pointer(), ListTmp.raw_pointer() + ListTmp.size());
+		ListTmp.resize(std::unique(ListTmp.raw_pointer(), ListTmp.raw_pointer() + ListTmp.size()) - ListTmp.raw_pointer());
+		VertexEdges.ReplaceList(VertexID, ListTmp.get_view());
+
+		if (bHasVertexVertices) {
+			for (size_t k = 0; k < ListTmp.size(); ++k)
+				ListTmp[k] = Edges[ListTmp[k]].Vertices.GetOtherValue(VertexID);
+			VertexVertices.ReplaceList(VertexID, ListTmp.get_view());
+		}
+		if (bHasVertexTriangles) {
+			ListTmp.resize(2 * (VertexEdges.HasList(VertexID) ? VertexEdges.GetListSizeUnsafe(VertexID) : 0));
+			int NumTris = CollectVertexEdgeTriangles(VertexID, VertexEdges, Edges, ListTmp.raw_pointer());
+			// ListTmp is unallocated if the vertex has no edges left, get_view() handles that case
+			ListTmp.resize(NumTris);
+			VertexTriangles.ReplaceList(VertexID, ListTmp.get_view());
+		}
+	}
+
+	// update neighbours and corners of affected triangles
+	std::sort(AffectedTris.raw_pointer(), AffectedTris.raw_pointer() + AffectedTris.size());
+	AffectedTris.resize(std::unique(AffectedTris.raw_pointer(), AffectedTris.raw_pointer() + AffectedTris.size()) - AffectedTris.raw_pointer());
+	for (int TriangleID : AffectedTris)
+	{
+		const Index3i& TriE = TriEdges[TriangleID];
+		if (bHasTriNeighbours)
+		{
+			Index3i TriNbrs(-1, -1, -1);
+			for (int j = 0; j < 3 && TriE.A >= 0; ++j) {
+				const Edge& Edge = Edges[TriE[j]];
+				TriNbrs[j] = (Edge.IsManifold()) ? Edge.TriInfo.GetOtherValue(TriangleID) : -2;
+			}
+			TriNeighbours[TriangleID] = TriNbrs;
+		}
+		if (bHasCornerTable)
+		{
+			Index3i TriV, OtherTriV;
+			bool bValid = (TriE.A >= 0) && GetTriangleFunc(TriangleID, TriV);
+			for (int j = 0; j < 3; ++j)
+			{
+				int OppCorner = -1;
+				const Edge* TriEdge = (bValid) ? &Edges[TriE[j]] : nullptr;
+				int OtherTriID = (bValid) ? TriEdge->TriInfo.GetOtherValue(TriangleID) : -1;
+				if (bValid && TriEdge->IsManifold() && OtherTriID >= 0 && OtherTriID != TriangleID && GetTriangleFunc(OtherTriID, OtherTriV)) {
+					for (int k = 0; k < 3; ++k) {
+						if (TriEdges[OtherTriID][k] == TriE[j] && OtherTriV[k] == TriV[(j + 1) % 3] && OtherTriV[(k + 1) % 3] == TriV[j])
+							OppCorner = 3 * OtherTriID + (k + 2) % 3;
+					}
+				}
+				CornerOpposites[3 * TriangleID + (j + 2) % 3] = OppCorner;
+			}
+		}
+	}
+
+	// VertexCorners of affected vertices, using the same (IsInterior, Corner) ordering as Build()
+	if (bHasCornerTable)
+	{
+		for (int VertexID : AffectedVertices)
+		{
+			uint32_t MinKey = 0xFFFFFFFFu;
+			auto UpdateCornerKey = [&](int TriangleID) {
+				Index3i TriV;
+				if (GetTriangleFunc(TriangleID, TriV) == false) return;
+				for (int j = 0; j < 3; ++j) {
+					int Corner = 3 * TriangleID + j;
+					uint32_t Key = (uint32_t)Corner | ((CornerOpposites[PrevCorner(Corner)] >= 0) ? 0x80000000u : 0);
+					if (TriV[j] == VertexID)
+						MinKey = GS::Min(MinKey, Key);
+				}
+			};
+			if (VertexEdges.HasList(VertexID)) {
+				for (int EdgeID : VertexEdges.GetListView(VertexID)) {
+					const Edge& Edge = Edges[EdgeID];
+					if (Edge.IsManifold()) {
+						UpdateCornerKey(Edge.TriInfo.A);
+						if (Edge.TriInfo.B >= 0) UpdateCornerKey(Edge.TriInfo.B);
+					}
+					else {
+						for (int TriangleID : NonManifoldEdgeTriLists.GetListView(Edge.TriInfo.B))
+							UpdateCornerKey(TriangleID);
+					}
+				}
+			}
+			VertexCorners[VertexID] = (MinKey == 0xFFFFFFFFu) ? -1 : (int)(MinKey & 0x7FFFFFFFu);
+		}
+	}
+
+	// lazy compaction
+	for (packed_int_lists* Lists : { &VertexEdges, &VertexTriangles, &VertexVertices, &NonManifoldEdgeTriLists }) {
+		if (Lists->NumUnusedElements > 0 && Lists->NumUnusedElements > Lists->NumListElements() / 2)
+			Lists->Compact();
+	}
+
+	return true;
+}
+
+
+
+
+void MeshTopology::Clear()
+{
+	VertexTriangles.Clear();
+	VertexVertices.Clear();
+	Edges.clear(true);
+	VertexEdges.Clear();
+	NonManifoldEdgeTriLists.Clear();
+	TriNeighbours.clear(true);
+	NonManifoldTriTriLists.Clear();
+	CornerOpposites.clear(true);
+	VertexCorners.clear(true);
+	TriEdges.clear(true);
+	FreeEdgeIDs.clear(true);
+}
+
+bool MeshTopology::Store(GS::ISerializer& Serializer) const
+{
+	GS::SerializationVersion CurrentVersion(MeshTopologyVersions::CurrentVersionNumber);
+	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
+	bOK = bOK && VertexTriangles.Store(Serializer, "VertexTriangles");
+	bOK = bOK && VertexVertices.Store(Serializer, "VertexVertices");
+	bOK = bOK && Edges.Store(Serializer, "Edges");
+	bOK = bOK && VertexEdges.Store(Serializer, "VertexEdges");
+	bOK = bOK && NonManifoldEdgeTriLists.Store(Serializer, "NonManifoldEdgeTriLists");
+	bOK = bOK && TriNeighbours.Store(Serializer, "TriNeighbours");
+	bOK = bOK && NonManifoldTriTriLists.Store(Serializer, "NonManifoldTriTriLists");
+	bOK = bOK && CornerOpposites.Store(Serializer, "CornerOpposites");
+	bOK = bOK && VertexCorners.Store(Serializer, "VertexCorners");
+	bOK = bOK && TriEdges.Store(Serializer, "TriEdges");
+	bOK = bOK && FreeEdgeIDs.Store(Serializer, "FreeEdgeIDs");
+	return bOK;
+}
+
+bool MeshTopology::Restore(GS::ISerializer& Serializer)
+{
+	GS::SerializationVersion Version;
+	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
+	bOK = bOK && (Version.Version >= 1 && Version.Version <= MeshTopologyVersions::CurrentVersionNumber);
+	bOK = bOK && VertexTriangles.Restore(Serializer, "VertexTriangles");
+	bOK = bOK && VertexVertices.Restore(Serializer, "VertexVertices");
+	bOK = bOK && Edges.Restore(Serializer, "Edges");
+	bOK = bOK && VertexEdges.Restore(Serializer, "VertexEdges");
+	bOK = bOK && NonManifoldEdgeTriLists.Restore(Serializer, "NonManifoldEdgeTriLists");
+	bOK = bOK && TriNeighbours.Restore(Serializer, "TriNeighbours");
+	bOK = bOK && NonManifoldTriTriLists.Restore(Serializer, "NonManifoldTriTriLists");
+	if (bOK && Version.Version >= 2) {
+		bOK = bOK && CornerOpposites.Restore(Serializer, "CornerOpposites");
+		bOK = bOK && VertexCorners.Restore(Serializer, "VertexCorners");
+	}
+	else {
+		CornerOpposites.clear(true);
+		VertexCorners.clear(true);
+	}
+	if (bOK && Version.Version >= 3) {
+		bOK = bOK && TriEdges.Restore(Serializer, "TriEdges");
+		bOK = bOK && FreeEdgeIDs.Restore(Serializer, "FreeEdgeIDs");
+	}
+	else {
+		TriEdges.clear(true);
+		FreeEdgeIDs.clear(true);
+	}
+	return bOK;
+}
+
+
+
 int MeshTopology::FindEdgeID(int VertexA, int VertexB) const
 {
 	if (VertexB < VertexA)
@@ -356,6 +1074,97 @@ int MeshTopology::FindEdgeID(int VertexA, int VertexB) const
 }
 
 
+void MeshTopology::EnumerateVertexTriangles(int VertexID, FunctionRef<void(int TriangleID)> TriangleFunc) const
+{
+	if (HasVertexTriangles())
+	{
+		if (VertexTriangles.HasList(VertexID) == false)
+			return;
+		int NumTris = 0;
+		const int* OneRingTris = VertexTriangles.GetListItemsUnsafe(VertexID, NumTris);
+		for (int k = 0; k < NumTris; ++k)
+			TriangleFunc(OneRingTris[k]);
+	}
+	else if (HasCornerTable())
+	{
+		// swing around the vertex: from corner c, the next corner at the vertex is across the edge opposite NextCorner(c)
+		int StartCorner = VertexCorners[VertexID];
+		if (StartCorner < 0)
+			return;
+		int Corner = StartCorner;
+		do {
+			TriangleFunc(Corner / 3);
+			int OppCorner = CornerOpposites[NextCorner(Corner)];
+			Corner = (OppCorner >= 0) ? NextCorner(OppCorner) : -1;
+		} while (Corner >= 0 && Corner != StartCorner);
+	}
+	else
+		gs_debug_assert(false);
+}
+
+
+void MeshTopology::EnumerateVertexVertices(int VertexID, FunctionRef<void(int NbrVertexID)> VertexFunc,
+	FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc) const
+{
+	if (HasVertexVertices())
+	{
+		if (VertexVertices.HasList(VertexID) == false)
+			return;
+		int NumVerts = 0;
+		const int* OneRingVerts = VertexVertices.GetListItemsUnsafe(VertexID, NumVerts);
+		for (int k = 0; k < NumVerts; ++k)
+			VertexFunc(OneRingVerts[k]);
+	}
+	else if (HasVertexEdges())
+	{
+		if (VertexEdges.HasList(VertexID) == false)
+			return;
+		int NumEdges = 0;
+		const int* OneRingEdges = VertexEdges.GetListItemsUnsafe(VertexID, NumEdges);
+		for (int k = 0; k < NumEdges; ++k)
+			VertexFunc(Edges[OneRingEdges[k]].Vertices.GetOtherValue(VertexID));
+	}
+	else if (HasCornerTable() && GetTriangleFunc)
+	{
+		// each triangle in the fan contributes the vertex at NextCorner(c). If the fan is open,
+		// the last triangle also contributes the vertex at PrevCorner(c).
+		int StartCorner = VertexCorners[VertexID];
+		if (StartCorner < 0)
+			return;
+		Index3i TriV;
+		int Corner = StartCorner;
+		while (true) 
+		{
+			GetTriangleFunc(Corner / 3, TriV);
+			VertexFunc(TriV[NextCorner(Corner) % 3]);
+			int OppCorner = CornerOpposites[NextCorner(Corner)];
+			if (OppCorner < 0) {
+				VertexFunc(TriV[PrevCorner(Corner) % 3]);
+				break;
+			}
+			Corner = NextCorner(OppCorner);
+			if (Corner == StartCorner)
+				break;
+		}
+	}
+	else
+		gs_debug_assert(false);
+}
+
+
+int MeshTopology::GetTriNeighbour(int TriangleID, int EdgeIndex) const
+{
+	if (HasTriNeighbours())
+		return TriNeighbours[TriangleID][EdgeIndex];
+	if (HasCornerTable()) {
+		int OppCorner = CornerOpposites[3 * TriangleID + (EdgeIndex + 2) % 3];
+		return (OppCorner >= 0) ? (OppCorner / 3) : -1;
+	}
+	gs_debug_assert(false);
+	return -1;
+}
+
+
 bool MeshTopology::CheckValidity() const
 {
 	if (VertexEdges.NumLists() > 0) 
@@ -371,5 +1180,14 @@ bool MeshTopology::CheckValidity() const
 		}
 	}
 
+	if (HasCornerTable())
+	{
+		int NumCorners = (int)CornerOpposites.size();
+		for (int Corner = 0; Corner < NumCorners; ++Corner) {
+			int OppCorner = CornerOpposites[Corner];
+			gs_debug_assert(OppCorner < 0 || (OppCorner < NumCorners && CornerOpposites[OppCorner] == Corner));
+		}
+	}
+
 	return true;
 }
\ No newline at end of file
@@ -8,6 +8,7 @@ using namespace GS;
 PolyMesh::PolyMesh()
 {
 	NumFaceGroupSets = 0;
+	PolygonOffsets.add(0);
 }
 
 
@@ -18,17 +19,22 @@ void PolyMesh::Clear()
 
 	Triangles.clear();
 	Quads.clear();
-	Polygons.clear();
+	PolygonOffsets.clear();
+	PolygonOffsets.add(0);
+	PolygonVertices.clear();
 	Faces.clear();
 
+	for (uint32_t k = 0; k < NumFaceGroupSets; ++k)
+		FaceGroupSets[k].clear();
 	NumFaceGroupSets = 0;
-	FaceGroups.clear();
 
 	MaterialIDs.clear();
 
 	NormalSets.Clear();
 	UVSets.Clear();
 	ColorSets.Clear();
+
+	RestoredSections.Reset();
 }
 
 
@@ -48,9 +54,10 @@ void PolyMesh::ReserveQuads(size_t NumQuads)
 {
 	Quads.reserve(Quads.size() + NumQuads);
 }
-void PolyMesh::ReservePolygons(size_t NumPolygons)
+void PolyMesh::ReservePolygons(size_t NumPolygons, size_t NumPolygonVertices)
 {
-	Polygons.reserve(Polygons.size() + NumPolygons);
+	PolygonOffsets.reserve(PolygonOffsets.size() + NumPolygons);
+	PolygonVertices.reserve(PolygonVertices.size() + NumPolygonVertices);
 }
 
 int PolyMesh::AddVertex(const Vector3d& NewPosition)
@@ -59,46 +66,82 @@ int PolyMesh::AddVertex(const Vector3d& NewPosition)
 	return vid;
 }
 
+int PolyMesh::AddVertices(int NumVertices)
+{
+	return (int)Positions.grow(NumVertices);
+}
+
 
 void PolyMesh::SetNumGroupSets(int NumGroupSetsIn)
 {
-	if (Faces.size() != 0) // must do this before starting to append faces
-	{
-		gs_runtime_assert(false);		
-		return;
-	}
-	NumFaceGroupSets = NumGroupSetsIn;
+	gs_runtime_assert(NumGroupSetsIn >= 0 && NumGroupSetsIn <= MaxFaceGroupSets);
+	while ((int)NumFaceGroupSets > NumGroupSetsIn)
+		RemoveFaceGroupSet(NumFaceGroupSets - 1);
+	while ((int)NumFaceGroupSets < NumGroupSetsIn && AddFaceGroupSet(0) >= 0)
+		;
 }
 
-
-int PolyMesh::AddNormalSet(size_t NumNormals)
+int PolyMesh::AddFaceGroupSet(int InitialGroupID)
 {
-	if (Faces.size() != 0) // must do this before starting to append faces
+	if (NumFaceGroupSets == MaxFaceGroupSets)
 	{
 		gs_runtime_assert(false);
 		return -1;
 	}
-	return NormalSets.AddSet(NumNormals);
+	int NewSetIndex = (int)NumFaceGroupSets++;
+	FaceGroupSets[NewSetIndex].initialize(Faces.size(), InitialGroupID);
+	return NewSetIndex;
 }
 
-int PolyMesh::AddUVSet(size_t NumUVs)
+void PolyMesh::RemoveFaceGroupSet(int GroupSet)
 {
-	if (Faces.size() != 0) // must do this before starting to append faces
-	{
-		gs_runtime_assert(false);
-		return -1;
-	}
-	return UVSets.AddSet(NumUVs);
+	gs_debug_assert(GroupSet >= 0 && GroupSet < (int)NumFaceGroupSets);
+	// unsafe_vector move-assignment does not free existing storage, so release the removed set first
+	FaceGroupSets[GroupSet].clear(true);
+	FaceGroupSets[GroupSet] = unsafe_vector<int>();
+	for (int k = GroupSet; k < (int)NumFaceGroupSets - 1; ++k)
+		FaceGroupSets[k] = std::move(FaceGroupSets[k + 1]);
+	NumFaceGroupSets--;
 }
 
+
+int PolyMesh::AddNormalSet(size_t NumNormals)
+{
+	return NormalSets.AddSet(NumNormals, GetTriangleCount(), GetQuadCount(), (int)PolygonVertices.size());
+}
+int PolyMesh::AddUVSet(size_t NumUVs)
+{
+	return UVSets.AddSet(NumUVs, GetTriangleCount(), GetQuadCount(), (int)PolygonVertices.size());
+}
 int PolyMesh::AddColorSet(size_t NumColors)
 {
-	if (Faces.size() != 0) // must do this before starting to append faces
-	{
-		gs_runtime_assert(false);
-		return -1;
-	}
-	return ColorSets.AddSet(NumColors);
+	return ColorSets.AddSet(NumColors, GetTriangleCount(), GetQuadCount(), (int)PolygonVertices.size());
+}
+
+void PolyMesh::RemoveNormalSet(int NormalSet)
+{
+	NormalSets.RemoveSet(NormalSet);
+}
+void PolyMesh::RemoveUVSet(int UVSet)
+{
+	UVSets.RemoveSet(UVSet);
+}
+void PolyMesh::RemoveColorSet(int ColorSet)
+{
+	ColorSets.RemoveSet(ColorSet);
+}
+
+int PolyMesh::AppendNormal(const Vector3f& Normal, int NormalSet)
+{
+	return NormalSets.AppendElement(Normal, NormalSet);
+}
+int PolyMesh::AppendUV(const Vector2d& UV, int UVSet)
+{
+	return UVSets.AppendElement(UV, UVSet);
+}
+int PolyMesh::AppendColor(const Vector4f& Color, int ColorSet)
+{
+	return ColorSets.AppendElement(Color, ColorSet);
 }
 
 
@@ -155,14 +198,85 @@ std::pair<PolyMesh::Face, int> PolyMesh::AddPolygon(
 	PolyMesh::Polygon&& Polygon,
 	int GroupID)
 {
-	gs_debug_assert(Polygon.Vertices.size() == Polygon.VertexCount);
-	gs_debug_assert(Polygon.Normals.size() == 0 || Polygon.Normals.size() == (Polygon.VertexCount * NormalSets.NumSets));
-	gs_debug_assert(Polygon.UVs.size() == 0 || Polygon.UVs.size() == (Polygon.VertexCount * UVSets.NumSets));
-	gs_debug_assert(Polygon.Colors.size() == 0 || Polygon.Colors.size() == (Polygon.VertexCount * ColorSets.NumSets));
+	gs_debug_assert((int)Polygon.Vertices.size() == Polygon.VertexCount);
+	gs_debug_assert(Polygon.Normals.size() == 0 || (int)Polygon.Normals.size() == (Polygon.VertexCount * NormalSets.NumSets));
+	gs_debug_assert(Polygon.UVs.size() == 0 || (int)Polygon.UVs.size() == (Polygon.VertexCount * UVSets.NumSets));
+	gs_debug_assert(Polygon.Colors.size() == 0 || (int)Polygon.Colors.size() == (Polygon.VertexCount * ColorSets.NumSets));
 
-	int NewPolyIndex = (int)Polygons.add_move(std::move(Polygon));
+	int NewPolyIndex = GetPolygonCount();
+	PolygonVertices.append(Polygon.Vertices.raw_pointer(), Polygon.VertexCount);
+	PolygonOffsets.add((int)PolygonVertices.size());
 
 	// todo validate polygon normals and UVs?
+	NormalSets.AddPolygon(Polygon.VertexCount, (Polygon.Normals.size() > 0) ? Polygon.Normals.raw_pointer() : nullptr, false);
+	UVSets.AddPolygon(Polygon.VertexCount, (Polygon.UVs.size() > 0) ? Polygon.UVs.raw_pointer() : nullptr, false);
+	ColorSets.AddPolygon(Polygon.VertexCount, (Polygon.Colors.size() > 0) ? Polygon.Colors.raw_pointer() : nullptr, false);
+
+	Face NewFace = PolyMesh::Face::Polygon(NewPolyIndex);
+	int NewFaceIndex = (int)Faces.add(NewFace);
+	on_append_new_face(GroupID);
+	return { NewFace, NewFaceIndex };
+}
+
+
+int PolyMesh::AddTriangles(
+	int NumTriangles,
+	int GroupID,
+	bool bSkipInitialization)
+{
+	int FirstFaceIndex = (int)Faces.size();
+	int FirstTriIndex = (int)Triangles.grow(NumTriangles);
+	if (!bSkipInitialization) {
+		for (int k = 0; k < NumTriangles; ++k)
+			Triangles[FirstTriIndex + k] = Index3i(-1, -1, -1);
+	}
+
+	for (int j = 0; j < NormalSets.NumSets; ++j)
+		NormalSets.Sets[j].Triangles.grow(NumTriangles);
+	for (int j = 0; j < UVSets.NumSets; ++j)
+		UVSets.Sets[j].Triangles.grow(NumTriangles);
+	for (int j = 0; j < ColorSets.NumSets; ++j)
+		ColorSets.Sets[j].Triangles.grow(NumTriangles);
+	if (!bSkipInitialization) {
+		for (int k = FirstTriIndex; k < FirstTriIndex + NumTriangles; ++k) {
+			for (int j = 0; j < NormalSets.NumSets; ++j)
+				NormalSets.SetTriangle(k, Index3i(-1), j);
+			for (int j = 0; j < UVSets.NumSets; ++j)
+				UVSets.SetTriangle(k, Index3i(-1), j);
+			for (int j = 0; j < ColorSets.NumSets; ++j)
+				ColorSets.SetTriangle(k, Index3i(-1), j);
+		}
+	}
+
+	int64_t StartFace = Faces.grow(NumTriangles);
+	for (int k = 0; k < NumTriangles; ++k)
+		Faces[StartFace + k] = PolyMesh::Face::Triangle(FirstTriIndex + k);
+
+	for (uint32_t j = 0; j < NumFaceGroupSets; ++j)
+	{
+		unsafe_vector<int>& GroupSet = FaceGroupSets[j];
+		int64_t StartGroup = GroupSet.grow(NumTriangles);
+		for (int k = 0; k < NumTriangles; ++k)
+			GroupSet[StartGroup + k] = (j == 0) ? GroupID : 0;
+	}
+	return FirstFaceIndex;
+}
+
+
+std::pair<PolyMesh::Face, int> PolyMesh::AddPolygon(
+	const_buffer_view<int> Vertices,
+	int GroupID)
+{
+	int VertexCount = (int)Vertices.size();
+	int NewPolyIndex = GetPolygonCount();
+	int64_t StartIndex = PolygonVertices.grow(VertexCount);
+	for (int j = 0; j < VertexCount; ++j)
+		PolygonVertices[StartIndex + j] = Vertices[j];
+	PolygonOffsets.add((int)PolygonVertices.size());
+
+	NormalSets.AddPolygon(VertexCount, nullptr, false);
+	UVSets.AddPolygon(VertexCount, nullptr, false);
+	ColorSets.AddPolygon(VertexCount, nullptr, false);
 
 	Face NewFace = PolyMesh::Face::Polygon(NewPolyIndex);
 	int NewFaceIndex = (int)Faces.add(NewFace);
@@ -171,13 +285,58 @@ std::pair<PolyMesh::Face, int> PolyMesh::AddPolygon(
 }
 
 
+int PolyMesh::AddPolygons(
+	const_buffer_view<int> VertexCounts,
+	const_buffer_view<int> Vertices,
+	const_buffer_view<int> GroupIDs)
+{
+	int NumNewPolygons = (int)VertexCounts.size();
+	gs_debug_assert(GroupIDs.is_empty() || GroupIDs.size() == VertexCounts.size());
+	int FirstFaceIndex = (int)Faces.size();
+	int FirstPolyIndex = GetPolygonCount();
+	if (NumNewPolygons == 0)
+		return FirstFaceIndex;
+
+	// vertex lists are already packed, so they can be appended in one pass
+	int64_t StartIndex = PolygonVertices.grow(Vertices.size());
+	for (size_t k = 0; k < Vertices.size(); ++k)
+		PolygonVertices[StartIndex + k] = Vertices[k];
+
+	int64_t StartOffset = PolygonOffsets.grow(NumNewPolygons);
+	int CurOffset = PolygonOffsets[StartOffset - 1];
+	for (int k = 0; k < NumNewPolygons; ++k) {
+		CurOffset += VertexCounts[k];
+		PolygonOffsets[StartOffset + k] = CurOffset;
+	}
+	gs_debug_assert(CurOffset == (int)PolygonVertices.size());
+
+	int NumNewVertices = (int)Vertices.size();
+	NormalSets.AddPolygon(NumNewVertices, nullptr, false);
+	UVSets.AddPolygon(NumNewVertices, nullptr, false);
+	ColorSets.AddPolygon(NumNewVertices, nullptr, false);
+
+	int64_t StartFace = Faces.grow(NumNewPolygons);
+	for (int k = 0; k < NumNewPolygons; ++k)
+		Faces[StartFace + k] = PolyMesh::Face::Polygon(FirstPolyIndex + k);
+
+	for (uint32_t j = 0; j < NumFaceGroupSets; ++j)
+	{
+		unsafe_vector<int>& GroupSet = FaceGroupSets[j];
+		int64_t StartGroup = GroupSet.grow(NumNewPolygons);
+		for (int k = 0; k < NumNewPolygons; ++k)
+			GroupSet[StartGroup + k] = (j == 0 && GroupIDs.is_empty() == false) ? GroupIDs[k] : 0;
+	}
+	return FirstFaceIndex;
+}
+
+
 bool PolyMesh::InitializeFaceAttributes(
 	int FaceIndex,
 	PolyMesh::EAttributeType AttributeType,
 	const void* Values,
 	int SingleSetIndex )
 {
-	if (FaceIndex < 0 || FaceIndex >= Faces.size()) return false;
+	if (FaceIndex < 0 || FaceIndex >= (int)Faces.size()) return false;
 	if (Values == nullptr) return false;
 
 	const Face& Face = Faces[FaceIndex];
@@ -204,36 +363,16 @@ bool PolyMesh::InitializeFaceAttributes(
 	}
 	else if (Face.Type == 2)
 	{
-		Polygon& Poly = Polygons[Face.Index];
+		int PolygonOffset = PolygonOffsets[Face.Index];
+		int VertexCount = GetPolygonVertexCount(Face.Index);
 		const unsafe_vector<int>* ElementIDList = (const unsafe_vector<int>*)Values;
-		if ( SingleSetIndex == -1 )
-		{
-			switch (AttributeType) {
-				case EAttributeType::Normal: Poly.Normals = *ElementIDList; break;
-				case EAttributeType::UV: Poly.UVs = *ElementIDList; break;
-				case EAttributeType::Color: Poly.Colors = *ElementIDList; break;
-			}
-		}
-		else
-		{
-			int StartIndex = SingleSetIndex * Poly.VertexCount;
-			switch (AttributeType) {
-				case EAttributeType::Normal: 
-					if (Poly.Normals.size() != Poly.VertexCount * NormalSets.NumSets)
-						Poly.Normals.initialize(Poly.VertexCount * NormalSets.NumSets, -1);
-					for (int j = 0; j < Poly.VertexCount; ++j) { Poly.Normals[StartIndex+j] = (*ElementIDList)[j]; } 
-					break;
-				case EAttributeType::UV:
-					if (Poly.UVs.size() != Poly.VertexCount * UVSets.NumSets)
-						Poly.UVs.initialize(Poly.VertexCount * UVSets.NumSets, -1);
-					for (int j = 0; j < Poly.VertexCount; ++j) { Poly.UVs[StartIndex+j] = (*ElementIDList)[j]; } 
-					break;
-				case EAttributeType::Color:
-					if (Poly.Colors.size() != Poly.VertexCount * ColorSets.NumSets)
-						Poly.Colors.initialize(Poly.VertexCount * ColorSets.NumSets, -1);
-					for (int j = 0; j < Poly.VertexCount; ++j) { Poly.Colors[StartIndex+j] = (*ElementIDList)[j]; } 
-					break;
-			}
+		switch (AttributeType) {
+			case EAttributeType::Normal:
+				NormalSets.SetPolygon(PolygonOffset, VertexCount, ElementIDList->raw_pointer(), SingleSetIndex); break;
+			case EAttributeType::UV:
+				UVSets.SetPolygon(PolygonOffset, VertexCount, ElementIDList->raw_pointer(), SingleSetIndex); break;
+			case EAttributeType::Color:
+				ColorSets.SetPolygon(PolygonOffset, VertexCount, ElementIDList->raw_pointer(), SingleSetIndex); break;
 		}
 		return true;
 	}
@@ -243,14 +382,10 @@ bool PolyMesh::InitializeFaceAttributes(
 
 void PolyMesh::on_append_new_face(int NewGroupID)
 {
-	if (NumFaceGroupSets > 0)
+	for (uint32_t j = 0; j < NumFaceGroupSets; ++j)
 	{
-		int NewGroupStartIndex = (int)FaceGroups.grow(NumFaceGroupSets);
-		FaceGroups[NewGroupStartIndex] = NewGroupID;
-		for (int j = 1; j < (int)NumFaceGroupSets; ++j)
-			FaceGroups[NewGroupStartIndex + j] = 0;
-
-		gs_debug_assert(FaceGroups.size() == NumFaceGroupSets * Faces.size());
+		FaceGroupSets[j].add((j == 0) ? NewGroupID : 0);
+		gs_debug_assert(FaceGroupSets[j].size() == Faces.size());
 	}
 }
 
@@ -268,10 +403,11 @@ bool PolyMesh::GetFaceVertexIndices(const Face& Face, InlineIndexList& IndexList
 		return true;
 	}
 	else if (Face.IsPolygon()) {
-		const Polygon& Poly = Polygons[Face.Index];
-		IndexList.SetSize(Poly.VertexCount);
-		for (int j = 0; j < Poly.VertexCount; ++j)
-			IndexList[j] = Poly.Vertices[j];
+		const int* PolyVertices = PolygonVertices.raw_pointer(PolygonOffsets[Face.Index]);
+		int VertexCount = GetPolygonVertexCount(Face.Index);
+		IndexList.SetSize(VertexCount);
+		for (int j = 0; j < VertexCount; ++j)
+			IndexList[j] = PolyVertices[j];
 		return true;
 	}
 	return false;
@@ -290,10 +426,11 @@ bool PolyMesh::GetFaceVertexPositions(const Face& Face, InlineVec3dList& Positio
 		return true;
 	}
 	else if (Face.IsPolygon()) {
-		const Polygon& Poly = Polygons[Face.Index];
-		PositionsList.SetSize(Poly.VertexCount);
-		for (int j = 0; j < Poly.VertexCount; ++j)
-			PositionsList[j] = Positions[Poly.Vertices[j]];
+		const int* PolyVertices = PolygonVertices.raw_pointer(PolygonOffsets[Face.Index]);
+		int VertexCount = GetPolygonVertexCount(Face.Index);
+		PositionsList.SetSize(VertexCount);
+		for (int j = 0; j < VertexCount; ++j)
+			PositionsList[j] = Positions[PolyVertices[j]];
 		return true;
 	}
 	return false;
@@ -317,3 +454,358 @@ void PolyMesh::Scale(const Vector3d& Scale)
 		Positions[i] = Vector3d(V.X * Scale.X, V.Y * Scale.Y, V.Z * Scale.Z);
 	}
 }
+
+
+
+
+struct PolyMeshVersions
+{
+	static constexpr uint32_t Version1 = 1;
+	//! version 2 stores each group and attribute set in separate buffers
+	static constexpr uint32_t Version2 = 2;
+	static constexpr uint32_t CurrentVersionNumber = Version2;
+};
+
+struct PolyMeshHeaderV1
+{
+	uint32_t VertexCount = 0;
+	uint32_t FaceCount = 0;
+	uint32_t TriangleCount = 0;
+	uint32_t QuadCount = 0;
+	uint32_t PolygonCount = 0;
+};
+
+static const uint32_t PolyMeshStoredSections[] = {
+	(uint32_t)EPolyMeshSections::Positions,
+	(uint32_t)EPolyMeshSections::Faces,
+	(uint32_t)EPolyMeshSections::FaceGroups,
+	(uint32_t)EPolyMeshSections::MaterialIDs,
+	(uint32_t)EPolyMeshSections::Normals,
+	(uint32_t)EPolyMeshSections::UVs,
+	(uint32_t)EPolyMeshSections::Colors
+};
+
+namespace GSLocal
+{
+	// polygon index lists are stored as a flat list of per-polygon counts and a single packed index list,
+	// each polygon has IndicesPerVertex indices for each of its vertices
+	static bool store_polygon_lists(const unsafe_vector<int>& PolygonOffsets, int IndicesPerVertex, const unsafe_vector<int>& Indices, GS::ISerializer& Serializer)
+	{
+		unsafe_vector<int> Counts;
+		size_t NumPolygons = PolygonOffsets.size() - 1;
+		Counts.resize(NumPolygons);
+		for (size_t k = 0; k < NumPolygons; ++k)
+			Counts[k] = (PolygonOffsets[k+1] - PolygonOffsets[k]) * IndicesPerVertex;
+
+		bool bOK = Counts.Store(Serializer, "PolygonCounts");
+		bOK = bOK && Indices.Store(Serializer, "PolygonIndices");
+		return bOK;
+	}
+
+	static bool restore_polygon_vertices(unsafe_vector<int>& PolygonOffsets, unsafe_vector<int>& PolygonVertices, GS::ISerializer& Serializer)
+	{
+		unsafe_vector<int> Counts;
+		bool bOK = Counts.Restore(Serializer, "PolygonCounts");
+		bOK = bOK && PolygonVertices.Restore(Serializer, "PolygonIndices");
+		if (!bOK) return false;
+
+		PolygonOffsets.resize(Counts.size() + 1);
+		PolygonOffsets[0] = 0;
+		for (size_t k = 0; k < Counts.size(); ++k)
+			PolygonOffsets[k+1] = PolygonOffsets[k] + Counts[k];
+		return PolygonOffsets[Counts.size()] == (int)PolygonVertices.size();
+	}
+
+	static bool restore_polygon_attribute_lists(const unsafe_vector<int>& PolygonOffsets, int NumSets, unsafe_vector<int>& Indices, GS::ISerializer& Serializer)
+	{
+		unsafe_vector<int> Counts;
+		bool bOK = Counts.Restore(Serializer, "PolygonCounts");
+		bOK = bOK && Indices.Restore(Serializer, "PolygonIndices");
+		if (!bOK) return false;
+
+		// polygon indices can only be assigned if the Faces section has been restored, see add_section_dependencies()
+		size_t NumPolygons = PolygonOffsets.size() - 1;
+		if (Counts.size() != NumPolygons)
+			return false;
+
+		size_t NumExpected = (size_t)PolygonOffsets[NumPolygons] * NumSets;
+		if (Indices.size() == NumExpected)
+			return true;
+
+		// older files may contain empty lists for polygons without attributes, these are expanded to -1 indices
+		unsafe_vector<int> Stored = std::move(Indices);
+		Indices.resize(NumExpected);
+		size_t CurIndex = 0;
+		for (size_t k = 0; k < NumPolygons; ++k)
+		{
+			int NumPolyIndices = (PolygonOffsets[k+1] - PolygonOffsets[k]) * NumSets;
+			int StartIndex = PolygonOffsets[k] * NumSets;
+			if (Counts[k] == NumPolyIndices) {
+				if (CurIndex + NumPolyIndices > Stored.size()) return false;
+				for (int j = 0; j < NumPolyIndices; ++j)
+					Indices[StartIndex + j] = Stored[CurIndex + j];
+			} else if (Counts[k] == 0) {
+				for (int j = 0; j < NumPolyIndices; ++j)
+					Indices[StartIndex + j] = -1;
+			} else
+				return false;
+			CurIndex += Counts[k];
+		}
+		return true;
+	}
+
+	template<typename ElementType>
+	static bool store_attribute(const IndexedPolyMeshAttribute<ElementType>& Attribute, GS::ISerializer& Serializer)
+	{
+		bool bOK = Serializer.WriteValue<uint8_t>("NumSets", Attribute.NumSets);
+		for (int k = 0; k < Attribute.NumSets; ++k)
+		{
+			const PolyMeshAttributeSet<ElementType>& Set = Attribute.Sets[k];
+			bOK = bOK && Set.Values.Store(Serializer, "Values");
+			bOK = bOK && Set.Triangles.Store(Serializer, "Triangles");
+			bOK = bOK && Set.Quads.Store(Serializer, "Quads");
+			bOK = bOK && Set.Polygons.Store(Serializer, "PolygonIndices");
+		}
+		return bOK;
+	}
+
+	template<typename ElementType>
+	static bool restore_attribute(IndexedPolyMeshAttribute<ElementType>& Attribute, GS::ISerializer& Serializer)
+	{
+		Attribute.Clear();
+		uint8_t NumSets = 0;
+		bool bOK = Serializer.ReadValue<uint8_t>("NumSets", NumSets);
+		if (!bOK || NumSets > IndexedPolyMeshAttribute<ElementType>::MaxSets) return false;
+		Attribute.NumSets = NumSets;
+		for (int k = 0; k < NumSets; ++k)
+		{
+			PolyMeshAttributeSet<ElementType>& Set = Attribute.Sets[k];
+			bOK = bOK && Set.Values.Restore(Serializer, "Values");
+			bOK = bOK && Set.Triangles.Restore(Serializer, "Triangles");
+			bOK = bOK && Set.Quads.Restore(Serializer, "Quads");
+			bOK = bOK && Set.Polygons.Restore(Serializer, "PolygonIndices");
+		}
+		return bOK;
+	}
+
+	//! version 1 stored all sets in single buffers, with per-set tuples interleaved for each face
+	template<typename ElementType>
+	static bool restore_attribute_v1(IndexedPolyMeshAttribute<ElementType>& Attribute,
+		const unsafe_vector<int>& PolygonOffsets, GS::ISerializer& Serializer)
+	{
+		Attribute.Clear();
+		uint8_t NumSets = 0;
+		Index4i SetCounts, SetOffsets;
+		unsafe_vector<ElementType> Values;
+		unsafe_vector<Index3i> Triangles;
+		unsafe_vector<Index4i> Quads;
+		unsafe_vector<int> Polygons;
+		bool bOK = Serializer.ReadValue<uint8_t>("NumSets", NumSets);
+		bOK = bOK && Serializer.ReadValue<Index4i>("SetCounts", SetCounts);
+		bOK = bOK && Serializer.ReadValue<Index4i>("SetOffsets", SetOffsets);
+		bOK = bOK && Values.Restore(Serializer, "Values");
+		bOK = bOK && Triangles.Restore(Serializer, "Triangles");
+		bOK = bOK && Quads.Restore(Serializer, "Quads");
+		bOK = bOK && restore_polygon_attribute_lists(PolygonOffsets, NumSets, Polygons, Serializer);
+		if (!bOK || NumSets > IndexedPolyMeshAttribute<ElementType>::MaxSets) return false;
+		if (NumSets == 0) return true;
+
+		Attribute.NumSets = NumSets;
+		size_t NumTriangles = Triangles.size() / NumSets, NumQuads = Quads.size() / NumSets;
+		for (int j = 0; j < NumSets; ++j)
+		{
+			PolyMeshAttributeSet<ElementType>& Set = Attribute.Sets[j];
+			if (SetOffsets[j] + SetCounts[j] > (int)Values.size()) return false;
+			Set.Values.initialize(SetCounts[j], Values.raw_pointer(SetOffsets[j]));
+			Set.Triangles.resize(NumTriangles);
+			for (size_t k = 0; k < NumTriangles; ++k)
+				Set.Triangles[k] = Triangles[k * NumSets + j];
+			Set.Quads.resize(NumQuads);
+			for (size_t k = 0; k < NumQuads; ++k)
+				Set.Quads[k] = Quads[k * NumSets + j];
+		}
+
+		// polygon index lists are only available if the Faces section was restored
+		if (Polygons.size() == 0)
+			return true;
+		size_t NumPolygons = PolygonOffsets.size() - 1;
+		for (int j = 0; j < NumSets; ++j)
+		{
+			PolyMeshAttributeSet<ElementType>& Set = Attribute.Sets[j];
+			Set.Polygons.resize(PolygonOffsets[NumPolygons]);
+			for (size_t k = 0; k < NumPolygons; ++k)
+			{
+				int Offset = PolygonOffsets[k];
+				int VertexCount = PolygonOffsets[k+1] - Offset;
+				for (int i = 0; i < VertexCount; ++i)
+					Set.Polygons[Offset + i] = Polygons[Offset * NumSets + j * VertexCount + i];
+			}
+		}
+		return true;
+	}
+}
+
+
+bool PolyMesh::Store(GS::ISerializer& Serializer) const
+{
+	GS::SerializationVersion CurrentVersion(PolyMeshVersions::CurrentVersionNumber);
+	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
+
+	PolyMeshHeaderV1 Header;
+	Header.VertexCount = (uint32_t)Positions.size();
+	Header.FaceCount = (uint32_t)Faces.size();
+	Header.TriangleCount = (uint32_t)Triangles.size();
+	Header.QuadCount = (uint32_t)Quads.size();
+	Header.PolygonCount = (uint32_t)GetPolygonCount();
+	bOK = bOK && Serializer.WriteValue<PolyMeshHeaderV1>("PolyMesh", Header);
+
+	bOK = bOK && SerializeSectionDirectory::StoreSections(Serializer, PolyMeshStoredSections, 7,
+		[&](uint32_t SectionID, GS::ISerializer& SectionSerializer) { return store_section(SectionID, SectionSerializer); });
+	return bOK;
+}
+
+bool PolyMesh::Restore(GS::ISerializer& Serializer)
+{
+	return Restore(Serializer, PolyMeshRestoreOptions());
+}
+
+bool PolyMesh::Restore(GS::ISerializer& Serializer, const PolyMeshRestoreOptions& Options)
+{
+	Clear();
+
+	GS::SerializationVersion Version;
+	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
+	gs_debug_assert(Version.Version == PolyMeshVersions::Version1 || Version.Version == PolyMeshVersions::Version2);
+	RestoredVersion = Version.Version;
+
+	PolyMeshHeaderV1 Header;
+	bOK = bOK && Serializer.ReadValue<PolyMeshHeaderV1>("PolyMesh", Header);
+
+	bOK = bOK && RestoredSections.RestoreSections(Serializer, add_section_dependencies((uint32_t)Options.Sections), Options.bAllowDeferredSections,
+		[&](uint32_t SectionID, GS::ISerializer& SectionSerializer) { return restore_section(SectionID, SectionSerializer); });
+
+	gs_debug_assert(!HasSections(EPolyMeshSections::Positions) || Positions.size() == Header.VertexCount);
+	gs_debug_assert(!HasSections(EPolyMeshSections::Faces) || Faces.size() == Header.FaceCount);
+	return bOK;
+}
+
+bool PolyMesh::RestoreDeferredSections(GS::ISerializer& Serializer, EPolyMeshSections Sections)
+{
+	return RestoredSections.RestoreDeferredSections(Serializer, add_section_dependencies((uint32_t)Sections),
+		[&](uint32_t SectionID, GS::ISerializer& SectionSerializer) { return restore_section(SectionID, SectionSerializer); });
+}
+
+uint32_t PolyMesh::add_section_dependencies(uint32_t Sections) const
+{
+	// version 1 attribute sections store polygon indices in a packed per-polygon form that can only be
+	// expanded once the polygons are known, so the Faces section (which precedes them) must also be restored
+	const uint32_t AttributeSections = (uint32_t)(EPolyMeshSections::Normals | EPolyMeshSections::UVs | EPolyMeshSections::Colors);
+	if (RestoredVersion < PolyMeshVersions::Version2 && (Sections & AttributeSections) != 0)
+		Sections |= (uint32_t)EPolyMeshSections::Faces;
+	return Sections;
+}
+
+bool PolyMesh::HasSections(EPolyMeshSections Sections) const
+{
+	// if nothing was restored the mesh was constructed directly, and all sections are available
+	if (RestoredSections.Sections.size() == 0)
+		return true;
+	uint32_t Restored = RestoredSections.GetRestoredSections();
+	return ((uint32_t)Sections & Restored) == (uint32_t)Sections;
+}
+
+EPolyMeshSections PolyMesh::GetDeferredSections() const
+{
+	return (EPolyMeshSections)RestoredSections.GetDeferredSections();
+}
+
+bool PolyMesh::store_section(uint32_t SectionID, GS::ISerializer& SectionSerializer) const
+{
+	switch ((EPolyMeshSections)SectionID)
+	{
+		case EPolyMeshSections::Positions: 
+			return Positions.Store(SectionSerializer, "Positions");
+		case EPolyMeshSections::Faces:
+		{
+			bool bOK = Triangles.Store(SectionSerializer, "Triangles");
+			bOK = bOK && Quads.Store(SectionSerializer, "Quads");
+			bOK = bOK && Faces.Store(SectionSerializer, "Faces");
+			bOK = bOK && GSLocal::store_polygon_lists(PolygonOffsets, 1, PolygonVertices, SectionSerializer);
+			return bOK;
+		}
+		case EPolyMeshSections::FaceGroups:
+		{
+			bool bOK = SectionSerializer.WriteValue<uint32_t>("NumFaceGroupSets", NumFaceGroupSets);
+			for (uint32_t k = 0; k < NumFaceGroupSets; ++k)
+				bOK = bOK && FaceGroupSets[k].Store(SectionSerializer, "FaceGroups");
+			return bOK;
+		}
+		case EPolyMeshSections::MaterialIDs: 
+			return MaterialIDs.Store(SectionSerializer, "MaterialIDs");
+		case EPolyMeshSections::Normals: 
+			return GSLocal::store_attribute(NormalSets, SectionSerializer);
+		case EPolyMeshSections::UVs: 
+			return GSLocal::store_attribute(UVSets, SectionSerializer);
+		case EPolyMeshSections::Colors: 
+			return GSLocal::store_attribute(ColorSets, SectionSerializer);
+		default: 
+			return false;
+	}
+}
+
+bool PolyMesh::restore_section(uint32_t SectionID, GS::ISerializer& SectionSerializer)
+{
+	switch ((EPolyMeshSections)SectionID)
+	{
+		case EPolyMeshSections::Positions:
+			return Positions.Restore(SectionSerializer, "Positions");
+		case EPolyMeshSections::Faces:
+		{
+			bool bOK = Triangles.Restore(SectionSerializer, "Triangles");
+			bOK = bOK && Quads.Restore(SectionSerializer, "Quads");
+			bOK = bOK && Faces.Restore(SectionSerializer, "Faces");
+			if (!bOK) return false;
+
+			size_t NumPolygons = 0;
+			for (const Face& Face : Faces)
+				NumPolygons += (Face.IsPolygon()) ? 1 : 0;
+			bOK = GSLocal::restore_polygon_vertices(PolygonOffsets, PolygonVertices, SectionSerializer);
+			return bOK && (PolygonOffsets.size() == NumPolygons + 1);
+		}
+		case EPolyMeshSections::FaceGroups:
+		{
+			uint32_t NumSets = 0;
+			bool bOK = SectionSerializer.ReadValue<uint32_t>("NumFaceGroupSets", NumSets);
+			if (!bOK || NumSets > MaxFaceGroupSets) return false;
+			NumFaceGroupSets = NumSets;
+			if (RestoredVersion >= PolyMeshVersions::Version2) {
+				for (uint32_t k = 0; k < NumFaceGroupSets; ++k)
+					bOK = bOK && FaceGroupSets[k].Restore(SectionSerializer, "FaceGroups");
+				return bOK;
+			}
+			// version 1 stores interleaved per-face tuples of set groups
+			unsafe_vector<int> FaceGroups;
+			bOK = FaceGroups.Restore(SectionSerializer, "FaceGroups");
+			size_t NumGroupFaces = (NumFaceGroupSets > 0) ? FaceGroups.size() / NumFaceGroupSets : 0;
+			for (uint32_t k = 0; k < NumFaceGroupSets; ++k) {
+				FaceGroupSets[k].resize(NumGroupFaces);
+				for (size_t j = 0; j < NumGroupFaces; ++j)
+					FaceGroupSets[k][j] = FaceGroups[j * NumFaceGroupSets + k];
+			}
+			return bOK;
+		}
+		case EPolyMeshSections::MaterialIDs:
+			return MaterialIDs.Restore(SectionSerializer, "MaterialIDs");
+		case EPolyMeshSections::Normals:
+			return (RestoredVersion >= PolyMeshVersions::Version2) ?
+				GSLocal::restore_attribute(NormalSets, SectionSerializer) : GSLocal::restore_attribute_v1(NormalSets, PolygonOffsets, SectionSerializer);
+		case EPolyMeshSections::UVs:
+			return (RestoredVersion >= PolyMeshVersions::Version2) ?
+				GSLocal::restore_attribute(UVSets, SectionSerializer) : GSLocal::restore_attribute_v1(UVSets, PolygonOffsets, SectionSerializer);
+		case EPolyMeshSections::Colors:
+			return (RestoredVersion >= PolyMeshVersions::Version2) ?
+				GSLocal::restore_attribute(ColorSets, SectionSerializer) : GSLocal::restore_attribute_v1(ColorSets, PolygonOffsets, SectionSerializer);
+		default:
+			return false;
+	}
+}
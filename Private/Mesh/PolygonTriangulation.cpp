@@ -0,0 +1,368 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Mesh/PolygonTriangulation.h"
+#include "Mesh/PolyMesh.h"
+#include "Mesh/MeshTypes.h"
+#include "Core/ParallelFor.h"
+#include "Math/GSMath.h"
+#include "Math/GSIndex2.h"
+
+#include <cmath>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	// fixed-size scratch storage, inline for polygons with up to PolygonTriangulationInlineVertexCount vertices and on
+	// the heap for larger ones. TInlineSmallList(Count) uses its inline values if Count < MaxInlineValues.
+	template<typename T>
+	using PolygonScratchBuffer = TInlineSmallList<T, PolygonTriangulationInlineVertexCount + 1>;
+
+
+	// twice the signed area of triangle ABC, positive if ABC is counter-clockwise
+	static inline double Orient2(const Vector2d& A, const Vector2d& B, const Vector2d& C)
+	{
+		return DotPerp(B - A, C - A);
+	}
+
+
+	// Uniform grid of the reflex vertices of a polygon, with about one cell per reflex vertex, so an ear test
+	// only visits the reflex vertices in the cells overlapped by the bounds of the ear. Vertices are removed
+	// from the grid when they become convex or are clipped.
+	struct ReflexVertexGrid
+	{
+		Vector2d Origin;
+		Vector2d InvCellSize;
+		int Resolution = 1;
+		unsafe_vector<int> CellFirst;		// first vertex of each cell, or -1
+		unsafe_vector<Index2i> CellLinks;	// (previous, next) vertex in the same cell, -1 at the ends of a list, -2 if not in the grid
+		unsafe_vector<int> VertexCell;
+
+		void Initialize(const Vector2d* Points, int N, int NumReflex)
+		{
+			Vector2d Min = Points[0], Max = Points[0];
+			for (int i = 1; i < N; ++i) {
+				Min = Vector2d(GS::Min(Min.X, Points[i].X), GS::Min(Min.Y, Points[i].Y));
+				Max = Vector2d(GS::Max(Max.X, Points[i].X), GS::Max(Max.Y, Points[i].Y));
+			}
+			Resolution = GS::Clamp((int)std::sqrt((double)NumReflex), 1, 1024);
+			Origin = Min;
+			InvCellSize.X = (Max.X > Min.X) ? (double)Resolution / (Max.X - Min.X) : 0;
+			InvCellSize.Y = (Max.Y > Min.Y) ? (double)Resolution / (Max.Y - Min.Y) : 0;
+			CellFirst.resize(Resolution * Resolution);
+			for (int k = 0; k < Resolution * Resolution; ++k)
+				CellFirst[k] = -1;
+			CellLinks.resize(N);
+			VertexCell.resize(N);
+			for (int i = 0; i < N; ++i)
+				CellLinks[i] = Index2i(-2, -2);
+		}
+
+		int CellCoord(double Value, int Axis) const
+		{
+			return GS::Clamp((int)((Value - Origin[Axis]) * InvCellSize[Axis]), 0, Resolution - 1);
+		}
+
+		void AddVertex(int V, const Vector2d& P)
+		{
+			if (CellLinks[V].A != -2) return;
+			int Cell = CellCoord(P.Y, 1) * Resolution + CellCoord(P.X, 0);
+			int First = CellFirst[Cell];
+			CellLinks[V] = Index2i(-1, First);
+			if (First >= 0)
+				CellLinks[First].A = V;
+			CellFirst[Cell] = V;
+			VertexCell[V] = Cell;
+		}
+
+		void RemoveVertex(int V)
+		{
+			Index2i Links = CellLinks[V];
+			if (Links.A == -2) return;
+			if (Links.A >= 0)
+				CellLinks[Links.A].B = Links.B;
+			else
+				CellFirst[VertexCell[V]] = Links.B;
+			if (Links.B >= 0)
+				CellLinks[Links.B].A = Links.A;
+			CellLinks[V] = Index2i(-2, -2);
+		}
+
+		// returns true if VertexFunc(V) returns true for any vertex V in the cells overlapping the box [Min,Max]
+		template<typename VertexFuncType>
+		bool AnyVertexInBox(const Vector2d& Min, const Vector2d& Max, const VertexFuncType& VertexFunc) const
+		{
+			int MinX = CellCoord(Min.X, 0), MaxX = CellCoord(Max.X, 0);
+			int MinY = CellCoord(Min.Y, 1), MaxY = CellCoord(Max.Y, 1);
+			for (int y = MinY; y <= MaxY; ++y)
+				for (int x = MinX; x <= MaxX; ++x)
+					for (int V = CellFirst[y * Resolution + x]; V >= 0; V = CellLinks[V].B)
+						if (VertexFunc(V))
+							return true;
+			return false;
+		}
+	};
+
+	static int TriangulatePolygon2(const Vector2d* Points, int N, Index3i* TrianglesOut)
+	{
+		if (N < 3) return 0;
+		if (N == 3) {
+			TrianglesOut[0] = Index3i(0, 1, 2);
+			return 1;
+		}
+
+		// all turn tests below are multiplied by the orientation sign, so both orientations can be handled the same way
+		double AreaSum = 0;
+		for (int i = 0, j = N - 1; i < N; j = i++)
+			AreaSum += DotPerp(Points[j], Points[i]);
+		double Sign = (AreaSum < 0) ? -1.0 : 1.0;
+
+		// convex (or degenerate) polygons can be fan-triangulated
+		bool bConvex = true;
+		for (int i = 0; i < N && bConvex; ++i) {
+			int Prev = (i == 0) ? N - 1 : i - 1, Next = (i == N - 1) ? 0 : i + 1;
+			bConvex = (Sign * Orient2(Points[Prev], Points[i], Points[Next]) >= 0);
+		}
+		if (bConvex) {
+			for (int j = 1; j < N - 1; ++j)
+				TrianglesOut[j - 1] = Index3i(0, j, j + 1);
+			return N - 2;
+		}
+
+		// ear clipping on a linked list of the remaining vertices
+		PolygonScratchBuffer<int> PrevV(N), NextV(N);
+		PolygonScratchBuffer<bool> IsReflex(N);
+		int NumReflex = 0;
+		// polygons that fit in the inline buffers test ears against all remaining vertices, larger polygons use a grid
+		bool bUseGrid = (N > PolygonTriangulationInlineVertexCount);
+		ReflexVertexGrid Grid;
+		auto UpdateReflex = [&](int i) {
+			NumReflex -= IsReflex[i] ? 1 : 0;
+			IsReflex[i] = (Sign * Orient2(Points[PrevV[i]], Points[i], Points[NextV[i]]) < 0);
+			NumReflex += IsReflex[i] ? 1 : 0;
+			if (bUseGrid && IsReflex[i])
+				Grid.AddVertex(i, Points[i]);
+			else if (bUseGrid)
+				Grid.RemoveVertex(i);
+		};
+		for (int i = 0; i < N; ++i) {
+			PrevV[i] = (i == 0) ? N - 1 : i - 1;
+			NextV[i] = (i == N - 1) ? 0 : i + 1;
+			IsReflex[i] = false;
+		}
+		if (bUseGrid) {
+			int NumInitialReflex = 0;
+			for (int i = 0; i < N; ++i)
+				NumInitialReflex += (Sign * Orient2(Points[PrevV[i]], Points[i], Points[NextV[i]]) < 0) ? 1 : 0;
+			Grid.Initialize(Points, N, NumInitialReflex);
+		}
+		for (int i = 0; i < N; ++i)
+			UpdateReflex(i);
+
+		// Mode 0 only accepts valid ears, ie convex vertices where no (reflex) vertex is inside or on the ear triangle.
+		// If there are none, the polygon is not simple. Mode 1 then accepts degenerate ears, and Mode 2 accepts any vertex.
+		auto IsEar = [&](int B, int Mode) {
+			int A = PrevV[B], C = NextV[B];
+			const Vector2d& PA = Points[A], &PB = Points[B], &PC = Points[C];
+			double Turn = Sign * Orient2(PA, PB, PC);
+			if (Mode == 2)
+				return true;
+			if (Mode == 1) {
+				double Tolerance = RealMath<double>::ZeroTolerance() * ( DistanceSquared(PA, PB) + DistanceSquared(PB, PC) );
+				return GS::Abs(Turn) <= Tolerance;
+			}
+			if (Turn <= 0)
+				return false;
+			if (NumReflex == 0)
+				return true;
+			auto IsInsideEar = [&](int V) {
+				if (IsReflex[V] == false) return false;
+				const Vector2d& P = Points[V];
+				if (P == PA || P == PB || P == PC) return false;		// ear vertices, and duplicate vertices eg from hole bridges
+				return Sign * Orient2(PA, PB, P) >= 0 && Sign * Orient2(PB, PC, P) >= 0 && Sign * Orient2(PC, PA, P) >= 0;
+			};
+			if (bUseGrid) {
+				Vector2d Min(GS::Min(PA.X, GS::Min(PB.X, PC.X)), GS::Min(PA.Y, GS::Min(PB.Y, PC.Y)));
+				Vector2d Max(GS::Max(PA.X, GS::Max(PB.X, PC.X)), GS::Max(PA.Y, GS::Max(PB.Y, PC.Y)));
+				return Grid.AnyVertexInBox(Min, Max, IsInsideEar) == false;
+			}
+			for (int V = NextV[C]; V != A; V = NextV[V]) {
+				if (IsInsideEar(V))
+					return false;
+			}
+			return true;
+		};
+
+		int NumTriangles = 0;
+		int Remaining = N;
+		int Current = 0;
+		int Mode = 0;
+		while (Remaining > 3)
+		{
+			bool bClipped = false;
+			for (int k = 0; k < Remaining && !bClipped; ++k)
+			{
+				if (IsEar(Current, Mode)) {
+					int A = PrevV[Current], C = NextV[Current];
+					TrianglesOut[NumTriangles++] = Index3i(A, Current, C);
+					NextV[A] = C;
+					PrevV[C] = A;
+					NumReflex -= IsReflex[Current] ? 1 : 0;
+					IsReflex[Current] = false;
+					if (bUseGrid)
+						Grid.RemoveVertex(Current);
+					Remaining--;
+					UpdateReflex(A);
+					UpdateReflex(C);
+					Current = NextV[C];		// skip C, so consecutive ears do not form a growing fan around A
+					bClipped = true;
+				}
+				else
+					Current = NextV[Current];
+			}
+			Mode = (bClipped) ? 0 : GS::Min(Mode + 1, 2);
+		}
+		TrianglesOut[NumTriangles++] = Index3i(PrevV[Current], Current, NextV[Current]);
+		gs_debug_assert(NumTriangles == N - 2);
+		return NumTriangles;
+	}
+
+
+	// project the polygon to the axis plane most aligned with the Newell normal and triangulate the 2D polygon
+	template<typename GetPositionFuncType>
+	static int TriangulatePolygon3(int N, const GetPositionFuncType& GetPosition, Index3i* TrianglesOut)
+	{
+		if (N < 3) return 0;
+		if (N == 3) {
+			TrianglesOut[0] = Index3i(0, 1, 2);
+			return 1;
+		}
+
+		PolygonScratchBuffer<Vector3d> Positions(N);
+		Vector3d Normal = Vector3d::Zero();
+		for (int i = 0; i < N; ++i)
+			Positions[i] = GetPosition(i);
+		for (int i = 0, j = N - 1; i < N; j = i++) {
+			const Vector3d& Pj = Positions[j], & Pi = Positions[i];
+			Normal.X += (Pj.Y - Pi.Y) * (Pj.Z + Pi.Z);
+			Normal.Y += (Pj.Z - Pi.Z) * (Pj.X + Pi.X);
+			Normal.Z += (Pj.X - Pi.X) * (Pj.Y + Pi.Y);
+		}
+
+		// drop the dominant normal axis. The 2D orientation may be flipped, but the 2D triangulation handles either orientation.
+		double AbsX = GS::Abs(Normal.X), AbsY = GS::Abs(Normal.Y), AbsZ = GS::Abs(Normal.Z);
+		int Axis0 = 0, Axis1 = 1;
+		if (AbsX >= AbsY && AbsX >= AbsZ) {
+			Axis0 = 1; Axis1 = 2;
+		} else if (AbsY >= AbsZ) {
+			Axis0 = 2; Axis1 = 0;
+		}
+		PolygonScratchBuffer<Vector2d> Projected(N);
+		for (int i = 0; i < N; ++i)
+			Projected[i] = Vector2d(Positions[i][Axis0], Positions[i][Axis1]);
+		return TriangulatePolygon2(&Projected[0], N, TrianglesOut);
+	}
+
+
+	static constexpr int32_t TriangulationBlockSize = 16 * 1024;
+}
+
+
+int GS::TriangulatePolygon(const_buffer_view<Vector2d> Vertices, Index3i* TrianglesOut)
+{
+	int N = (int)Vertices.size();
+	if (N < 3) return 0;
+	return GSLocal::TriangulatePolygon2(&Vertices[0], N, TrianglesOut);
+}
+
+int GS::TriangulatePolygon(const_buffer_view<Vector3d> Vertices, Index3i* TrianglesOut)
+{
+	return GSLocal::TriangulatePolygon3((int)Vertices.size(), [&](int i) { return Vertices[i]; }, TrianglesOut);
+}
+
+int GS::TriangulatePolyMeshFace(const PolyMesh& Mesh, int FaceIndex, Index3i* TrianglesOut)
+{
+	const PolyMesh::Face& Face = Mesh.GetFace(FaceIndex);
+	int N = Mesh.GetFaceVertexCount(Face);
+	return GSLocal::TriangulatePolygon3(N, [&](int i) { return Mesh.GetPosition(Mesh.GetFaceVertex(Face, i)); }, TrianglesOut);
+}
+
+
+int GS::ComputePolyMeshTriangleOffsets(const PolyMesh& Mesh, unsafe_vector<int>& FaceTriangleOffsetsOut, bool bParallel)
+{
+	using namespace GSLocal;
+	int NumFaces = Mesh.GetFaceCount();
+	int32_t NumBlocks = (NumFaces + TriangulationBlockSize - 1) / TriangulationBlockSize;
+	FaceTriangleOffsetsOut.resize(NumFaces + 1);
+
+	// write the per-face triangle counts shifted by one, sum the counts of each block, and then prefix-sum
+	// the block counts and offset the faces of each block
+	unsafe_vector<int> BlockOffsets;
+	BlockOffsets.resize(NumBlocks + 1);
+	BlockOffsets[0] = 0;
+	FaceTriangleOffsetsOut[0] = 0;
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int Start = (int)BlockIndex * TriangulationBlockSize, End = GS::Min(Start + TriangulationBlockSize, NumFaces);
+		int Sum = 0;
+		for (int FaceIndex = Start; FaceIndex < End; ++FaceIndex) {
+			Sum += GS::Max(Mesh.GetFaceVertexCount(FaceIndex) - 2, 0);
+			FaceTriangleOffsetsOut[FaceIndex + 1] = Sum;
+		}
+		BlockOffsets[BlockIndex + 1] = Sum;
+	}, Flags);
+	for (int32_t b = 0; b < NumBlocks; ++b)
+		BlockOffsets[b + 1] += BlockOffsets[b];
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int Start = (int)BlockIndex * TriangulationBlockSize, End = GS::Min(Start + TriangulationBlockSize, NumFaces);
+		for (int FaceIndex = Start; FaceIndex < End; ++FaceIndex)
+			FaceTriangleOffsetsOut[FaceIndex + 1] += BlockOffsets[BlockIndex];
+	}, Flags);
+
+	return BlockOffsets[NumBlocks];
+}
+
+
+void GS::TriangulatePolyMesh(
+	const PolyMesh& Mesh,
+	const_buffer_view<int> FaceTriangleOffsets,
+	Index3i* TrianglesOut,
+	const PolyMeshTriangulationOptions& Options)
+{
+	using namespace GSLocal;
+	int NumFaces = Mesh.GetFaceCount();
+	gs_runtime_assert((int)FaceTriangleOffsets.size() == NumFaces + 1);
+	int32_t NumBlocks = (NumFaces + TriangulationBlockSize - 1) / TriangulationBlockSize;
+
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !Options.bParallel;
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int Start = (int)BlockIndex * TriangulationBlockSize, End = GS::Min(Start + TriangulationBlockSize, NumFaces);
+		for (int FaceIndex = Start; FaceIndex < End; ++FaceIndex)
+		{
+			Index3i* FaceTriangles = &TrianglesOut[FaceTriangleOffsets[FaceIndex]];
+			int NumFaceTriangles = TriangulatePolyMeshFace(Mesh, FaceIndex, FaceTriangles);
+			gs_debug_assert(NumFaceTriangles == FaceTriangleOffsets[FaceIndex + 1] - FaceTriangleOffsets[FaceIndex]);
+			if (Options.bOutputVertexIndices) {
+				const PolyMesh::Face& Face = Mesh.GetFace(FaceIndex);
+				for (int j = 0; j < NumFaceTriangles; ++j) {
+					Index3i& Tri = FaceTriangles[j];
+					Tri = Index3i(Mesh.GetFaceVertex(Face, Tri.A), Mesh.GetFaceVertex(Face, Tri.B), Mesh.GetFaceVertex(Face, Tri.C));
+				}
+			}
+		}
+	}, Flags);
+}
+
+
+void GS::TriangulatePolyMesh(
+	const PolyMesh& Mesh,
+	unsafe_vector<Index3i>& TrianglesOut,
+	unsafe_vector<int>& FaceTriangleOffsetsOut,
+	const PolyMeshTriangulationOptions& Options)
+{
+	int NumTriangles = ComputePolyMeshTriangleOffsets(Mesh, FaceTriangleOffsetsOut, Options.bParallel);
+	TrianglesOut.resize(NumTriangles);
+	TriangulatePolyMesh(Mesh, FaceTriangleOffsetsOut.get_view(), TrianglesOut.raw_pointer(), Options);
+}
@@ -3,7 +3,10 @@
 
 #include "Core/ParallelFor.h"
 #include "Spatial/AxisBoxTree2.h"
+#include "Spatial/WideAxisBoxTree2.h"
 #include "Mesh/MeshTypes.h"
+#include "Mesh/MeshConnectedComponents.h"
+#include "Core/DerivedDataCache.h"
 
 using namespace GS;
 
@@ -16,6 +19,84 @@ SurfaceTexelSampling::~SurfaceTexelSampling()
 
 void SurfaceTexelSampling::Build(ConstMeshView2d UVMesh, int ImageWidth, int ImageHeight,
 	FunctionRef<Vector3d(int, Vector3d)> ComputeTriBaryPoint3DFunc)
+{
+	build_samples(UVMesh, ImageWidth, ImageHeight, ComputeTriBaryPoint3DFunc, nullptr, ContentHash128());
+}
+
+
+struct SurfaceTexelSamplingVersions
+{
+	// version 2: UVIsland is set in TexelSamples
+	static constexpr uint32_t CurrentVersionNumber = 2;
+};
+
+ContentHash128 SurfaceTexelSampling::MakeCacheKey(const ContentHash128& UVMeshHash, const ContentHash128& SurfaceHash, int ImageWidth, int ImageHeight)
+{
+	ContentHasher Hasher;
+	Hasher.AppendString("SurfaceTexelSampling");
+	Hasher.AppendValue<uint32_t>(SurfaceTexelSamplingVersions::CurrentVersionNumber);
+	Hasher.AppendHash(UVMeshHash);
+	Hasher.AppendHash(SurfaceHash);
+	Hasher.AppendValue<int32_t>(ImageWidth);
+	Hasher.AppendValue<int32_t>(ImageHeight);
+	return Hasher.Finalize128();
+}
+
+bool SurfaceTexelSampling::BuildCached(DerivedDataCache& Cache, const ContentHash128& SurfaceHash,
+	ConstMeshView2d UVMesh, int ImageWidth, int ImageHeight,
+	FunctionRef<Vector3d(int, Vector3d)> ComputeTriBaryPoint3DFunc)
+{
+	ContentHash128 UVMeshHash = ComputeContentHash(UVMesh);
+	ContentHash128 CacheKey = MakeCacheKey(UVMeshHash, SurfaceHash, ImageWidth, ImageHeight);
+	return Cache.GetOrBuild(CacheKey, *this, [&]() {
+		build_samples(UVMesh, ImageWidth, ImageHeight, ComputeTriBaryPoint3DFunc, &Cache, UVMeshHash);
+	});
+}
+
+void SurfaceTexelSampling::Clear()
+{
+	TexelSamples.clear(true);
+	SampleBounds = AxisBox3d::Empty();
+}
+
+void SurfaceTexelSampling::BuildSampleGrid(PointHashGrid3d& GridOut, double CellSize, bool bParallel) const
+{
+	int NumTexelSamples = NumSamples();
+	if (CellSize <= 0)
+	{
+		// samples lie on a surface, so assume they are spread over an area of about MaxDim^2, and aim for ~8 samples per cell
+		double MaxDim = GS::Max(SampleBounds.DimensionX(), GS::Max(SampleBounds.DimensionY(), SampleBounds.DimensionZ()));
+		CellSize = (MaxDim > 0 && NumTexelSamples > 0) ? (MaxDim * GS::Sqrt(8.0 / (double)NumTexelSamples)) : 1.0;
+	}
+	GridOut.Build(NumTexelSamples, [&](int k, Vector3d& Pos) {
+		Pos = TexelSamples[k].SurfacePos;
+		return true;
+	}, SampleBounds, CellSize, bParallel);
+}
+
+bool SurfaceTexelSampling::Store(GS::ISerializer& Serializer) const
+{
+	GS::SerializationVersion CurrentVersion(SurfaceTexelSamplingVersions::CurrentVersionNumber);
+	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
+	bOK = bOK && Serializer.WriteValue<AxisBox3d>("SampleBounds", SampleBounds);
+	bOK = bOK && TexelSamples.Store(Serializer, "TexelSamples");
+	return bOK;
+}
+
+bool SurfaceTexelSampling::Restore(GS::ISerializer& Serializer)
+{
+	GS::SerializationVersion Version;
+	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
+	bOK = bOK && (Version.Version == SurfaceTexelSamplingVersions::CurrentVersionNumber);
+	bOK = bOK && Serializer.ReadValue<AxisBox3d>("SampleBounds", SampleBounds);
+	bOK = bOK && TexelSamples.Restore(Serializer, "TexelSamples");
+	return bOK;
+}
+
+
+void SurfaceTexelSampling::build_samples(const ConstMeshView2d& UVMesh, int ImageWidth, int ImageHeight,
+	FunctionRef<Vector3d(int, Vector3d)> ComputeTriBaryPoint3DFunc,
+	DerivedDataCache* Cache, const ContentHash128& UVMeshHash)
 {
 	//gs_debug_assert(ImageWidth == ImageHeight);		// other case is untested...
 
@@ -26,15 +107,30 @@ void SurfaceTexelSampling::Build(ConstMeshView2d UVMesh, int ImageWidth, int Ima
 
 	// build 2D box tree
 	AxisBoxTree2d BoxTree;
-	BoxTree.Build(UVMesh.GetNumTriangleIDs(), [&](int TriangleID, GS::AxisBox2d& Box) {
+	auto GetUVTriBoxFunc = [&](int TriangleID, GS::AxisBox2d& Box) {
 		Triangle2d TriV;
 		UVMesh.GetTriangle(TriangleID, TriV);
 		Box = ((Triangle2d)TriV).Bounds();
 		Box = (AxisBox2d)TriV.Bounds();
 		return true;
-	});
+	};
+	// UV layouts are very uneven (dense islands and large empty gutters), which SAH handles much better than midpoint splits
+	AxisBoxTree2BuildOptions TreeOptions;
+	TreeOptions.Method = EAxisBoxTreeBuildMethod::BinnedSAH;
+	if (Cache != nullptr)
+		BoxTree.BuildCached(*Cache, UVMeshHash, UVMesh.GetNumTriangleIDs(), GetUVTriBoxFunc, TreeOptions);
+	else
+		BoxTree.Build(UVMesh.GetNumTriangleIDs(), GetUVTriBoxFunc, TreeOptions);
+
+	// per-pixel distance queries below are the dominant cost, the wide tree tests 4 child boxes at a time
+	WideAxisBoxTree2d WideBoxTree;
+	WideBoxTree.Build(BoxTree);
 	//BoxTree.Validate();
 
+	// UV islands are the triangle components connected by shared UV vertices
+	MeshConnectedComponents UVIslands;
+	UVIslands.BuildTriangleComponents(UVMesh);
+
 	SampleBounds = AxisBox3d::Empty();
 
 	// TODO: to support tiling / worldspace textures, we need to figure out which UV-unit-boxes
@@ -62,7 +158,7 @@ void SurfaceTexelSampling::Build(ConstMeshView2d UVMesh, int ImageWidth, int Ima
 		GS::DistanceQueryOptions<double> Options;
 		Options.MaxDistance = 1.1 * MaxGutterUVWidth;
 
-		DistanceResult2d QueryResult = BoxTree.PointDistanceQuery(PosUV, [&](int tid, const Vector2d& QueryPoint) {
+		DistanceResult2d QueryResult = WideBoxTree.PointDistanceQuery(PosUV, [&](int tid, const Vector2d& QueryPoint) {
 			Triangle2d Tri;
 			UVMesh.GetTriangle(tid, Tri);
 			int edge; double edgeparam;
@@ -96,7 +192,7 @@ void SurfaceTexelSampling::Build(ConstMeshView2d UVMesh, int ImageWidth, int Ima
 		SampleBounds.Contain(Pos3D);
 
 		TexelPoint3d& Pt = AllPoints[LinearIndex];
-		//Pt.UVIsland = TriUVIslandIndex[NearestTID];
+		Pt.UVIsland = UVIslands.ComponentIDs[NearestTID];
 		Pt.PixelPos = Vector2i(xi, yi);
 		Pt.TriangleID = NearestTID;
 		//Pt.UVPos = Vector2d(PosUV3.X, PosUV3.Y);
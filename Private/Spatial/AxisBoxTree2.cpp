@@ -1,6 +1,14 @@
 // Copyright Gradientspace Corp. All Rights Reserved.
 #include "Spatial/AxisBoxTree2.h"
 #include "Mesh/MeshTypes.h"
+#include "Core/inline_stack.h"
+#include "Core/DerivedDataCache.h"
+#include "Core/ParallelFor.h"
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <bit>
 
 using namespace GS;
 
@@ -147,6 +155,36 @@ bool split_group_by_midpoint(
 
 template<typename RealType>
 void GS::AxisBoxTree2<RealType>::Build(int32_t MaxBoxID, FunctionRef<bool(int BoxID, BoxType& Box)> GetBoxFunc, int32_t CountHint)
+{
+	reset_update_state();
+	BuildMaxBoxID = MaxBoxID;
+	LastBuildOptions = AxisBoxTree2BuildOptions();
+	LastBuildOptions.Method = EAxisBoxTreeBuildMethod::Midpoint;
+	LastBuildOptions.MaxLeafSize = 4;
+	build_midpoint(MaxBoxID, GetBoxFunc, CountHint, 4);
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::Build(int32_t MaxBoxID, FunctionRef<bool(int BoxID, BoxType& Box)> GetBoxFunc, const AxisBoxTree2BuildOptions& Options, int32_t CountHint)
+{
+	reset_update_state();
+	BuildMaxBoxID = MaxBoxID;
+	LastBuildOptions = Options;
+	if (Options.Method == EAxisBoxTreeBuildMethod::BinnedSAH)
+	{
+		build_binned_sah(MaxBoxID, GetBoxFunc, Options);
+	}
+	else
+	{
+		Clear();
+		build_midpoint(MaxBoxID, GetBoxFunc, CountHint, GS::Clamp(Options.MaxLeafSize, 1, 15));
+	}
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::build_midpoint(int32_t MaxBoxID, FunctionRef<bool(int BoxID, BoxType& Box)> GetBoxFunc, int32_t CountHint, int MaxLeafSize)
 {
 	static_assert(sizeof(ChildIndex) == sizeof(int32_t));
 
@@ -167,7 +205,7 @@ void GS::AxisBoxTree2<RealType>::Build(int32_t MaxBoxID, FunctionRef<bool(int Bo
 	int32_t NumBoxes = (int32_t)BoxesList.size();
 
 
-	int NumChildrenInLeaf = 4;
+	int NumChildrenInLeaf = MaxLeafSize;
 
 	// trivial case - no tree, just a single box
 	if (NumBoxes <= NumChildrenInLeaf) {
@@ -325,16 +363,418 @@ void GS::AxisBoxTree2<RealType>::Build(int32_t MaxBoxID, FunctionRef<bool(int Bo
 
 
 
+namespace GSLocal
+{
+	template<typename RealType>
+	struct TSAHBuildBox
+	{
+		AxisBox2<RealType> Box;
+		Vector2<RealType> Center;
+		int32_t BoxID;
+	};
+
+	// (not default-initialized, as bin arrays are allocated per split. Call Reset() before use)
+	template<typename RealType>
+	struct TSAHBin
+	{
+		AxisBox2<RealType> Bounds;
+		AxisBox2<RealType> CenterBounds;
+		int32_t Count;
+
+		void Reset() {
+			Bounds = CenterBounds = AxisBox2<RealType>::Empty();
+			Count = 0;
+		}
+		void Contain(const TSAHBin& Other) {
+			Bounds.Contain(Other.Bounds);
+			CenterBounds.Contain(Other.CenterBounds);
+			Count += Other.Count;
+		}
+	};
+
+	// range of boxes [Start, Start+Count) in the partitioned build-box array
+	template<typename RealType>
+	struct TSAHBuildNode
+	{
+		AxisBox2<RealType> Bounds;
+		AxisBox2<RealType> CenterBounds;
+		int32_t Start = 0;
+		int32_t Count = 0;
+		int32_t Left = -1;
+		int32_t Right = -1;
+		// for top-level nodes, index of the subtree that was built for this range in parallel
+		int32_t SubtreeIndex = -1;
+		bool IsLeaf() const { return Left < 0; }
+	};
+
+	static constexpr int MaxSAHBins = 32;
+	// top-level ranges larger than this have their bins computed with ParallelFor
+	static constexpr int32_t ParallelBinningMinCount = 64 * 1024;
+	static constexpr int32_t ParallelBinningBlockSize = 16 * 1024;
+
+	template<typename RealType>
+	RealType sah_box_cost(const AxisBox2<RealType>& Box)
+	{
+		// half-perimeter, which (unlike area) is still meaningful for degenerate boxes, eg of horizontal UV edges
+		return (Box.IsValid()) ? (Box.DimensionX() + Box.DimensionY()) : (RealType)0;
+	}
+
+	template<typename RealType>
+	int sah_bin_index(RealType Value, RealType AxisMin, RealType AxisScale, int NumBins)
+	{
+		int Bin = (int)((Value - AxisMin) * AxisScale);
+		return GS::Clamp(Bin, 0, NumBins - 1);
+	}
+
+	template<typename RealType>
+	void sah_compute_bins(
+		const TSAHBuildBox<RealType>* Boxes, int32_t Start, int32_t Count,
+		const AxisBox2<RealType>& CenterBounds, int NumBins, bool bParallel,
+		TSAHBin<RealType> Bins[2][MaxSAHBins])
+	{
+		Vector2<RealType> Scale;
+		for (int k = 0; k < 2; ++k) {
+			RealType Extent = CenterBounds.Max[k] - CenterBounds.Min[k];
+			Scale[k] = (Extent > 0) ? ((RealType)NumBins / Extent) : (RealType)0;
+		}
+
+		auto BinRange = [&](int32_t RangeStart, int32_t RangeEnd, TSAHBin<RealType> ToBins[2][MaxSAHBins]) {
+			for (int32_t i = RangeStart; i < RangeEnd; ++i) {
+				const TSAHBuildBox<RealType>& Box = Boxes[i];
+				for (int k = 0; k < 2; ++k) {
+					TSAHBin<RealType>& Bin = ToBins[k][sah_bin_index(Box.Center[k], CenterBounds.Min[k], Scale[k], NumBins)];
+					Bin.Bounds.Contain(Box.Box);
+					Bin.CenterBounds.Contain(Box.Center);
+					Bin.Count++;
+				}
+			}
+		};
+
+		if (bParallel == false || Count < ParallelBinningMinCount)
+		{
+			BinRange(Start, Start + Count, Bins);
+			return;
+		}
+
+		// bin blocks in parallel and then combine in block order, so the result is deterministic
+		struct BlockBins { TSAHBin<RealType> Bins[2][MaxSAHBins]; };
+		int32_t NumBlocks = (Count + ParallelBinningBlockSize - 1) / ParallelBinningBlockSize;
+		unsafe_vector<BlockBins> PerBlockBins;
+		PerBlockBins.resize(NumBlocks);
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			for (int k = 0; k < 2; ++k)
+				for (int j = 0; j < NumBins; ++j)
+					PerBlockBins[BlockIndex].Bins[k][j].Reset();
+			int32_t BlockStart = Start + (int32_t)BlockIndex * ParallelBinningBlockSize;
+			int32_t BlockEnd = GS::Min(BlockStart + ParallelBinningBlockSize, Start + Count);
+			BinRange(BlockStart, BlockEnd, PerBlockBins[BlockIndex].Bins);
+		});
+		for (int32_t b = 0; b < NumBlocks; ++b)
+			for (int k = 0; k < 2; ++k)
+				for (int j = 0; j < NumBins; ++j)
+					Bins[k][j].Contain(PerBlockBins[b].Bins[k][j]);
+	}
+
+	// try to split Node into Left and Right children. Returns false if the node should be a leaf.
+	template<typename RealType>
+	bool sah_split_node(
+		TSAHBuildBox<RealType>* Boxes, 
+		const TSAHBuildNode<RealType>& Node,
+		int MaxLeafSize, int NumBins, bool bParallel,
+		TSAHBuildNode<RealType>& LeftChild, TSAHBuildNode<RealType>& RightChild)
+	{
+		if (Node.Count <= 1)
+			return false;
+
+		int BestAxis = -1, BestSplitBin = -1;
+		RealType BestCost = RealConstants<RealType>::SafeMaxValue();
+		TSAHBin<RealType> BestLeft, BestRight;
+
+		bool bHasCenterExtent = (Node.CenterBounds.Dimension(0) > 0 || Node.CenterBounds.Dimension(1) > 0);
+		if (bHasCenterExtent)
+		{
+			// small ranges don't benefit from more bins than boxes
+			NumBins = GS::Clamp((int)Node.Count, 2, NumBins);
+			TSAHBin<RealType> Bins[2][MaxSAHBins];
+			for (int k = 0; k < 2; ++k)
+				for (int j = 0; j < NumBins; ++j)
+					Bins[k][j].Reset();
+			sah_compute_bins(Boxes, Node.Start, Node.Count, Node.CenterBounds, NumBins, bParallel, Bins);
+
+			for (int k = 0; k < 2; ++k)
+			{
+				if (Node.CenterBounds.Dimension(k) <= 0)
+					continue;
+
+				// sweep from the right to accumulate suffix bounds, then from the left to evaluate split costs
+				TSAHBin<RealType> RightAccum[MaxSAHBins];
+				TSAHBin<RealType> Accum;
+				Accum.Reset();
+				for (int j = NumBins - 1; j > 0; --j) {
+					Accum.Contain(Bins[k][j]);
+					RightAccum[j] = Accum;
+				}
+				Accum.Reset();
+				for (int j = 0; j < NumBins - 1; ++j) {
+					Accum.Contain(Bins[k][j]);
+					const TSAHBin<RealType>& Right = RightAccum[j + 1];
+					if (Accum.Count == 0 || Right.Count == 0)
+						continue;
+					RealType Cost = sah_box_cost(Accum.Bounds) * (RealType)Accum.Count + sah_box_cost(Right.Bounds) * (RealType)Right.Count;
+					if (Cost < BestCost) {
+						BestCost = Cost; BestAxis = k; BestSplitBin = j;
+						BestLeft = Accum; BestRight = Right;
+					}
+				}
+			}
+		}
+
+		// compare to the cost of a leaf, with traversal cost equal to one box test
+		if (BestAxis >= 0 && Node.Count <= MaxLeafSize)
+		{
+			RealType ParentCost = sah_box_cost(Node.Bounds);
+			RealType SplitCost = ParentCost + BestCost;
+			RealType LeafCost = ParentCost * (RealType)Node.Count;
+			if (SplitCost >= LeafCost)
+				return false;
+		}
+
+		if (BestAxis >= 0)
+		{
+			RealType AxisMin = Node.CenterBounds.Min[BestAxis];
+			RealType Extent = Node.CenterBounds.Max[BestAxis] - AxisMin;
+			RealType Scale = (RealType)NumBins / Extent;
+			TSAHBuildBox<RealType>* Middle = std::partition(Boxes + Node.Start, Boxes + Node.Start + Node.Count,
+				[&](const TSAHBuildBox<RealType>& Box) { return sah_bin_index(Box.Center[BestAxis], AxisMin, Scale, NumBins) <= BestSplitBin; });
+			int32_t NumLeft = (int32_t)(Middle - (Boxes + Node.Start));
+			gs_debug_assert(NumLeft == BestLeft.Count);
+
+			LeftChild = TSAHBuildNode<RealType>{ BestLeft.Bounds, BestLeft.CenterBounds, Node.Start, NumLeft };
+			RightChild = TSAHBuildNode<RealType>{ BestRight.Bounds, BestRight.CenterBounds, Node.Start + NumLeft, Node.Count - NumLeft };
+			return true;
+		}
+
+		if (Node.Count <= MaxLeafSize)
+			return false;
+
+		// all centers are coincident, so split in half arbitrarily
+		int32_t NumLeft = Node.Count / 2;
+		LeftChild = TSAHBuildNode<RealType>{ AxisBox2<RealType>::Empty(), AxisBox2<RealType>::Empty(), Node.Start, NumLeft };
+		RightChild = TSAHBuildNode<RealType>{ AxisBox2<RealType>::Empty(), AxisBox2<RealType>::Empty(), Node.Start + NumLeft, Node.Count - NumLeft };
+		for (int32_t i = 0; i < Node.Count; ++i) {
+			TSAHBuildNode<RealType>& Child = (i < NumLeft) ? LeftChild : RightChild;
+			Child.Bounds.Contain(Boxes[Node.Start + i].Box);
+			Child.CenterBounds.Contain(Boxes[Node.Start + i].Center);
+		}
+		return true;
+	}
+
+	// build a subtree serially. Nodes[0] must be the root node of the subtree.
+	template<typename RealType>
+	void sah_build_subtree(
+		TSAHBuildBox<RealType>* Boxes,
+		unsafe_vector<TSAHBuildNode<RealType>>& Nodes,
+		int MaxLeafSize, int NumBins)
+	{
+		unsafe_vector<int32_t> SplitJobs;
+		SplitJobs.reserve(64);
+		SplitJobs.add(0);
+		int32_t NodeIndex = -1;
+		while (SplitJobs.pop_back(NodeIndex))
+		{
+			TSAHBuildNode<RealType> LeftChild, RightChild;
+			if (sah_split_node(Boxes, Nodes[NodeIndex], MaxLeafSize, NumBins, false, LeftChild, RightChild) == false)
+				continue;
+			// (note: add_ref may resize, so don't hold references into Nodes)
+			int32_t LeftIndex = (int32_t)Nodes.add_ref(LeftChild);
+			int32_t RightIndex = (int32_t)Nodes.add_ref(RightChild);
+			Nodes[NodeIndex].Left = LeftIndex;
+			Nodes[NodeIndex].Right = RightIndex;
+			SplitJobs.add(RightIndex);
+			SplitJobs.add(LeftIndex);
+		}
+	}
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::build_binned_sah(int32_t MaxBoxID, FunctionRef<bool(int BoxID, BoxType& Box)> GetBoxFunc, const AxisBoxTree2BuildOptions& Options)
+{
+	using namespace GSLocal;
+	using BuildBox = TSAHBuildBox<RealType>;
+	using BuildNode = TSAHBuildNode<RealType>;
+
+	Clear();
+
+	int MaxLeafSize = GS::Clamp(Options.MaxLeafSize, 1, 15);
+	int NumBins = GS::Clamp(Options.NumSAHBins, 2, MaxSAHBins);
+	bool bParallel = Options.bParallel;
+
+	// collect valid boxes. In parallel mode boxes are fetched in blocks and then compacted.
+	unsafe_vector<BuildBox> Boxes;
+	if (bParallel && MaxBoxID > ParallelBinningBlockSize)
+	{
+		unsafe_vector<BuildBox> AllBoxes;
+		AllBoxes.resize(MaxBoxID);
+		int32_t NumBlocks = (MaxBoxID + ParallelBinningBlockSize - 1) / ParallelBinningBlockSize;
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockStart = (int32_t)BlockIndex * ParallelBinningBlockSize;
+			int32_t BlockEnd = GS::Min(BlockStart + ParallelBinningBlockSize, MaxBoxID);
+			for (int32_t k = BlockStart; k < BlockEnd; ++k) {
+				BuildBox& NewBox = AllBoxes[k];
+				NewBox.BoxID = GetBoxFunc(k, NewBox.Box) ? k : -1;
+				NewBox.Center = NewBox.Box.Center();
+			}
+		});
+		Boxes.reserve(MaxBoxID);
+		for (int32_t k = 0; k < MaxBoxID; ++k) {
+			if (AllBoxes[k].BoxID >= 0)
+				Boxes.add_ref(AllBoxes[k]);
+		}
+	}
+	else
+	{
+		Boxes.reserve(MaxBoxID);
+		for (int32_t k = 0; k < MaxBoxID; ++k) {
+			BuildBox NewBox;
+			if (GetBoxFunc(k, NewBox.Box)) {
+				NewBox.BoxID = k;
+				NewBox.Center = NewBox.Box.Center();
+				Boxes.add_ref(NewBox);
+			}
+		}
+	}
+	int32_t NumBoxes = (int32_t)Boxes.size();
+
+	BuildNode RootNode{ BoxType::Empty(), BoxType::Empty(), 0, NumBoxes };
+	for (int32_t k = 0; k < NumBoxes; ++k) {
+		RootNode.Bounds.Contain(Boxes[k].Box);
+		RootNode.CenterBounds.Contain(Boxes[k].Center);
+	}
+	RootBounds = RootNode.Bounds;
+
+	// trivial case - no tree, just a single leaf
+	if (NumBoxes <= MaxLeafSize)
+	{
+		LeafBoxLists.resize(NumBoxes);
+		for (int32_t k = 0; k < NumBoxes; ++k)
+			LeafBoxLists[k] = SourceBox2{ Boxes[k].Box, Boxes[k].BoxID };
+		RootIndex.Index = 0;
+		RootIndex.LeafCount = NumBoxes;
+		return;
+	}
+
+	// split top-level nodes (with parallel binning) until ranges are small enough to be built as independent subtrees
+	int32_t SubtreeMaxCount = (bParallel) ? GS::Max(NumBoxes / 64, (int32_t)1024) : NumBoxes;
+	unsafe_vector<BuildNode> TopNodes;
+	unsafe_vector<int32_t> SubtreeRoots;
+	TopNodes.add_ref(RootNode);
+	unsafe_vector<int32_t> SplitJobs;
+	SplitJobs.add(0);
+	int32_t NodeIndex = -1;
+	while (SplitJobs.pop_back(NodeIndex))
+	{
+		if (TopNodes[NodeIndex].Count <= SubtreeMaxCount) {
+			TopNodes[NodeIndex].SubtreeIndex = (int32_t)SubtreeRoots.add(NodeIndex);
+			continue;
+		}
+		BuildNode LeftChild, RightChild;
+		if (sah_split_node(Boxes.raw_pointer(), TopNodes[NodeIndex], MaxLeafSize, NumBins, bParallel, LeftChild, RightChild) == false)
+			continue;
+		int32_t LeftIndex = (int32_t)TopNodes.add_ref(LeftChild);
+		int32_t RightIndex = (int32_t)TopNodes.add_ref(RightChild);
+		TopNodes[NodeIndex].Left = LeftIndex;
+		TopNodes[NodeIndex].Right = RightIndex;
+		SplitJobs.add(RightIndex);
+		SplitJobs.add(LeftIndex);
+	}
+
+	// build subtrees. Each subtree only modifies its own range of Boxes.
+	int32_t NumSubtrees = (int32_t)SubtreeRoots.size();
+	unsafe_vector<unsafe_vector<BuildNode>> Subtrees;
+	Subtrees.resize(NumSubtrees);
+	auto BuildSubtree = [&](uint32_t SubtreeIndex) {
+		Subtrees[SubtreeIndex].reserve(2 * TopNodes[SubtreeRoots[SubtreeIndex]].Count / MaxLeafSize + 1);
+		Subtrees[SubtreeIndex].add_ref(TopNodes[SubtreeRoots[SubtreeIndex]]);
+		sah_build_subtree(Boxes.raw_pointer(), Subtrees[SubtreeIndex], MaxLeafSize, NumBins);
+	};
+	if (bParallel)
+		GS::ParallelFor(NumSubtrees, BuildSubtree);
+	else
+		for (int32_t k = 0; k < NumSubtrees; ++k) BuildSubtree(k);
+
+	// leaf boxes are the partitioned boxes list, each leaf is a contiguous range
+	LeafBoxLists.resize(NumBoxes);
+	for (int32_t k = 0; k < NumBoxes; ++k)
+		LeafBoxLists[k] = SourceBox2{ Boxes[k].Box, Boxes[k].BoxID };
+
+	// flatten the top-level tree and subtrees into NodeTree, in depth-first order
+	struct FlattenJob
+	{
+		int32_t SubtreeIndex;		// -1 for top-level nodes
+		int32_t NodeIndex;
+		int32_t ParentIndex;		// index into NodeTree, or -1 for root
+		bool bIsLeftChild;
+	};
+	auto GetBuildNode = [&](int32_t SubtreeIndex, int32_t NodeIndex) -> const BuildNode& {
+		return (SubtreeIndex < 0) ? TopNodes[NodeIndex] : Subtrees[SubtreeIndex][NodeIndex];
+	};
+
+	int32_t TotalNodes = (int32_t)TopNodes.size();
+	for (int32_t k = 0; k < NumSubtrees; ++k)
+		TotalNodes += (int32_t)Subtrees[k].size();
+	NodeTree.reserve(TotalNodes / 2 + 1);
+
+	unsafe_vector<FlattenJob> FlattenJobs;
+	FlattenJobs.add(FlattenJob{ -1, 0, -1, false });
+	FlattenJob Job;
+	while (FlattenJobs.pop_back(Job))
+	{
+		const BuildNode* Node = &GetBuildNode(Job.SubtreeIndex, Job.NodeIndex);
+		if (Job.SubtreeIndex < 0 && Node->SubtreeIndex >= 0) {
+			Job.SubtreeIndex = Node->SubtreeIndex;
+			Job.NodeIndex = 0;
+			Node = &GetBuildNode(Job.SubtreeIndex, 0);
+		}
+
+		ChildIndex NewIndex;
+		if (Node->IsLeaf())
+		{
+			gs_debug_assert(Node->Count > 0 && Node->Count <= MaxLeafSize);
+			NewIndex.LeafCount = (uint32_t)Node->Count;
+			NewIndex.Index = (uint32_t)Node->Start;
+		}
+		else
+		{
+			NewIndex.LeafCount = 0;
+			NewIndex.Index = (uint32_t)NodeTree.grow(1);
+			FlattenJobs.add(FlattenJob{ Job.SubtreeIndex, Node->Right, (int32_t)NewIndex.Index, false });
+			FlattenJobs.add(FlattenJob{ Job.SubtreeIndex, Node->Left, (int32_t)NewIndex.Index, true });
+		}
+
+		if (Job.ParentIndex < 0) {
+			RootIndex = NewIndex;
+		}
+		else if (Job.bIsLeftChild) {
+			NodeTree[Job.ParentIndex].LeftChild = NewIndex;
+			NodeTree[Job.ParentIndex].LeftBounds = Node->Bounds;
+		}
+		else {
+			NodeTree[Job.ParentIndex].RightChild = NewIndex;
+			NodeTree[Job.ParentIndex].RightBounds = Node->Bounds;
+		}
+	}
+	gs_debug_assert(RootIndex.LeafCount > 0 || RootIndex.Index == 0);
+}
+
+
+
 template<typename RealType>
 int GS::AxisBoxTree2<RealType>::PointContainmentQuery(
 	Vector2<RealType> Point,
 	FunctionRef<bool(int)> ElementTestFunc) const
 {
-	// use 32-elem small list here?? for 3 million tris the stack is never deeper than 21 levels...
-	// but need to make it support pop  (currently it's Resize() is very bad!!)
-	//TInlineSmallList<ChildIndex, 32> stack;
-	unsafe_vector<ChildIndex> stack;
-	stack.reserve(32);
+	inline_stack<ChildIndex, QueryStackSize> stack;
 
 	if (RootBounds.Contains(Point) == false)
 		return -1;
@@ -371,9 +811,7 @@ bool GS::AxisBoxTree2<RealType>::PointContainmentQuery_FindAll(
 	FunctionRef<bool(int)> ElementTestFunc,
 	FunctionRef<void(int)> FoundElementFunc ) const
 {
-	//TInlineSmallList<ChildIndex, 32> stack;
-	unsafe_vector<ChildIndex> stack;
-	stack.reserve(32);
+	inline_stack<ChildIndex, QueryStackSize> stack;
 
 	if (RootBounds.Contains(Point) == false)
 		return false;
@@ -420,7 +858,7 @@ DistanceResult2<RealType> GS::AxisBoxTree2<RealType>::PointDistanceQuery(
 		AxisBox2<RealType> Box;
 	};
 
-	TInlineSmallList<StackBox, 32> stack;
+	inline_stack<StackBox, 32> stack;
 	//unsafe_vector<StackBox> stack;
 	//stack.reserve(32);
 
@@ -469,10 +907,11 @@ DistanceResult2<RealType> GS::AxisBoxTree2<RealType>::PointDistanceQuery(
 				GS::SwapTemp(ChildDists[0], ChildDists[1]);
 				GS::SwapTemp(Children[0], Children[1]);
 			}
+			// push farther child first, so that the nearer child is popped (and MinDistSqr shrinks) first
 			if (ChildDists[0] < MinDistSqr) {
-				stack.push_back(Children[0]);
 				if (ChildDists[1] < MinDistSqr)		// Y is larger
 					stack.push_back(Children[1]);
+				stack.push_back(Children[0]);
 			}
 		}
 	}
@@ -484,6 +923,1006 @@ DistanceResult2<RealType> GS::AxisBoxTree2<RealType>::PointDistanceQuery(
 
 
 
+template<typename RealType>
+bool GS::AxisBoxTree2<RealType>::BoxOverlapQuery(
+	const AxisBox2<RealType>& QueryBox,
+	FunctionRef<void(int)> FoundElementFunc) const
+{
+	return BoxOverlapQuery<FunctionRef<void(int)>&>(QueryBox, FoundElementFunc);
+}
+
+template<typename RealType>
+bool GS::AxisBoxTree2<RealType>::RadiusQuery(
+	Vector2<RealType> QueryPoint,
+	RealType Radius,
+	FunctionRef<void(int, RealType)> FoundElementFunc) const
+{
+	return RadiusQuery<FunctionRef<void(int, RealType)>&>(QueryPoint, Radius, FoundElementFunc);
+}
+
+template<typename RealType>
+int GS::AxisBoxTree2<RealType>::KNearestQuery(
+	Vector2<RealType> QueryPoint,
+	int K,
+	FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+	DistanceResult2<RealType>* ResultsOut,
+	DistanceQueryOptions<RealType> Options) const
+{
+	using FuncType = FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)>;
+	return KNearestQuery<FuncType&>(QueryPoint, K, ElementDistanceSqrFunc, ResultsOut, Options);
+}
+
+
+
+
+
+namespace GSLocal
+{
+	// a pair of subtrees of TreeA and TreeB whose bounds overlap. For self-overlap queries TreeA == TreeB,
+	// and bSameNode indicates that A and B are the same subtree
+	template<typename RealType>
+	struct TOverlapPairTask
+	{
+		typename AxisBoxTree2<RealType>::ChildIndex A;
+		typename AxisBoxTree2<RealType>::ChildIndex B;
+		AxisBox2<RealType> BoxA;
+		AxisBox2<RealType> BoxB;
+		bool bSameNode;
+	};
+
+	template<typename RealType>
+	inline bool overlap_inclusive(const AxisBox2<RealType>& A, const AxisBox2<RealType>& B)
+	{
+		return !((B.Max.X < A.Min.X) || (B.Min.X > A.Max.X) || (B.Max.Y < A.Min.Y) || (B.Min.Y > A.Max.Y));
+	}
+
+	template<typename RealType>
+	inline RealType half_perimeter(const AxisBox2<RealType>& Box)
+	{
+		return Box.DimensionX() + Box.DimensionY();
+	}
+
+	/**
+	 * Process one subtree pair: leaf/leaf pairs report overlapping element pairs to EmitFunc(IDA,IDB),
+	 * otherwise child pairs with overlapping bounds are passed to PushFunc. For interior/interior pairs the
+	 * larger subtree is descended, and a same-node pair expands into its two same-node children plus the cross pair.
+	 */
+	template<typename RealType, typename PushFuncType, typename EmitFuncType>
+	inline void process_overlap_pair(
+		const AxisBoxTree2<RealType>& TreeA, const AxisBoxTree2<RealType>& TreeB, bool bSelf,
+		const TOverlapPairTask<RealType>& Pair, PushFuncType&& PushFunc, EmitFuncType&& EmitFunc)
+	{
+		using TreeType = AxisBoxTree2<RealType>;
+		using SourceBox2 = typename TreeType::SourceBox2;
+		using InteriorNode = typename TreeType::InteriorNode;
+
+		if (Pair.bSameNode)
+		{
+			if (Pair.A.LeafCount > 0) {
+				for (uint32_t j = 0; j < Pair.A.LeafCount; ++j) {
+					const SourceBox2& BoxJ = TreeA.LeafBoxLists[Pair.A.Index + j];
+					for (uint32_t k = j+1; k < Pair.A.LeafCount; ++k) {
+						const SourceBox2& BoxK = TreeA.LeafBoxLists[Pair.A.Index + k];
+						if (overlap_inclusive(BoxJ.Box, BoxK.Box))
+							EmitFunc(GS::Min(BoxJ.BoxID, BoxK.BoxID), GS::Max(BoxJ.BoxID, BoxK.BoxID));
+					}
+				}
+				return;
+			}
+			const InteriorNode& Node = TreeA.NodeTree[Pair.A.Index];
+			PushFunc( TOverlapPairTask<RealType>{ Node.LeftChild, Node.LeftChild, Node.LeftBounds, Node.LeftBounds, true } );
+			PushFunc( TOverlapPairTask<RealType>{ Node.RightChild, Node.RightChild, Node.RightBounds, Node.RightBounds, true } );
+			if (overlap_inclusive(Node.LeftBounds, Node.RightBounds))
+				PushFunc( TOverlapPairTask<RealType>{ Node.LeftChild, Node.RightChild, Node.LeftBounds, Node.RightBounds, false } );
+			return;
+		}
+
+		bool bLeafA = (Pair.A.LeafCount > 0), bLeafB = (Pair.B.LeafCount > 0);
+		if (bLeafA && bLeafB)
+		{
+			for (uint32_t j = 0; j < Pair.A.LeafCount; ++j) {
+				const SourceBox2& BoxJ = TreeA.LeafBoxLists[Pair.A.Index + j];
+				if (overlap_inclusive(BoxJ.Box, Pair.BoxB) == false)
+					continue;
+				for (uint32_t k = 0; k < Pair.B.LeafCount; ++k) {
+					const SourceBox2& BoxK = TreeB.LeafBoxLists[Pair.B.Index + k];
+					if (overlap_inclusive(BoxJ.Box, BoxK.Box)) {
+						if (bSelf)
+							EmitFunc(GS::Min(BoxJ.BoxID, BoxK.BoxID), GS::Max(BoxJ.BoxID, BoxK.BoxID));
+						else
+							EmitFunc(BoxJ.BoxID, BoxK.BoxID);
+					}
+				}
+			}
+			return;
+		}
+
+		bool bDescendA = bLeafB || (!bLeafA && half_perimeter(Pair.BoxA) >= half_perimeter(Pair.BoxB));
+		if (bDescendA)
+		{
+			const InteriorNode& Node = TreeA.NodeTree[Pair.A.Index];
+			if (overlap_inclusive(Node.LeftBounds, Pair.BoxB))
+				PushFunc( TOverlapPairTask<RealType>{ Node.LeftChild, Pair.B, Node.LeftBounds, Pair.BoxB, false } );
+			if (overlap_inclusive(Node.RightBounds, Pair.BoxB))
+				PushFunc( TOverlapPairTask<RealType>{ Node.RightChild, Pair.B, Node.RightBounds, Pair.BoxB, false } );
+		}
+		else
+		{
+			const InteriorNode& Node = TreeB.NodeTree[Pair.B.Index];
+			if (overlap_inclusive(Pair.BoxA, Node.LeftBounds))
+				PushFunc( TOverlapPairTask<RealType>{ Pair.A, Node.LeftChild, Pair.BoxA, Node.LeftBounds, false } );
+			if (overlap_inclusive(Pair.BoxA, Node.RightBounds))
+				PushFunc( TOverlapPairTask<RealType>{ Pair.A, Node.RightChild, Pair.BoxA, Node.RightBounds, false } );
+		}
+	}
+
+	// expand the top levels of the dual traversal breadth-first until there are enough subtree pairs to process in parallel
+	template<typename RealType>
+	void collect_overlap_tasks(
+		const AxisBoxTree2<RealType>& TreeA, const AxisBoxTree2<RealType>& TreeB, bool bSelf, bool bParallel,
+		unsafe_vector<TOverlapPairTask<RealType>>& Tasks)
+	{
+		Tasks.clear();
+		if (TreeA.NodeTree.size() == 0 && TreeA.LeafBoxLists.size() == 0) return;
+		if (TreeB.NodeTree.size() == 0 && TreeB.LeafBoxLists.size() == 0) return;
+		if (!bSelf && overlap_inclusive(TreeA.RootBounds, TreeB.RootBounds) == false) return;
+
+		Tasks.add( TOverlapPairTask<RealType>{ TreeA.RootIndex, TreeB.RootIndex, TreeA.RootBounds, TreeB.RootBounds, bSelf } );
+		if (!bParallel)
+			return;
+
+		static constexpr size_t TargetTaskCount = 512;
+		static constexpr int MaxExpandPasses = 24;
+		unsafe_vector<TOverlapPairTask<RealType>> NextTasks;
+		for (int Pass = 0; Pass < MaxExpandPasses && Tasks.size() < TargetTaskCount; ++Pass)
+		{
+			NextTasks.clear();
+			bool bExpanded = false;
+			for (const TOverlapPairTask<RealType>& Task : Tasks)
+			{
+				bool bLeafPair = (Task.A.LeafCount > 0) && (Task.bSameNode || Task.B.LeafCount > 0);
+				if (bLeafPair) {
+					NextTasks.add(Task);		// leaf pairs are emitted by the job that processes them
+					continue;
+				}
+				process_overlap_pair(TreeA, TreeB, bSelf, Task, 
+					[&](const TOverlapPairTask<RealType>& ChildTask) { NextTasks.add(ChildTask); }, 
+					[](int, int) { gs_debug_assert(false); });
+				bExpanded = true;
+			}
+			GS::SwapTemp(Tasks, NextTasks);
+			if (!bExpanded)
+				break;
+		}
+	}
+
+	template<typename RealType, typename EmitFuncType>
+	void traverse_overlap_task(
+		const AxisBoxTree2<RealType>& TreeA, const AxisBoxTree2<RealType>& TreeB, bool bSelf,
+		const TOverlapPairTask<RealType>& Task, EmitFuncType&& EmitFunc)
+	{
+		inline_stack<TOverlapPairTask<RealType>, 128> stack;
+		stack.push_back(Task);
+		TOverlapPairTask<RealType> next;
+		while (stack.pop_back(next))
+		{
+			process_overlap_pair(TreeA, TreeB, bSelf, next,
+				[&](const TOverlapPairTask<RealType>& ChildTask) { stack.push_back(ChildTask); }, EmitFunc);
+		}
+	}
+
+	template<typename RealType>
+	void find_overlap_pairs(
+		const AxisBoxTree2<RealType>& TreeA, const AxisBoxTree2<RealType>& TreeB, bool bSelf,
+		FunctionRef<void(int, int)> PairFunc, bool bParallel)
+	{
+		unsafe_vector<TOverlapPairTask<RealType>> Tasks;
+		collect_overlap_tasks(TreeA, TreeB, bSelf, bParallel, Tasks);
+
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		Flags.bUnbalanced = true;
+		GS::ParallelFor((uint32_t)Tasks.size(), [&](uint32_t TaskIndex)
+		{
+			traverse_overlap_task(TreeA, TreeB, bSelf, Tasks[TaskIndex], PairFunc);
+		}, Flags);
+	}
+
+	template<typename RealType>
+	void collect_overlap_pairs(
+		const AxisBoxTree2<RealType>& TreeA, const AxisBoxTree2<RealType>& TreeB, bool bSelf,
+		unsafe_vector<Index2i>& PairsOut, FunctionRef<bool(int, int)> PairFilterFunc, bool bParallel)
+	{
+		PairsOut.clear();
+		unsafe_vector<TOverlapPairTask<RealType>> Tasks;
+		collect_overlap_tasks(TreeA, TreeB, bSelf, bParallel, Tasks);
+		uint32_t NumTasks = (uint32_t)Tasks.size();
+
+		// each job writes to its own buffer, these are concatenated in job order below
+		std::vector<unsafe_vector<Index2i>> TaskPairs(NumTasks);
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		Flags.bUnbalanced = true;
+		GS::ParallelFor(NumTasks, [&](uint32_t TaskIndex)
+		{
+			unsafe_vector<Index2i>& Pairs = TaskPairs[TaskIndex];
+			traverse_overlap_task(TreeA, TreeB, bSelf, Tasks[TaskIndex], [&](int IDA, int IDB) {
+				if ( !PairFilterFunc || PairFilterFunc(IDA, IDB) )
+					Pairs.add(Index2i(IDA, IDB));
+			});
+		}, Flags);
+
+		size_t TotalPairs = 0;
+		for (const unsafe_vector<Index2i>& Pairs : TaskPairs)
+			TotalPairs += Pairs.size();
+		PairsOut.resize(TotalPairs);
+		size_t Offset = 0;
+		for (const unsafe_vector<Index2i>& Pairs : TaskPairs) {
+			if (Pairs.size() > 0)
+				std::memcpy(PairsOut.raw_pointer(Offset), Pairs.raw_pointer(), Pairs.size() * sizeof(Index2i));
+			Offset += Pairs.size();
+		}
+	}
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::FindOverlappingPairs(
+	const AxisBoxTree2& OtherTree,
+	FunctionRef<void(int ThisID, int OtherID)> PairFunc,
+	bool bParallel) const
+{
+	GSLocal::find_overlap_pairs<RealType>(*this, OtherTree, false, PairFunc, bParallel);
+}
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::FindOverlappingPairs(
+	const AxisBoxTree2& OtherTree,
+	unsafe_vector<Index2i>& PairsOut,
+	FunctionRef<bool(int ThisID, int OtherID)> PairFilterFunc,
+	bool bParallel) const
+{
+	GSLocal::collect_overlap_pairs<RealType>(*this, OtherTree, false, PairsOut, PairFilterFunc, bParallel);
+}
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::FindSelfOverlaps(
+	FunctionRef<void(int IDA, int IDB)> PairFunc,
+	bool bParallel) const
+{
+	GSLocal::find_overlap_pairs<RealType>(*this, *this, true, PairFunc, bParallel);
+}
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::FindSelfOverlaps(
+	unsafe_vector<Index2i>& PairsOut,
+	FunctionRef<bool(int IDA, int IDB)> PairFilterFunc,
+	bool bParallel) const
+{
+	GSLocal::collect_overlap_pairs<RealType>(*this, *this, true, PairsOut, PairFilterFunc, bParallel);
+}
+
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::Refit(FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc, bool bParallel)
+{
+	if (NodeTree.size() == 0 && LeafBoxLists.size() == 0)
+		return;
+
+	// refit the subtrees below a fixed depth in parallel, then refit the top of the tree serially
+	static constexpr int ParallelRefitDepth = 8;
+	unsafe_vector<ChildIndex> Subtrees;
+	collect_refit_subtrees(RootIndex, 0, ParallelRefitDepth, Subtrees);
+
+	unsafe_vector<BoxType> SubtreeBounds;
+	SubtreeBounds.resize(Subtrees.size());
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+	GS::ParallelFor((uint32_t)Subtrees.size(), [&](uint32_t k)
+	{
+		SubtreeBounds[k] = refit_subtree(Subtrees[k], GetBoxFunc);
+	}, Flags);
+
+	int NextSubtree = 0;
+	RootBounds = refit_top(RootIndex, 0, ParallelRefitDepth, SubtreeBounds.raw_pointer(), NextSubtree);
+	gs_debug_assert(NextSubtree == (int)Subtrees.size());
+}
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::collect_refit_subtrees(ChildIndex Index, int Depth, int MaxDepth, unsafe_vector<ChildIndex>& Subtrees) const
+{
+	if (Index.LeafCount > 0 || Depth == MaxDepth) {
+		Subtrees.add(Index);
+		return;
+	}
+	const InteriorNode& Node = NodeTree[Index.Index];
+	collect_refit_subtrees(Node.LeftChild, Depth+1, MaxDepth, Subtrees);
+	collect_refit_subtrees(Node.RightChild, Depth+1, MaxDepth, Subtrees);
+}
+
+template<typename RealType>
+AxisBox2<RealType> GS::AxisBoxTree2<RealType>::refit_top(ChildIndex Index, int Depth, int MaxDepth, const BoxType* SubtreeBounds, int& NextSubtree)
+{
+	// must visit nodes in the same order as collect_refit_subtrees()
+	if (Index.LeafCount > 0 || Depth == MaxDepth)
+		return SubtreeBounds[NextSubtree++];
+	InteriorNode& Node = NodeTree[Index.Index];
+	Node.LeftBounds = refit_top(Node.LeftChild, Depth+1, MaxDepth, SubtreeBounds, NextSubtree);
+	Node.RightBounds = refit_top(Node.RightChild, Depth+1, MaxDepth, SubtreeBounds, NextSubtree);
+	BoxType Bounds = Node.LeftBounds;
+	Bounds.Contain(Node.RightBounds);
+	return Bounds;
+}
+
+template<typename RealType>
+AxisBox2<RealType> GS::AxisBoxTree2<RealType>::refit_subtree(ChildIndex Index, FunctionRef<bool(int, AxisBox2<RealType>& Box)>& GetBoxFunc)
+{
+	BoxType Bounds = BoxType::Empty();
+	if (Index.LeafCount > 0) 
+	{
+		for (uint32_t j = 0; j < Index.LeafCount; ++j) {
+			SourceBox2& Box = LeafBoxLists[Index.Index + j];
+			BoxType NewBox;
+			if (GetBoxFunc(Box.BoxID, NewBox))
+				Box.Box = NewBox;
+			Bounds.Contain(Box.Box);
+		}
+		return Bounds;
+	}
+	InteriorNode& Node = NodeTree[Index.Index];
+	Node.LeftBounds = refit_subtree(Node.LeftChild, GetBoxFunc);
+	Node.RightBounds = refit_subtree(Node.RightChild, GetBoxFunc);
+	Bounds = Node.LeftBounds;
+	Bounds.Contain(Node.RightBounds);
+	return Bounds;
+}
+
+
+
+namespace GSLocal
+{
+	// quality metric for UpdateElements(), summed half-perimeter of the child bounds of a node
+	template<typename RealType>
+	RealType node_cost(const typename AxisBoxTree2<RealType>::InteriorNode& Node)
+	{
+		return Node.LeftBounds.DimensionX() + Node.LeftBounds.DimensionY() + Node.RightBounds.DimensionX() + Node.RightBounds.DimensionY();
+	}
+
+	template<typename RealType>
+	bool boxes_equal(const AxisBox2<RealType>& A, const AxisBox2<RealType>& B)
+	{
+		return A.Min.X == B.Min.X && A.Min.Y == B.Min.Y && A.Max.X == B.Max.X && A.Max.Y == B.Max.Y;
+	}
+}
+
+
+template<typename RealType>
+bool GS::AxisBoxTree2<RealType>::UpdateElements(
+	const_buffer_view<int> ElementIDs,
+	FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc,
+	const AxisBoxTree2UpdateOptions& Options)
+{
+	if (NodeTree.size() == 0 && LeafBoxLists.size() == 0)
+		return false;
+
+	if (!bUpdateStateValid)
+		build_update_state();
+
+	if (Options.FullRebuildInterval > 0 && NumUpdatesSinceBuild+1 >= Options.FullRebuildInterval)
+	{
+		// GetBoxFunc only has to return boxes for ElementIDs, so rebuild from the current
+		// element boxes in the tree, with the updated boxes replaced
+		for (int ElementID : ElementIDs)
+		{
+			if (ElementID < 0 || ElementID >= (int)BoxIDToLeafSlot.size())
+				continue;
+			int32_t LeafSlot = BoxIDToLeafSlot[ElementID];
+			BoxType NewBox;
+			if (LeafSlot >= 0 && GetBoxFunc(ElementID, NewBox))
+				LeafBoxLists[LeafSlot].Box = NewBox;
+		}
+		rebuild_from_leaves();
+		return true;
+	}
+	NumUpdatesSinceBuild++;
+
+	RealType RebuildThreshold = (RealType)GS::Max(Options.RebuildQualityThreshold, 1.0);
+	unsafe_vector<int32_t> RebuildNodes;
+	for (int ElementID : ElementIDs)
+	{
+		if (ElementID < 0 || ElementID >= (int)BoxIDToLeafSlot.size())
+			continue;
+		int32_t LeafSlot = BoxIDToLeafSlot[ElementID];
+		BoxType NewBox;
+		if (LeafSlot < 0 || GetBoxFunc(ElementID, NewBox) == false)
+			continue;
+		LeafBoxLists[LeafSlot].Box = NewBox;
+		refit_leaf_ancestors(LeafSlot, RebuildThreshold, RebuildNodes);
+	}
+	if (RebuildNodes.size() == 0)
+		return false;
+
+	// rebuild the highest degraded nodes first, this discards any degraded nodes below them
+	unsafe_vector<Index2i> RebuildOrder;		// (depth, node index)
+	for (int32_t NodeIndex : RebuildNodes) {
+		int Depth = 0;
+		for (int32_t ParentRef = NodeParents[NodeIndex]; ParentRef >= 0; ParentRef = NodeParents[ParentRef >> 1])
+			Depth++;
+		RebuildOrder.add(Index2i(Depth, NodeIndex));
+	}
+	bool bRebuilt = false;
+	std::sort(RebuildOrder.raw_pointer(), RebuildOrder.raw_pointer() + RebuildOrder.size(), [](const Index2i& A, const Index2i& B) {
+		return (A.A != B.A) ? (A.A < B.A) : (A.B < B.B);
+	});
+	for (const Index2i& Rebuild : RebuildOrder) 
+	{
+		if (NodeParents[Rebuild.B] == -2)
+			continue;		// already discarded by rebuild of an ancestor
+		if (count_subtree_elements(Rebuild.B, Options.MaxRebuildElements) > Options.MaxRebuildElements)
+			continue;
+		bRebuilt = true;
+		if (NodeParents[Rebuild.B] == -1) {
+			rebuild_from_leaves();
+			return true;
+		}
+		rebuild_subtree(Rebuild.B);
+	}
+
+	// discarded subtrees are left in NodeTree and LeafBoxLists, compact if they are the majority
+	if (NumUnusedNodes > (int32_t)NodeTree.size() / 2) {
+		rebuild_from_leaves();
+		bRebuilt = true;
+	}
+	return bRebuilt;
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::reset_update_state()
+{
+	bUpdateStateValid = false;
+	NumUpdatesSinceBuild = 0;
+	NumUnusedNodes = 0;
+	BoxIDToLeafSlot.clear(true);
+	LeafSlotParents.clear(true);
+	NodeParents.clear(true);
+	NodeBuildCost.clear(true);
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::build_update_state()
+{
+	int32_t MaxBoxID = BuildMaxBoxID;
+	for (const SourceBox2& Box : LeafBoxLists)
+		MaxBoxID = GS::Max(MaxBoxID, Box.BoxID + 1);
+	BuildMaxBoxID = MaxBoxID;
+
+	BoxIDToLeafSlot.resize(MaxBoxID);
+	for (int32_t k = 0; k < MaxBoxID; ++k)
+		BoxIDToLeafSlot[k] = -1;
+	LeafSlotParents.resize(LeafBoxLists.size());
+	for (size_t k = 0; k < LeafBoxLists.size(); ++k)
+		LeafSlotParents[k] = -2;
+	NodeParents.resize(NodeTree.size());
+	NodeBuildCost.resize(NodeTree.size());
+	for (size_t k = 0; k < NodeTree.size(); ++k) {
+		NodeParents[k] = -2;
+		NodeBuildCost[k] = GSLocal::node_cost<RealType>(NodeTree[k]);
+	}
+
+	assign_subtree_parents(RootIndex, -1);
+
+	NumUnusedNodes = 0;
+	for (size_t k = 0; k < NodeTree.size(); ++k)
+		NumUnusedNodes += (NodeParents[k] == -2) ? 1 : 0;
+	bUpdateStateValid = true;
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::assign_subtree_parents(ChildIndex SubtreeRoot, int32_t ParentRef)
+{
+	struct StackEntry
+	{
+		ChildIndex Index;
+		int32_t ParentRef;
+	};
+	inline_stack<StackEntry, QueryStackSize> stack;
+	stack.push_back( {SubtreeRoot, ParentRef} );
+	StackEntry next;
+	while (stack.pop_back(next))
+	{
+		if (next.Index.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.Index.LeafCount; ++j) {
+				int32_t LeafSlot = next.Index.Index + j;
+				LeafSlotParents[LeafSlot] = next.ParentRef;
+				BoxIDToLeafSlot[LeafBoxLists[LeafSlot].BoxID] = LeafSlot;
+			}
+		}
+		else
+		{
+			int32_t NodeIndex = next.Index.Index;
+			NodeParents[NodeIndex] = next.ParentRef;
+			const InteriorNode& Node = NodeTree[NodeIndex];
+			stack.push_back( {Node.LeftChild, NodeIndex << 1} );
+			stack.push_back( {Node.RightChild, (NodeIndex << 1) | 1} );
+		}
+	}
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::refit_leaf_ancestors(int32_t LeafSlot, RealType RebuildThreshold, unsafe_vector<int32_t>& RebuildNodes)
+{
+	int32_t ParentRef = LeafSlotParents[LeafSlot];
+	ChildIndex Leaf = (ParentRef < 0) ? RootIndex : 
+		( (ParentRef & 1) ? NodeTree[ParentRef >> 1].RightChild : NodeTree[ParentRef >> 1].LeftChild );
+	BoxType NewBounds = BoxType::Empty();
+	for (uint32_t j = 0; j < Leaf.LeafCount; ++j)
+		NewBounds.Contain(LeafBoxLists[Leaf.Index + j].Box);
+
+	while (ParentRef >= 0)
+	{
+		int32_t NodeIndex = ParentRef >> 1;
+		InteriorNode& Node = NodeTree[NodeIndex];
+		BoxType& ChildBounds = (ParentRef & 1) ? Node.RightBounds : Node.LeftBounds;
+		if (GSLocal::boxes_equal(ChildBounds, NewBounds))
+			return;		// ancestors are unchanged
+		ChildBounds = NewBounds;
+
+		if (GSLocal::node_cost<RealType>(Node) > RebuildThreshold * NodeBuildCost[NodeIndex])
+			RebuildNodes.add(NodeIndex);
+
+		NewBounds = Node.LeftBounds;
+		NewBounds.Contain(Node.RightBounds);
+		ParentRef = NodeParents[NodeIndex];
+	}
+	RootBounds = NewBounds;
+}
+
+
+template<typename RealType>
+int32_t GS::AxisBoxTree2<RealType>::count_subtree_elements(int32_t NodeIndex, int32_t MaxCount) const
+{
+	// stops counting once MaxCount is exceeded, so the cost is bounded for large subtrees
+	int32_t Count = 0;
+	inline_stack<ChildIndex, QueryStackSize> stack;
+	stack.push_back(ChildIndex{ 0, (uint32_t)NodeIndex });
+	ChildIndex next;
+	while (stack.pop_back(next) && Count <= MaxCount)
+	{
+		if (next.LeafCount > 0) {
+			Count += next.LeafCount;
+		} else {
+			const InteriorNode& Node = NodeTree[next.Index];
+			stack.push_back(Node.LeftChild);
+			stack.push_back(Node.RightChild);
+		}
+	}
+	return Count;
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::rebuild_subtree(int32_t NodeIndex)
+{
+	int32_t ParentRef = NodeParents[NodeIndex];
+	gs_debug_assert(ParentRef >= 0);
+
+	// collect the element boxes in the subtree, and mark its nodes as unused
+	unsafe_vector<SourceBox2> SubtreeBoxes;
+	unsafe_vector<ChildIndex> stack;
+	stack.push_back(ChildIndex{ 0, (uint32_t)NodeIndex });
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				SubtreeBoxes.add(LeafBoxLists[next.Index + j]);
+				LeafSlotParents[next.Index + j] = -2;
+			}
+		}
+		else
+		{
+			NodeParents[next.Index] = -2;
+			NumUnusedNodes++;
+			const InteriorNode& Node = NodeTree[next.Index];
+			stack.push_back(Node.LeftChild);
+			stack.push_back(Node.RightChild);
+		}
+	}
+
+	// subtrees are limited by MaxRebuildElements, small enough that a serial build is faster than parallel dispatch
+	AxisBoxTree2BuildOptions SubtreeOptions = LastBuildOptions;
+	SubtreeOptions.bParallel = false;
+	AxisBoxTree2<RealType> Subtree;
+	Subtree.Build((int32_t)SubtreeBoxes.size(), [&](int k, BoxType& Box) { Box = SubtreeBoxes[k].Box; return true; }, SubtreeOptions);
+
+	// append the new subtree nodes and leaves, remapping child indices and BoxIDs
+	uint32_t NodeOffset = (uint32_t)NodeTree.size();
+	uint32_t LeafOffset = (uint32_t)LeafBoxLists.size();
+	auto RemapChild = [&](ChildIndex Child) {
+		Child.Index += (Child.LeafCount > 0) ? LeafOffset : NodeOffset;
+		return Child;
+	};
+	for (const InteriorNode& SubtreeNode : Subtree.NodeTree) {
+		InteriorNode NewNode = SubtreeNode;
+		NewNode.LeftChild = RemapChild(SubtreeNode.LeftChild);
+		NewNode.RightChild = RemapChild(SubtreeNode.RightChild);
+		NodeTree.add(NewNode);
+		NodeParents.add(-2);
+		NodeBuildCost.add(GSLocal::node_cost<RealType>(NewNode));
+	}
+	for (const SourceBox2& SubtreeBox : Subtree.LeafBoxLists) {
+		LeafBoxLists.add( SourceBox2{ SubtreeBox.Box, SubtreeBoxes[SubtreeBox.BoxID].BoxID } );
+		LeafSlotParents.add(-2);
+	}
+
+	ChildIndex NewRoot = RemapChild(Subtree.RootIndex);
+	InteriorNode& Parent = NodeTree[ParentRef >> 1];
+	if (ParentRef & 1) {
+		Parent.RightChild = NewRoot;
+		Parent.RightBounds = Subtree.RootBounds;
+	} else {
+		Parent.LeftChild = NewRoot;
+		Parent.LeftBounds = Subtree.RootBounds;
+	}
+	assign_subtree_parents(NewRoot, ParentRef);
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::rebuild_from_leaves()
+{
+	unsafe_vector<SourceBox2> AllBoxes;
+	AllBoxes.reserve(LeafBoxLists.size());
+	unsafe_vector<ChildIndex> stack;
+	stack.push_back(RootIndex);
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j)
+				AllBoxes.add(LeafBoxLists[next.Index + j]);
+		} 
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			stack.push_back(Node.LeftChild);
+			stack.push_back(Node.RightChild);
+		}
+	}
+
+	int32_t MaxBoxID = BuildMaxBoxID;
+	AxisBoxTree2BuildOptions BuildOptions = LastBuildOptions;
+	Build((int32_t)AllBoxes.size(), [&](int k, BoxType& Box) { Box = AllBoxes[k].Box; return true; }, BuildOptions);
+	for (SourceBox2& Box : LeafBoxLists)
+		Box.BoxID = AllBoxes[Box.BoxID].BoxID;
+	BuildMaxBoxID = MaxBoxID;
+	build_update_state();
+}
+
+
+
+
+namespace GSLocal
+{
+	static constexpr int DistanceQueryPacketSize = 16;
+	static constexpr int DistanceQueryPacketsPerTile = 64;
+
+	// spread the low 16 bits of x into the even bits of the result
+	inline uint32_t morton_spread_bits16(uint32_t x)
+	{
+		x &= 0xFFFF;
+		x = (x | (x << 8)) & 0x00FF00FF;
+		x = (x | (x << 4)) & 0x0F0F0F0F;
+		x = (x | (x << 2)) & 0x33333333;
+		x = (x | (x << 1)) & 0x55555555;
+		return x;
+	}
+
+	// stable LSD radix sort of 64-bit keys by their upper 32 bits
+	inline void radix_sort_upper32(unsafe_vector<uint64_t>& Keys)
+	{
+		size_t N = Keys.size();
+		unsafe_vector<uint64_t> Temp;
+		Temp.resize(N);
+		uint64_t* Src = Keys.raw_pointer();
+		uint64_t* Dst = Temp.raw_pointer();
+		for (int Pass = 0; Pass < 4; ++Pass)
+		{
+			int Shift = 32 + 8 * Pass;
+			size_t Counts[257] = { 0 };
+			for (size_t i = 0; i < N; ++i)
+				Counts[((Src[i] >> Shift) & 0xFF) + 1]++;
+			for (int b = 0; b < 256; ++b)
+				Counts[b + 1] += Counts[b];
+			for (size_t i = 0; i < N; ++i)
+				Dst[Counts[(Src[i] >> Shift) & 0xFF]++] = Src[i];
+			GS::SwapTemp(Src, Dst);
+		}
+		// after an even number of passes the sorted keys are back in Keys
+	}
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::PointDistanceQueryBatch(
+	const_buffer_view<Vector2<RealType>> Points,
+	FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+	unsafe_vector<DistanceResult2<RealType>>& ResultsOut,
+	DistanceQueryOptions<RealType> Options,
+	bool bParallel) const
+{
+	using namespace GSLocal;
+
+	int32_t NumPoints = (int32_t)Points.size();
+	ResultsOut.resize(NumPoints);
+	if (NumPoints == 0)
+		return;
+	const Vector2<RealType>* PointsBuffer = &Points[0];
+
+	// sort points along a Morton curve over their bounding box, so that each packet contains nearby points
+	BoxType PointBounds = BoxType::Empty();
+	for (int32_t k = 0; k < NumPoints; ++k)
+		PointBounds.Contain(PointsBuffer[k]);
+	RealType ScaleX = (PointBounds.DimensionX() > 0) ? ((RealType)65535 / PointBounds.DimensionX()) : (RealType)0;
+	RealType ScaleY = (PointBounds.DimensionY() > 0) ? ((RealType)65535 / PointBounds.DimensionY()) : (RealType)0;
+
+	unsafe_vector<uint64_t> SortKeys;
+	SortKeys.resize(NumPoints);
+	for (int32_t k = 0; k < NumPoints; ++k)
+	{
+		uint32_t qx = (uint32_t)GS::Clamp((PointsBuffer[k].X - PointBounds.Min.X) * ScaleX, (RealType)0, (RealType)65535);
+		uint32_t qy = (uint32_t)GS::Clamp((PointsBuffer[k].Y - PointBounds.Min.Y) * ScaleY, (RealType)0, (RealType)65535);
+		uint32_t Code = morton_spread_bits16(qx) | (morton_spread_bits16(qy) << 1);
+		SortKeys[k] = ((uint64_t)Code << 32) | (uint64_t)k;
+	}
+	radix_sort_upper32(SortKeys);
+
+	unsafe_vector<int32_t> SortedIndices;
+	SortedIndices.resize(NumPoints);
+	for (int32_t k = 0; k < NumPoints; ++k)
+		SortedIndices[k] = (int32_t)(SortKeys[k] & 0xFFFFFFFF);
+	SortKeys.clear(true);
+
+	int32_t NumPackets = (NumPoints + DistanceQueryPacketSize - 1) / DistanceQueryPacketSize;
+	int32_t NumTiles = (NumPackets + DistanceQueryPacketsPerTile - 1) / DistanceQueryPacketsPerTile;
+	auto ProcessTile = [&](uint32_t TileIndex)
+	{
+		int32_t FirstPacket = (int32_t)TileIndex * DistanceQueryPacketsPerTile;
+		int32_t EndPacket = GS::Min(FirstPacket + DistanceQueryPacketsPerTile, NumPackets);
+		for (int32_t Packet = FirstPacket; Packet < EndPacket; ++Packet)
+		{
+			int32_t Start = Packet * DistanceQueryPacketSize;
+			int Count = (int)GS::Min(DistanceQueryPacketSize, NumPoints - Start);
+			packet_distance_query(PointsBuffer, SortedIndices.raw_pointer(Start), Count, 
+				ElementDistanceSqrFunc, Options, ResultsOut.raw_pointer());
+		}
+	};
+	if (bParallel)
+		GS::ParallelFor(NumTiles, ProcessTile);
+	else
+		for (int32_t k = 0; k < NumTiles; ++k) ProcessTile(k);
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::packet_distance_query(
+	const Vector2<RealType>* Points, const int32_t* PointIndices, int NumPoints,
+	FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+	const DistanceQueryOptions<RealType>& Options, DistanceResult2<RealType>* ResultsOut) const
+{
+	static constexpr int PacketSize = GSLocal::DistanceQueryPacketSize;
+	gs_debug_assert(NumPoints <= PacketSize);
+	RealType MaxDistSqr = Options.MaxDistance * Options.MaxDistance;
+
+	Vector2<RealType> QueryPoints[PacketSize];
+	RealType MinDistSqr[PacketSize];
+	DistanceResult2<RealType> MinDistResults[PacketSize];
+	uint32_t RootMask = 0;
+	for (int k = 0; k < NumPoints; ++k)
+	{
+		QueryPoints[k] = Points[PointIndices[k]];
+		MinDistSqr[k] = MaxDistSqr;
+		if (RootBounds.DistanceSquared(QueryPoints[k]) <= MaxDistSqr)
+			RootMask |= (1u << k);
+	}
+
+	// seed the packet with the nearest element to its first point. Points in a packet are spatially 
+	// coherent, so this usually gives a tight initial bound that prunes most of the packet traversal
+	if (RootMask != 0 && NumPoints > 1)
+	{
+		DistanceResult2<RealType> SeedResult = PointDistanceQuery(QueryPoints[0], ElementDistanceSqrFunc, Options);
+		if (SeedResult.ElementID >= 0)
+		{
+			for (int k = 0; k < NumPoints; ++k) {
+				DistanceResult2<RealType> ElemDistSqrResult = (k == 0) ? SeedResult : ElementDistanceSqrFunc(SeedResult.ElementID, QueryPoints[k]);
+				if (ElemDistSqrResult.DistanceSqr < MinDistSqr[k]) {
+					MinDistSqr[k] = ElemDistSqrResult.DistanceSqr;
+					MinDistResults[k] = ElemDistSqrResult;
+					MinDistResults[k].ElementID = SeedResult.ElementID;
+				}
+			}
+		}
+	}
+
+	// each stack entry carries the mask of packet points that may still find a closer element in that subtree
+	struct PacketStackBox
+	{
+		ChildIndex Index;
+		AxisBox2<RealType> Box;
+		uint32_t Mask;
+	};
+	inline_stack<PacketStackBox, 32> stack;
+	if (RootMask != 0)
+		stack.push_back( {RootIndex, RootBounds, RootMask} );
+
+	PacketStackBox nextBox;
+	while (stack.pop_back(nextBox))
+	{
+		// re-test points because min-distances may have decreased while this node was on the stack
+		uint32_t Mask = 0;
+		for (uint32_t Bits = nextBox.Mask; Bits != 0; Bits &= Bits - 1) {
+			int k = std::countr_zero(Bits);
+			if (nextBox.Box.DistanceSquared(QueryPoints[k]) <= MinDistSqr[k])
+				Mask |= (1u << k);
+		}
+		if (Mask == 0)
+			continue;
+
+		ChildIndex next = nextBox.Index;
+		if (next.LeafCount > 0) 
+		{
+			for (uint32_t j = 0; j < next.LeafCount; ++j) 
+			{
+				const SourceBox2& Box = LeafBoxLists[next.Index + j];
+				for (uint32_t Bits = Mask; Bits != 0; Bits &= Bits - 1) 
+				{
+					int k = std::countr_zero(Bits);
+					if (Box.Box.DistanceSquared(QueryPoints[k]) < MinDistSqr[k]) {
+						DistanceResult2<RealType> ElemDistSqrResult = ElementDistanceSqrFunc(Box.BoxID, QueryPoints[k]);
+						if (ElemDistSqrResult.DistanceSqr < MinDistSqr[k]) {
+							MinDistSqr[k] = ElemDistSqrResult.DistanceSqr;
+							MinDistResults[k] = ElemDistSqrResult;
+							MinDistResults[k].ElementID = Box.BoxID;
+						}
+					}
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			PacketStackBox Children[2] = { {Node.LeftChild, Node.LeftBounds, 0}, {Node.RightChild, Node.RightBounds, 0} };
+			RealType ChildDistSums[2] = { 0, 0 };
+			int ChildCounts[2] = { 0, 0 };
+			for (uint32_t Bits = Mask; Bits != 0; Bits &= Bits - 1) 
+			{
+				int k = std::countr_zero(Bits);
+				for (int c = 0; c < 2; ++c) {
+					RealType DistSqr = Children[c].Box.DistanceSquared(QueryPoints[k]);
+					if (DistSqr < MinDistSqr[k]) {
+						Children[c].Mask |= (1u << k);
+						ChildDistSums[c] += DistSqr;
+						ChildCounts[c]++;
+					}
+				}
+			}
+
+			// push the child with larger average distance first, so the nearer child is popped first
+			RealType AvgDist0 = (ChildCounts[0] > 0) ? ChildDistSums[0] / (RealType)ChildCounts[0] : (RealType)0;
+			RealType AvgDist1 = (ChildCounts[1] > 0) ? ChildDistSums[1] / (RealType)ChildCounts[1] : (RealType)0;
+			int First = (AvgDist0 < AvgDist1) ? 1 : 0;
+			if (Children[First].Mask != 0)
+				stack.push_back(Children[First]);
+			if (Children[1 - First].Mask != 0)
+				stack.push_back(Children[1 - First]);
+		}
+	}
+
+	for (int k = 0; k < NumPoints; ++k)
+		ResultsOut[PointIndices[k]] = MinDistResults[k];
+}
+
+
+
+struct AxisBoxTree2Versions
+{
+	// version 2 adds the build options, used by UpdateElements() to rebuild the restored tree
+	static constexpr uint32_t CurrentVersionNumber = 2;
+};
+
+template<typename RealType>
+ContentHash128 GS::AxisBoxTree2<RealType>::MakeCacheKey(const ContentHash128& BoxesHash, int32_t MaxBoxID, const AxisBoxTree2BuildOptions& Options)
+{
+	ContentHasher Hasher;
+	Hasher.AppendString("AxisBoxTree2");
+	Hasher.AppendValue<uint32_t>(AxisBoxTree2Versions::CurrentVersionNumber);
+	Hasher.AppendValue<uint32_t>(sizeof(RealType));
+	Hasher.AppendHash(BoxesHash);
+	Hasher.AppendValue<int32_t>(MaxBoxID);
+	// bParallel is not included because parallel and serial builds produce identical trees
+	Hasher.AppendValue<uint8_t>((uint8_t)Options.Method);
+	Hasher.AppendValue<int32_t>(Options.MaxLeafSize);
+	Hasher.AppendValue<int32_t>(Options.NumSAHBins);
+	return Hasher.Finalize128();
+}
+
+template<typename RealType>
+bool GS::AxisBoxTree2<RealType>::BuildCached(
+	DerivedDataCache& Cache,
+	const ContentHash128& BoxesHash,
+	int32_t MaxBoxID,
+	FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc,
+	const AxisBoxTree2BuildOptions& Options,
+	int32_t CountHint)
+{
+	ContentHash128 CacheKey = MakeCacheKey(BoxesHash, MaxBoxID, Options);
+	bool bCached = Cache.GetOrBuild(CacheKey, *this, [&]() {
+		Build(MaxBoxID, GetBoxFunc, Options, CountHint);
+	});
+	BuildMaxBoxID = MaxBoxID;
+	LastBuildOptions = Options;
+	return bCached;
+}
+
+template<typename RealType>
+void GS::AxisBoxTree2<RealType>::Clear()
+{
+	RootIndex = ChildIndex{ 0, 0 };
+	RootBounds = BoxType::Empty();
+	NodeTree.clear(true);
+	LeafBoxLists.clear(true);
+	reset_update_state();
+}
+
+template<typename RealType>
+bool GS::AxisBoxTree2<RealType>::Store(GS::ISerializer& Serializer) const
+{
+	GS::SerializationVersion CurrentVersion(AxisBoxTree2Versions::CurrentVersionNumber);
+	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
+	bOK = bOK && Serializer.WriteValue<uint32_t>("RealSize", sizeof(RealType));
+	bOK = bOK && Serializer.WriteValue<ChildIndex>("RootIndex", RootIndex);
+	bOK = bOK && Serializer.WriteValue<BoxType>("RootBounds", RootBounds);
+	bOK = bOK && NodeTree.Store(Serializer, "NodeTree");
+	bOK = bOK && LeafBoxLists.Store(Serializer, "LeafBoxLists");
+	bOK = bOK && Serializer.WriteValue<uint32_t>("BuildMethod", (uint32_t)LastBuildOptions.Method);
+	bOK = bOK && Serializer.WriteValue<int>("BuildMaxLeafSize", LastBuildOptions.MaxLeafSize);
+	bOK = bOK && Serializer.WriteValue<int>("BuildNumSAHBins", LastBuildOptions.NumSAHBins);
+	bOK = bOK && Serializer.WriteBoolean("BuildParallel", LastBuildOptions.bParallel);
+	return bOK;
+}
+
+template<typename RealType>
+bool GS::AxisBoxTree2<RealType>::Restore(GS::ISerializer& Serializer)
+{
+	GS::SerializationVersion Version;
+	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
+	bOK = bOK && (Version.Version == AxisBoxTree2Versions::CurrentVersionNumber);
+	uint32_t RealSize = 0;
+	bOK = bOK && Serializer.ReadValue<uint32_t>("RealSize", RealSize);
+	bOK = bOK && (RealSize == sizeof(RealType));
+	bOK = bOK && Serializer.ReadValue<ChildIndex>("RootIndex", RootIndex);
+	bOK = bOK && Serializer.ReadValue<BoxType>("RootBounds", RootBounds);
+	bOK = bOK && NodeTree.Restore(Serializer, "NodeTree");
+	bOK = bOK && LeafBoxLists.Restore(Serializer, "LeafBoxLists");
+	uint32_t BuildMethod = 0;
+	bOK = bOK && Serializer.ReadValue<uint32_t>("BuildMethod", BuildMethod);
+	LastBuildOptions.Method = (BuildMethod == (uint32_t)EAxisBoxTreeBuildMethod::Midpoint) ? EAxisBoxTreeBuildMethod::Midpoint : EAxisBoxTreeBuildMethod::BinnedSAH;
+	bOK = bOK && Serializer.ReadValue<int>("BuildMaxLeafSize", LastBuildOptions.MaxLeafSize);
+	bOK = bOK && Serializer.ReadValue<int>("BuildNumSAHBins", LastBuildOptions.NumSAHBins);
+	bOK = bOK && Serializer.ReadBoolean("BuildParallel", LastBuildOptions.bParallel);
+	reset_update_state();
+	BuildMaxBoxID = 0;		// recomputed from the leaf boxes in build_update_state()
+	return bOK;
+}
+
+
+
+
 template<typename RealType>
 void check_boxes(const AxisBox2<RealType>& A, const AxisBox2<RealType>& B)
 {
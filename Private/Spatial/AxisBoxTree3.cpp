@@ -0,0 +1,1385 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Spatial/AxisBoxTree3.h"
+#include "Core/inline_stack.h"
+#include "Mesh/DenseMesh.h"
+#include "Mesh/PolyMesh.h"
+#include "Mesh/PolygonTriangulation.h"
+#include "Core/ParallelFor.h"
+#include "Intersection/GSRayBatch.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <bit>
+#include <cmath>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	template<typename RealType>
+	struct TSAHBuildBox3
+	{
+		AxisBox3<RealType> Box;
+		Vector3<RealType> Center;
+		int32_t BoxID;
+	};
+
+	// (not default-initialized, as bin arrays are allocated per split. Call Reset() before use)
+	template<typename RealType>
+	struct TSAHBin3
+	{
+		AxisBox3<RealType> Bounds;
+		AxisBox3<RealType> CenterBounds;
+		int32_t Count;
+
+		void Reset() {
+			Bounds = CenterBounds = AxisBox3<RealType>::Empty();
+			Count = 0;
+		}
+		void Contain(const TSAHBin3& Other) {
+			Bounds.Contain(Other.Bounds);
+			CenterBounds.Contain(Other.CenterBounds);
+			Count += Other.Count;
+		}
+	};
+
+	// range of boxes [Start, Start+Count) in the partitioned build-box array
+	template<typename RealType>
+	struct TSAHBuildNode3
+	{
+		AxisBox3<RealType> Bounds;
+		AxisBox3<RealType> CenterBounds;
+		int32_t Start = 0;
+		int32_t Count = 0;
+		int32_t Left = -1;
+		int32_t Right = -1;
+		// for top-level nodes, index of the subtree that was built for this range in parallel
+		int32_t SubtreeIndex = -1;
+		bool IsLeaf() const { return Left < 0; }
+	};
+
+	static constexpr int MaxSAHBins3 = 32;
+	// top-level ranges larger than this have their bins computed with ParallelFor
+	static constexpr int32_t ParallelBinningMinCount3 = 64 * 1024;
+	static constexpr int32_t ParallelBinningBlockSize3 = 16 * 1024;
+
+	template<typename RealType>
+	RealType sah_box_cost3(const AxisBox3<RealType>& Box)
+	{
+		// half surface area, plus a small fraction of the half-perimeter so that flat and degenerate boxes still have a cost
+		if (Box.IsValid() == false)
+			return (RealType)0;
+		RealType DX = Box.DimensionX(), DY = Box.DimensionY(), DZ = Box.DimensionZ();
+		return (DX*DY + DY*DZ + DZ*DX) + (RealType)0.001 * (DX + DY + DZ) * (DX + DY + DZ);
+	}
+
+	template<typename RealType>
+	int sah_bin_index3(RealType Value, RealType AxisMin, RealType AxisScale, int NumBins)
+	{
+		int Bin = (int)((Value - AxisMin) * AxisScale);
+		return GS::Clamp(Bin, 0, NumBins - 1);
+	}
+
+	template<typename RealType>
+	void sah_compute_bins3(
+		const TSAHBuildBox3<RealType>* Boxes, int32_t Start, int32_t Count,
+		const AxisBox3<RealType>& CenterBounds, int NumBins, bool bParallel,
+		TSAHBin3<RealType> Bins[3][MaxSAHBins3])
+	{
+		Vector3<RealType> Scale;
+		for (int k = 0; k < 3; ++k) {
+			RealType Extent = CenterBounds.Max[k] - CenterBounds.Min[k];
+			Scale[k] = (Extent > 0) ? ((RealType)NumBins / Extent) : (RealType)0;
+		}
+
+		auto BinRange = [&](int32_t RangeStart, int32_t RangeEnd, TSAHBin3<RealType> ToBins[3][MaxSAHBins3]) {
+			for (int32_t i = RangeStart; i < RangeEnd; ++i) {
+				const TSAHBuildBox3<RealType>& Box = Boxes[i];
+				for (int k = 0; k < 3; ++k) {
+					TSAHBin3<RealType>& Bin = ToBins[k][sah_bin_index3(Box.Center[k], CenterBounds.Min[k], Scale[k], NumBins)];
+					Bin.Bounds.Contain(Box.Box);
+					Bin.CenterBounds.Contain(Box.Center);
+					Bin.Count++;
+				}
+			}
+		};
+
+		if (bParallel == false || Count < ParallelBinningMinCount3)
+		{
+			BinRange(Start, Start + Count, Bins);
+			return;
+		}
+
+		// bin blocks in parallel and then combine in block order, so the result is deterministic
+		struct BlockBins { TSAHBin3<RealType> Bins[3][MaxSAHBins3]; };
+		int32_t NumBlocks = (Count + ParallelBinningBlockSize3 - 1) / ParallelBinningBlockSize3;
+		unsafe_vector<BlockBins> PerBlockBins;
+		PerBlockBins.resize(NumBlocks);
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			for (int k = 0; k < 3; ++k)
+				for (int j = 0; j < NumBins; ++j)
+					PerBlockBins[BlockIndex].Bins[k][j].Reset();
+			int32_t BlockStart = Start + (int32_t)BlockIndex * ParallelBinningBlockSize3;
+			int32_t BlockEnd = GS::Min(BlockStart + ParallelBinningBlockSize3, Start + Count);
+			BinRange(BlockStart, BlockEnd, PerBlockBins[BlockIndex].Bins);
+		});
+		for (int32_t b = 0; b < NumBlocks; ++b)
+			for (int k = 0; k < 3; ++k)
+				for (int j = 0; j < NumBins; ++j)
+					Bins[k][j].Contain(PerBlockBins[b].Bins[k][j]);
+	}
+
+	// try to split Node into Left and Right children. Returns false if the node should be a leaf.
+	template<typename RealType>
+	bool sah_split_node3(
+		TSAHBuildBox3<RealType>* Boxes,
+		const TSAHBuildNode3<RealType>& Node,
+		int MaxLeafSize, int NumBins, bool bParallel,
+		TSAHBuildNode3<RealType>& LeftChild, TSAHBuildNode3<RealType>& RightChild)
+	{
+		if (Node.Count <= 1)
+			return false;
+
+		int BestAxis = -1, BestSplitBin = -1;
+		RealType BestCost = RealConstants<RealType>::SafeMaxValue();
+		TSAHBin3<RealType> BestLeft, BestRight;
+
+		bool bHasCenterExtent = (Node.CenterBounds.Dimension(0) > 0 || Node.CenterBounds.Dimension(1) > 0 || Node.CenterBounds.Dimension(2) > 0);
+		if (bHasCenterExtent)
+		{
+			// small ranges don't benefit from more bins than boxes
+			NumBins = GS::Clamp((int)Node.Count, 2, NumBins);
+			TSAHBin3<RealType> Bins[3][MaxSAHBins3];
+			for (int k = 0; k < 3; ++k)
+				for (int j = 0; j < NumBins; ++j)
+					Bins[k][j].Reset();
+			sah_compute_bins3(Boxes, Node.Start, Node.Count, Node.CenterBounds, NumBins, bParallel, Bins);
+
+			for (int k = 0; k < 3; ++k)
+			{
+				if (Node.CenterBounds.Dimension(k) <= 0)
+					continue;
+
+				// sweep from the right to accumulate suffix bounds, then from the left to evaluate split costs
+				TSAHBin3<RealType> RightAccum[MaxSAHBins3];
+				TSAHBin3<RealType> Accum;
+				Accum.Reset();
+				for (int j = NumBins - 1; j > 0; --j) {
+					Accum.Contain(Bins[k][j]);
+					RightAccum[j] = Accum;
+				}
+				Accum.Reset();
+				for (int j = 0; j < NumBins - 1; ++j) {
+					Accum.Contain(Bins[k][j]);
+					const TSAHBin3<RealType>& Right = RightAccum[j + 1];
+					if (Accum.Count == 0 || Right.Count == 0)
+						continue;
+					RealType Cost = sah_box_cost3(Accum.Bounds) * (RealType)Accum.Count + sah_box_cost3(Right.Bounds) * (RealType)Right.Count;
+					if (Cost < BestCost) {
+						BestCost = Cost; BestAxis = k; BestSplitBin = j;
+						BestLeft = Accum; BestRight = Right;
+					}
+				}
+			}
+		}
+
+		// compare to the cost of a leaf, with traversal cost equal to one box test
+		if (BestAxis >= 0 && Node.Count <= MaxLeafSize)
+		{
+			RealType ParentCost = sah_box_cost3(Node.Bounds);
+			RealType SplitCost = ParentCost + BestCost;
+			RealType LeafCost = ParentCost * (RealType)Node.Count;
+			if (SplitCost >= LeafCost)
+				return false;
+		}
+
+		if (BestAxis >= 0)
+		{
+			RealType AxisMin = Node.CenterBounds.Min[BestAxis];
+			RealType Extent = Node.CenterBounds.Max[BestAxis] - AxisMin;
+			RealType Scale = (RealType)NumBins / Extent;
+			TSAHBuildBox3<RealType>* Middle = std::partition(Boxes + Node.Start, Boxes + Node.Start + Node.Count,
+				[&](const TSAHBuildBox3<RealType>& Box) { return sah_bin_index3(Box.Center[BestAxis], AxisMin, Scale, NumBins) <= BestSplitBin; });
+			int32_t NumLeft = (int32_t)(Middle - (Boxes + Node.Start));
+			gs_debug_assert(NumLeft == BestLeft.Count);
+
+			LeftChild = TSAHBuildNode3<RealType>{ BestLeft.Bounds, BestLeft.CenterBounds, Node.Start, NumLeft };
+			RightChild = TSAHBuildNode3<RealType>{ BestRight.Bounds, BestRight.CenterBounds, Node.Start + NumLeft, Node.Count - NumLeft };
+			return true;
+		}
+
+		if (Node.Count <= MaxLeafSize)
+			return false;
+
+		// all centers are coincident, so split in half arbitrarily
+		int32_t NumLeft = Node.Count / 2;
+		LeftChild = TSAHBuildNode3<RealType>{ AxisBox3<RealType>::Empty(), AxisBox3<RealType>::Empty(), Node.Start, NumLeft };
+		RightChild = TSAHBuildNode3<RealType>{ AxisBox3<RealType>::Empty(), AxisBox3<RealType>::Empty(), Node.Start + NumLeft, Node.Count - NumLeft };
+		for (int32_t i = 0; i < Node.Count; ++i) {
+			TSAHBuildNode3<RealType>& Child = (i < NumLeft) ? LeftChild : RightChild;
+			Child.Bounds.Contain(Boxes[Node.Start + i].Box);
+			Child.CenterBounds.Contain(Boxes[Node.Start + i].Center);
+		}
+		return true;
+	}
+
+	// build a subtree serially. Nodes[0] must be the root node of the subtree.
+	template<typename RealType>
+	void sah_build_subtree3(
+		TSAHBuildBox3<RealType>* Boxes,
+		unsafe_vector<TSAHBuildNode3<RealType>>& Nodes,
+		int MaxLeafSize, int NumBins)
+	{
+		unsafe_vector<int32_t> SplitJobs;
+		SplitJobs.reserve(64);
+		SplitJobs.add(0);
+		int32_t NodeIndex = -1;
+		while (SplitJobs.pop_back(NodeIndex))
+		{
+			TSAHBuildNode3<RealType> LeftChild, RightChild;
+			if (sah_split_node3(Boxes, Nodes[NodeIndex], MaxLeafSize, NumBins, false, LeftChild, RightChild) == false)
+				continue;
+			// (note: add_ref may resize, so don't hold references into Nodes)
+			int32_t LeftIndex = (int32_t)Nodes.add_ref(LeftChild);
+			int32_t RightIndex = (int32_t)Nodes.add_ref(RightChild);
+			Nodes[NodeIndex].Left = LeftIndex;
+			Nodes[NodeIndex].Right = RightIndex;
+			SplitJobs.add(RightIndex);
+			SplitJobs.add(LeftIndex);
+		}
+	}
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::Build(int32_t MaxBoxID, FunctionRef<bool(int BoxID, BoxType& Box)> GetBoxFunc, const AxisBoxTree3BuildOptions& Options)
+{
+	build_binned_sah(MaxBoxID, GetBoxFunc, Options);
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::BuildTriangles(
+	int32_t MaxTriangleID,
+	FunctionRef<bool(int, Vector3<RealType>& A, Vector3<RealType>& B, Vector3<RealType>& C)> GetTriangleFunc,
+	const AxisBoxTree3BuildOptions& Options)
+{
+	// fetch all triangles first, so that GetTriangleFunc is only called once per triangle
+	unsafe_vector<SourceTriangle3> Triangles;
+	unsafe_vector<uint8_t> TriangleValid;
+	Triangles.resize(MaxTriangleID);
+	TriangleValid.resize(MaxTriangleID);
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !Options.bParallel;
+	int32_t NumBlocks = (MaxTriangleID + GSLocal::ParallelBinningBlockSize3 - 1) / GSLocal::ParallelBinningBlockSize3;
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockStart = (int32_t)BlockIndex * GSLocal::ParallelBinningBlockSize3;
+		int32_t BlockEnd = GS::Min(BlockStart + GSLocal::ParallelBinningBlockSize3, MaxTriangleID);
+		for (int32_t k = BlockStart; k < BlockEnd; ++k) {
+			SourceTriangle3& Tri = Triangles[k];
+			TriangleValid[k] = GetTriangleFunc(k, Tri.V[0], Tri.V[1], Tri.V[2]) ? 1 : 0;
+		}
+	}, Flags);
+
+	build_binned_sah(MaxTriangleID, [&](int k, BoxType& Box) {
+		if (TriangleValid[k] == 0)
+			return false;
+		const SourceTriangle3& Tri = Triangles[k];
+		Box = BoxType(Tri.V[0], Tri.V[0]);
+		Box.Contain(Tri.V[1]);
+		Box.Contain(Tri.V[2]);
+		return true;
+	}, Options);
+
+	// store triangles in leaf order
+	size_t NumLeafBoxes = LeafBoxLists.size();
+	LeafTriangles.resize(NumLeafBoxes);
+	for (size_t k = 0; k < NumLeafBoxes; ++k)
+		LeafTriangles[k] = Triangles[LeafBoxLists[k].BoxID];
+	bTriangleTree = true;
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::Build(const DenseMesh& Mesh, const AxisBoxTree3BuildOptions& Options)
+{
+	BuildTriangles(Mesh.GetTriangleCount(), [&](int TriIndex, Vector3<RealType>& A, Vector3<RealType>& B, Vector3<RealType>& C)
+	{
+		const Index3i& Tri = Mesh.GetTriangle(TriIndex);
+		A = (Vector3<RealType>)Mesh.GetPosition(Tri.A);
+		B = (Vector3<RealType>)Mesh.GetPosition(Tri.B);
+		C = (Vector3<RealType>)Mesh.GetPosition(Tri.C);
+		return true;
+	}, Options);
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::Build(const PolyMesh& Mesh, const AxisBoxTree3BuildOptions& Options)
+{
+	// triangulate faces (concave faces are ear-clipped), with mesh vertex indices
+	PolyMeshTriangulationOptions TriangulationOptions;
+	TriangulationOptions.bParallel = Options.bParallel;
+	unsafe_vector<Index3i> Triangles;
+	unsafe_vector<int> FaceTriangleOffsets;
+	TriangulatePolyMesh(Mesh, Triangles, FaceTriangleOffsets, TriangulationOptions);
+
+	BuildTriangles((int32_t)Triangles.size(), [&](int TriIndex, Vector3<RealType>& A, Vector3<RealType>& B, Vector3<RealType>& C)
+	{
+		const Index3i& Tri = Triangles[TriIndex];
+		A = (Vector3<RealType>)Mesh.GetPosition(Tri.A);
+		B = (Vector3<RealType>)Mesh.GetPosition(Tri.B);
+		C = (Vector3<RealType>)Mesh.GetPosition(Tri.C);
+		return true;
+	}, Options);
+
+	// ElementIDs are faces. The face of a triangle is the last face whose first triangle is at or before it.
+	const int* OffsetsBegin = FaceTriangleOffsets.raw_pointer();
+	const int* OffsetsEnd = OffsetsBegin + FaceTriangleOffsets.size();
+	for (SourceBox3& LeafBox : LeafBoxLists)
+		LeafBox.BoxID = (int32_t)(std::upper_bound(OffsetsBegin, OffsetsEnd, LeafBox.BoxID) - OffsetsBegin) - 1;
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::build_binned_sah(int32_t MaxBoxID, FunctionRef<bool(int BoxID, BoxType& Box)> GetBoxFunc, const AxisBoxTree3BuildOptions& Options)
+{
+	using namespace GSLocal;
+	using BuildBox = TSAHBuildBox3<RealType>;
+	using BuildNode = TSAHBuildNode3<RealType>;
+
+	Clear();
+
+	int MaxLeafSize = GS::Clamp(Options.MaxLeafSize, 1, 15);
+	int NumBins = GS::Clamp(Options.NumSAHBins, 2, MaxSAHBins3);
+	bool bParallel = Options.bParallel;
+
+	// collect valid boxes. In parallel mode boxes are fetched in blocks and then compacted.
+	unsafe_vector<BuildBox> Boxes;
+	if (bParallel && MaxBoxID > ParallelBinningBlockSize3)
+	{
+		unsafe_vector<BuildBox> AllBoxes;
+		AllBoxes.resize(MaxBoxID);
+		int32_t NumBlocks = (MaxBoxID + ParallelBinningBlockSize3 - 1) / ParallelBinningBlockSize3;
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockStart = (int32_t)BlockIndex * ParallelBinningBlockSize3;
+			int32_t BlockEnd = GS::Min(BlockStart + ParallelBinningBlockSize3, MaxBoxID);
+			for (int32_t k = BlockStart; k < BlockEnd; ++k) {
+				BuildBox& NewBox = AllBoxes[k];
+				NewBox.BoxID = GetBoxFunc(k, NewBox.Box) ? k : -1;
+				NewBox.Center = NewBox.Box.Center();
+			}
+		});
+		Boxes.reserve(MaxBoxID);
+		for (int32_t k = 0; k < MaxBoxID; ++k) {
+			if (AllBoxes[k].BoxID >= 0)
+				Boxes.add_ref(AllBoxes[k]);
+		}
+	}
+	else
+	{
+		Boxes.reserve(MaxBoxID);
+		for (int32_t k = 0; k < MaxBoxID; ++k) {
+			BuildBox NewBox;
+			if (GetBoxFunc(k, NewBox.Box)) {
+				NewBox.BoxID = k;
+				NewBox.Center = NewBox.Box.Center();
+				Boxes.add_ref(NewBox);
+			}
+		}
+	}
+	int32_t NumBoxes = (int32_t)Boxes.size();
+
+	BuildNode RootNode{ BoxType::Empty(), BoxType::Empty(), 0, NumBoxes };
+	for (int32_t k = 0; k < NumBoxes; ++k) {
+		RootNode.Bounds.Contain(Boxes[k].Box);
+		RootNode.CenterBounds.Contain(Boxes[k].Center);
+	}
+	RootBounds = RootNode.Bounds;
+
+	// trivial case - no tree, just a single leaf
+	if (NumBoxes <= MaxLeafSize)
+	{
+		LeafBoxLists.resize(NumBoxes);
+		for (int32_t k = 0; k < NumBoxes; ++k)
+			LeafBoxLists[k] = SourceBox3{ Boxes[k].Box, Boxes[k].BoxID };
+		RootIndex.Index = 0;
+		RootIndex.LeafCount = NumBoxes;
+		return;
+	}
+
+	// split top-level nodes (with parallel binning) until ranges are small enough to be built as independent subtrees
+	int32_t SubtreeMaxCount = (bParallel) ? GS::Max(NumBoxes / 64, (int32_t)1024) : NumBoxes;
+	unsafe_vector<BuildNode> TopNodes;
+	unsafe_vector<int32_t> SubtreeRoots;
+	TopNodes.add_ref(RootNode);
+	unsafe_vector<int32_t> SplitJobs;
+	SplitJobs.add(0);
+	int32_t NodeIndex = -1;
+	while (SplitJobs.pop_back(NodeIndex))
+	{
+		if (TopNodes[NodeIndex].Count <= SubtreeMaxCount) {
+			TopNodes[NodeIndex].SubtreeIndex = (int32_t)SubtreeRoots.add(NodeIndex);
+			continue;
+		}
+		BuildNode LeftChild, RightChild;
+		if (sah_split_node3(Boxes.raw_pointer(), TopNodes[NodeIndex], MaxLeafSize, NumBins, bParallel, LeftChild, RightChild) == false)
+			continue;
+		int32_t LeftIndex = (int32_t)TopNodes.add_ref(LeftChild);
+		int32_t RightIndex = (int32_t)TopNodes.add_ref(RightChild);
+		TopNodes[NodeIndex].Left = LeftIndex;
+		TopNodes[NodeIndex].Right = RightIndex;
+		SplitJobs.add(RightIndex);
+		SplitJobs.add(LeftIndex);
+	}
+
+	// build subtrees. Each subtree only modifies its own range of Boxes.
+	int32_t NumSubtrees = (int32_t)SubtreeRoots.size();
+	unsafe_vector<unsafe_vector<BuildNode>> Subtrees;
+	Subtrees.resize(NumSubtrees);
+	auto BuildSubtree = [&](uint32_t SubtreeIndex) {
+		Subtrees[SubtreeIndex].reserve(2 * TopNodes[SubtreeRoots[SubtreeIndex]].Count / MaxLeafSize + 1);
+		Subtrees[SubtreeIndex].add_ref(TopNodes[SubtreeRoots[SubtreeIndex]]);
+		sah_build_subtree3(Boxes.raw_pointer(), Subtrees[SubtreeIndex], MaxLeafSize, NumBins);
+	};
+	if (bParallel)
+		GS::ParallelFor(NumSubtrees, BuildSubtree);
+	else
+		for (int32_t k = 0; k < NumSubtrees; ++k) BuildSubtree(k);
+
+	// leaf boxes are the partitioned boxes list, each leaf is a contiguous range
+	LeafBoxLists.resize(NumBoxes);
+	for (int32_t k = 0; k < NumBoxes; ++k)
+		LeafBoxLists[k] = SourceBox3{ Boxes[k].Box, Boxes[k].BoxID };
+
+	// flatten the top-level tree and subtrees into NodeTree, in depth-first order
+	struct FlattenJob
+	{
+		int32_t SubtreeIndex;		// -1 for top-level nodes
+		int32_t NodeIndex;
+		int32_t ParentIndex;		// index into NodeTree, or -1 for root
+		bool bIsLeftChild;
+	};
+	auto GetBuildNode = [&](int32_t SubtreeIndex, int32_t NodeIndex) -> const BuildNode& {
+		return (SubtreeIndex < 0) ? TopNodes[NodeIndex] : Subtrees[SubtreeIndex][NodeIndex];
+	};
+
+	int32_t TotalNodes = (int32_t)TopNodes.size();
+	for (int32_t k = 0; k < NumSubtrees; ++k)
+		TotalNodes += (int32_t)Subtrees[k].size();
+	NodeTree.reserve(TotalNodes / 2 + 1);
+
+	unsafe_vector<FlattenJob> FlattenJobs;
+	FlattenJobs.add(FlattenJob{ -1, 0, -1, false });
+	FlattenJob Job;
+	while (FlattenJobs.pop_back(Job))
+	{
+		const BuildNode* Node = &GetBuildNode(Job.SubtreeIndex, Job.NodeIndex);
+		if (Job.SubtreeIndex < 0 && Node->SubtreeIndex >= 0) {
+			Job.SubtreeIndex = Node->SubtreeIndex;
+			Job.NodeIndex = 0;
+			Node = &GetBuildNode(Job.SubtreeIndex, 0);
+		}
+
+		ChildIndex NewIndex;
+		if (Node->IsLeaf())
+		{
+			gs_debug_assert(Node->Count > 0 && Node->Count <= MaxLeafSize);
+			NewIndex.LeafCount = (uint32_t)Node->Count;
+			NewIndex.Index = (uint32_t)Node->Start;
+		}
+		else
+		{
+			NewIndex.LeafCount = 0;
+			NewIndex.Index = (uint32_t)NodeTree.grow(1);
+			FlattenJobs.add(FlattenJob{ Job.SubtreeIndex, Node->Right, (int32_t)NewIndex.Index, false });
+			FlattenJobs.add(FlattenJob{ Job.SubtreeIndex, Node->Left, (int32_t)NewIndex.Index, true });
+		}
+
+		if (Job.ParentIndex < 0) {
+			RootIndex = NewIndex;
+		}
+		else if (Job.bIsLeftChild) {
+			NodeTree[Job.ParentIndex].LeftChild = NewIndex;
+			NodeTree[Job.ParentIndex].LeftBounds = Node->Bounds;
+		}
+		else {
+			NodeTree[Job.ParentIndex].RightChild = NewIndex;
+			NodeTree[Job.ParentIndex].RightBounds = Node->Bounds;
+		}
+	}
+	gs_debug_assert(RootIndex.LeafCount > 0 || RootIndex.Index == 0);
+}
+
+
+
+
+namespace GSLocal
+{
+	// per-ray data for box and watertight triangle tests
+	template<typename RealType>
+	struct TRayQueryData3
+	{
+		Vector3<RealType> Origin;
+		Vector3<RealType> Direction;
+		Vector3<RealType> InvDirection;
+		// watertight test: ray is transformed so that dimension kz is the largest direction component
+		int kx, ky, kz;
+		RealType Sx, Sy, Sz;
+
+		TRayQueryData3() {}
+		TRayQueryData3(const Ray3<RealType>& Ray)
+		{
+			Origin = Ray.Origin;
+			Direction = Ray.Direction;
+			for (int k = 0; k < 3; ++k)
+				InvDirection[k] = (RealType)1 / Direction[k];		// inf for zero components, handled in ray_box()
+
+			RealType AbsX = GS::Abs(Direction.X), AbsY = GS::Abs(Direction.Y), AbsZ = GS::Abs(Direction.Z);
+			kz = (AbsX > AbsY) ? ((AbsX > AbsZ) ? 0 : 2) : ((AbsY > AbsZ) ? 1 : 2);
+			kx = (kz + 1) % 3;
+			ky = (kx + 1) % 3;
+			if (Direction[kz] < 0)		// preserve triangle winding
+				GS::SwapTemp(kx, ky);
+			Sx = Direction[kx] / Direction[kz];
+			Sy = Direction[ky] / Direction[kz];
+			Sz = (RealType)1 / Direction[kz];
+		}
+	};
+
+	// conservative slab test. Comparisons are ordered so that NaNs (from 0*inf, when the origin is on
+	// a slab plane of a zero direction component) are ignored, and the far distance is expanded by
+	// a rounding-error bound so that the box test can't cull a hit that the triangle test would find.
+	template<typename RealType>
+	inline bool ray_box(const TRayQueryData3<RealType>& Ray, const AxisBox3<RealType>& Box, RealType MaxDist, RealType& EntryDistOut)
+	{
+		static constexpr RealType Gamma3 = (RealType)3 * std::numeric_limits<RealType>::epsilon() / ((RealType)1 - (RealType)3 * std::numeric_limits<RealType>::epsilon());
+		RealType TNear = 0, TFar = MaxDist;
+		for (int k = 0; k < 3; ++k) {
+			RealType T0 = (Box.Min[k] - Ray.Origin[k]) * Ray.InvDirection[k];
+			RealType T1 = (Box.Max[k] - Ray.Origin[k]) * Ray.InvDirection[k];
+			if (T0 > T1) GS::SwapTemp(T0, T1);
+			T1 *= (RealType)1 + (RealType)2 * Gamma3;
+			TNear = (T0 > TNear) ? T0 : TNear;
+			TFar = (T1 < TFar) ? T1 : TFar;
+			if (TNear > TFar)
+				return false;
+		}
+		EntryDistOut = TNear;
+		return true;
+	}
+
+	// watertight ray-triangle intersection from Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection", JCGT 2013.
+	// Triangles are two-sided. Hits with distance > MaxDist are rejected.
+	template<typename RealType>
+	inline bool ray_triangle_watertight(const TRayQueryData3<RealType>& Ray,
+		const Vector3<RealType>& V0, const Vector3<RealType>& V1, const Vector3<RealType>& V2,
+		RealType MaxDist, RealType& DistOut, Vector3<RealType>& BaryCoordsOut)
+	{
+		Vector3<RealType> A = V0 - Ray.Origin, B = V1 - Ray.Origin, C = V2 - Ray.Origin;
+		RealType Ax = A[Ray.kx] - Ray.Sx * A[Ray.kz], Ay = A[Ray.ky] - Ray.Sy * A[Ray.kz];
+		RealType Bx = B[Ray.kx] - Ray.Sx * B[Ray.kz], By = B[Ray.ky] - Ray.Sy * B[Ray.kz];
+		RealType Cx = C[Ray.kx] - Ray.Sx * C[Ray.kz], Cy = C[Ray.ky] - Ray.Sy * C[Ray.kz];
+
+		RealType U = Cx * By - Cy * Bx;
+		RealType V = Ax * Cy - Ay * Cx;
+		RealType W = Bx * Ay - By * Ax;
+		if constexpr (std::is_same_v<RealType, float>)
+		{
+			// edge functions that are exactly zero in float are recomputed in double, to resolve edge/vertex hits consistently
+			if (U == 0 || V == 0 || W == 0) {
+				U = (float)((double)Cx * (double)By - (double)Cy * (double)Bx);
+				V = (float)((double)Ax * (double)Cy - (double)Ay * (double)Cx);
+				W = (float)((double)Bx * (double)Ay - (double)By * (double)Ax);
+			}
+		}
+		if ((U < 0 || V < 0 || W < 0) && (U > 0 || V > 0 || W > 0))
+			return false;
+
+		RealType Det = U + V + W;
+		if (Det == 0)
+			return false;
+
+		RealType Az = Ray.Sz * A[Ray.kz], Bz = Ray.Sz * B[Ray.kz], Cz = Ray.Sz * C[Ray.kz];
+		RealType T = U * Az + V * Bz + W * Cz;
+		if (Det < 0) {
+			T = -T; Det = -Det; U = -U; V = -V; W = -W;
+		}
+		if (T < 0 || T > MaxDist * Det)
+			return false;
+
+		RealType InvDet = (RealType)1 / Det;
+		DistOut = T * InvDet;
+		BaryCoordsOut = Vector3<RealType>(U * InvDet, V * InvDet, W * InvDet);
+		return true;
+	}
+
+	// closest point on triangle ABC to P, from Ericson, "Real-Time Collision Detection", 5.1.5
+	template<typename RealType>
+	inline Vector3<RealType> closest_point_on_triangle(const Vector3<RealType>& P,
+		const Vector3<RealType>& A, const Vector3<RealType>& B, const Vector3<RealType>& C,
+		Vector3<RealType>& BaryCoordsOut)
+	{
+		Vector3<RealType> AB = B - A, AC = C - A, AP = P - A;
+		RealType d1 = AB.Dot(AP), d2 = AC.Dot(AP);
+		if (d1 <= 0 && d2 <= 0) {
+			BaryCoordsOut = Vector3<RealType>(1, 0, 0);
+			return A;
+		}
+		Vector3<RealType> BP = P - B;
+		RealType d3 = AB.Dot(BP), d4 = AC.Dot(BP);
+		if (d3 >= 0 && d4 <= d3) {
+			BaryCoordsOut = Vector3<RealType>(0, 1, 0);
+			return B;
+		}
+		RealType vc = d1 * d4 - d3 * d2;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0 && d1 - d3 > 0) {
+			RealType v = d1 / (d1 - d3);
+			BaryCoordsOut = Vector3<RealType>(1 - v, v, 0);
+			return A + v * AB;
+		}
+		Vector3<RealType> CP = P - C;
+		RealType d5 = AB.Dot(CP), d6 = AC.Dot(CP);
+		if (d6 >= 0 && d5 <= d6) {
+			BaryCoordsOut = Vector3<RealType>(0, 0, 1);
+			return C;
+		}
+		RealType vb = d5 * d2 - d1 * d6;
+		if (vb <= 0 && d2 >= 0 && d6 <= 0 && d2 - d6 > 0) {
+			RealType w = d2 / (d2 - d6);
+			BaryCoordsOut = Vector3<RealType>(1 - w, 0, w);
+			return A + w * AC;
+		}
+		RealType va = d3 * d6 - d5 * d4;
+		if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0 && (d4 - d3) + (d5 - d6) > 0) {
+			RealType w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			BaryCoordsOut = Vector3<RealType>(0, 1 - w, w);
+			return B + w * (C - B);
+		}
+		RealType Sum = va + vb + vc;
+		if (Sum <= 0)
+		{
+			// degenerate triangle, use the nearest vertex
+			RealType DA = P.DistanceSquared(A), DB = P.DistanceSquared(B), DC = P.DistanceSquared(C);
+			if (DA <= DB && DA <= DC) { BaryCoordsOut = Vector3<RealType>(1, 0, 0); return A; }
+			if (DB <= DC) { BaryCoordsOut = Vector3<RealType>(0, 1, 0); return B; }
+			BaryCoordsOut = Vector3<RealType>(0, 0, 1);
+			return C;
+		}
+		RealType Denom = (RealType)1 / Sum;
+		RealType v = vb * Denom, w = vc * Denom;
+		BaryCoordsOut = Vector3<RealType>(1 - v - w, v, w);
+		return A + AB * v + AC * w;
+	}
+
+	template<typename RealType>
+	struct TRayStackEntry3
+	{
+		typename AxisBoxTree3<RealType>::ChildIndex Index;
+		RealType EntryDist;
+	};
+}
+
+
+template<typename RealType>
+DistanceResult3<RealType> GS::AxisBoxTree3<RealType>::PointDistanceQuery(
+	const Vector3<RealType>& QueryPoint,
+	FunctionRef<DistanceResult3<RealType>(int BoxID, const Vector3<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+	DistanceQueryOptions<RealType> Options) const
+{
+	struct StackBox
+	{
+		ChildIndex Index;
+		AxisBox3<RealType> Box;
+	};
+	if (LeafBoxLists.size() == 0)
+		return DistanceResult3<RealType>();
+
+	RealType MaxDistSqr = Options.MaxDistance * Options.MaxDistance;
+	if (RootBounds.DistanceSquared(QueryPoint) > MaxDistSqr)
+		return DistanceResult3<RealType>();
+	RealType MinDistSqr = MaxDistSqr;
+	DistanceResult3<RealType> MinDistResult;
+
+	inline_stack<StackBox, 64> stack;
+	stack.push_back( {RootIndex, RootBounds} );
+	StackBox nextBox;
+	while (stack.pop_back(nextBox))
+	{
+		// MinDistSqr may have shrunk while this node was on the stack
+		if (nextBox.Box.DistanceSquared(QueryPoint) > MinDistSqr)
+			continue;
+
+		ChildIndex next = nextBox.Index;
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox3& Box = LeafBoxLists[next.Index + j];
+				if (Box.Box.DistanceSquared(QueryPoint) < MinDistSqr) {
+					DistanceResult3<RealType> ElemDistSqrResult = ElementDistanceSqrFunc(Box.BoxID, QueryPoint);
+					if (ElemDistSqrResult.DistanceSqr < MinDistSqr) {
+						MinDistSqr = ElemDistSqrResult.DistanceSqr;
+						MinDistResult = ElemDistSqrResult;
+						MinDistResult.ElementID = Box.BoxID;
+					}
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			StackBox Children[2] = { {Node.LeftChild,Node.LeftBounds},  {Node.RightChild,Node.RightBounds} };
+			RealType ChildDists[2] = { Node.LeftBounds.DistanceSquared(QueryPoint), Node.RightBounds.DistanceSquared(QueryPoint)};
+			if (ChildDists[0] > ChildDists[1]) {
+				GS::SwapTemp(ChildDists[0], ChildDists[1]);
+				GS::SwapTemp(Children[0], Children[1]);
+			}
+			// push farther child first, so that the nearer child is popped (and MinDistSqr shrinks) first
+			if (ChildDists[0] < MinDistSqr) {
+				if (ChildDists[1] < MinDistSqr)
+					stack.push_back(Children[1]);
+				stack.push_back(Children[0]);
+			}
+		}
+	}
+	return MinDistResult;
+}
+
+
+template<typename RealType>
+RayHitResult3<RealType> GS::AxisBoxTree3<RealType>::FindNearestHit(
+	const Ray3<RealType>& Ray,
+	FunctionRef<bool(int BoxID, const Ray3<RealType>& Ray, RayHitResult3<RealType>& HitOut)> ElementRayFunc,
+	RayQueryOptions<RealType> Options) const
+{
+	using namespace GSLocal;
+	RayHitResult3<RealType> NearestHit;
+	if (LeafBoxLists.size() == 0)
+		return NearestHit;
+
+	TRayQueryData3<RealType> RayData(Ray);
+	RealType NearestDist = Options.MaxDistance;
+	RealType EntryDist;
+	if (ray_box(RayData, RootBounds, NearestDist, EntryDist) == false)
+		return NearestHit;
+
+	inline_stack<TRayStackEntry3<RealType>, 64> stack;
+	stack.push_back( {RootIndex, EntryDist} );
+	TRayStackEntry3<RealType> next;
+	while (stack.pop_back(next))
+	{
+		if (next.EntryDist > NearestDist)
+			continue;
+		if (next.Index.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.Index.LeafCount; ++j) {
+				const SourceBox3& Box = LeafBoxLists[next.Index.Index + j];
+				if (ray_box(RayData, Box.Box, NearestDist, EntryDist) == false)
+					continue;
+				RayHitResult3<RealType> ElementHit;
+				if (ElementRayFunc(Box.BoxID, Ray, ElementHit) && ElementHit.RayParameter < NearestDist) {
+					NearestDist = ElementHit.RayParameter;
+					NearestHit = ElementHit;
+					NearestHit.ElementID = Box.BoxID;
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index.Index];
+			RealType LeftDist = 0, RightDist = 0;
+			bool bHitLeft = ray_box(RayData, Node.LeftBounds, NearestDist, LeftDist);
+			bool bHitRight = ray_box(RayData, Node.RightBounds, NearestDist, RightDist);
+			// push farther child first, so that the nearer child is popped first
+			if (bHitLeft && bHitRight) {
+				if (LeftDist <= RightDist) {
+					stack.push_back( {Node.RightChild, RightDist} );
+					stack.push_back( {Node.LeftChild, LeftDist} );
+				} else {
+					stack.push_back( {Node.LeftChild, LeftDist} );
+					stack.push_back( {Node.RightChild, RightDist} );
+				}
+			}
+			else if (bHitLeft)
+				stack.push_back( {Node.LeftChild, LeftDist} );
+			else if (bHitRight)
+				stack.push_back( {Node.RightChild, RightDist} );
+		}
+	}
+	return NearestHit;
+}
+
+
+template<typename RealType>
+bool GS::AxisBoxTree3<RealType>::BoxOverlapQuery(
+	const AxisBox3<RealType>& QueryBox,
+	FunctionRef<void(int)> FoundElementFunc) const
+{
+	// AxisBox3::Intersects() excludes touching boxes, this includes them so that degenerate boxes can be found
+	auto BoxesOverlap = [](const AxisBox3<RealType>& A, const AxisBox3<RealType>& B) {
+		return !((B.Max.X < A.Min.X) || (B.Min.X > A.Max.X) || (B.Max.Y < A.Min.Y) || (B.Min.Y > A.Max.Y) || (B.Max.Z < A.Min.Z) || (B.Min.Z > A.Max.Z));
+	};
+	if (LeafBoxLists.size() == 0 || BoxesOverlap(RootBounds, QueryBox) == false)
+		return false;
+
+	inline_stack<ChildIndex, 64> stack;
+	int NumFound = 0;
+	stack.push_back(RootIndex);
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox3& Box = LeafBoxLists[next.Index + j];
+				if (BoxesOverlap(Box.Box, QueryBox)) {
+					FoundElementFunc(Box.BoxID);
+					NumFound++;
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			if (BoxesOverlap(Node.LeftBounds, QueryBox))
+				stack.push_back(Node.LeftChild);
+			if (BoxesOverlap(Node.RightBounds, QueryBox))
+				stack.push_back(Node.RightChild);
+		}
+	}
+	return NumFound > 0;
+}
+
+
+template<typename RealType>
+RayHitResult3<RealType> GS::AxisBoxTree3<RealType>::FindNearestHitTriangle(
+	const Ray3<RealType>& Ray,
+	RayQueryOptions<RealType> Options) const
+{
+	using namespace GSLocal;
+	gs_debug_assert(bTriangleTree);
+	RayHitResult3<RealType> NearestHit;
+	if (LeafTriangles.size() == 0)
+		return NearestHit;
+
+	TRayQueryData3<RealType> RayData(Ray);
+	RealType NearestDist = Options.MaxDistance;
+	RealType EntryDist;
+	if (ray_box(RayData, RootBounds, NearestDist, EntryDist) == false)
+		return NearestHit;
+
+	int32_t NearestSlot = -1;
+	Vector3<RealType> NearestBaryCoords = Vector3<RealType>::Zero();
+
+	inline_stack<TRayStackEntry3<RealType>, 64> stack;
+	stack.push_back( {RootIndex, EntryDist} );
+	TRayStackEntry3<RealType> next;
+	while (stack.pop_back(next))
+	{
+		if (next.EntryDist > NearestDist)
+			continue;
+		if (next.Index.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.Index.LeafCount; ++j) {
+				int32_t Slot = next.Index.Index + j;
+				const SourceTriangle3& Tri = LeafTriangles[Slot];
+				RealType HitDist; Vector3<RealType> BaryCoords;
+				if (ray_triangle_watertight(RayData, Tri.V[0], Tri.V[1], Tri.V[2], NearestDist, HitDist, BaryCoords) && HitDist < NearestDist) {
+					NearestDist = HitDist;
+					NearestSlot = Slot;
+					NearestBaryCoords = BaryCoords;
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index.Index];
+			RealType LeftDist = 0, RightDist = 0;
+			bool bHitLeft = ray_box(RayData, Node.LeftBounds, NearestDist, LeftDist);
+			bool bHitRight = ray_box(RayData, Node.RightBounds, NearestDist, RightDist);
+			// push farther child first, so that the nearer child is popped first
+			if (bHitLeft && bHitRight) {
+				if (LeftDist <= RightDist) {
+					stack.push_back( {Node.RightChild, RightDist} );
+					stack.push_back( {Node.LeftChild, LeftDist} );
+				} else {
+					stack.push_back( {Node.LeftChild, LeftDist} );
+					stack.push_back( {Node.RightChild, RightDist} );
+				}
+			}
+			else if (bHitLeft)
+				stack.push_back( {Node.LeftChild, LeftDist} );
+			else if (bHitRight)
+				stack.push_back( {Node.RightChild, RightDist} );
+		}
+	}
+
+	if (NearestSlot >= 0)
+	{
+		const SourceTriangle3& Tri = LeafTriangles[NearestSlot];
+		NearestHit.ElementID = LeafBoxLists[NearestSlot].BoxID;
+		NearestHit.RayParameter = NearestDist;
+		NearestHit.BaryCoords = NearestBaryCoords;
+		NearestHit.HitPoint = NearestBaryCoords.X * Tri.V[0] + NearestBaryCoords.Y * Tri.V[1] + NearestBaryCoords.Z * Tri.V[2];
+	}
+	return NearestHit;
+}
+
+
+template<typename RealType>
+bool GS::AxisBoxTree3<RealType>::TestAnyHitTriangle(
+	const Ray3<RealType>& Ray,
+	RayQueryOptions<RealType> Options) const
+{
+	using namespace GSLocal;
+	gs_debug_assert(bTriangleTree);
+	if (LeafTriangles.size() == 0)
+		return false;
+
+	TRayQueryData3<RealType> RayData(Ray);
+	RealType MaxDist = Options.MaxDistance;
+	RealType EntryDist;
+	if (ray_box(RayData, RootBounds, MaxDist, EntryDist) == false)
+		return false;
+
+	// no ordering is needed, so only the node index is stored
+	inline_stack<ChildIndex, 64> stack;
+	stack.push_back(RootIndex);
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceTriangle3& Tri = LeafTriangles[next.Index + j];
+				RealType HitDist; Vector3<RealType> BaryCoords;
+				if (ray_triangle_watertight(RayData, Tri.V[0], Tri.V[1], Tri.V[2], MaxDist, HitDist, BaryCoords))
+					return true;
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			if (ray_box(RayData, Node.RightBounds, MaxDist, EntryDist))
+				stack.push_back(Node.RightChild);
+			if (ray_box(RayData, Node.LeftBounds, MaxDist, EntryDist))
+				stack.push_back(Node.LeftChild);
+		}
+	}
+	return false;
+}
+
+
+template<typename RealType>
+DistanceResult3<RealType> GS::AxisBoxTree3<RealType>::FindNearestPoint(
+	const Vector3<RealType>& QueryPoint,
+	DistanceQueryOptions<RealType> Options) const
+{
+	gs_debug_assert(bTriangleTree);
+	if (LeafTriangles.size() == 0)
+		return DistanceResult3<RealType>();
+
+	struct StackBox
+	{
+		ChildIndex Index;
+		AxisBox3<RealType> Box;
+	};
+
+	RealType MaxDistSqr = Options.MaxDistance * Options.MaxDistance;
+	if (RootBounds.DistanceSquared(QueryPoint) > MaxDistSqr)
+		return DistanceResult3<RealType>();
+	RealType MinDistSqr = MaxDistSqr;
+	int32_t NearestSlot = -1;
+	Vector3<RealType> NearestPoint = Vector3<RealType>::Zero(), NearestBaryCoords = Vector3<RealType>::Zero();
+
+	inline_stack<StackBox, 64> stack;
+	stack.push_back( {RootIndex, RootBounds} );
+	StackBox nextBox;
+	while (stack.pop_back(nextBox))
+	{
+		if (nextBox.Box.DistanceSquared(QueryPoint) > MinDistSqr)
+			continue;
+
+		ChildIndex next = nextBox.Index;
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				int32_t Slot = next.Index + j;
+				if (LeafBoxLists[Slot].Box.DistanceSquared(QueryPoint) >= MinDistSqr)
+					continue;
+				const SourceTriangle3& Tri = LeafTriangles[Slot];
+				Vector3<RealType> BaryCoords;
+				Vector3<RealType> TriPoint = GSLocal::closest_point_on_triangle(QueryPoint, Tri.V[0], Tri.V[1], Tri.V[2], BaryCoords);
+				RealType DistSqr = TriPoint.DistanceSquared(QueryPoint);
+				if (DistSqr < MinDistSqr) {
+					MinDistSqr = DistSqr;
+					NearestSlot = Slot;
+					NearestPoint = TriPoint;
+					NearestBaryCoords = BaryCoords;
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			StackBox Children[2] = { {Node.LeftChild,Node.LeftBounds},  {Node.RightChild,Node.RightBounds} };
+			RealType ChildDists[2] = { Node.LeftBounds.DistanceSquared(QueryPoint), Node.RightBounds.DistanceSquared(QueryPoint)};
+			if (ChildDists[0] > ChildDists[1]) {
+				GS::SwapTemp(ChildDists[0], ChildDists[1]);
+				GS::SwapTemp(Children[0], Children[1]);
+			}
+			// push farther child first, so that the nearer child is popped (and MinDistSqr shrinks) first
+			if (ChildDists[0] < MinDistSqr) {
+				if (ChildDists[1] < MinDistSqr)
+					stack.push_back(Children[1]);
+				stack.push_back(Children[0]);
+			}
+		}
+	}
+
+	DistanceResult3<RealType> Result;
+	if (NearestSlot >= 0) {
+		Result = DistanceResult3<RealType>(LeafBoxLists[NearestSlot].BoxID, MinDistSqr, NearestPoint);
+		Result.BaryCoords = NearestBaryCoords;
+	}
+	return Result;
+}
+
+
+
+
+namespace GSLocal
+{
+	static constexpr int RayPacketWidth3 = 8;
+	static constexpr int RayPacketsPerJob3 = 16;
+
+	// float copy of Box expanded by Pad, which must be large enough to cover rounding of the box and of the float ray origins
+	template<typename RealType>
+	inline AxisBox3f to_padded_float_box3(const AxisBox3<RealType>& Box, double Pad)
+	{
+		return AxisBox3f(
+			Vector3f((float)((double)Box.Min.X - Pad), (float)((double)Box.Min.Y - Pad), (float)((double)Box.Min.Z - Pad)),
+			Vector3f((float)((double)Box.Max.X + Pad), (float)((double)Box.Max.Y + Pad), (float)((double)Box.Max.Z + Pad)));
+	}
+
+	// traverse the tree with one packet of rays from Batch. If bAnyHit, AnyHitsOut is set for each ray and
+	// rays are retired from the packet at their first hit, otherwise the nearest hit of each ray is written to NearestHitsOut.
+	template<typename RealType, bool bAnyHit>
+	void ray_packet_traversal3(
+		const AxisBoxTree3<RealType>& Tree, const RayBatch& Batch, int PacketIndex, double BoxPad,
+		RayHitResult3<RealType>* NearestHitsOut, uint8_t* AnyHitsOut)
+	{
+		using ChildIndex = typename AxisBoxTree3<RealType>::ChildIndex;
+		using InteriorNode = typename AxisBoxTree3<RealType>::InteriorNode;
+		using SourceTriangle3 = typename AxisBoxTree3<RealType>::SourceTriangle3;
+		constexpr int Width = RayPacketWidth3;
+
+		RayPacket3f<Width> Packet;
+		uint32_t ActiveMask = Batch.GetPacket<Width>(PacketIndex, Packet);
+		int StartIndex = PacketIndex * Width;
+
+		TRayQueryData3<RealType> RayData[Width];
+		RealType NearestDist[Width];
+		int32_t NearestSlot[Width];
+		Vector3<RealType> NearestBaryCoords[Width];
+		for (int k = 0; k < Width; ++k)
+		{
+			NearestSlot[k] = -1;
+			if ((ActiveMask & (1u << k)) == 0)
+				continue;
+			const Ray3d& Ray = Batch.Rays[StartIndex + k];
+			RayData[k] = TRayQueryData3<RealType>(Ray3<RealType>((Vector3<RealType>)Ray.Origin, (Vector3<RealType>)Ray.Direction));
+			NearestDist[k] = (RealType)GS::Min(Batch.MaxDistances[StartIndex + k], (double)RealConstants<RealType>::SafeMaxValue());
+		}
+
+		// entry distances are stored per lane, so that lanes which found a nearer hit while the node
+		// was on the stack can be culled when it is popped
+		struct PacketStackEntry
+		{
+			ChildIndex Index;
+			uint32_t Mask;
+			float EntryDist[Width];
+		};
+		inline_stack<PacketStackEntry, 64> stack;
+		PacketStackEntry next;
+		next.Index = Tree.RootIndex;
+		next.Mask = TestRayPacketBoxIntersection<Width>(Packet, to_padded_float_box3(Tree.RootBounds, BoxPad), next.EntryDist) & ActiveMask;
+		if (next.Mask != 0)
+			stack.push_back(next);
+
+		while (stack.pop_back(next))
+		{
+			uint32_t Mask = next.Mask & ActiveMask;
+			if constexpr (bAnyHit == false)
+			{
+				for (uint32_t LaneMask = Mask; LaneMask != 0; LaneMask &= LaneMask - 1) {
+					int k = std::countr_zero(LaneMask);
+					if (next.EntryDist[k] > Packet.MaxDistance[k])
+						Mask &= ~(1u << k);
+				}
+			}
+			if (Mask == 0)
+				continue;
+
+			if (next.Index.LeafCount > 0)
+			{
+				for (uint32_t j = 0; j < next.Index.LeafCount && Mask != 0; ++j)
+				{
+					int32_t Slot = next.Index.Index + j;
+					const SourceTriangle3& Tri = Tree.LeafTriangles[Slot];
+					for (uint32_t LaneMask = Mask; LaneMask != 0; LaneMask &= LaneMask - 1)
+					{
+						int k = std::countr_zero(LaneMask);
+						RealType HitDist; Vector3<RealType> BaryCoords;
+						if (ray_triangle_watertight(RayData[k], Tri.V[0], Tri.V[1], Tri.V[2], NearestDist[k], HitDist, BaryCoords) == false)
+							continue;
+						if constexpr (bAnyHit)
+						{
+							AnyHitsOut[Batch.SourceIndices[StartIndex + k]] = 1;
+							ActiveMask &= ~(1u << k);
+							Mask &= ~(1u << k);
+						}
+						else if (HitDist < NearestDist[k])
+						{
+							NearestDist[k] = HitDist;
+							NearestSlot[k] = Slot;
+							NearestBaryCoords[k] = BaryCoords;
+							// shrink the float ray interval so that farther boxes are culled for this lane
+							Packet.MaxDistance[k] = RayBatch::to_float_distance((double)HitDist);
+						}
+					}
+				}
+				if constexpr (bAnyHit) {
+					if (ActiveMask == 0)
+						break;
+				}
+			}
+			else
+			{
+				const InteriorNode& Node = Tree.NodeTree[next.Index.Index];
+				PacketStackEntry Left, Right;
+				Left.Index = Node.LeftChild;
+				Left.Mask = TestRayPacketBoxIntersection<Width>(Packet, to_padded_float_box3(Node.LeftBounds, BoxPad), Left.EntryDist) & Mask;
+				Right.Index = Node.RightChild;
+				Right.Mask = TestRayPacketBoxIntersection<Width>(Packet, to_padded_float_box3(Node.RightBounds, BoxPad), Right.EntryDist) & Mask;
+
+				// push the child that is nearer for fewer lanes first, so that the child nearer for most lanes is popped first
+				bool bLeftFirst = true;
+				if constexpr (bAnyHit == false)
+				{
+					int NumLeftNearer = 0, NumRightNearer = 0;
+					for (uint32_t BothMask = Left.Mask & Right.Mask; BothMask != 0; BothMask &= BothMask - 1) {
+						int k = std::countr_zero(BothMask);
+						(Left.EntryDist[k] <= Right.EntryDist[k]) ? NumLeftNearer++ : NumRightNearer++;
+					}
+					bLeftFirst = (NumLeftNearer >= NumRightNearer);
+				}
+				if (bLeftFirst) {
+					if (Right.Mask != 0) stack.push_back(Right);
+					if (Left.Mask != 0) stack.push_back(Left);
+				} else {
+					if (Left.Mask != 0) stack.push_back(Left);
+					if (Right.Mask != 0) stack.push_back(Right);
+				}
+			}
+		}
+
+		if constexpr (bAnyHit == false)
+		{
+			for (int k = 0; k < Width && StartIndex + k < Batch.GetRayCount(); ++k)
+			{
+				RayHitResult3<RealType> Hit;
+				if (NearestSlot[k] >= 0)
+				{
+					const SourceTriangle3& Tri = Tree.LeafTriangles[NearestSlot[k]];
+					const Vector3<RealType>& Bary = NearestBaryCoords[k];
+					Hit.ElementID = Tree.LeafBoxLists[NearestSlot[k]].BoxID;
+					Hit.RayParameter = NearestDist[k];
+					Hit.BaryCoords = Bary;
+					Hit.HitPoint = Bary.X * Tri.V[0] + Bary.Y * Tri.V[1] + Bary.Z * Tri.V[2];
+				}
+				NearestHitsOut[Batch.SourceIndices[StartIndex + k]] = Hit;
+			}
+		}
+	}
+
+	// padding for float box tests, relative to the largest coordinate magnitude of the tree and ray origins
+	template<typename RealType>
+	double ray_packet_box_padding3(const AxisBox3<RealType>& RootBounds, const RayBatch& Batch)
+	{
+		double MaxCoord = 0;
+		for (int k = 0; k < 3; ++k) {
+			MaxCoord = GS::Max(MaxCoord, GS::Max(GS::Abs((double)RootBounds.Min[k]), GS::Abs((double)RootBounds.Max[k])));
+			MaxCoord = GS::Max(MaxCoord, GS::Max(GS::Abs(Batch.OriginBounds.Min[k]), GS::Abs(Batch.OriginBounds.Max[k])));
+		}
+		return GS::Max(MaxCoord * std::ldexp(1.0, -20), (double)std::numeric_limits<float>::min());
+	}
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::FindNearestHitTriangles(
+	const RayBatch& Batch,
+	unsafe_vector<RayHitResult3<RealType>>& HitsOut,
+	bool bParallel) const
+{
+	using namespace GSLocal;
+	gs_debug_assert(bTriangleTree);
+	int NumRays = Batch.GetRayCount();
+	HitsOut.resize(NumRays);
+	if (LeafTriangles.size() == 0)
+	{
+		for (int k = 0; k < NumRays; ++k)
+			HitsOut[k] = RayHitResult3<RealType>();
+		return;
+	}
+
+	double BoxPad = ray_packet_box_padding3(RootBounds, Batch);
+	int NumPackets = Batch.GetPacketCount(RayPacketWidth3);
+	int NumJobs = (NumPackets + RayPacketsPerJob3 - 1) / RayPacketsPerJob3;
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+	GS::ParallelFor(NumJobs, [&](uint32_t JobIndex) {
+		int PacketEnd = GS::Min(((int)JobIndex + 1) * RayPacketsPerJob3, NumPackets);
+		for (int PacketIndex = (int)JobIndex * RayPacketsPerJob3; PacketIndex < PacketEnd; ++PacketIndex)
+			ray_packet_traversal3<RealType, false>(*this, Batch, PacketIndex, BoxPad, HitsOut.raw_pointer(), nullptr);
+	}, Flags);
+}
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::TestAnyHitTriangles(
+	const RayBatch& Batch,
+	unsafe_vector<uint8_t>& HitsOut,
+	bool bParallel) const
+{
+	using namespace GSLocal;
+	gs_debug_assert(bTriangleTree);
+	int NumRays = Batch.GetRayCount();
+	HitsOut.resize(NumRays);
+	for (int k = 0; k < NumRays; ++k)
+		HitsOut[k] = 0;
+	if (LeafTriangles.size() == 0)
+		return;
+
+	double BoxPad = ray_packet_box_padding3(RootBounds, Batch);
+	int NumPackets = Batch.GetPacketCount(RayPacketWidth3);
+	int NumJobs = (NumPackets + RayPacketsPerJob3 - 1) / RayPacketsPerJob3;
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+	GS::ParallelFor(NumJobs, [&](uint32_t JobIndex) {
+		int PacketEnd = GS::Min(((int)JobIndex + 1) * RayPacketsPerJob3, NumPackets);
+		for (int PacketIndex = (int)JobIndex * RayPacketsPerJob3; PacketIndex < PacketEnd; ++PacketIndex)
+			ray_packet_traversal3<RealType, true>(*this, Batch, PacketIndex, BoxPad, nullptr, HitsOut.raw_pointer());
+	}, Flags);
+}
+
+
+
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::Clear()
+{
+	RootIndex = ChildIndex{ 0, 0 };
+	RootBounds = BoxType::Empty();
+	NodeTree.clear(true);
+	LeafBoxLists.clear(true);
+	LeafTriangles.clear(true);
+	bTriangleTree = false;
+}
+
+
+struct AxisBoxTree3Versions
+{
+	static constexpr uint32_t CurrentVersionNumber = 1;
+};
+
+template<typename RealType>
+bool GS::AxisBoxTree3<RealType>::Store(GS::ISerializer& Serializer) const
+{
+	GS::SerializationVersion CurrentVersion(AxisBoxTree3Versions::CurrentVersionNumber);
+	bool bOK = Serializer.WriteVersion(SerializeVersionString(), CurrentVersion);
+	bOK = bOK && Serializer.WriteValue<uint32_t>("RealSize", sizeof(RealType));
+	bOK = bOK && Serializer.WriteBoolean("bTriangleTree", bTriangleTree);
+	bOK = bOK && Serializer.WriteValue<ChildIndex>("RootIndex", RootIndex);
+	bOK = bOK && Serializer.WriteValue<BoxType>("RootBounds", RootBounds);
+	bOK = bOK && NodeTree.Store(Serializer, "NodeTree");
+	bOK = bOK && LeafBoxLists.Store(Serializer, "LeafBoxLists");
+	bOK = bOK && LeafTriangles.Store(Serializer, "LeafTriangles");
+	return bOK;
+}
+
+template<typename RealType>
+bool GS::AxisBoxTree3<RealType>::Restore(GS::ISerializer& Serializer)
+{
+	Clear();
+	GS::SerializationVersion Version;
+	bool bOK = Serializer.ReadVersion(SerializeVersionString(), Version);
+	bOK = bOK && (Version.Version == AxisBoxTree3Versions::CurrentVersionNumber);
+	uint32_t RealSize = 0;
+	bOK = bOK && Serializer.ReadValue<uint32_t>("RealSize", RealSize);
+	bOK = bOK && (RealSize == sizeof(RealType));
+	bOK = bOK && Serializer.ReadBoolean("bTriangleTree", bTriangleTree);
+	bOK = bOK && Serializer.ReadValue<ChildIndex>("RootIndex", RootIndex);
+	bOK = bOK && Serializer.ReadValue<BoxType>("RootBounds", RootBounds);
+	bOK = bOK && NodeTree.Restore(Serializer, "NodeTree");
+	bOK = bOK && LeafBoxLists.Restore(Serializer, "LeafBoxLists");
+	bOK = bOK && LeafTriangles.Restore(Serializer, "LeafTriangles");
+	return bOK;
+}
+
+
+
+
+template<typename RealType>
+static void check_boxes3(const AxisBox3<RealType>& A, const AxisBox3<RealType>& B)
+{
+	gs_debug_assert(A.Contains(B) && B.Contains(A));
+}
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::Validate()
+{
+	AxisBox3<RealType> ComputedBounds;
+	if (RootIndex.LeafCount > 0)
+		validate_leaf_child(RootIndex, ComputedBounds);
+	else if (NodeTree.size() > 0)
+		validate_internal_node(RootIndex, ComputedBounds);
+	else
+		return;
+	check_boxes3(RootBounds, ComputedBounds);
+	gs_debug_assert(bTriangleTree == false || LeafTriangles.size() == LeafBoxLists.size());
+}
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::validate_leaf_child(ChildIndex Index, AxisBox3<RealType>& ComputedBounds)
+{
+	gs_debug_assert(Index.LeafCount > 0);
+	ComputedBounds = AxisBox3<RealType>::Empty();
+	for (uint32_t j = 0; j < Index.LeafCount; ++j) {
+		ComputedBounds.Contain(LeafBoxLists[Index.Index + j].Box);
+	}
+}
+
+template<typename RealType>
+void GS::AxisBoxTree3<RealType>::validate_internal_node(ChildIndex Index, AxisBox3<RealType>& ComputedBounds)
+{
+	gs_debug_assert(Index.LeafCount == 0);
+	const InteriorNode& Node = NodeTree[Index.Index];
+
+	AxisBox3<RealType> LeftBox, RightBox;
+	if (Node.LeftChild.LeafCount > 0)
+		validate_leaf_child(Node.LeftChild, LeftBox);
+	else
+		validate_internal_node(Node.LeftChild, LeftBox);
+	check_boxes3(LeftBox, Node.LeftBounds);
+
+	if (Node.RightChild.LeafCount > 0)
+		validate_leaf_child(Node.RightChild, RightBox);
+	else
+		validate_internal_node(Node.RightChild, RightBox);
+	check_boxes3(RightBox, Node.RightBounds);
+
+	ComputedBounds = LeftBox;
+	ComputedBounds.Contain(RightBox);
+}
+
+
+// explicit instantiation
+template class GRADIENTSPACECORE_API GS::AxisBoxTree3<float>;
+template class GRADIENTSPACECORE_API GS::AxisBoxTree3<double>;
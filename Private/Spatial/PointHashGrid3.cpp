@@ -0,0 +1,276 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Spatial/PointHashGrid3.h"
+#include "Core/ParallelFor.h"
+#include "Core/ParallelSort.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	static constexpr int32_t HashGridBlockSize = 16 * 1024;
+
+	inline int32_t hash_grid_cell_coord(double Value, double Origin, double InvCellSize)
+	{
+		double Cell = std::floor((Value - Origin) * InvCellSize);
+		return (int32_t)GS::Clamp(Cell, -1.0e9, 1.0e9);
+	}
+
+	inline uint32_t hash_grid_cell(int32_t X, int32_t Y, int32_t Z, uint32_t BucketMask)
+	{
+		uint32_t h = ((uint32_t)X * 73856093u) ^ ((uint32_t)Y * 19349663u) ^ ((uint32_t)Z * 83492791u);
+		// mix high bits into the low bits that are used by the mask
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		return h & BucketMask;
+	}
+}
+
+
+template<typename RealType>
+void GS::PointHashGrid3<RealType>::Clear()
+{
+	CellSize = InvCellSize = (RealType)1;
+	GridOrigin = Vector3<RealType>::Zero();
+	BucketMask = 0;
+	BucketStarts.clear(true);
+	PointIDs.clear(true);
+	Positions.clear(true);
+}
+
+
+template<typename RealType>
+void GS::PointHashGrid3<RealType>::Build(
+	const_buffer_view<Vector3<RealType>> Points,
+	RealType CellSizeIn,
+	bool bParallel)
+{
+	int32_t NumPoints = (int32_t)Points.size();
+	if (NumPoints == 0) {
+		Clear();
+		return;
+	}
+	const Vector3<RealType>* PointsBuffer = &Points[0];
+	Build(NumPoints, [PointsBuffer](int k, Vector3<RealType>& P) { P = PointsBuffer[k]; return true; }, CellSizeIn, bParallel);
+}
+
+
+template<typename RealType>
+void GS::PointHashGrid3<RealType>::Build(
+	int32_t MaxPointID,
+	FunctionRef<bool(int, Vector3<RealType>&)> GetPointFunc,
+	RealType CellSizeIn,
+	bool bParallel)
+{
+	// only the min corner of the bounds is used, as the grid origin
+	AxisBox3<RealType> Bounds = AxisBox3<RealType>::Empty();
+	Vector3<RealType> Point;
+	for (int32_t k = 0; k < MaxPointID; ++k) {
+		if (GetPointFunc(k, Point))
+			Bounds.Contain(Point);
+	}
+	Build(MaxPointID, GetPointFunc, Bounds, CellSizeIn, bParallel);
+}
+
+
+template<typename RealType>
+void GS::PointHashGrid3<RealType>::Build(
+	int32_t MaxPointID,
+	FunctionRef<bool(int, Vector3<RealType>&)> GetPointFunc,
+	const AxisBox3<RealType>& PointBounds,
+	RealType CellSizeIn,
+	bool bParallel)
+{
+	using namespace GSLocal;
+	Clear();
+	gs_debug_assert(CellSizeIn > 0);
+	CellSize = (CellSizeIn > 0) ? CellSizeIn : (RealType)1;
+	InvCellSize = (RealType)1 / CellSize;
+	GridOrigin = (PointBounds.IsValid()) ? PointBounds.Min : Vector3<RealType>::Zero();
+
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+	int32_t NumBlocks = (MaxPointID + HashGridBlockSize - 1) / HashGridBlockSize;
+
+	// fetch points and count valid points per block
+	unsafe_vector<Vector3<RealType>> AllPoints;
+	unsafe_vector<uint8_t> PointValid;
+	unsafe_vector<int32_t> BlockOffsets;
+	AllPoints.resize(MaxPointID);
+	PointValid.resize(MaxPointID);
+	BlockOffsets.resize(NumBlocks + 1);
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * HashGridBlockSize, MaxPointID);
+		int32_t Count = 0;
+		for (int32_t k = (int32_t)BlockIndex * HashGridBlockSize; k < BlockEnd; ++k) {
+			PointValid[k] = GetPointFunc(k, AllPoints[k]) ? 1 : 0;
+			Count += PointValid[k];
+		}
+		BlockOffsets[BlockIndex + 1] = Count;
+	}, Flags);
+	BlockOffsets[0] = 0;
+	for (int32_t b = 0; b < NumBlocks; ++b)
+		BlockOffsets[b + 1] += BlockOffsets[b];
+	int32_t NumPoints = (NumBlocks > 0) ? BlockOffsets[NumBlocks] : 0;
+
+	// table size is the power of two >= NumPoints, so buckets hold about one cell each on average
+	uint32_t NumBuckets = std::bit_ceil((uint32_t)GS::Max(NumPoints, (int32_t)16));
+	BucketMask = NumBuckets - 1;
+	int NumBucketBits = std::countr_zero(NumBuckets);
+
+	// sort keys are (bucket, point ID). Sorting by bucket then ID keeps points in ID order within each bucket.
+	unsafe_vector<uint64_t> SortKeys;
+	SortKeys.resize(NumPoints);
+	double OriginX = (double)GridOrigin.X, OriginY = (double)GridOrigin.Y, OriginZ = (double)GridOrigin.Z;
+	double InvCell = (double)InvCellSize;
+	uint32_t Mask = BucketMask;
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * HashGridBlockSize, MaxPointID);
+		int32_t WriteIndex = BlockOffsets[BlockIndex];
+		for (int32_t k = (int32_t)BlockIndex * HashGridBlockSize; k < BlockEnd; ++k) {
+			if (PointValid[k] == 0)
+				continue;
+			const Vector3<RealType>& P = AllPoints[k];
+			uint32_t Bucket = hash_grid_cell(
+				hash_grid_cell_coord((double)P.X, OriginX, InvCell), hash_grid_cell_coord((double)P.Y, OriginY, InvCell),
+				hash_grid_cell_coord((double)P.Z, OriginZ, InvCell), Mask);
+			SortKeys[WriteIndex++] = ((uint64_t)Bucket << 32) | (uint64_t)k;
+		}
+	}, Flags);
+	PointValid.clear(true);
+	GS::ParallelRadixSortUpper32(SortKeys, NumBucketBits, bParallel);
+
+	// gather sorted IDs and positions, and set bucket starts. Each sorted index writes the starts of the
+	// buckets in (previous bucket, bucket], so writes are disjoint and this can run in parallel.
+	PointIDs.resize(NumPoints);
+	Positions.resize(NumPoints);
+	BucketStarts.resize((size_t)NumBuckets + 1);
+	int32_t NumSortedBlocks = (NumPoints + HashGridBlockSize - 1) / HashGridBlockSize;
+	GS::ParallelFor(NumSortedBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * HashGridBlockSize, NumPoints);
+		for (int32_t i = (int32_t)BlockIndex * HashGridBlockSize; i < BlockEnd; ++i) {
+			int32_t PointID = (int32_t)(SortKeys[i] & 0xFFFFFFFF);
+			PointIDs[i] = PointID;
+			Positions[i] = AllPoints[PointID];
+			int64_t Bucket = (int64_t)(SortKeys[i] >> 32);
+			int64_t PrevBucket = (i > 0) ? (int64_t)(SortKeys[i - 1] >> 32) : -1;
+			for (int64_t b = PrevBucket + 1; b <= Bucket; ++b)
+				BucketStarts[b] = i;
+		}
+	}, Flags);
+	int64_t LastBucket = (NumPoints > 0) ? (int64_t)(SortKeys[NumPoints - 1] >> 32) : -1;
+	for (int64_t b = LastBucket + 1; b <= (int64_t)NumBuckets; ++b)
+		BucketStarts[b] = NumPoints;
+}
+
+
+template<typename RealType>
+void GS::PointHashGrid3<RealType>::enumerate_buckets(
+	const AxisBox3<RealType>& QueryBox,
+	FunctionRef<void(int32_t Start, int32_t End)> RangeFunc) const
+{
+	using namespace GSLocal;
+	int32_t NumPoints = (int32_t)PointIDs.size();
+	if (NumPoints == 0 || QueryBox.IsValid() == false)
+		return;
+
+	double InvCell = (double)InvCellSize;
+	int32_t MinCell[3], MaxCell[3];
+	// the cell count is accumulated in double, as the product of the clamped cell ranges can overflow int64
+	double NumCells = 1;
+	for (int j = 0; j < 3; ++j) {
+		MinCell[j] = hash_grid_cell_coord((double)QueryBox.Min[j], (double)GridOrigin[j], InvCell);
+		MaxCell[j] = hash_grid_cell_coord((double)QueryBox.Max[j], (double)GridOrigin[j], InvCell);
+		NumCells *= (double)((int64_t)MaxCell[j] - (int64_t)MinCell[j] + 1);
+	}
+
+	// if the query covers more cells than there are buckets, it is cheaper to scan all points
+	if (NumCells >= (double)BucketMask + 1)
+	{
+		RangeFunc(0, NumPoints);
+		return;
+	}
+
+	// multiple cells may hash to the same bucket, so collect unique buckets first
+	unsafe_vector<uint32_t> Buckets;
+	Buckets.reserve((size_t)NumCells);
+	for (int32_t z = MinCell[2]; z <= MaxCell[2]; ++z)
+		for (int32_t y = MinCell[1]; y <= MaxCell[1]; ++y)
+			for (int32_t x = MinCell[0]; x <= MaxCell[0]; ++x)
+				Buckets.add(hash_grid_cell(x, y, z, BucketMask));
+	uint32_t* BucketsBuffer = Buckets.raw_pointer();
+	int NumBuckets = (int)Buckets.size();
+	std::sort(BucketsBuffer, BucketsBuffer + NumBuckets);
+	for (int k = 0; k < NumBuckets; ++k)
+	{
+		if (k > 0 && BucketsBuffer[k] == BucketsBuffer[k - 1])
+			continue;
+		int32_t Start = BucketStarts[BucketsBuffer[k]], End = BucketStarts[BucketsBuffer[k] + 1];
+		if (Start < End)
+			RangeFunc(Start, End);
+	}
+}
+
+
+template<typename RealType>
+void GS::PointHashGrid3<RealType>::RadiusQuery(
+	const Vector3<RealType>& Center, RealType Radius,
+	FunctionRef<void(int PointID, RealType DistanceSqr)> PointFunc) const
+{
+	if (Radius < 0)
+		return;
+	RealType RadiusSqr = Radius * Radius;
+	Vector3<RealType> Extent(Radius, Radius, Radius);
+	enumerate_buckets(AxisBox3<RealType>(Center - Extent, Center + Extent), [&](int32_t Start, int32_t End) {
+		for (int32_t i = Start; i < End; ++i) {
+			RealType DistSqr = Positions[i].DistanceSquared(Center);
+			if (DistSqr <= RadiusSqr)
+				PointFunc(PointIDs[i], DistSqr);
+		}
+	});
+}
+
+template<typename RealType>
+int GS::PointHashGrid3<RealType>::RadiusQuery(
+	const Vector3<RealType>& Center, RealType Radius,
+	unsafe_vector<int>& PointIDsOut) const
+{
+	size_t InitialCount = PointIDsOut.size();
+	RadiusQuery(Center, Radius, [&](int PointID, RealType) { PointIDsOut.add(PointID); });
+	return (int)(PointIDsOut.size() - InitialCount);
+}
+
+
+template<typename RealType>
+void GS::PointHashGrid3<RealType>::BoxQuery(
+	const AxisBox3<RealType>& QueryBox,
+	FunctionRef<void(int PointID)> PointFunc) const
+{
+	enumerate_buckets(QueryBox, [&](int32_t Start, int32_t End) {
+		for (int32_t i = Start; i < End; ++i) {
+			const Vector3<RealType>& P = Positions[i];
+			if (P.X >= QueryBox.Min.X && P.X <= QueryBox.Max.X && P.Y >= QueryBox.Min.Y && P.Y <= QueryBox.Max.Y && P.Z >= QueryBox.Min.Z && P.Z <= QueryBox.Max.Z)
+				PointFunc(PointIDs[i]);
+		}
+	});
+}
+
+template<typename RealType>
+int GS::PointHashGrid3<RealType>::BoxQuery(
+	const AxisBox3<RealType>& QueryBox,
+	unsafe_vector<int>& PointIDsOut) const
+{
+	size_t InitialCount = PointIDsOut.size();
+	BoxQuery(QueryBox, [&](int PointID) { PointIDsOut.add(PointID); });
+	return (int)(PointIDsOut.size() - InitialCount);
+}
+
+
+// explicit instantiation
+template class GRADIENTSPACECORE_API GS::PointHashGrid3<float>;
+template class GRADIENTSPACECORE_API GS::PointHashGrid3<double>;
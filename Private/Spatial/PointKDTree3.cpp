@@ -0,0 +1,519 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Spatial/PointKDTree3.h"
+#include "Mesh/DenseMesh.h"
+#include "Core/ParallelFor.h"
+
+#include <algorithm>
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	static constexpr int32_t KDTreeBlockSize = 16 * 1024;
+	// ranges with more points than this are split level-by-level with a parallel loop over the nodes of each level
+	static constexpr int32_t KDTreeParallelSubtreeSize = 16 * 1024;
+	// median splits halve the point count at each level, so the depth is at most ~32 and stacks of this size never overflow
+	static constexpr int KDTreeQueryStackSize = 64;
+	static constexpr int32_t KDTreeQueryBlockSize = 256;
+
+	struct TKDBuildRange
+	{
+		int32_t NodeIndex;
+		int32_t Start;
+		int32_t Count;
+	};
+
+	// choose split axis (largest extent) and partition the range at the median. Returns the split value.
+	template<typename SourcePoint, typename RealType>
+	RealType kd_split_range(SourcePoint* Points, int32_t Start, int32_t Count, int& AxisOut)
+	{
+		Vector3<RealType> Min = Points[Start].Position, Max = Points[Start].Position;
+		for (int32_t i = Start + 1; i < Start + Count; ++i) {
+			const Vector3<RealType>& P = Points[i].Position;
+			for (int j = 0; j < 3; ++j) {
+				Min[j] = GS::Min(Min[j], P[j]);
+				Max[j] = GS::Max(Max[j], P[j]);
+			}
+		}
+		int Axis = 0;
+		if (Max[1] - Min[1] > Max[Axis] - Min[Axis]) Axis = 1;
+		if (Max[2] - Min[2] > Max[Axis] - Min[Axis]) Axis = 2;
+		AxisOut = Axis;
+
+		int32_t Mid = Count / 2;
+		std::nth_element(Points + Start, Points + Start + Mid, Points + Start + Count,
+			[Axis](const SourcePoint& A, const SourcePoint& B) { return A.Position[Axis] < B.Position[Axis]; });
+		return Points[Start + Mid].Position[Axis];
+	}
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::Clear()
+{
+	Nodes.clear(true);
+	Points.clear(true);
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::Build(
+	const_buffer_view<Vector3<RealType>> PointsIn,
+	const PointKDTree3BuildOptions& Options)
+{
+	int32_t NumPoints = (int32_t)PointsIn.size();
+	if (NumPoints == 0) {
+		Clear();
+		return;
+	}
+	const Vector3<RealType>* PointsBuffer = &PointsIn[0];
+	Build(NumPoints, [PointsBuffer](int k, Vector3<RealType>& P) { P = PointsBuffer[k]; return true; }, Options);
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::Build(
+	const DenseMesh& Mesh,
+	const PointKDTree3BuildOptions& Options)
+{
+	Build(Mesh.GetVertexCount(), [&Mesh](int k, Vector3<RealType>& P) { P = (Vector3<RealType>)Mesh.GetPosition(k); return true; }, Options);
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::Build(
+	int32_t MaxPointID,
+	FunctionRef<bool(int, Vector3<RealType>&)> GetPointFunc,
+	const PointKDTree3BuildOptions& Options)
+{
+	using namespace GSLocal;
+	Clear();
+
+	// fetch points in blocks, then compact valid points in ID order
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !Options.bParallel;
+	int32_t NumBlocks = (MaxPointID + KDTreeBlockSize - 1) / KDTreeBlockSize;
+	unsafe_vector<SourcePoint> AllPoints;
+	unsafe_vector<int32_t> BlockOffsets;
+	AllPoints.resize(MaxPointID);
+	BlockOffsets.resize(NumBlocks + 1);
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * KDTreeBlockSize, MaxPointID);
+		int32_t Count = 0;
+		for (int32_t k = (int32_t)BlockIndex * KDTreeBlockSize; k < BlockEnd; ++k) {
+			bool bValid = GetPointFunc(k, AllPoints[k].Position);
+			AllPoints[k].PointID = (bValid) ? k : -1;
+			Count += (bValid) ? 1 : 0;
+		}
+		BlockOffsets[BlockIndex + 1] = Count;
+	}, Flags);
+	BlockOffsets[0] = 0;
+	for (int32_t b = 0; b < NumBlocks; ++b)
+		BlockOffsets[b + 1] += BlockOffsets[b];
+	int32_t NumPoints = BlockOffsets[NumBlocks];
+	if (NumPoints == MaxPointID)
+	{
+		Points = std::move(AllPoints);
+	}
+	else
+	{
+		Points.resize(NumPoints);
+		GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+			int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * KDTreeBlockSize, MaxPointID);
+			int32_t WriteIndex = BlockOffsets[BlockIndex];
+			for (int32_t k = (int32_t)BlockIndex * KDTreeBlockSize; k < BlockEnd; ++k) {
+				if (AllPoints[k].PointID >= 0)
+					Points[WriteIndex++] = AllPoints[k];
+			}
+		}, Flags);
+	}
+
+	build_internal(Options);
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::build_internal(const PointKDTree3BuildOptions& Options)
+{
+	using namespace GSLocal;
+	int32_t NumPoints = (int32_t)Points.size();
+	if (NumPoints == 0)
+		return;
+	int32_t MaxLeafSize = GS::Clamp(Options.MaxLeafSize, 1, 1024);
+	bool bParallel = Options.bParallel;
+	SourcePoint* PointsBuffer = Points.raw_pointer();
+
+	auto MakeLeaf = [](int32_t Start, int32_t Count) {
+		Node Leaf;
+		Leaf.SplitValue = 0;
+		Leaf.Index = Start;
+		Leaf.Axis = -1;
+		Leaf.Count = (uint16_t)Count;
+		return Leaf;
+	};
+
+	// split the top levels of the tree. Child node pairs are allocated serially, and then the splits
+	// of all the nodes in a level are computed in parallel, as they operate on disjoint point ranges.
+	int32_t SubtreeMaxCount = (bParallel) ? GS::Max(KDTreeParallelSubtreeSize, MaxLeafSize) : NumPoints;
+	Nodes.resize(1);
+	unsafe_vector<TKDBuildRange> Level, NextLevel, Subtrees;
+	Level.add(TKDBuildRange{ 0, 0, NumPoints });
+	while (Level.size() > 0)
+	{
+		NextLevel.clear(false);
+		unsafe_vector<TKDBuildRange> SplitRanges;
+		for (const TKDBuildRange& Range : Level)
+		{
+			if (Range.Count <= SubtreeMaxCount)
+				Subtrees.add(Range);
+			else
+				SplitRanges.add(Range);
+		}
+		int32_t NumSplits = (int32_t)SplitRanges.size();
+		if (NumSplits == 0)
+			break;
+		int32_t FirstChild = (int32_t)Nodes.size();
+		Nodes.resize(Nodes.size() + 2 * NumSplits);
+		ParallelForFlags Flags;
+		Flags.bForceSingleThread = !bParallel;
+		GS::ParallelFor(NumSplits, [&](uint32_t k) {
+			const TKDBuildRange& Range = SplitRanges[k];
+			int Axis = 0;
+			RealType SplitValue = kd_split_range<SourcePoint, RealType>(PointsBuffer, Range.Start, Range.Count, Axis);
+			Node& SplitNode = Nodes[Range.NodeIndex];
+			SplitNode.SplitValue = SplitValue;
+			SplitNode.Index = FirstChild + 2 * (int32_t)k;
+			SplitNode.Axis = (int16_t)Axis;
+			SplitNode.Count = 0;
+		}, Flags);
+		for (int32_t k = 0; k < NumSplits; ++k)
+		{
+			const TKDBuildRange& Range = SplitRanges[k];
+			int32_t Mid = Range.Count / 2;
+			NextLevel.add(TKDBuildRange{ FirstChild + 2 * k, Range.Start, Mid });
+			NextLevel.add(TKDBuildRange{ FirstChild + 2 * k + 1, Range.Start + Mid, Range.Count - Mid });
+		}
+		GS::SwapTemp(Level, NextLevel);
+	}
+
+	// build subtrees into local node lists. Local node 0 is the subtree root and child indices are local.
+	int32_t NumSubtrees = (int32_t)Subtrees.size();
+	unsafe_vector<unsafe_vector<Node>> SubtreeNodes;
+	SubtreeNodes.resize(NumSubtrees);
+	auto BuildSubtree = [&](uint32_t SubtreeIndex)
+	{
+		const TKDBuildRange& Root = Subtrees[SubtreeIndex];
+		unsafe_vector<Node>& LocalNodes = SubtreeNodes[SubtreeIndex];
+		LocalNodes.reserve(2 * (Root.Count / MaxLeafSize) + 1);
+		LocalNodes.resize(1);
+		TKDBuildRange Stack[KDTreeQueryStackSize];
+		int StackSize = 0;
+		Stack[StackSize++] = TKDBuildRange{ 0, Root.Start, Root.Count };
+		while (StackSize > 0)
+		{
+			TKDBuildRange Range = Stack[--StackSize];
+			if (Range.Count <= MaxLeafSize) {
+				LocalNodes[Range.NodeIndex] = MakeLeaf(Range.Start, Range.Count);
+				continue;
+			}
+			int Axis = 0;
+			RealType SplitValue = kd_split_range<SourcePoint, RealType>(PointsBuffer, Range.Start, Range.Count, Axis);
+			int32_t ChildIndex = (int32_t)LocalNodes.size();
+			LocalNodes.resize(LocalNodes.size() + 2);
+			Node& SplitNode = LocalNodes[Range.NodeIndex];
+			SplitNode.SplitValue = SplitValue;
+			SplitNode.Index = ChildIndex;
+			SplitNode.Axis = (int16_t)Axis;
+			SplitNode.Count = 0;
+			int32_t Mid = Range.Count / 2;
+			Stack[StackSize++] = TKDBuildRange{ ChildIndex + 1, Range.Start + Mid, Range.Count - Mid };
+			Stack[StackSize++] = TKDBuildRange{ ChildIndex, Range.Start, Mid };
+		}
+	};
+	ParallelForFlags SubtreeFlags;
+	SubtreeFlags.bForceSingleThread = !bParallel;
+	SubtreeFlags.bUnbalanced = true;
+	GS::ParallelFor(NumSubtrees, BuildSubtree, SubtreeFlags);
+
+	// splice subtrees into Nodes. Local root replaces the top-level placeholder node, and the other
+	// local nodes are appended, so local index i > 0 maps to SubtreeOffset + i - 1.
+	unsafe_vector<int32_t> SubtreeOffsets;
+	SubtreeOffsets.resize(NumSubtrees);
+	int32_t TotalNodes = (int32_t)Nodes.size();
+	for (int32_t k = 0; k < NumSubtrees; ++k) {
+		SubtreeOffsets[k] = TotalNodes;
+		TotalNodes += (int32_t)SubtreeNodes[k].size() - 1;
+	}
+	Nodes.resize(TotalNodes);
+	GS::ParallelFor(NumSubtrees, [&](uint32_t k) {
+		const unsafe_vector<Node>& LocalNodes = SubtreeNodes[k];
+		int32_t Offset = SubtreeOffsets[k] - 1;
+		int32_t NumLocal = (int32_t)LocalNodes.size();
+		for (int32_t i = 0; i < NumLocal; ++i) {
+			Node NewNode = LocalNodes[i];
+			if (NewNode.IsLeaf() == false)
+				NewNode.Index += Offset;
+			int32_t GlobalIndex = (i == 0) ? Subtrees[k].NodeIndex : (Offset + i);
+			Nodes[GlobalIndex] = NewNode;
+		}
+	}, SubtreeFlags);
+}
+
+
+
+namespace GSLocal
+{
+	template<typename RealType>
+	struct TKDQueryStackEntry
+	{
+		int32_t NodeIndex;
+		RealType BoundDistSqr;
+	};
+}
+
+
+template<typename RealType>
+DistanceResult3<RealType> GS::PointKDTree3<RealType>::FindNearest(
+	const Vector3<RealType>& QueryPoint,
+	DistanceQueryOptions<RealType> Options) const
+{
+	using namespace GSLocal;
+	DistanceResult3<RealType> Result;
+	if (Nodes.size() == 0)
+		return Result;
+
+	RealType MinDistSqr = Options.MaxDistance * Options.MaxDistance;
+	int32_t NearestIndex = -1;
+
+	TKDQueryStackEntry<RealType> Stack[KDTreeQueryStackSize];
+	int StackSize = 0;
+	Stack[StackSize++] = { 0, (RealType)0 };
+	while (StackSize > 0)
+	{
+		TKDQueryStackEntry<RealType> Entry = Stack[--StackSize];
+		if (Entry.BoundDistSqr > MinDistSqr)
+			continue;
+		const Node* CurNode = &Nodes[Entry.NodeIndex];
+		// descend to the leaf on the query side, pushing the far children
+		while (CurNode->IsLeaf() == false)
+		{
+			RealType Diff = QueryPoint[CurNode->Axis] - CurNode->SplitValue;
+			int32_t NearChild = (Diff < 0) ? CurNode->Index : (CurNode->Index + 1);
+			int32_t FarChild = (Diff < 0) ? (CurNode->Index + 1) : CurNode->Index;
+			RealType FarBound = GS::Max(Entry.BoundDistSqr, Diff * Diff);
+			if (FarBound <= MinDistSqr)
+				Stack[StackSize++] = { FarChild, FarBound };
+			CurNode = &Nodes[NearChild];
+		}
+		const SourcePoint* LeafPoints = &Points[CurNode->Index];
+		for (int j = 0; j < CurNode->Count; ++j) {
+			RealType DistSqr = LeafPoints[j].Position.DistanceSquared(QueryPoint);
+			if (DistSqr <= MinDistSqr && (DistSqr < MinDistSqr || NearestIndex < 0)) {
+				MinDistSqr = DistSqr;
+				NearestIndex = CurNode->Index + j;
+			}
+		}
+	}
+
+	if (NearestIndex >= 0)
+		Result = DistanceResult3<RealType>(Points[NearestIndex].PointID, MinDistSqr, Points[NearestIndex].Position);
+	return Result;
+}
+
+
+template<typename RealType>
+int GS::PointKDTree3<RealType>::FindKNearest(
+	const Vector3<RealType>& QueryPoint, int K,
+	DistanceResult3<RealType>* ResultsOut,
+	DistanceQueryOptions<RealType> Options) const
+{
+	using namespace GSLocal;
+	if (Nodes.size() == 0 || K <= 0)
+		return 0;
+
+	// ResultsOut[0..NumFound) is a max-heap on DistanceSqr, so the current K'th distance is ResultsOut[0]
+	auto HeapLess = [](const DistanceResult3<RealType>& A, const DistanceResult3<RealType>& B) { return A.DistanceSqr < B.DistanceSqr; };
+	RealType MaxDistSqr = Options.MaxDistance * Options.MaxDistance;
+	int NumFound = 0;
+	auto CullDistSqr = [&]() { return (NumFound < K) ? MaxDistSqr : ResultsOut[0].DistanceSqr; };
+
+	TKDQueryStackEntry<RealType> Stack[KDTreeQueryStackSize];
+	int StackSize = 0;
+	Stack[StackSize++] = { 0, (RealType)0 };
+	while (StackSize > 0)
+	{
+		TKDQueryStackEntry<RealType> Entry = Stack[--StackSize];
+		if (Entry.BoundDistSqr > CullDistSqr())
+			continue;
+		const Node* CurNode = &Nodes[Entry.NodeIndex];
+		while (CurNode->IsLeaf() == false)
+		{
+			RealType Diff = QueryPoint[CurNode->Axis] - CurNode->SplitValue;
+			int32_t NearChild = (Diff < 0) ? CurNode->Index : (CurNode->Index + 1);
+			int32_t FarChild = (Diff < 0) ? (CurNode->Index + 1) : CurNode->Index;
+			RealType FarBound = GS::Max(Entry.BoundDistSqr, Diff * Diff);
+			if (FarBound <= CullDistSqr())
+				Stack[StackSize++] = { FarChild, FarBound };
+			CurNode = &Nodes[NearChild];
+		}
+		const SourcePoint* LeafPoints = &Points[CurNode->Index];
+		for (int j = 0; j < CurNode->Count; ++j)
+		{
+			RealType DistSqr = LeafPoints[j].Position.DistanceSquared(QueryPoint);
+			if (NumFound < K) {
+				if (DistSqr <= MaxDistSqr) {
+					ResultsOut[NumFound++] = DistanceResult3<RealType>(LeafPoints[j].PointID, DistSqr, LeafPoints[j].Position);
+					std::push_heap(ResultsOut, ResultsOut + NumFound, HeapLess);
+				}
+			}
+			else if (DistSqr < ResultsOut[0].DistanceSqr) {
+				std::pop_heap(ResultsOut, ResultsOut + K, HeapLess);
+				ResultsOut[K - 1] = DistanceResult3<RealType>(LeafPoints[j].PointID, DistSqr, LeafPoints[j].Position);
+				std::push_heap(ResultsOut, ResultsOut + K, HeapLess);
+			}
+		}
+	}
+
+	std::sort_heap(ResultsOut, ResultsOut + NumFound, HeapLess);
+	return NumFound;
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::FindInRadius(
+	const Vector3<RealType>& QueryPoint, RealType Radius,
+	FunctionRef<void(int PointID, RealType DistanceSqr)> PointFunc) const
+{
+	using namespace GSLocal;
+	if (Nodes.size() == 0 || Radius < 0)
+		return;
+	RealType RadiusSqr = Radius * Radius;
+
+	TKDQueryStackEntry<RealType> Stack[KDTreeQueryStackSize];
+	int StackSize = 0;
+	Stack[StackSize++] = { 0, (RealType)0 };
+	while (StackSize > 0)
+	{
+		TKDQueryStackEntry<RealType> Entry = Stack[--StackSize];
+		const Node& CurNode = Nodes[Entry.NodeIndex];
+		if (CurNode.IsLeaf())
+		{
+			const SourcePoint* LeafPoints = &Points[CurNode.Index];
+			for (int j = 0; j < CurNode.Count; ++j) {
+				RealType DistSqr = LeafPoints[j].Position.DistanceSquared(QueryPoint);
+				if (DistSqr <= RadiusSqr)
+					PointFunc(LeafPoints[j].PointID, DistSqr);
+			}
+			continue;
+		}
+		RealType Diff = QueryPoint[CurNode.Axis] - CurNode.SplitValue;
+		int32_t NearChild = (Diff < 0) ? CurNode.Index : (CurNode.Index + 1);
+		int32_t FarChild = (Diff < 0) ? (CurNode.Index + 1) : CurNode.Index;
+		RealType FarBound = GS::Max(Entry.BoundDistSqr, Diff * Diff);
+		if (FarBound <= RadiusSqr)
+			Stack[StackSize++] = { FarChild, FarBound };
+		Stack[StackSize++] = { NearChild, Entry.BoundDistSqr };
+	}
+}
+
+
+template<typename RealType>
+int GS::PointKDTree3<RealType>::FindInRadius(
+	const Vector3<RealType>& QueryPoint, RealType Radius,
+	unsafe_vector<int>& PointIDsOut) const
+{
+	size_t InitialCount = PointIDsOut.size();
+	FindInRadius(QueryPoint, Radius, [&](int PointID, RealType) { PointIDsOut.add(PointID); });
+	return (int)(PointIDsOut.size() - InitialCount);
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::FindNearestBatch(
+	const_buffer_view<Vector3<RealType>> QueryPoints,
+	unsafe_vector<DistanceResult3<RealType>>& ResultsOut,
+	DistanceQueryOptions<RealType> Options,
+	bool bParallel) const
+{
+	using namespace GSLocal;
+	int32_t NumQueries = (int32_t)QueryPoints.size();
+	ResultsOut.resize(NumQueries);
+	int32_t NumBlocks = (NumQueries + KDTreeQueryBlockSize - 1) / KDTreeQueryBlockSize;
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * KDTreeQueryBlockSize, NumQueries);
+		for (int32_t i = (int32_t)BlockIndex * KDTreeQueryBlockSize; i < BlockEnd; ++i)
+			ResultsOut[i] = FindNearest(QueryPoints[i], Options);
+	}, Flags);
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::FindKNearestBatch(
+	const_buffer_view<Vector3<RealType>> QueryPoints, int K,
+	unsafe_vector<DistanceResult3<RealType>>& ResultsOut,
+	DistanceQueryOptions<RealType> Options,
+	bool bParallel) const
+{
+	using namespace GSLocal;
+	int32_t NumQueries = (int32_t)QueryPoints.size();
+	K = GS::Max(K, 0);
+	ResultsOut.resize((size_t)NumQueries * K);
+	int32_t NumBlocks = (NumQueries + KDTreeQueryBlockSize - 1) / KDTreeQueryBlockSize;
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * KDTreeQueryBlockSize, NumQueries);
+		for (int32_t i = (int32_t)BlockIndex * KDTreeQueryBlockSize; i < BlockEnd; ++i) {
+			DistanceResult3<RealType>* QueryResults = ResultsOut.raw_pointer() + (size_t)i * K;
+			int NumFound = FindKNearest(QueryPoints[i], K, QueryResults, Options);
+			for (int j = NumFound; j < K; ++j)
+				QueryResults[j] = DistanceResult3<RealType>();
+		}
+	}, Flags);
+}
+
+
+template<typename RealType>
+void GS::PointKDTree3<RealType>::FindInRadiusBatch(
+	const_buffer_view<Vector3<RealType>> QueryPoints, RealType Radius,
+	unsafe_vector<int>& OffsetsOut,
+	unsafe_vector<int>& PointIDsOut,
+	bool bParallel) const
+{
+	using namespace GSLocal;
+	int32_t NumQueries = (int32_t)QueryPoints.size();
+	OffsetsOut.resize(NumQueries + 1);
+	int32_t NumBlocks = (NumQueries + KDTreeQueryBlockSize - 1) / KDTreeQueryBlockSize;
+	ParallelForFlags Flags;
+	Flags.bForceSingleThread = !bParallel;
+
+	// count pass, then prefix-sum, then fill pass. This runs the queries twice but avoids per-thread result buffers.
+	OffsetsOut[0] = 0;
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * KDTreeQueryBlockSize, NumQueries);
+		for (int32_t i = (int32_t)BlockIndex * KDTreeQueryBlockSize; i < BlockEnd; ++i) {
+			int Count = 0;
+			FindInRadius(QueryPoints[i], Radius, [&](int, RealType) { Count++; });
+			OffsetsOut[i + 1] = Count;
+		}
+	}, Flags);
+	for (int32_t i = 0; i < NumQueries; ++i)
+		OffsetsOut[i + 1] += OffsetsOut[i];
+
+	PointIDsOut.resize(OffsetsOut[NumQueries]);
+	GS::ParallelFor(NumBlocks, [&](uint32_t BlockIndex) {
+		int32_t BlockEnd = GS::Min(((int32_t)BlockIndex + 1) * KDTreeQueryBlockSize, NumQueries);
+		for (int32_t i = (int32_t)BlockIndex * KDTreeQueryBlockSize; i < BlockEnd; ++i) {
+			int WriteIndex = OffsetsOut[i];
+			FindInRadius(QueryPoints[i], Radius, [&](int PointID, RealType) { PointIDsOut[WriteIndex++] = PointID; });
+		}
+	}, Flags);
+}
+
+
+// explicit instantiation
+template class GRADIENTSPACECORE_API GS::PointKDTree3<float>;
+template class GRADIENTSPACECORE_API GS::PointKDTree3<double>;
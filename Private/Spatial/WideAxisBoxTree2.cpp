@@ -0,0 +1,378 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#include "Spatial/WideAxisBoxTree2.h"
+#include "Core/inline_stack.h"
+
+#include <cmath>
+#include <limits>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GS_WIDE_BOXTREE_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define GS_WIDE_BOXTREE_AVX 1
+#include <immintrin.h>
+#endif
+
+using namespace GS;
+
+
+namespace GSLocal
+{
+	// round to float such that the result is <= / >= the input, so float bounds always contain the source bounds
+	inline float round_down_float(double Value) {
+		float f = (float)Value;
+		return ((double)f > Value) ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+	}
+	inline float round_up_float(double Value) {
+		float f = (float)Value;
+		return ((double)f < Value) ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+	}
+	inline float round_down_float(float Value) { return Value; }
+	inline float round_up_float(float Value) { return Value; }
+
+
+	// returns bitmask with bit k set if child box k contains the point (inclusive)
+	template<int Width>
+	inline uint32_t wide_contains_mask(const float* MinX, const float* MinY, const float* MaxX, const float* MaxY, float PX, float PY)
+	{
+#if defined(GS_WIDE_BOXTREE_AVX)
+		if constexpr (Width == 8)
+		{
+			__m256 X = _mm256_set1_ps(PX), Y = _mm256_set1_ps(PY);
+			__m256 InX = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(MinX), X, _CMP_LE_OQ), _mm256_cmp_ps(X, _mm256_loadu_ps(MaxX), _CMP_LE_OQ));
+			__m256 InY = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(MinY), Y, _CMP_LE_OQ), _mm256_cmp_ps(Y, _mm256_loadu_ps(MaxY), _CMP_LE_OQ));
+			return (uint32_t)_mm256_movemask_ps(_mm256_and_ps(InX, InY));
+		}
+#endif
+		uint32_t Mask = 0;
+#if defined(GS_WIDE_BOXTREE_SSE)
+		__m128 X = _mm_set1_ps(PX), Y = _mm_set1_ps(PY);
+		for (int k = 0; k < Width; k += 4)
+		{
+			__m128 InX = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(MinX + k), X), _mm_cmple_ps(X, _mm_loadu_ps(MaxX + k)));
+			__m128 InY = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(MinY + k), Y), _mm_cmple_ps(Y, _mm_loadu_ps(MaxY + k)));
+			Mask |= (uint32_t)_mm_movemask_ps(_mm_and_ps(InX, InY)) << k;
+		}
+#else
+		for (int k = 0; k < Width; ++k) {
+			if (MinX[k] <= PX && PX <= MaxX[k] && MinY[k] <= PY && PY <= MaxY[k])
+				Mask |= (1u << k);
+		}
+#endif
+		return Mask;
+	}
+
+
+	// computes a lower bound on squared distance from point to each child box. PointEps is subtracted 
+	// from the per-axis distances to account for rounding of the query point to float
+	template<int Width>
+	inline void wide_distance_sqr(const float* MinX, const float* MinY, const float* MaxX, const float* MaxY, 
+		float PX, float PY, float PointEps, float* DistSqrOut)
+	{
+#if defined(GS_WIDE_BOXTREE_AVX)
+		if constexpr (Width == 8)
+		{
+			__m256 X = _mm256_set1_ps(PX), Y = _mm256_set1_ps(PY), Eps = _mm256_set1_ps(PointEps), Zero = _mm256_setzero_ps();
+			__m256 DX = _mm256_max_ps(_mm256_sub_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(MinX), X), _mm256_sub_ps(X, _mm256_loadu_ps(MaxX))), Eps), Zero);
+			__m256 DY = _mm256_max_ps(_mm256_sub_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(MinY), Y), _mm256_sub_ps(Y, _mm256_loadu_ps(MaxY))), Eps), Zero);
+			_mm256_storeu_ps(DistSqrOut, _mm256_add_ps(_mm256_mul_ps(DX, DX), _mm256_mul_ps(DY, DY)));
+			return;
+		}
+#endif
+#if defined(GS_WIDE_BOXTREE_SSE)
+		__m128 X = _mm_set1_ps(PX), Y = _mm_set1_ps(PY), Eps = _mm_set1_ps(PointEps), Zero = _mm_setzero_ps();
+		for (int k = 0; k < Width; k += 4)
+		{
+			__m128 DX = _mm_max_ps(_mm_sub_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(MinX + k), X), _mm_sub_ps(X, _mm_loadu_ps(MaxX + k))), Eps), Zero);
+			__m128 DY = _mm_max_ps(_mm_sub_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(MinY + k), Y), _mm_sub_ps(Y, _mm_loadu_ps(MaxY + k))), Eps), Zero);
+			_mm_storeu_ps(DistSqrOut + k, _mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY)));
+		}
+#else
+		for (int k = 0; k < Width; ++k) {
+			float DX = GS::Max(GS::Max(MinX[k] - PX, PX - MaxX[k]) - PointEps, 0.0f);
+			float DY = GS::Max(GS::Max(MinY[k] - PY, PY - MaxY[k]) - PointEps, 0.0f);
+			DistSqrOut[k] = DX * DX + DY * DY;
+		}
+#endif
+	}
+
+	// float threshold that is >= the given squared distance, to compare against conservative float box distances
+	template<typename RealType>
+	inline float conservative_threshold(RealType DistSqr)
+	{
+		if (DistSqr >= (RealType)FLT_MAX)
+			return std::numeric_limits<float>::infinity();
+		return round_up_float(DistSqr) * (1.0f + 1e-5f);
+	}
+}
+
+
+
+template<typename RealType, int Width>
+void GS::WideAxisBoxTree2<RealType, Width>::Clear()
+{
+	RootIndex = ChildIndex{ 0, 0 };
+	RootBounds = BoxType::Empty();
+	Nodes.clear(true);
+	LeafBoxLists.clear(true);
+}
+
+
+template<typename RealType, int Width>
+void GS::WideAxisBoxTree2<RealType, Width>::Build(const AxisBoxTree2<RealType>& BinaryTree)
+{
+	using namespace GSLocal;
+	using InteriorNode = typename AxisBoxTree2<RealType>::InteriorNode;
+
+	Clear();
+	RootIndex = BinaryTree.RootIndex;
+	RootBounds = BinaryTree.RootBounds;
+	// leaf ranges are unchanged by collapsing, so leaf ChildIndex values can be copied directly
+	LeafBoxLists = BinaryTree.LeafBoxLists;
+	if (RootIndex.LeafCount > 0 || BinaryTree.NodeTree.size() == 0)
+		return;
+
+	struct CollapseJob
+	{
+		uint32_t BinaryNodeIndex;
+		int32_t WideNodeIndex;
+	};
+	struct ChildSlot
+	{
+		ChildIndex Index;
+		BoxType Bounds;
+	};
+
+	Nodes.reserve(BinaryTree.NodeTree.size() / (Width - 1) + 1);
+	Nodes.grow(1);
+	unsafe_vector<CollapseJob> Jobs;
+	Jobs.add(CollapseJob{ RootIndex.Index, 0 });
+	RootIndex = ChildIndex{ 0, 0 };
+
+	CollapseJob Job;
+	while (Jobs.pop_back(Job))
+	{
+		// pull up grandchildren into this node, always expanding the interior child with the largest bounds
+		const InteriorNode& BinaryNode = BinaryTree.NodeTree[Job.BinaryNodeIndex];
+		ChildSlot Slots[Width];
+		Slots[0] = ChildSlot{ BinaryNode.LeftChild, BinaryNode.LeftBounds };
+		Slots[1] = ChildSlot{ BinaryNode.RightChild, BinaryNode.RightBounds };
+		int NumSlots = 2;
+		while (NumSlots < Width)
+		{
+			int ExpandSlot = -1;
+			RealType MaxSize = -1;
+			for (int k = 0; k < NumSlots; ++k) {
+				RealType Size = Slots[k].Bounds.DimensionX() + Slots[k].Bounds.DimensionY();
+				if (Slots[k].Index.LeafCount == 0 && Size > MaxSize) {
+					MaxSize = Size;
+					ExpandSlot = k;
+				}
+			}
+			if (ExpandSlot < 0)
+				break;
+			const InteriorNode& ExpandNode = BinaryTree.NodeTree[Slots[ExpandSlot].Index.Index];
+			Slots[ExpandSlot] = ChildSlot{ ExpandNode.LeftChild, ExpandNode.LeftBounds };
+			Slots[NumSlots++] = ChildSlot{ ExpandNode.RightChild, ExpandNode.RightBounds };
+		}
+
+		WideNode NewNode;
+		for (int k = 0; k < Width; ++k)
+		{
+			if (k >= NumSlots) {
+				NewNode.MinX[k] = NewNode.MinY[k] = std::numeric_limits<float>::infinity();
+				NewNode.MaxX[k] = NewNode.MaxY[k] = -std::numeric_limits<float>::infinity();
+				NewNode.Children[k] = ChildIndex{ 0, 0 };
+				continue;
+			}
+
+			const BoxType& Bounds = Slots[k].Bounds;
+			NewNode.MinX[k] = round_down_float(Bounds.Min.X);
+			NewNode.MinY[k] = round_down_float(Bounds.Min.Y);
+			NewNode.MaxX[k] = round_up_float(Bounds.Max.X);
+			NewNode.MaxY[k] = round_up_float(Bounds.Max.Y);
+
+			if (Slots[k].Index.LeafCount > 0) {
+				NewNode.Children[k] = Slots[k].Index;
+			} else {
+				int32_t NewWideIndex = (int32_t)Nodes.grow(1);
+				NewNode.Children[k] = ChildIndex{ 0, (uint32_t)NewWideIndex };
+				Jobs.add(CollapseJob{ Slots[k].Index.Index, NewWideIndex });
+			}
+		}
+		Nodes[Job.WideNodeIndex] = NewNode;
+	}
+}
+
+
+
+template<typename RealType, int Width>
+int GS::WideAxisBoxTree2<RealType, Width>::PointContainmentQuery(
+	Vector2<RealType> Point,
+	FunctionRef<bool(int)> ElementTestFunc) const
+{
+	if (RootBounds.Contains(Point) == false)
+		return -1;
+
+	// (float conversion is monotonic, so a point inside the source bounds is also inside the outward-rounded float bounds)
+	float PX = (float)Point.X, PY = (float)Point.Y;
+
+	inline_stack<ChildIndex, 64> stack;
+	stack.push_back(RootIndex);
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox2& Box = LeafBoxLists[next.Index + j];
+				if (Box.Box.Contains(Point)) {
+					if (ElementTestFunc(Box.BoxID))
+						return Box.BoxID;
+				}
+			}
+		}
+		else
+		{
+			const WideNode& Node = Nodes[next.Index];
+			uint32_t Mask = GSLocal::wide_contains_mask<Width>(Node.MinX, Node.MinY, Node.MaxX, Node.MaxY, PX, PY);
+			for (int k = 0; Mask != 0; ++k, Mask >>= 1) {
+				if (Mask & 1)
+					stack.push_back(Node.Children[k]);
+			}
+		}
+	}
+	return -1;
+}
+
+
+template<typename RealType, int Width>
+bool GS::WideAxisBoxTree2<RealType, Width>::PointContainmentQuery_FindAll(
+	Vector2<RealType> Point,
+	FunctionRef<bool(int)> ElementTestFunc,
+	FunctionRef<void(int)> FoundElementFunc) const
+{
+	if (RootBounds.Contains(Point) == false)
+		return false;
+
+	float PX = (float)Point.X, PY = (float)Point.Y;
+
+	int NumFound = 0;
+	inline_stack<ChildIndex, 64> stack;
+	stack.push_back(RootIndex);
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox2& Box = LeafBoxLists[next.Index + j];
+				if (Box.Box.Contains(Point)) {
+					if (ElementTestFunc(Box.BoxID)) {
+						FoundElementFunc(Box.BoxID);
+						NumFound++;
+					}
+				}
+			}
+		}
+		else
+		{
+			const WideNode& Node = Nodes[next.Index];
+			uint32_t Mask = GSLocal::wide_contains_mask<Width>(Node.MinX, Node.MinY, Node.MaxX, Node.MaxY, PX, PY);
+			for (int k = 0; Mask != 0; ++k, Mask >>= 1) {
+				if (Mask & 1)
+					stack.push_back(Node.Children[k]);
+			}
+		}
+	}
+	return NumFound > 0;
+}
+
+
+template<typename RealType, int Width>
+DistanceResult2<RealType> GS::WideAxisBoxTree2<RealType, Width>::PointDistanceQuery(
+	Vector2<RealType> QueryPoint,
+	FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+	DistanceQueryOptions<RealType> Options) const
+{
+	using namespace GSLocal;
+
+	struct StackEntry
+	{
+		ChildIndex Index;
+		float DistSqr;
+	};
+
+	RealType MaxDistSqr = Options.MaxDistance * Options.MaxDistance;
+	RealType MinDistSqr = RootBounds.DistanceSquared(QueryPoint);
+	DistanceResult2<RealType> MinDistResult;
+	if (MinDistSqr > MaxDistSqr)
+		return DistanceResult2<RealType>();
+	MinDistSqr = MaxDistSqr;
+	float MinDistSqrThreshold = conservative_threshold(MinDistSqr);
+
+	float PX = (float)QueryPoint.X, PY = (float)QueryPoint.Y;
+	// covers rounding of the query point to float and of the per-axis float subtractions
+	float PointEps = (GS::Abs(PX) + GS::Abs(PY)) * (4.0f * FLT_EPSILON) + FLT_MIN;
+
+	inline_stack<StackEntry, 64> stack;
+	stack.push_back(StackEntry{ RootIndex, 0.0f });
+	StackEntry nextEntry;
+	while (stack.pop_back(nextEntry))
+	{
+		// test again because we may have found a smaller min-distance while this node was on the stack
+		if (nextEntry.DistSqr > MinDistSqrThreshold)
+			continue;
+
+		ChildIndex next = nextEntry.Index;
+		if (next.LeafCount > 0) 
+		{
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox2& Box = LeafBoxLists[next.Index + j];
+				RealType BoxDistSqr = Box.Box.DistanceSquared(QueryPoint);
+				if (BoxDistSqr < MinDistSqr) {
+					DistanceResult2<RealType> ElemDistSqrResult = ElementDistanceSqrFunc(Box.BoxID, QueryPoint);
+					if (ElemDistSqrResult.DistanceSqr < MinDistSqr) {
+						MinDistSqr = ElemDistSqrResult.DistanceSqr;
+						MinDistResult = ElemDistSqrResult;
+						MinDistResult.ElementID = Box.BoxID;
+						MinDistSqrThreshold = conservative_threshold(MinDistSqr);
+					}
+				}
+			}
+		}
+		else
+		{
+			const WideNode& Node = Nodes[next.Index];
+			float ChildDistSqr[Width];
+			wide_distance_sqr<Width>(Node.MinX, Node.MinY, Node.MaxX, Node.MaxY, PX, PY, PointEps, ChildDistSqr);
+
+			// sort active children by decreasing distance, and push in that order so the nearest child is popped first
+			StackEntry Active[Width];
+			int NumActive = 0;
+			for (int k = 0; k < Width; ++k)
+			{
+				if (ChildDistSqr[k] > MinDistSqrThreshold)
+					continue;
+				StackEntry NewEntry{ Node.Children[k], ChildDistSqr[k] };
+				int j = NumActive++;
+				while (j > 0 && Active[j - 1].DistSqr < NewEntry.DistSqr) {
+					Active[j] = Active[j - 1];
+					j--;
+				}
+				Active[j] = NewEntry;
+			}
+			for (int k = 0; k < NumActive; ++k)
+				stack.push_back(Active[k]);
+		}
+	}
+
+	return MinDistResult;
+}
+
+
+// explicit instantiation
+template class GRADIENTSPACECORE_API GS::WideAxisBoxTree2<float, 4>;
+template class GRADIENTSPACECORE_API GS::WideAxisBoxTree2<double, 4>;
+template class GRADIENTSPACECORE_API GS::WideAxisBoxTree2<float, 8>;
+template class GRADIENTSPACECORE_API GS::WideAxisBoxTree2<double, 8>;
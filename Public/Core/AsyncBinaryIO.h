@@ -0,0 +1,143 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/BinaryIO.h"
+#include "Core/GSError.h"
+#include "Core/unsafe_vector.h"
+#include "Core/gs_parallel_api.h"
+
+#include <mutex>
+#include <atomic>
+
+namespace GS
+{
+
+/**
+ * WriteBehindBinaryWriter buffers writes and passes them to a target IBinaryWriter on a
+ * background task (via GS::Parallel::StartTask), so that the caller can continue working while the
+ * data is written. Two buffers are used: when the active buffer is full it is handed to
+ * the background task, and writing continues into the other buffer. The caller only blocks
+ * if the previous buffer is still being written.
+ * 
+ * Flush() starts writing any buffered bytes without waiting. Wait() flushes and blocks until 
+ * all pending writes are complete. Write failures are reported via Wait() (and in the GSErrorSet, if provided).
+ * After a failed write no further data is written, and the failure remains set until ResetWriteFailure() is called.
+ * 
+ * The TargetWriter must not be used directly until Wait() has returned, and must outlive this writer.
+ */
+class GRADIENTSPACECORE_API WriteBehindBinaryWriter : public IBinaryWriter
+{
+public:
+	static constexpr size_t DefaultBufferBytes = 8 * 1024 * 1024;
+
+	WriteBehindBinaryWriter(IBinaryWriter& TargetWriter, size_t BufferBytes = DefaultBufferBytes);
+	~WriteBehindBinaryWriter();
+
+	WriteBehindBinaryWriter(const WriteBehindBinaryWriter&) = delete;
+	WriteBehindBinaryWriter& operator=(const WriteBehindBinaryWriter&) = delete;
+	WriteBehindBinaryWriter(WriteBehindBinaryWriter&&) = delete;
+	WriteBehindBinaryWriter& operator=(WriteBehindBinaryWriter&&) = delete;
+
+	virtual bool WriteBytes(const void* WriteBuffer, size_t ByteCount) override;
+
+	//! start writing any buffered bytes on the background task. Does not wait for the write to complete.
+	bool Flush();
+	//! flush and wait for all pending writes to complete. Returns false if any write failed since the last ResetWriteFailure(),
+	//! and errors that have not been returned by a previous Wait() are appended to ErrorsOut if it is non-null.
+	bool Wait(GSErrorSet* ErrorsOut = nullptr);
+	//! clear a write failure, so that writing can continue. Should only be called after Wait() has returned false.
+	void ResetWriteFailure();
+
+protected:
+	IBinaryWriter& target_writer;
+	size_t buffer_size = 0;
+	unsafe_vector<uint8_t> buffers[2];
+	int active_buffer = 0;
+	size_t active_used = 0;
+
+	TaskContainer write_task;
+	bool write_task_pending = false;
+
+	// set by the background task and read on the calling thread
+	std::atomic<bool> write_failed = false;
+	// set when Wait() has returned a failure, so the destructor does not assert
+	bool write_failure_reported = false;
+	// written by background task, only read after the task completes
+	GSErrorSet task_errors;
+
+	void wait_for_pending_write();
+	void launch_write(int BufferIndex, size_t NumBytes);
+};
+
+
+
+/**
+ * PrefetchBinaryReader reads a source IBinaryReader in fixed-size chunks on background tasks
+ * (via GS::Parallel::StartTask), keeping up to NumPrefetchChunks chunks ahead of the consumer.
+ * Reads start at the current position of the Source reader.
+ * 
+ * Wait() blocks until all in-flight chunk reads complete, and returns false if a read failed 
+ * (errors are appended to ErrorsOut if it is non-null). Reaching the end of the source is not an error.
+ * 
+ * The Source reader must not be used directly while this reader is active, and must outlive it.
+ */
+class GRADIENTSPACECORE_API PrefetchBinaryReader : public IBinaryReader
+{
+public:
+	static constexpr size_t DefaultChunkBytes = 4 * 1024 * 1024;
+
+	PrefetchBinaryReader(IBinaryReader& Source, size_t ChunkBytes = DefaultChunkBytes, int NumPrefetchChunks = 2);
+	~PrefetchBinaryReader();
+
+	PrefetchBinaryReader(const PrefetchBinaryReader&) = delete;
+	PrefetchBinaryReader& operator=(const PrefetchBinaryReader&) = delete;
+	PrefetchBinaryReader(PrefetchBinaryReader&&) = delete;
+	PrefetchBinaryReader& operator=(PrefetchBinaryReader&&) = delete;
+
+	virtual bool IsEndOfFile() const override;
+	//! discards prefetched chunks, repositions the Source reader and restarts prefetching
+	virtual void SetPosition(size_t offset) override;
+	virtual bool ReadBytes(void* ToBuffer, size_t ByteCount) override;
+	virtual size_t ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount) override;
+
+	//! wait for all in-flight chunk reads to complete. Returns false if any read failed.
+	bool Wait(GSErrorSet* ErrorsOut = nullptr);
+
+protected:
+	IBinaryReader& source_reader;
+	size_t chunk_size = 0;
+
+	struct Chunk
+	{
+		unsafe_vector<uint8_t> Data;
+		size_t NumBytes = 0;
+		bool bEndOfSource = false;
+		TaskContainer FetchTask;
+		bool bFetchPending = false;
+	};
+	unsafe_vector<Chunk> chunks;
+
+	// index of the chunk being consumed (in sequence, not slot), and read offset inside that chunk
+	size_t consume_chunk = 0;
+	size_t consume_offset = 0;
+	bool consume_started = false;
+	// next chunk sequence index to launch a fetch task for
+	size_t next_launch_chunk = 0;
+	bool reached_end = false;
+	bool is_eof = false;
+
+	// fetch tasks claim the next chunk sequence index and read from source_reader under this lock
+	std::mutex source_lock;
+	size_t next_fetch_chunk = 0;
+	bool source_exhausted = false;
+	bool read_failed = false;
+	GSErrorSet task_errors;
+
+	void launch_fetches();
+	bool begin_next_chunk();
+	void wait_for_all_fetches();
+};
+
+
+} // end namespace GS
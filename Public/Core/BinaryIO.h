@@ -2,6 +2,7 @@
 #pragma once
 
 #include "GradientspacePlatform.h"
+#include "Core/MemoryMappedFile.h"
 
 #include <istream>
 #include <ostream>
@@ -15,8 +16,15 @@ class GRADIENTSPACECORE_API IBinaryReader
 public:
 	virtual ~IBinaryReader() {}
 	virtual bool IsEndOfFile() const = 0;
-	virtual bool ReadBytes(void* ToBuffer, int ByteCount) = 0;
+	virtual bool ReadBytes(void* ToBuffer, size_t ByteCount) = 0;
 	virtual void SetPosition(size_t offset) = 0;
+
+	//! read up to MaxByteCount bytes, returns the number of bytes read (less than MaxByteCount at end-of-file).
+	//! Default implementation can only report all-or-nothing, readers should override this.
+	virtual size_t ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount)
+	{
+		return ReadBytes(ToBuffer, MaxByteCount) ? MaxByteCount : 0;
+	}
 };
 
 
@@ -27,7 +35,8 @@ public:
 
 	virtual bool IsEndOfFile() const override;
 	virtual void SetPosition(size_t offset) override;
-	virtual bool ReadBytes(void* ToBuffer, int ByteCount) override;
+	virtual bool ReadBytes(void* ToBuffer, size_t ByteCount) override;
+	virtual size_t ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount) override;
 
 protected:
 	std::istream& in_stream;
@@ -50,7 +59,8 @@ public:
 	bool IsOpen() const;
 	void CloseFile();
 
-	virtual bool ReadBytes(void* ToBuffer, int ByteCount) override;
+	virtual bool ReadBytes(void* ToBuffer, size_t ByteCount) override;
+	virtual size_t ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount) override;
 
 protected:
 	FileBinaryReader();		// prevent external construction, only allow opening via static functions
@@ -58,13 +68,55 @@ protected:
 };
 
 
+/**
+ * MappedFileBinaryReader reads from a memory-mapped file (see MemoryMappedFile), which avoids
+ * the intermediate stream buffer of FileBinaryReader. As the read position advances, the next 
+ * ReadAheadBytes of the file are prefetched. MapRange() provides zero-copy access to the file bytes.
+ */
+class GRADIENTSPACECORE_API MappedFileBinaryReader : public IBinaryReader
+{
+public:
+	MappedFileBinaryReader& operator=(MappedFileBinaryReader&& copy) = default;
+	MappedFileBinaryReader(MappedFileBinaryReader&& moved) = default;
+
+	static constexpr size_t DefaultReadAheadBytes = 8 * 1024 * 1024;
+	static MappedFileBinaryReader OpenFile(const std::string& FilePath, size_t ReadAheadBytes = DefaultReadAheadBytes);
+
+	virtual bool IsEndOfFile() const override;
+	virtual void SetPosition(size_t offset) override;
+	virtual bool ReadBytes(void* ToBuffer, size_t ByteCount) override;
+	virtual size_t ReadAvailableBytes(void* ToBuffer, size_t MaxByteCount) override;
+
+	bool operator!() const;
+	bool IsOpen() const;
+	void CloseFile();
+
+	size_t GetPosition() const { return read_position; }
+	size_t GetFileSize() const { return mapped_file.GetSize(); }
+
+	//! returns zero-copy view of file bytes [Offset, Offset+Length), clamped to the file size. View is valid until the file is closed.
+	const_buffer_view<uint8_t> MapRange(size_t Offset, size_t Length) const;
+
+protected:
+	MappedFileBinaryReader();		// prevent external construction, only allow opening via static functions
+	MemoryMappedFile mapped_file;
+	size_t read_position = 0;
+	size_t read_ahead_bytes = DefaultReadAheadBytes;
+	size_t prefetched_until = 0;
+	bool is_eof = false;
+
+	void update_read_ahead();
+};
+
+
+
 
 
 class GRADIENTSPACECORE_API IBinaryWriter
 {
 public:
 	virtual ~IBinaryWriter() {}
-	virtual bool WriteBytes(const void* WriteBuffer, int ByteCount) = 0;
+	virtual bool WriteBytes(const void* WriteBuffer, size_t ByteCount) = 0;
 };
 
 
@@ -73,7 +125,7 @@ class GRADIENTSPACECORE_API StreamBinaryWriter : public IBinaryWriter
 public:
 	StreamBinaryWriter(std::ostream& stream);
 
-	virtual bool WriteBytes(const void* WriteBuffer, int ByteCount) override;
+	virtual bool WriteBytes(const void* WriteBuffer, size_t ByteCount) override;
 
 protected:
 	std::ostream& out_stream;
@@ -92,7 +144,7 @@ public:
 	bool IsOpen() const;
 	void CloseFile();
 
-	virtual bool WriteBytes(const void* WriteBuffer, int ByteCount) override;
+	virtual bool WriteBytes(const void* WriteBuffer, size_t ByteCount) override;
 
 protected:
 	FileBinaryWriter();		// prevent external construction, only allow opening via static functions
@@ -100,5 +152,59 @@ protected:
 };
 
 
+/**
+ * AlignedFileBinaryWriter accumulates writes in a large page-aligned buffer, which is written
+ * to the file in full-buffer chunks. Writes larger than the buffer go directly to the file.
+ * 
+ * If bUseDirectIO is enabled, the file is opened with O_DIRECT (Linux) or FILE_FLAG_NO_BUFFERING (Windows),
+ * which bypasses the OS page cache. In that mode all writes are staged through the aligned buffer,
+ * and the final partial block is padded and the file truncated to the written size on close.
+ */
+class GRADIENTSPACECORE_API AlignedFileBinaryWriter : public IBinaryWriter
+{
+public:
+	~AlignedFileBinaryWriter();
+	AlignedFileBinaryWriter& operator=(AlignedFileBinaryWriter&& moved);
+	AlignedFileBinaryWriter(AlignedFileBinaryWriter&& moved);
+	AlignedFileBinaryWriter(const AlignedFileBinaryWriter& copy) = delete;
+	AlignedFileBinaryWriter& operator=(const AlignedFileBinaryWriter& copy) = delete;
+
+	static constexpr size_t DefaultBufferBytes = 8 * 1024 * 1024;
+	static AlignedFileBinaryWriter OpenFile(const std::string& FilePath, size_t BufferBytes = DefaultBufferBytes, bool bUseDirectIO = false);
+
+	bool operator!() const;
+	bool IsOpen() const;
+	//! write pending buffered bytes and close file. Returns false if any write failed.
+	bool CloseFile();
+
+	virtual bool WriteBytes(const void* WriteBuffer, size_t ByteCount) override;
+
+	//! write any full blocks in the buffer to the file. In direct-IO mode a trailing partial block remains buffered.
+	bool Flush();
+
+	size_t GetNumBytesWritten() const { return total_bytes; }
+
+	//! alignment of buffer and direct-IO write sizes
+	static constexpr size_t BlockAlignment = 4096;
+
+protected:
+	AlignedFileBinaryWriter();		// prevent external construction, only allow opening via static functions
+
+	intptr_t file_handle = -1;
+	uint8_t* buffer = nullptr;
+	size_t buffer_size = 0;
+	size_t buffer_used = 0;
+	size_t total_bytes = 0;
+	bool use_direct_io = false;
+	bool write_failed = false;
+
+	bool write_to_file(const void* Data, size_t NumBytes);
+	bool finish_direct_io_tail();
+	void release();
+	void move_from(AlignedFileBinaryWriter& moved);
+};
+
+
+
 
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+
+#include <atomic>
+#include <utility>
+
+namespace GS
+{
+
+/**
+ * ConcurrentUnionFind is a lock-free disjoint-set forest over the integers [0,NumElements). Union() and Find()
+ * can be called from multiple threads at the same time, parent links are only modified with compare-and-swap.
+ *
+ * Union() always links the root with the larger index to the root with the smaller index, so after all
+ * unions are done, the root of each set is its smallest element. This makes the result independent of the
+ * order of the Union() calls. Find() does path-halving, which is a benign race: a failed CAS just means
+ * another thread already shortened the path.
+ */
+class ConcurrentUnionFind
+{
+public:
+	unsafe_vector<int32_t> Parents;
+
+	//! initialize NumElements singleton sets
+	void Initialize(int NumElements)
+	{
+		Parents.resize(NumElements);
+		for (int k = 0; k < NumElements; ++k)
+			Parents[k] = k;
+	}
+
+	int NumElements() const { return (int)Parents.size(); }
+
+	//! return the root element of the set containing Element
+	int Find(int Element)
+	{
+		while (true)
+		{
+			std::atomic_ref<int32_t> ParentRef(Parents[Element]);
+			int32_t Parent = ParentRef.load(std::memory_order_acquire);
+			if (Parent == Element)
+				return Element;
+			int32_t GrandParent = std::atomic_ref<int32_t>(Parents[Parent]).load(std::memory_order_acquire);
+			if (GrandParent != Parent)
+				ParentRef.compare_exchange_weak(Parent, GrandParent, std::memory_order_acq_rel);
+			Element = GrandParent;
+		}
+	}
+
+	//! return the root element of the set containing Element, without path compression.
+	//! Only safe if no other thread is calling Union().
+	int FindRoot(int Element) const
+	{
+		while (Parents[Element] != Element)
+			Element = Parents[Element];
+		return Element;
+	}
+
+	//! merge the sets containing ElementA and ElementB. Returns true if they were different sets.
+	bool Union(int ElementA, int ElementB)
+	{
+		while (true)
+		{
+			ElementA = Find(ElementA);
+			ElementB = Find(ElementB);
+			if (ElementA == ElementB)
+				return false;
+			if (ElementA > ElementB)
+				std::swap(ElementA, ElementB);
+			// link larger root to smaller root. If this fails, ElementB is no longer a root and we retry.
+			int32_t Expected = ElementB;
+			if (std::atomic_ref<int32_t>(Parents[ElementB]).compare_exchange_strong(Expected, ElementA, std::memory_order_acq_rel))
+				return true;
+		}
+	}
+
+	//! point every element directly at its root. Only safe if no other thread is calling Union().
+	void Flatten()
+	{
+		int N = NumElements();
+		for (int k = 0; k < N; ++k)
+			Parents[k] = Parents[Parents[k]];		// parents have smaller indices than children, so they are already flat
+	}
+};
+
+
+} // end namespace GS
@@ -0,0 +1,115 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/dynamic_buffer.h"
+#include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
+#include "Core/FunctionRef.h"
+
+#include <string>
+#include <string_view>
+
+namespace GS
+{
+
+/**
+ * 128-bit content hash value. Low is equal to the 64-bit hash of the same content.
+ */
+struct GRADIENTSPACECORE_API ContentHash128
+{
+	uint64_t Low = 0;
+	uint64_t High = 0;
+
+	bool operator==(const ContentHash128& Other) const { return Low == Other.Low && High == Other.High; }
+	bool operator!=(const ContentHash128& Other) const { return !(*this == Other); }
+	bool IsZero() const { return Low == 0 && High == 0; }
+
+	//! 32-character lowercase hex string, eg for use as a file name
+	std::string ToHexString() const;
+};
+
+struct ContentHash128Hasher
+{
+	size_t operator()(const ContentHash128& Hash) const { return (size_t)Hash.Low; }
+};
+
+
+/**
+ * ContentHasher computes a fast non-cryptographic hash of a byte stream incrementally.
+ * The 64-bit result is the XXH64 hash of the bytes (with the given Seed), and the 128-bit 
+ * result extends it with a second, independently-finalized 64 bits of the same state.
+ * 
+ * Note that hashing structs will include any padding bytes, so types with padding should be
+ * hashed member-wise to produce stable hashes.
+ */
+class GRADIENTSPACECORE_API ContentHasher
+{
+public:
+	explicit ContentHasher(uint64_t Seed = 0);
+
+	void Reset(uint64_t Seed = 0);
+	void AppendBytes(const void* Data, size_t NumBytes);
+
+	template<typename ValueType>
+	void AppendValue(const ValueType& Value) { AppendBytes(&Value, sizeof(ValueType)); }
+
+	void AppendString(std::string_view String) { 
+		AppendValue<uint64_t>((uint64_t)String.size());
+		AppendBytes(String.data(), String.size()); 
+	}
+	void AppendHash(const ContentHash128& Hash) { AppendValue(Hash.Low); AppendValue(Hash.High); }
+
+	uint64_t Finalize64() const;
+	ContentHash128 Finalize128() const;
+
+protected:
+	uint64_t lanes[4];
+	uint64_t seed = 0;
+	uint64_t total_bytes = 0;
+	uint8_t pending[32];
+	uint32_t num_pending = 0;
+
+	uint64_t finalize(const uint64_t* lane_order, uint64_t seed_offset) const;
+};
+
+
+/**
+ * Compute a 128-bit content hash of NumBytes bytes at Data. Large buffers are split into fixed-size 
+ * chunks that are hashed in parallel, and the chunk hashes are combined. The chunk size is fixed
+ * so the result does not depend on the number of threads.
+ */
+GRADIENTSPACECORE_API
+ContentHash128 ComputeContentHash(const void* Data, size_t NumBytes);
+
+/**
+ * Compute a 128-bit content hash over NumElements elements, where AppendElementsFunc(StartIndex, Count, Hasher)
+ * appends elements [StartIndex, StartIndex+Count) to the hasher. Chunks of elements are hashed in parallel.
+ * This is useful for strided or computed data that cannot be hashed as a single contiguous buffer.
+ */
+GRADIENTSPACECORE_API
+ContentHash128 ComputeContentHash(size_t NumElements, size_t ElementsPerChunk, 
+	FunctionRef<void(size_t StartIndex, size_t Count, ContentHasher& Hasher)> AppendElementsFunc);
+
+
+template<typename ValueType>
+ContentHash128 ComputeContentHash(const_buffer_view<ValueType> Buffer)
+{
+	return (Buffer.size() > 0) ?
+		ComputeContentHash(&Buffer[0], Buffer.size() * sizeof(ValueType)) : ComputeContentHash(nullptr, 0);
+}
+
+template<typename ValueType>
+ContentHash128 ComputeContentHash(const dynamic_buffer<ValueType>& Buffer)
+{
+	return ComputeContentHash(Buffer.get_view());
+}
+
+template<typename ValueType>
+ContentHash128 ComputeContentHash(const unsafe_vector<ValueType>& Buffer)
+{
+	return ComputeContentHash(Buffer.get_view());
+}
+
+
+} // end namespace GS
@@ -0,0 +1,107 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/ContentHash.h"
+#include "Core/FunctionRef.h"
+#include "Core/SharedPointer.h"
+#include "Core/gs_serializer.h"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+
+namespace GS
+{
+
+/**
+ * DerivedDataCache stores serialized results of expensive computations (eg spatial data structures, 
+ * mesh topology, etc) keyed by a ContentHash128 of the inputs and build parameters. 
+ * 
+ * Cached data is held in memory with least-recently-used eviction once MaxMemoryBytes is exceeded.
+ * If a disk cache directory is configured, data is also written to <Directory>/<KeyHex>.gsdd files, and
+ * entries missing from memory are looked up there. Cached objects are stored/restored via ISerializer, 
+ * so any type with Store()/Restore() functions can be cached.
+ * 
+ * All functions are thread-safe. Key construction is the responsibility of the caller, generally
+ * via a static MakeCacheKey() function on the cached type, which should include a type/version identifier.
+ */
+class GRADIENTSPACECORE_API DerivedDataCache
+{
+public:
+	static constexpr size_t DefaultMaxMemoryBytes = 256 * 1024 * 1024;
+
+	explicit DerivedDataCache(size_t MaxMemoryBytes = DefaultMaxMemoryBytes, const std::string& DiskCacheDirectory = std::string());
+
+	DerivedDataCache(const DerivedDataCache&) = delete;
+	DerivedDataCache& operator=(const DerivedDataCache&) = delete;
+
+	//! set the disk cache directory. Directory must already exist. Pass an empty string to disable the disk cache.
+	void SetDiskCacheDirectory(const std::string& DiskCacheDirectory);
+	std::string GetDiskCacheDirectory() const;
+
+	void SetMaxMemoryBytes(size_t MaxMemoryBytes);
+	size_t GetMemoryBytes() const;
+	int GetMemoryEntryCount() const;
+
+	//! if Key is cached, call RestoreFunc with a serializer containing the cached data. Returns false if not found or RestoreFunc returns false.
+	bool Get(const ContentHash128& Key, FunctionRef<bool(ISerializer& Serializer)> RestoreFunc);
+
+	//! serialize data via StoreFunc and add it to the cache under Key, replacing any existing entry
+	bool Put(const ContentHash128& Key, FunctionRef<bool(ISerializer& Serializer)> StoreFunc);
+
+	//! returns true if Key is in the memory cache or the disk cache
+	bool Contains(const ContentHash128& Key) const;
+
+	//! remove Key from the memory cache and the disk cache
+	void Remove(const ContentHash128& Key);
+
+	//! remove all entries from the memory cache. The disk cache is not modified.
+	void ClearMemory();
+
+	/**
+	 * Restore Object from the cache if Key is found, otherwise call BuildFunc() and then store Object in the cache.
+	 * ObjectType must have Store(ISerializer&) const and Restore(ISerializer&) functions.
+	 * @return true if Object was restored from the cache, false if it was built
+	 */
+	template<typename ObjectType, typename BuildFuncType>
+	bool GetOrBuild(const ContentHash128& Key, ObjectType& Object, BuildFuncType&& BuildFunc)
+	{
+		if (Get(Key, [&](ISerializer& Serializer) { return Object.Restore(Serializer); }))
+			return true;
+		BuildFunc();
+		Put(Key, [&](ISerializer& Serializer) { return Object.Store(Serializer); });
+		return false;
+	}
+
+protected:
+	using BlobPtr = SharedPtr<const std::vector<uint8_t>>;
+
+	struct CacheEntry
+	{
+		ContentHash128 Key;
+		BlobPtr Data;
+	};
+
+	mutable std::mutex cache_lock;
+	size_t max_memory_bytes = DefaultMaxMemoryBytes;
+	size_t memory_bytes = 0;
+	std::string disk_directory;
+
+	// most-recently-used entry is at the front
+	std::list<CacheEntry> lru_list;
+	std::unordered_map<ContentHash128, std::list<CacheEntry>::iterator, ContentHash128Hasher> entry_map;
+
+	BlobPtr find_memory(const ContentHash128& Key);
+	void insert_memory(const ContentHash128& Key, BlobPtr Data);
+	void evict_to_limit();
+
+	std::string get_disk_path(const std::string& Directory, const ContentHash128& Key) const;
+	BlobPtr read_disk(const ContentHash128& Key) const;
+	bool write_disk(const ContentHash128& Key, const std::vector<uint8_t>& Data) const;
+};
+
+
+} // end namespace GS
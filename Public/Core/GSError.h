@@ -41,7 +41,10 @@ enum class EGSStandardErrors : uint32_t
 {
 
 	InvalidTopology_MultipleGroupBoundaries,
-	InvalidTopology_DegenerateFace
+	InvalidTopology_DegenerateFace,
+
+	FileIO_WriteFailed,
+	FileIO_ReadFailed
 
 };
 
@@ -0,0 +1,57 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/buffer_view.h"
+
+#include <string>
+
+namespace GS
+{
+
+/**
+ * MemoryMappedFile maps an entire file into the address space as read-only memory.
+ * This uses mmap() on Linux and CreateFileMapping()/MapViewOfFile() on Windows.
+ * Pages are loaded on first access, PrefetchRange() can be used to hint
+ * that a range will be accessed soon (ie read-ahead).
+ */
+class GRADIENTSPACECORE_API MemoryMappedFile
+{
+public:
+	MemoryMappedFile();
+	~MemoryMappedFile();
+	MemoryMappedFile(const MemoryMappedFile& copy) = delete;
+	MemoryMappedFile& operator=(const MemoryMappedFile& copy) = delete;
+	MemoryMappedFile(MemoryMappedFile&& moved);
+	MemoryMappedFile& operator=(MemoryMappedFile&& moved);
+
+	//! map the file at FilePath. Returns false if the file could not be opened or mapped. Empty files open successfully.
+	bool Open(const std::string& FilePath);
+	void Close();
+
+	bool IsOpen() const { return bIsOpen; }
+	size_t GetSize() const { return FileSize; }
+	const uint8_t* GetData() const { return MappedData; }
+
+	//! returns view of the mapped bytes [Offset, Offset+Length), clamped to the file size
+	const_buffer_view<uint8_t> MapRange(size_t Offset, size_t Length) const;
+
+	//! hint to the OS that the given byte range will be accessed soon
+	void PrefetchRange(size_t Offset, size_t Length) const;
+	//! hint to the OS that the file will be read front-to-back
+	void AdviseSequential() const;
+
+protected:
+	const uint8_t* MappedData = nullptr;
+	size_t FileSize = 0;
+	bool bIsOpen = false;
+
+	// platform file handles
+	intptr_t FileHandle = -1;
+	intptr_t MappingHandle = 0;
+
+	void move_from(MemoryMappedFile& moved);
+};
+
+
+} // end namespace GS
@@ -0,0 +1,20 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+
+namespace GS
+{
+
+/**
+ * Stable parallel LSD radix sort of 64-bit keys by bits [32,32+NumKeyBits) of each key, ie by the 
+ * upper 32 bits when NumKeyBits is 32. The lower 32 bits are usually an index or payload, and as the
+ * sort is stable, keys with equal upper bits stay in their input order. Fewer NumKeyBits means fewer passes,
+ * each pass sorts a digit of up to 11 bits by counting digits per block and then scattering blocks in parallel.
+ */
+GRADIENTSPACECORE_API
+void ParallelRadixSortUpper32(unsafe_vector<uint64_t>& Keys, int NumKeyBits = 32, bool bParallel = true);
+
+
+} // end namespace GS
@@ -2,11 +2,13 @@
 #pragma once
 
 #include "GradientspacePlatform.h"
+#include "Core/MemoryMappedFile.h"
 
 #include <istream>
 #include <ostream>
 #include <fstream>
 #include <string>
+#include <string_view>
 
 
 namespace GS
@@ -72,6 +74,9 @@ class GRADIENTSPACECORE_API ITextReader
 public:
 	virtual ~ITextReader() {}
 	virtual bool IsEndOfFile() const = 0;
+	//! copies the next line into ToBuffer as a null-terminated string of at most MaxCount-1 chars. Whether the
+	//! line terminator is included depends on the reader: FileTextReader keeps the '\n' (like fgets), while
+	//! StreamTextReader and MappedTextReader strip it. Callers that parse lines should accept either.
 	virtual bool ReadLine(char* ToBuffer, int MaxCount) = 0;
 };
 
@@ -82,6 +87,7 @@ public:
 	StreamTextReader(std::istream& stream);
 
 	virtual bool IsEndOfFile() const override;
+	//! reads with std::istream::getline(), the '\n' is not included
 	virtual bool ReadLine(char* ToBuffer, int MaxCount) override;
 
 protected:
@@ -103,6 +109,7 @@ public:
 	bool IsOpen() const;
 	void CloseFile();
 
+	//! reads with fgets(), so the '\n' is included if the line fit in ToBuffer
 	virtual bool ReadLine(char* ToBuffer, int MaxCount) override;
 
 protected:
@@ -111,6 +118,43 @@ protected:
 };
 
 
+/**
+ * MappedTextReader reads lines from a memory-mapped file (see MemoryMappedFile). The 
+ * ReadLine(std::string_view&) variant returns views into the mapped file without copying.
+ * Returned lines do not include the line terminator (\n or \r\n). 
+ * GetText() provides the entire file, eg for use with the parallel parsing functions in TextParsing.h
+ */
+class GRADIENTSPACECORE_API MappedTextReader : public ITextReader
+{
+public:
+	MappedTextReader& operator=(MappedTextReader&& copy) = default;
+	MappedTextReader(MappedTextReader&& moved) = default;
+
+	static MappedTextReader OpenFile(const std::string& FilePath);
+
+	virtual bool IsEndOfFile() const override;
+	bool operator!() const;
+	bool IsOpen() const;
+	void CloseFile();
+
+	//! copies next line into ToBuffer (truncated to MaxCount-1 chars), returns false at end of file.
+	//! Unlike FileTextReader, the line terminator is not included.
+	virtual bool ReadLine(char* ToBuffer, int MaxCount) override;
+	//! returns view of next line, valid until the file is closed. Returns false at end of file.
+	bool ReadLine(std::string_view& LineOut);
+
+	//! view of entire file contents, valid until the file is closed
+	std::string_view GetText() const;
+	size_t GetPosition() const { return read_position; }
+	void SetPosition(size_t Position);
+
+protected:
+	MappedTextReader();		// prevent external construction, only allow opening via static functions
+	MemoryMappedFile mapped_file;
+	size_t read_position = 0;
+};
+
+
 
 
 }
@@ -0,0 +1,192 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+#include "Core/FunctionRef.h"
+#include "Core/ParallelFor.h"
+
+#include <string_view>
+#include <charconv>
+
+namespace GS
+{
+
+namespace TextParsing
+{
+	//! returns true for space, tab, \r, \n, \v and \f
+	inline bool IsWhitespace(char c)
+	{
+		// branch-free test against the whitespace characters, all of which are <= 32
+		return (uint8_t)c <= 32 && ((1ull << (uint8_t)c) & ((1ull << ' ') | (1ull << '\t') | (1ull << '\r') | (1ull << '\n') | (1ull << '\v') | (1ull << '\f'))) != 0;
+	}
+}
+
+
+/**
+ * TextTokenizer splits a string_view into whitespace-separated tokens, without copying,
+ * and parses numeric tokens with std::from_chars (locale-independent, no allocations).
+ * 
+ * Typical usage for a line like "v 1.0 2.0 3.0":
+ *    TextTokenizer Tokens(Line);
+ *    std::string_view Type; Vector3d V;
+ *    bool bOK = Tokens.NextToken(Type) && Tokens.ParseDouble(V.X) && Tokens.ParseDouble(V.Y) && Tokens.ParseDouble(V.Z);
+ */
+class TextTokenizer
+{
+public:
+	TextTokenizer() {}
+	explicit TextTokenizer(std::string_view TextIn) : Text(TextIn) {}
+
+	void Reset(std::string_view TextIn) { Text = TextIn; Position = 0; }
+
+	//! returns true if any non-whitespace characters remain
+	bool HasMoreTokens()
+	{
+		skip_whitespace();
+		return Position < Text.size();
+	}
+
+	//! returns the next whitespace-delimited token, or false if there are no more tokens
+	bool NextToken(std::string_view& TokenOut)
+	{
+		skip_whitespace();
+		if (Position >= Text.size()) return false;
+		size_t Start = Position;
+		const char* Data = Text.data();
+		size_t N = Text.size();
+		while (Position < N && !TextParsing::IsWhitespace(Data[Position]))
+			Position++;
+		TokenOut = Text.substr(Start, Position - Start);
+		return true;
+	}
+
+	//! skip the next token, returns false if there are no more tokens
+	bool SkipToken()
+	{
+		std::string_view Unused;
+		return NextToken(Unused);
+	}
+
+	bool ParseDouble(double& ValueOut) { return parse_number(ValueOut); }
+	bool ParseFloat(float& ValueOut) { return parse_number(ValueOut); }
+	bool ParseInt(int& ValueOut) { return parse_number(ValueOut); }
+	bool ParseInt64(int64_t& ValueOut) { return parse_number(ValueOut); }
+
+	//! parse up to MaxCount numbers into ValuesOut, returns the number parsed
+	template<typename NumberType>
+	int ParseNumbers(NumberType* ValuesOut, int MaxCount)
+	{
+		int Count = 0;
+		while (Count < MaxCount && parse_number(ValuesOut[Count]))
+			Count++;
+		return Count;
+	}
+
+	//! remaining unparsed text
+	std::string_view GetRemaining() const { return Text.substr(Position); }
+
+protected:
+	std::string_view Text;
+	size_t Position = 0;
+
+	void skip_whitespace()
+	{
+		const char* Data = Text.data();
+		size_t N = Text.size();
+		while (Position < N && TextParsing::IsWhitespace(Data[Position]))
+			Position++;
+	}
+
+	template<typename NumberType>
+	bool parse_number(NumberType& ValueOut)
+	{
+		skip_whitespace();
+		const char* Begin = Text.data() + Position;
+		const char* End = Text.data() + Text.size();
+		// from_chars does not accept a leading '+'
+		if (Begin < End && *Begin == '+') Begin++;
+		std::from_chars_result Result = std::from_chars(Begin, End, ValueOut);
+		if (Result.ec != std::errc()) return false;
+		// number must be followed by whitespace or end of text, otherwise it is not a numeric token
+		if (Result.ptr < End && !TextParsing::IsWhitespace(*Result.ptr)) return false;
+		Position = (size_t)(Result.ptr - Text.data());
+		return true;
+	}
+};
+
+
+
+namespace TextParsing
+{
+	/**
+	 * Split Text into chunks of approximately TargetChunkBytes, with each chunk boundary placed
+	 * after a newline, so that every chunk contains only complete lines.
+	 */
+	GRADIENTSPACECORE_API
+	void SplitIntoLineChunks(std::string_view Text, size_t TargetChunkBytes, unsafe_vector<std::string_view>& ChunksOut);
+
+	//! call LineFunc for each line in Text, excluding line terminators (\n or \r\n)
+	template<typename LineFuncType>
+	void EnumerateLines(std::string_view Text, LineFuncType LineFunc)
+	{
+		const char* Data = Text.data();
+		size_t N = Text.size(), Position = 0;
+		while (Position < N)
+		{
+			const char* LineEnd = (const char*)memchr(Data + Position, '\n', N - Position);
+			size_t LineLength = (LineEnd != nullptr) ? (size_t)(LineEnd - (Data + Position)) : (N - Position);
+			size_t NextPosition = Position + LineLength + ((LineEnd != nullptr) ? 1 : 0);
+			if (LineLength > 0 && Data[Position + LineLength - 1] == '\r')
+				LineLength--;
+			LineFunc(std::string_view(Data + Position, LineLength));
+			Position = NextPosition;
+		}
+	}
+
+	/**
+	 * Parse the lines of Text in parallel. Text is split into newline-aligned chunks, and the
+	 * lines of each chunk are passed to ParseLineFunc(Line, ChunkElements) on a ParallelFor job, 
+	 * which appends any parsed elements to ChunkElements. The per-chunk results are then 
+	 * concatenated into ElementsOut in the original line order.
+	 */
+	template<typename ElementType>
+	void ParallelParseLines(
+		std::string_view Text,
+		FunctionRef<void(std::string_view Line, unsafe_vector<ElementType>& ChunkElements)> ParseLineFunc,
+		unsafe_vector<ElementType>& ElementsOut,
+		size_t TargetChunkBytes = 4 * 1024 * 1024)
+	{
+		unsafe_vector<std::string_view> Chunks;
+		SplitIntoLineChunks(Text, TargetChunkBytes, Chunks);
+		uint32_t NumChunks = (uint32_t)Chunks.size();
+
+		unsafe_vector<unsafe_vector<ElementType>> ChunkResults;
+		ChunkResults.resize(NumChunks);
+		ParallelFor(NumChunks, [&](uint32_t ChunkIndex)
+		{
+			unsafe_vector<ElementType>& ChunkElements = ChunkResults[ChunkIndex];
+			EnumerateLines(Chunks[ChunkIndex], [&](std::string_view Line) { ParseLineFunc(Line, ChunkElements); });
+		});
+
+		// merge in order
+		unsafe_vector<size_t> ChunkOffsets;
+		ChunkOffsets.resize(NumChunks + 1);
+		ChunkOffsets[0] = 0;
+		for (uint32_t k = 0; k < NumChunks; ++k)
+			ChunkOffsets[k+1] = ChunkOffsets[k] + ChunkResults[k].size();
+
+		size_t StartSize = ElementsOut.size();
+		ElementsOut.resize(StartSize + ChunkOffsets[NumChunks]);
+		ParallelFor(NumChunks, [&](uint32_t ChunkIndex)
+		{
+			const unsafe_vector<ElementType>& ChunkElements = ChunkResults[ChunkIndex];
+			size_t Offset = StartSize + ChunkOffsets[ChunkIndex];
+			for (size_t j = 0; j < ChunkElements.size(); ++j)
+				ElementsOut[Offset + j] = ChunkElements[j];
+		});
+	}
+}
+
+
+} // end namespace GS
@@ -3,6 +3,7 @@
 
 #include "GradientspacePlatform.h"
 #include "Core/gs_debug.h"
+#include <type_traits>
 
 namespace GS
 {
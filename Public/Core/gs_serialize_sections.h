@@ -0,0 +1,76 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/gs_serializer.h"
+#include "Core/unsafe_vector.h"
+#include "Core/FunctionRef.h"
+
+namespace GS
+{
+
+/**
+ * SerializeSectionDirectory stores an object as a set of independent sections (eg the
+ * per-attribute buffers of a mesh), with a section directory written at the head. Each
+ * section is stored as a single sized data block, containing a nested MemorySerializer stream.
+ * 
+ * On Restore, the caller selects a subset of sections via a bitmask. Unrequested sections are
+ * skipped via ISerializer::SkipData(), which does not touch the section bytes if the
+ * Serializer supports seeking. In that case the read position of each skipped section is 
+ * also recorded, so that it can be restored later (eg on first access) via RestoreDeferredSections().
+ * 
+ * SectionIDs are single-bit flags, so at most 32 sections can be stored.
+ */
+class GRADIENTSPACECORE_API SerializeSectionDirectory
+{
+public:
+	using SectionFunc = FunctionRef<bool(uint32_t SectionID, GS::ISerializer& SectionSerializer)>;
+
+	struct Section
+	{
+		uint32_t SectionID = 0;
+		bool bRestored = false;
+		bool bDeferred = false;
+		size_t ReadPosition = 0;
+	};
+	unsafe_vector<Section> Sections;
+
+	void Reset() { Sections.clear(); }
+
+	//! write section directory and then each section in order
+	static bool StoreSections(
+		GS::ISerializer& Serializer,
+		const uint32_t* SectionIDs, int NumSections,
+		SectionFunc StoreSectionFunc);
+
+	//! read the section directory and all sections. Sections included in RequestedSections are passed to RestoreSectionFunc,
+	//! others are skipped. If bAllowDeferred is true and the Serializer supports seeking, the skipped sections can be
+	//! restored later via RestoreDeferredSections(), with the same Serializer.
+	bool RestoreSections(
+		GS::ISerializer& Serializer,
+		uint32_t RequestedSections,
+		bool bAllowDeferred,
+		SectionFunc RestoreSectionFunc);
+
+	//! restore previously-deferred sections included in RequestedSections. Serializer must be the same
+	//! stream passed to RestoreSections(). Its read position is restored before returning.
+	bool RestoreDeferredSections(
+		GS::ISerializer& Serializer,
+		uint32_t RequestedSections,
+		SectionFunc RestoreSectionFunc);
+
+	//! bitmask of sections present in the stored object
+	uint32_t GetStoredSections() const;
+	//! bitmask of sections that have been restored
+	uint32_t GetRestoredSections() const;
+	//! bitmask of sections that were skipped but can still be restored via RestoreDeferredSections()
+	uint32_t GetDeferredSections() const;
+
+	static constexpr const char* SerializeVersionString() { return "SectionDirectory_Version"; }
+
+protected:
+	static bool read_section(GS::ISerializer& Serializer, Section& SectionInfo, bool bRestore, SectionFunc RestoreSectionFunc);
+};
+
+
+} // end namespace GS
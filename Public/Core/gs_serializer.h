@@ -45,6 +45,15 @@ public:
 	virtual bool WriteData(const char* key, const void* buffer, size_t num_bytes) = 0;
 	virtual bool ReadData(const char* key, size_t num_bytes, void* buffer) = 0;
 
+	//! skip over the next data block, which must have been written via WriteData(key, ..., num_bytes). 
+	//! Default implementation reads the data into a temporary buffer, seekable serializers should override.
+	virtual bool SkipData(const char* key, size_t num_bytes);
+
+	//! Serializers that support random-access reads return true here and implement Get/SetReadPosition()
+	virtual bool SupportsSeek() const { return false; }
+	virtual size_t GetReadPosition() const { return 0; }
+	virtual bool SetReadPosition([[maybe_unused]] size_t Position) { return false; }
+
 	virtual bool WriteBoolean(const char* key, bool bValue);
 	virtual bool ReadBoolean(const char* key, bool& bValue);
 
@@ -75,6 +84,11 @@ public:
 
 	virtual bool WriteData(const char* key, const void* buffer, size_t num_bytes) override;
 	virtual bool ReadData(const char* Key, size_t num_bytes, void* buffer) override;
+	virtual bool SkipData(const char* key, size_t num_bytes) override;
+
+	virtual bool SupportsSeek() const override { return is_reading; }
+	virtual size_t GetReadPosition() const override { return read_index; }
+	virtual bool SetReadPosition(size_t Position) override;
 
 	void BeginWrite();
 	void BeginRead();
@@ -90,13 +104,16 @@ public:
 	// todo some way to take ownership of buffer memory? can't really do with std::vector...
 
 protected:
+	// parse key/length header of next record, returns pointer to record data, or nullptr on failure
+	const uint8_t* read_record_header(const char* key, size_t num_bytes);
+
 	// use dynamic_buffer or unsafe_vector here?
 	std::vector<uint8_t> data;
 
 	bool validate_keys = true;
 	bool is_reading = false;
 
-	size_t read_index;
+	size_t read_index = 0;
 };
 
 
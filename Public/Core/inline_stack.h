@@ -0,0 +1,98 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/gs_debug.h"
+
+#include <type_traits>
+
+namespace GS
+{
+
+/**
+ * inline_stack<T,N> is a LIFO stack for depth-first traversals. The first N values are stored
+ * in inline memory (ie on the call stack if the inline_stack is a local variable), so no memory is
+ * allocated unless more than N values are pushed. In that case all values are moved to a heap buffer,
+ * which is used until the inline_stack is destroyed or clear(true) is called.
+ *
+ * ValueType must be trivially copyable, values are copied with assignment and never destructed.
+ */
+template<typename ValueType, int InlineCapacity>
+class inline_stack
+{
+	static_assert(std::is_trivially_copyable_v<ValueType>, "inline_stack requires a trivially copyable ValueType");
+	static_assert(InlineCapacity > 0);
+
+protected:
+	alignas(ValueType) unsigned char m_inline_storage[sizeof(ValueType) * InlineCapacity];
+	ValueType* m_values = nullptr;
+	ValueType* m_heap_values = nullptr;
+	int m_size = 0;
+	int m_capacity = InlineCapacity;
+
+public:
+	inline_stack() {
+		m_values = reinterpret_cast<ValueType*>(m_inline_storage);
+	}
+	~inline_stack() {
+		delete[] m_heap_values;
+	}
+
+	inline_stack(const inline_stack&) = delete;
+	inline_stack(inline_stack&&) = delete;
+	inline_stack& operator=(const inline_stack&) = delete;
+	inline_stack& operator=(inline_stack&&) = delete;
+
+	int size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	//! true if values have been moved to the heap buffer
+	bool is_heap_allocated() const { return m_heap_values != nullptr; }
+
+	void push_back(const ValueType& Value)
+	{
+		if (m_size == m_capacity)
+			grow();
+		m_values[m_size++] = Value;
+	}
+
+	//! remove the last value and return it in Out. Returns false if the stack is empty.
+	bool pop_back(ValueType& Out)
+	{
+		if (m_size == 0) return false;
+		Out = m_values[--m_size];
+		return true;
+	}
+
+	ValueType& back() {
+		gs_debug_assert(m_size > 0);
+		return m_values[m_size - 1];
+	}
+
+	//! remove all values. If bFreeMemory is true, the heap buffer is released and inline storage is used again.
+	void clear(bool bFreeMemory = false)
+	{
+		m_size = 0;
+		if (bFreeMemory && m_heap_values != nullptr) {
+			delete[] m_heap_values;
+			m_heap_values = nullptr;
+			m_values = reinterpret_cast<ValueType*>(m_inline_storage);
+			m_capacity = InlineCapacity;
+		}
+	}
+
+protected:
+	void grow()
+	{
+		int new_capacity = 2 * m_capacity;
+		ValueType* new_values = new ValueType[new_capacity];
+		for (int k = 0; k < m_size; ++k)
+			new_values[k] = m_values[k];
+		delete[] m_heap_values;
+		m_heap_values = new_values;
+		m_values = new_values;
+		m_capacity = new_capacity;
+	}
+};
+
+
+} // end namespace GS
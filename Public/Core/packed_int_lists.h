@@ -4,6 +4,7 @@
 #include "GradientspacePlatform.h"
 #include "Core/unsafe_vector.h"
 #include "Core/buffer_view.h"
+#include "Core/gs_serializer.h"
 
 
 namespace GS
@@ -12,13 +13,15 @@ namespace GS
 /**
  * packed_int_lists stores a list of small lists of integers, useful for (eg) storing neighbourhood information
  * in static index-based data structures like meshes. For example the one-ring triangle neighbours of a vertex, etc.
- * The data structure is meant to be constructed and then queried, it cannot be dynamically modified.
+ * The data structure is meant to be constructed and then queried, but lists can be replaced (see below).
  * Each list is added via a call to AppendList(), which appends the provided set of items.
  *
  * There are two usage modes: 
  *  1) call Initialize() to set a fixed # of lists, and then AppendList with a specified ListID (index)
  *  2) call AppendList() without a ListID to append a new list (ie resize) and then return the new ListID
  * 
+ * Lists can be edited after construction with ReplaceList()/RemoveList(). Shrinking lists are rewritten in place,
+ * growing lists are appended, and the storage they no longer use is counted in NumUnusedElements until Compact().
  */
 class GRADIENTSPACECORE_API packed_int_lists
 {
@@ -27,10 +30,15 @@ public:
 	unsafe_vector<int> ListPointers;
 	// sequential packed lists, each list starts with list size and then elements
 	unsafe_vector<int> PackedLists;
+	// number of elements in PackedLists that are not part of any list, after ReplaceList()/RemoveList(). Not serialized.
+	int64_t NumUnusedElements = 0;
 
 	int NumLists() const { return (int)ListPointers.size(); }
 	int64_t NumListElements() const { return PackedLists.size(); }
 
+	//! remove all lists and free memory
+	void Clear() { ListPointers.clear(true); PackedLists.clear(true); NumUnusedElements = 0; }
+
 	//! initialize with a fixed number of known ListIDs
 	void Initialize(int NumListIDs, int ListSizeEstimate = 0, size_t KnownExactTotalListItems = 0);
 
@@ -43,6 +51,19 @@ public:
 	//! append a (non-empty) list at a new ListID. returns new ListID, or -1 on invalid input.
 	int AppendList(int NumItems, const int* Items);
 
+	//! replace the list at ListID with Items (which may be empty, to remove the list). The list is rewritten
+	//! in place if Items fits in its current storage, otherwise it is appended to PackedLists.
+	void ReplaceList(int ListID, const_buffer_view<int> Items);
+
+	//! remove the list at ListID, if it exists
+	void RemoveList(int ListID);
+
+	//! increase the number of lists to NumListIDs, new lists are empty
+	void GrowLists(int NumListIDs);
+
+	//! rewrite PackedLists in ListID order without unused storage. ListIDs are unchanged.
+	void Compact();
+
 	bool HasList(int ListID) const { return ListPointers[ListID] >= 0; }
 
 	int GetListSizeUnsafe(int ListID) const { 
@@ -60,6 +81,11 @@ public:
 	}
 
 	const_buffer_view<int> GetListView(int ListID) const;
+
+	//! custom_key is prepended to the data keys of the stored buffers, if non-null
+	bool Store(GS::ISerializer& Serializer, const char* custom_key = nullptr) const;
+	bool Restore(GS::ISerializer& Serializer, const char* custom_key = nullptr);
+	constexpr const char* SerializeVersionString() const { return "packed_int_lists_Version"; }
 };
 
 
@@ -0,0 +1,106 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+#include "Core/gs_debug.h"
+
+namespace GS
+{
+
+/**
+ * refcount_vector tracks a set of integer IDs with per-ID reference counts, for example the vertex, edge and
+ * triangle IDs of a dynamic mesh. An ID is valid while its refcount is positive. When the refcount of an ID
+ * goes to zero, the ID is added to a free list and is returned by a later allocate(), so the range of
+ * IDs [0,max_index()) stays compact as elements are removed and added.
+ */
+class refcount_vector
+{
+private:
+	unsafe_vector<int32_t> m_refcounts;
+	unsafe_vector<int32_t> m_free_indices;
+	int32_t m_used_count = 0;
+
+public:
+	//! number of valid IDs
+	int count() const { return m_used_count; }
+	//! upper bound of the valid IDs, all valid IDs are in the range [0,max_index())
+	int max_index() const { return (int)m_refcounts.size(); }
+	bool is_dense() const { return m_free_indices.size() == 0; }
+
+	bool is_valid(int index) const {
+		return index >= 0 && index < (int)m_refcounts.size() && m_refcounts[index] > 0;
+	}
+	bool is_valid_unsafe(int index) const {
+		return m_refcounts[index] > 0;
+	}
+	int refcount(int index) const {
+		return (index >= 0 && index < (int)m_refcounts.size()) ? m_refcounts[index] : 0;
+	}
+
+	//! allocate an ID with refcount 1, reusing a free ID if available
+	int allocate()
+	{
+		m_used_count++;
+		int32_t index = 0;
+		while (m_free_indices.pop_back(index)) {
+			// free list may contain IDs that were re-allocated via allocate_at()
+			if (m_refcounts[index] == 0) {
+				m_refcounts[index] = 1;
+				return index;
+			}
+		}
+		return (int)m_refcounts.add(1);
+	}
+
+	//! allocate a specific ID with refcount 1. Returns false if the ID is already in use.
+	bool allocate_at(int index)
+	{
+		if (index < (int)m_refcounts.size() && m_refcounts[index] > 0)
+			return false;
+		while ((int)m_refcounts.size() <= index) {
+			m_refcounts.add(0);
+			if ((int)m_refcounts.size() <= index)
+				m_free_indices.add((int32_t)m_refcounts.size() - 1);
+		}
+		m_refcounts[index] = 1;
+		m_used_count++;
+		return true;
+	}
+
+	int increment(int index, int increment_by = 1)
+	{
+		gs_debug_assert(m_refcounts[index] > 0);
+		m_refcounts[index] += increment_by;
+		return m_refcounts[index];
+	}
+
+	//! decrement the refcount of index, and free it if the refcount reaches zero
+	int decrement(int index, int decrement_by = 1)
+	{
+		gs_debug_assert(m_refcounts[index] >= decrement_by);
+		m_refcounts[index] -= decrement_by;
+		if (m_refcounts[index] == 0) {
+			m_free_indices.add(index);
+			m_used_count--;
+		}
+		return m_refcounts[index];
+	}
+
+	//! set the refcount of a valid index directly
+	void set_refcount(int index, int new_refcount)
+	{
+		gs_debug_assert(m_refcounts[index] > 0 && new_refcount > 0);
+		m_refcounts[index] = new_refcount;
+	}
+
+	void clear(bool free_memory = true)
+	{
+		m_refcounts.clear(free_memory);
+		m_free_indices.clear(free_memory);
+		m_used_count = 0;
+	}
+};
+
+
+} // end namespace GS
@@ -666,9 +666,7 @@ bool unsafe_vector<ValueType>::Restore(GS::ISerializer& Serializer, const char*
 	bOK = bOK && Serializer.ReadValue("Length", length);
 	if (bOK && length == 0)
 	{
-		m_length = 0;
-		m_allocated_length = 0;
-		m_storage = nullptr;
+		clear(true);
 		return true;
 	}
 
@@ -0,0 +1,91 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
+#include "Math/GSRay3.h"
+#include "Math/GSAxisBox3.h"
+#include "Intersection/GSRayBoxIntersection.h"
+
+namespace GS
+{
+
+/**
+ * RayBatch stores a set of rays for batched queries (eg picking or occlusion rays), in the source
+ * double-precision form and as float SoA lanes prepared for TestRayWideBoxIntersection / TestRayPacketBoxIntersection.
+ *
+ * Rays can optionally be reordered for coherence (by direction octant, then direction and origin),
+ * so that consecutive rays form packets that traverse similar paths through a BVH or grid.
+ * SourceIndices maps batch order back to the input order, batched queries return results in input order.
+ */
+class GRADIENTSPACECORE_API RayBatch
+{
+public:
+	//! rays in batch order
+	unsafe_vector<Ray3d> Rays;
+	//! maximum ray parameter for each ray, in batch order
+	unsafe_vector<double> MaxDistances;
+	//! index in the input list of each ray in batch order
+	unsafe_vector<int32_t> SourceIndices;
+
+	//! float SoA copies of Rays, with safe inverse directions (see PreparedRay3f)
+	unsafe_vector<float> OriginX, OriginY, OriginZ;
+	unsafe_vector<float> InvDirX, InvDirY, InvDirZ;
+
+	//! bounds of all ray origins
+	AxisBox3d OriginBounds = AxisBox3d::Empty();
+
+	//! initialize with all rays limited to MaxDistance. If bSortForCoherence is true, rays are reordered.
+	void Initialize(const_buffer_view<Ray3d> InputRays, double MaxDistance = Mathd::SafeMaxValue(), bool bSortForCoherence = true);
+	//! initialize with a per-ray MaxDistance. If bSortForCoherence is true, rays are reordered.
+	void Initialize(const_buffer_view<Ray3d> InputRays, const_buffer_view<double> InputMaxDistances, bool bSortForCoherence = true);
+
+	void Clear();
+
+	int GetRayCount() const { return (int)Rays.size(); }
+
+	//! number of packets of size Width needed to cover all rays. The last packet may be partial.
+	int GetPacketCount(int Width) const { return (GetRayCount() + Width - 1) / Width; }
+
+	PreparedRay3f GetPreparedRay(int RayIndex) const
+	{
+		PreparedRay3f Result;
+		Result.Origin[0] = OriginX[RayIndex]; Result.Origin[1] = OriginY[RayIndex]; Result.Origin[2] = OriginZ[RayIndex];
+		Result.InvDirection[0] = InvDirX[RayIndex]; Result.InvDirection[1] = InvDirY[RayIndex]; Result.InvDirection[2] = InvDirZ[RayIndex];
+		return Result;
+	}
+
+	//! fill PacketOut with rays [PacketIndex*Width, (PacketIndex+1)*Width). Returns mask of active lanes, lanes past the end of the batch are inactive.
+	template<int Width>
+	uint32_t GetPacket(int PacketIndex, RayPacket3f<Width>& PacketOut) const
+	{
+		int Start = PacketIndex * Width;
+		int NumRays = GetRayCount();
+		uint32_t ActiveMask = 0;
+		for (int k = 0; k < Width; ++k)
+		{
+			int RayIndex = Start + k;
+			if (RayIndex < NumRays) {
+				PacketOut.SetRay(k, GetPreparedRay(RayIndex), to_float_distance(MaxDistances[RayIndex]));
+				ActiveMask |= (1u << k);
+			}
+			else
+				PacketOut.SetInactive(k);
+		}
+		return ActiveMask;
+	}
+
+	//! convert a ray distance to float, rounding up so that float culling is conservative
+	static float to_float_distance(double Distance)
+	{
+		float f = (float)Distance;
+		return ((double)f < Distance) ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+	}
+
+protected:
+	void initialize_internal(const_buffer_view<Ray3d> InputRays, const double* InputMaxDistances, double ConstantMaxDistance, bool bSortForCoherence);
+};
+
+
+}
@@ -4,6 +4,9 @@
 #include "Math/GSRay3.h"
 #include "Math/GSAxisBox3.h"
 
+#include <cmath>
+#include <limits>
+
 namespace GS
 {
 
@@ -16,4 +19,132 @@ GRADIENTSPACECORE_API
 bool ComputeRayBoxIntersection(const Ray3d& Ray, const GS::AxisBox3d& Box, double& RayParameterOut, Vector3d& HitPositionOut, Vector3d& CellFaceNormalOut);
 
 
+
+//
+// Vectorized ray/box tests. These use float SoA layouts so that 4 (SSE) or 8 (AVX, or 2x SSE) boxes or rays
+// are tested at once. Box bounds should be rounded outwards when converted to float (SetBox() does this),
+// and the far slab distance is padded by a rounding-error bound, so the tests are conservative for culling.
+//
+
+/**
+ * Ray prepared for repeated float box tests. Zero (or denormal) direction components are replaced by a
+ * large finite inverse, so that rays lying in a slab plane do not produce 0*inf NaNs.
+ */
+struct PreparedRay3f
+{
+	float Origin[3];
+	float InvDirection[3];
+
+	PreparedRay3f() {}
+
+	template<typename RealType>
+	explicit PreparedRay3f(const Ray3<RealType>& Ray)
+	{
+		for (int k = 0; k < 3; ++k) {
+			Origin[k] = (float)Ray.Origin[k];
+			InvDirection[k] = SafeInverse((float)Ray.Direction[k]);
+		}
+	}
+
+	static float SafeInverse(float DirectionValue)
+	{
+		return (std::abs(DirectionValue) > 1e-30f) ? (1.0f / DirectionValue) : std::copysign(1e30f, DirectionValue);
+	}
+};
+
+
+/**
+ * Width float boxes in SoA layout. Empty lanes have Min=+inf and Max=-inf and are never hit.
+ */
+template<int Width>
+struct WideAxisBox3f
+{
+	static_assert(Width == 4 || Width == 8, "WideAxisBox3f supports 4 or 8 lanes");
+
+	float MinX[Width];
+	float MinY[Width];
+	float MinZ[Width];
+	float MaxX[Width];
+	float MaxY[Width];
+	float MaxZ[Width];
+
+	void SetEmpty(int Lane)
+	{
+		MinX[Lane] = MinY[Lane] = MinZ[Lane] = std::numeric_limits<float>::infinity();
+		MaxX[Lane] = MaxY[Lane] = MaxZ[Lane] = -std::numeric_limits<float>::infinity();
+	}
+	void SetAllEmpty()
+	{
+		for (int k = 0; k < Width; ++k)
+			SetEmpty(k);
+	}
+
+	//! set lane box, rounding double bounds outwards so that the float box contains Box
+	template<typename RealType>
+	void SetBox(int Lane, const AxisBox3<RealType>& Box)
+	{
+		MinX[Lane] = round_down(Box.Min.X); MinY[Lane] = round_down(Box.Min.Y); MinZ[Lane] = round_down(Box.Min.Z);
+		MaxX[Lane] = round_up(Box.Max.X); MaxY[Lane] = round_up(Box.Max.Y); MaxZ[Lane] = round_up(Box.Max.Z);
+	}
+
+	static float round_down(double Value) {
+		float f = (float)Value;
+		return ((double)f > Value) ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+	}
+	static float round_up(double Value) {
+		float f = (float)Value;
+		return ((double)f < Value) ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+	}
+};
+
+
+/**
+ * Packet of Width rays in SoA layout, for testing coherent rays against a single box.
+ * Inactive lanes should have MaxDistance < 0 (or be excluded via the active-lane mask).
+ */
+template<int Width>
+struct RayPacket3f
+{
+	static_assert(Width == 4 || Width == 8, "RayPacket3f supports 4 or 8 lanes");
+
+	float OriginX[Width];
+	float OriginY[Width];
+	float OriginZ[Width];
+	float InvDirX[Width];
+	float InvDirY[Width];
+	float InvDirZ[Width];
+	float MaxDistance[Width];
+
+	void SetRay(int Lane, const PreparedRay3f& Ray, float MaxDist)
+	{
+		OriginX[Lane] = Ray.Origin[0]; OriginY[Lane] = Ray.Origin[1]; OriginZ[Lane] = Ray.Origin[2];
+		InvDirX[Lane] = Ray.InvDirection[0]; InvDirY[Lane] = Ray.InvDirection[1]; InvDirZ[Lane] = Ray.InvDirection[2];
+		MaxDistance[Lane] = MaxDist;
+	}
+	void SetInactive(int Lane)
+	{
+		OriginX[Lane] = OriginY[Lane] = OriginZ[Lane] = 0;
+		InvDirX[Lane] = InvDirY[Lane] = InvDirZ[Lane] = 1.0f;
+		MaxDistance[Lane] = -1.0f;
+	}
+};
+
+
+//! Test Ray against the Width boxes, in parameter range [0,MaxDistance]. Returns a bitmask with bit k set if box k is hit.
+//! If EntryDistOut is non-null, EntryDistOut[k] is set to the entry parameter for each lane (0 if the origin is inside the box).
+template<int Width>
+uint32_t TestRayWideBoxIntersection(const PreparedRay3f& Ray, const WideAxisBox3f<Width>& Boxes, float MaxDistance, float* EntryDistOut = nullptr);
+
+//! Test the Width rays of Packet against Box, each in parameter range [0,Packet.MaxDistance[k]]. Returns a bitmask with bit k set if ray k hits the box.
+//! If EntryDistOut is non-null, EntryDistOut[k] is set to the entry parameter for each lane.
+template<int Width>
+uint32_t TestRayPacketBoxIntersection(const RayPacket3f<Width>& Packet, const AxisBox3f& Box, float* EntryDistOut = nullptr);
+
+
+// explicit instantiation
+extern template GRADIENTSPACECORE_API uint32_t TestRayWideBoxIntersection<4>(const PreparedRay3f&, const WideAxisBox3f<4>&, float, float*);
+extern template GRADIENTSPACECORE_API uint32_t TestRayWideBoxIntersection<8>(const PreparedRay3f&, const WideAxisBox3f<8>&, float, float*);
+extern template GRADIENTSPACECORE_API uint32_t TestRayPacketBoxIntersection<4>(const RayPacket3f<4>&, const AxisBox3f&, float*);
+extern template GRADIENTSPACECORE_API uint32_t TestRayPacketBoxIntersection<8>(const RayPacket3f<8>&, const AxisBox3f&, float*);
+
 }
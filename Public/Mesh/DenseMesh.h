@@ -6,6 +6,8 @@
 #include "Core/dynamic_buffer.h"
 #include "Core/rle_buffer.h"
 #include "Core/gs_serializer.h"
+#include "Core/gs_serialize_sections.h"
+#include "Core/gs_debug.h"
 
 #include "Mesh/MeshTypes.h"
 #include "Math/GSVector2.h"
@@ -16,24 +18,78 @@
 namespace GS 
 {
 
+//! Stored sections of a DenseMesh, used to select which attributes are restored
+enum class EDenseMeshSections : uint32_t
+{
+	None = 0,
+	Positions = 1 << 0,
+	Triangles = 1 << 1,
+	TriGroups = 1 << 2,
+	TriMaterialIndexes = 1 << 3,
+	TriVertexNormals = 1 << 4,
+	TriVertexUVs = 1 << 5,
+	TriVertexColors = 1 << 6,
+
+	Geometry = Positions | Triangles,
+	All = 0x7F
+};
+inline EDenseMeshSections operator|(EDenseMeshSections A, EDenseMeshSections B) {
+	return (EDenseMeshSections)((uint32_t)A | (uint32_t)B);
+}
+inline bool operator&(EDenseMeshSections Combined, EDenseMeshSections Check) {
+	return ((uint32_t)Combined & (uint32_t)Check) != 0;
+}
+
+struct DenseMeshRestoreOptions
+{
+	//! sections that will be restored, others are skipped
+	EDenseMeshSections Sections = EDenseMeshSections::All;
+	//! if true and the Serializer supports seeking, skipped sections can be restored later via DenseMesh::RestoreDeferredSections()
+	bool bAllowDeferredSections = false;
+};
+
 
+/**
+ * DenseMesh is a compact triangle mesh with per-triangle groups and material indexes, and optional
+ * per-triangle-vertex normals, UV sets and colors.
+ * 
+ * The normals, UV and color buffers are only allocated once they are enabled, either explicitly or on the
+ * first Set call, so a mesh without these attributes only stores positions, triangles and the (RLE) groups/materials.
+ * The lazy allocation in the Set functions is not thread-safe, call EnableNormals()/etc before setting values in parallel.
+ * 
+ * Positions can optionally be stored in float precision, see SetFloatPositions().
+ */
 class GRADIENTSPACECORE_API DenseMesh
 {
+public:
+	static constexpr int MaxUVSets = 8;
+
 protected:
 
+	bool bFloatPositions = false;
 	dynamic_buffer<Vector3d> Positions;
+	dynamic_buffer<Vector3f> PositionsF;
 	dynamic_buffer<Index3i> Triangles;
 
 	rle_buffer<int> TriGroups;
 	rle_buffer<int> TriMaterialIndexes;
+
+	// optional attributes, buffers are empty unless enabled
+	bool bHasNormals = false;
 	dynamic_buffer<TriVtxNormals> TriVertexNormals;
-	dynamic_buffer<TriVtxUVs> TriVertexUVs;
+	int NumUVSets = 0;
+	dynamic_buffer<TriVtxUVs> TriVertexUVs[MaxUVSets];
+	bool bHasColors = false;
 	dynamic_buffer<TriVtxColors> TriVertexColors;
 
 	// tangents
-	// extended UVs
 	// extended groups
 
+	// section directory of the last Restore(), tracks which sections are loaded or deferred
+	SerializeSectionDirectory RestoredSections;
+	// serialization version of the last Restore(), sections are stored differently in each version
+	uint32_t RestoredVersion = 0;
+
 public:
 	DenseMesh();
 
@@ -41,9 +97,18 @@ public:
 	void Resize(int VertexCount, int TriangleCount);
 
 	inline int GetVertexCount() const;
-	inline const Vector3d& GetPosition(int VertexIndex) const;
+	//! returns the position by value, because it may be converted from float storage. Use GetPositionRef() 
+	//! where a reference to the stored position is needed.
+	inline Vector3d GetPosition(int VertexIndex) const;
+	//! reference to the stored position, requires double-precision position storage (ie HasFloatPositions() == false)
+	inline const Vector3d& GetPositionRef(int VertexIndex) const;
 	inline void SetPosition(int VertexIndex, const Vector3d& NewPosition);
 
+	//! true if positions are stored as Vector3f
+	bool HasFloatPositions() const { return bFloatPositions; }
+	//! switch between float and double position storage. Existing positions are converted.
+	void SetFloatPositions(bool bEnable);
+
 	inline int GetTriangleCount() const;
 	inline const Index3i& GetTriangle(int TriIndex) const;
 	inline void SetTriangle(int TriIndex, const Index3i& NewTriangle);
@@ -56,28 +121,59 @@ public:
 	inline void SetTriMaterialIndex(int TriIndex, int NewMaterialIndex);
 	inline void SetConstantTriMaterialIndex(int NewMaterialIndex);
 
+	bool HasNormals() const { return bHasNormals; }
+	//! allocate the normals buffer if necessary. New normals are initialized to zero.
+	void EnableNormals();
+	void DiscardNormals();
+	//! requires HasNormals()
 	inline const TriVtxNormals& GetTriVtxNormals(int TriIndex) const;
+	//! enables normals if necessary
 	inline void SetTriVtxNormals(int TriIndex, const TriVtxNormals& NewNormals);
 
-	inline const TriVtxUVs& GetTriVtxUVs(int TriIndex) const;
-	inline void SetTriVtxUVs(int TriIndex, const TriVtxUVs& NewUVs);
-
+	int GetNumUVSets() const { return NumUVSets; }
+	bool HasUVs(int UVSet = 0) const { return UVSet < NumUVSets; }
+	//! allocate or discard UV sets so that sets [0,NumSets) exist. New UVs are initialized to zero.
+	void SetNumUVSets(int NumSets);
+	void DiscardUVs() { SetNumUVSets(0); }
+	//! requires HasUVs(UVSet)
+	inline const TriVtxUVs& GetTriVtxUVs(int TriIndex, int UVSet = 0) const;
+	//! enables UV sets up to UVSet if necessary. UVSet must be in range [0,MaxUVSets).
+	inline void SetTriVtxUVs(int TriIndex, const TriVtxUVs& NewUVs, int UVSet = 0);
+
+	bool HasColors() const { return bHasColors; }
+	//! allocate the colors buffer if necessary. New colors are initialized to white.
+	void EnableColors();
+	void DiscardColors();
+	//! requires HasColors()
 	inline const TriVtxColors& GetTriVtxColors(int TriIndex) const;
-	inline void SetTriVtxColors(int TriIndex, const TriVtxColors& NewUVs);
+	//! enables colors if necessary
+	inline void SetTriVtxColors(int TriIndex, const TriVtxColors& NewColors);
 
 	inline Vector3d ComputeTriNormal(int TriIndex, bool bReverseOrientation = false) const;
 	inline Vector3d ComputeTriCentroid(int TriIndex) const;
 
 	bool Store(GS::ISerializer& Serializer) const;
 	bool Restore(GS::ISerializer& Serializer);
+	//! restore the subset of sections selected in Options. Skipped attribute buffers are left empty.
+	bool Restore(GS::ISerializer& Serializer, const DenseMeshRestoreOptions& Options);
+	//! restore sections that were deferred by Restore(). Serializer must be the same stream that was passed to Restore().
+	//! Sections that are already loaded are ignored, so this can be called on first access of an attribute.
+	bool RestoreDeferredSections(GS::ISerializer& Serializer, EDenseMeshSections Sections);
+	//! returns true if all the given Sections are loaded
+	bool HasSections(EDenseMeshSections Sections) const;
+	//! sections that were skipped by Restore() and can still be restored via RestoreDeferredSections()
+	EDenseMeshSections GetDeferredSections() const;
 	constexpr const char* SerializeVersionString() const { return "DenseMesh_Version"; }
+
+protected:
+	bool restore_section(uint32_t SectionID, GS::ISerializer& SectionSerializer);
 };
 
 
 
 int DenseMesh::GetVertexCount() const
 {
-	return (int)Positions.size();
+	return (bFloatPositions) ? (int)PositionsF.size() : (int)Positions.size();
 }
 
 int DenseMesh::GetTriangleCount() const
@@ -85,14 +181,23 @@ int DenseMesh::GetTriangleCount() const
 	return (int)Triangles.size();
 }
 
-const Vector3d& DenseMesh::GetPosition(int Index) const
+Vector3d DenseMesh::GetPosition(int Index) const
+{
+	return (bFloatPositions) ? (Vector3d)PositionsF[Index] : Positions[Index];
+}
+
+const Vector3d& DenseMesh::GetPositionRef(int Index) const
 {
+	gs_debug_assert(bFloatPositions == false);
 	return Positions[Index];
 }
 
 void DenseMesh::SetPosition(int VertexIndex, const Vector3d& NewPosition)
 {
-	Positions[VertexIndex] = NewPosition;
+	if (bFloatPositions)
+		PositionsF[VertexIndex] = (Vector3f)NewPosition;
+	else
+		Positions[VertexIndex] = NewPosition;
 }
 
 const Index3i& DenseMesh::GetTriangle(int Index) const
@@ -137,31 +242,43 @@ void DenseMesh::SetConstantTriMaterialIndex(int NewMaterialIndex)
 
 const TriVtxNormals& DenseMesh::GetTriVtxNormals(int Index) const
 {
+	gs_debug_assert(bHasNormals);
 	return TriVertexNormals[Index];
 }
 
 void DenseMesh::SetTriVtxNormals(int TriIndex, const TriVtxNormals& NewNormals)
 {
+	if (!bHasNormals)
+		EnableNormals();
 	TriVertexNormals.set_value(TriIndex, NewNormals);
 }
 
-const TriVtxUVs& DenseMesh::GetTriVtxUVs(int Index) const
+const TriVtxUVs& DenseMesh::GetTriVtxUVs(int Index, int UVSet) const
 {
-	return TriVertexUVs[Index];
+	gs_debug_assert(UVSet < NumUVSets);
+	return TriVertexUVs[UVSet][Index];
 }
 
-void DenseMesh::SetTriVtxUVs(int TriIndex, const TriVtxUVs& NewUVs)
+void DenseMesh::SetTriVtxUVs(int TriIndex, const TriVtxUVs& NewUVs, int UVSet)
 {
-	TriVertexUVs.set_value(TriIndex, NewUVs);
+	gs_debug_assert(UVSet >= 0 && UVSet < MaxUVSets);
+	if (UVSet < 0 || UVSet >= MaxUVSets)
+		return;
+	if (UVSet >= NumUVSets)
+		SetNumUVSets(UVSet + 1);
+	TriVertexUVs[UVSet].set_value(TriIndex, NewUVs);
 }
 
 const TriVtxColors& DenseMesh::GetTriVtxColors(int Index) const
 {
+	gs_debug_assert(bHasColors);
 	return TriVertexColors[Index];
 }
 
 void DenseMesh::SetTriVtxColors(int TriIndex, const TriVtxColors& NewColor)
 {
+	if (!bHasColors)
+		EnableColors();
 	TriVertexColors.set_value(TriIndex, NewColor);
 }
 
@@ -169,15 +286,14 @@ void DenseMesh::SetTriVtxColors(int TriIndex, const TriVtxColors& NewColor)
 Vector3d DenseMesh::ComputeTriNormal(int TriIndex, bool bReverseOrientation) const
 {
 	Index3i TriV = Triangles[TriIndex];
-	return (bReverseOrientation) ? 
-		GS::Normal(Positions[TriV.B], Positions[TriV.A], Positions[TriV.C]) 
-		: GS::Normal(Positions[TriV.A], Positions[TriV.B], Positions[TriV.C]);
+	Vector3d A = GetPosition(TriV.A), B = GetPosition(TriV.B), C = GetPosition(TriV.C);
+	return (bReverseOrientation) ? GS::Normal(B, A, C) : GS::Normal(A, B, C);
 }
 
 Vector3d DenseMesh::ComputeTriCentroid(int TriIndex) const
 {
 	Index3i TriV = Triangles[TriIndex];
-	return (Positions[TriV.A] + Positions[TriV.B] + Positions[TriV.C]) / 3.0;
+	return (GetPosition(TriV.A) + GetPosition(TriV.B) + GetPosition(TriV.C)) / 3.0;
 }
 
 
@@ -0,0 +1,233 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+#include "Core/packed_int_lists.h"
+#include "Core/refcount_vector.h"
+#include "Core/FunctionRef.h"
+#include "Math/GSVector3.h"
+#include "Math/GSIndex2.h"
+#include "Math/GSIndex3.h"
+
+namespace GS
+{
+
+class DenseMesh;
+
+
+enum class EDynamicMeshResult
+{
+	Ok = 0,
+	Failed_NotAVertex = 1,
+	Failed_NotATriangle = 2,
+	Failed_NotAnEdge = 3,
+	Failed_IsBoundaryEdge = 10,
+	Failed_FlippedEdgeExists = 11,
+	Failed_InvalidNeighbourhood = 12,
+	Failed_CollapseTetrahedron = 13,
+	Failed_CollapseTriangle = 14
+};
+
+
+/**
+ * DynamicMesh3 is an edge-based triangle mesh that supports local topology changes, a port of
+ * geometry3Sharp's DMesh3. Unlike DenseMesh, elements can be removed, and the mesh can be edited with
+ * O(1) local operations like SplitEdge(), FlipEdge(), CollapseEdge() and PokeTriangle().
+ *
+ * Vertex, edge and triangle IDs are tracked with refcount_vector, removed IDs are added to a free list and
+ * reused, so the ID ranges may contain gaps and IsVertex()/IsEdge()/IsTriangle() must be used to skip them.
+ * Vertex refcounts are 1 + the number of triangles using the vertex.
+ *
+ * Each edge stores its two vertices (sorted) and its one or two triangles, the second TriangleID is -1 for
+ * boundary edges. Each triangle stores its three EdgeIDs, and each vertex its list of EdgeIDs in VertexEdges.
+ * The VertexEdges lists are packed_int_lists that are rewritten in place when they shrink, and appended and
+ * lazily compacted when they grow. Edges are always manifold, AppendTriangle() fails for triangles that
+ * would create a nonmanifold edge (but vertices may be bowties).
+ */
+class GRADIENTSPACECORE_API DynamicMesh3
+{
+public:
+	static constexpr int InvalidID = -1;
+	static constexpr int NonManifoldID = -2;
+
+	struct Edge
+	{
+		Index2i Vertices;		// sorted min, max
+		Index2i Triangles;		// second triangle is -1 for boundary edges
+	};
+
+	struct EdgeSplitInfo
+	{
+		int OriginalEdge = -1;
+		Index2i OriginalVertices;		// the vertices of OriginalEdge, NewVertex is at Lerp(A, B, SplitT)
+		Index2i OtherVertices;			// opposite vertices of the triangles of OriginalEdge, second is -1 for boundary edges
+		Index2i OriginalTriangles;
+		int NewVertex = -1;
+		Index2i NewTriangles;			// second is -1 for boundary edges
+		Index3i NewEdges;				// (NewVertex,B), (NewVertex,OtherVertices.A), (NewVertex,OtherVertices.B). Last is -1 for boundary edges
+	};
+
+	struct EdgeFlipInfo
+	{
+		int EdgeID = -1;
+		Index2i OriginalVertices;
+		Index2i OpposingVertices;		// the vertices of EdgeID after the flip
+		Index2i Triangles;
+	};
+
+	struct EdgeCollapseInfo
+	{
+		int KeptVertex = -1;
+		int RemovedVertex = -1;
+		Index2i OpposingVertices;		// second is -1 for boundary edges
+		bool bIsBoundary = false;
+		int CollapsedEdge = -1;
+		Index2i RemovedTriangles;		// second is -1 for boundary edges
+		Index2i RemovedEdges;			// (RemovedVertex,OpposingVertices.A/B), second is -1 for boundary edges
+		Index2i KeptEdges;				// (KeptVertex,OpposingVertices.A/B), second is -1 for boundary edges
+	};
+
+	struct PokeTriangleInfo
+	{
+		int OriginalTriangle = -1;
+		Index3i TriVertices;
+		int NewVertex = -1;
+		Index2i NewTriangles;
+		Index3i NewEdges;				// (TriVertices[j], NewVertex)
+	};
+
+protected:
+	unsafe_vector<Vector3d> Positions;
+	refcount_vector VertexRefCounts;
+	packed_int_lists VertexEdges;
+
+	unsafe_vector<Index3i> Triangles;
+	unsafe_vector<Index3i> TriangleEdges;
+	refcount_vector TriangleRefCounts;
+	unsafe_vector<int> TriangleGroups;
+	bool bHasTriangleGroups = false;
+
+	unsafe_vector<Edge> Edges;
+	refcount_vector EdgeRefCounts;
+
+public:
+	DynamicMesh3();
+
+	//! copy the vertices and triangles of Mesh. Triangles that would be nonmanifold are skipped, their indices
+	//! are returned in SkippedTrianglesOut if provided. Mesh TriGroups are copied if bCopyGroups is true.
+	void Copy(const DenseMesh& Mesh, bool bCopyGroups = true, unsafe_vector<int>* SkippedTrianglesOut = nullptr);
+
+	//! store a compacted copy of this mesh in MeshOut. If provided, VertexMapOut/TriangleMapOut map IDs of this mesh to indices in MeshOut.
+	void ExtractCompactMesh(DenseMesh& MeshOut, unsafe_vector<int>* VertexMapOut = nullptr, unsafe_vector<int>* TriangleMapOut = nullptr) const;
+
+	void Clear();
+
+	int VertexCount() const { return VertexRefCounts.count(); }
+	int TriangleCount() const { return TriangleRefCounts.count(); }
+	int EdgeCount() const { return EdgeRefCounts.count(); }
+	//! upper bound on VertexIDs, valid IDs are in [0,MaxVertexID())
+	int MaxVertexID() const { return VertexRefCounts.max_index(); }
+	int MaxTriangleID() const { return TriangleRefCounts.max_index(); }
+	int MaxEdgeID() const { return EdgeRefCounts.max_index(); }
+	bool IsCompact() const { return VertexRefCounts.is_dense() && TriangleRefCounts.is_dense() && EdgeRefCounts.is_dense(); }
+
+	bool IsVertex(int VertexID) const { return VertexRefCounts.is_valid(VertexID); }
+	bool IsTriangle(int TriangleID) const { return TriangleRefCounts.is_valid(TriangleID); }
+	bool IsEdge(int EdgeID) const { return EdgeRefCounts.is_valid(EdgeID); }
+
+	const Vector3d& GetVertex(int VertexID) const { return Positions[VertexID]; }
+	void SetVertex(int VertexID, const Vector3d& NewPosition) { Positions[VertexID] = NewPosition; }
+	const Index3i& GetTriangle(int TriangleID) const { return Triangles[TriangleID]; }
+	const Index3i& GetTriEdges(int TriangleID) const { return TriangleEdges[TriangleID]; }
+	const Edge& GetEdge(int EdgeID) const { return Edges[EdgeID]; }
+	const Index2i& GetEdgeV(int EdgeID) const { return Edges[EdgeID].Vertices; }
+	const Index2i& GetEdgeT(int EdgeID) const { return Edges[EdgeID].Triangles; }
+
+	bool HasTriangleGroups() const { return bHasTriangleGroups; }
+	//! enable per-triangle groups, existing triangles are assigned InitialGroup
+	void EnableTriangleGroups(int InitialGroup = 0);
+	void DiscardTriangleGroups();
+	int GetTriangleGroup(int TriangleID) const { return (bHasTriangleGroups) ? TriangleGroups[TriangleID] : -1; }
+	void SetTriangleGroup(int TriangleID, int NewGroup) { if (bHasTriangleGroups) TriangleGroups[TriangleID] = NewGroup; }
+
+	//! append a new vertex and return its VertexID
+	int AppendVertex(const Vector3d& Position);
+	//! append a new triangle and return its TriangleID. Returns InvalidID if a vertex is invalid or the
+	//! vertices are not unique, and NonManifoldID if an edge of the triangle already has two triangles.
+	int AppendTriangle(const Index3i& TriVertices, int Group = 0);
+
+	//! remove a triangle, and its edges if they have no other triangles. Vertices that are no longer used
+	//! by any triangle are also removed if bRemoveIsolatedVertices is true.
+	EDynamicMeshResult RemoveTriangle(int TriangleID, bool bRemoveIsolatedVertices = true);
+	//! remove a vertex and all its triangles
+	EDynamicMeshResult RemoveVertex(int VertexID, bool bRemoveIsolatedVertices = true);
+
+	//! return the EdgeID between VertexA and VertexB, or InvalidID
+	int FindEdge(int VertexA, int VertexB) const;
+	//! return the EdgeID between VertexA and VertexB in TriangleID, or InvalidID
+	int FindEdgeFromTri(int VertexA, int VertexB, int TriangleID) const;
+	//! return the TriangleID with the given vertices, or InvalidID
+	int FindTriangle(int VertexA, int VertexB, int VertexC) const;
+
+	bool IsBoundaryEdge(int EdgeID) const { return Edges[EdgeID].Triangles.B == InvalidID; }
+	bool IsBoundaryVertex(int VertexID) const;
+	int GetVtxEdgeCount(int VertexID) const { return VertexEdges.HasList(VertexID) ? VertexEdges.GetListSizeUnsafe(VertexID) : 0; }
+	//! number of triangles at the vertex, ie the vertex refcount minus 1
+	int GetVtxTriangleCount(int VertexID) const { return VertexRefCounts.refcount(VertexID) - 1; }
+	//! the triangles across the three edges of TriangleID, or InvalidID for boundary edges
+	Index3i GetTriNeighbourTris(int TriangleID) const;
+	//! return the vertex of TriangleID/EdgeID opposite to the edge/vertex, or InvalidID
+	int GetEdgeOpposingV(int EdgeID, int TriangleID) const;
+
+	void EnumerateVertexEdges(int VertexID, FunctionRef<void(int EdgeID)> EdgeFunc) const;
+	void EnumerateVertexVertices(int VertexID, FunctionRef<void(int NbrVertexID)> VertexFunc) const;
+	//! call TriangleFunc for each triangle at the vertex, once per triangle
+	void EnumerateVertexTriangles(int VertexID, FunctionRef<void(int TriangleID)> TriangleFunc) const;
+
+	Vector3d ComputeTriNormal(int TriangleID) const;
+	Vector3d ComputeTriCentroid(int TriangleID) const;
+
+	//
+	// local topology operations
+	//
+
+	//! split EdgeID by inserting a new vertex at Lerp(A, B, SplitT), where (A,B) are the sorted edge vertices.
+	//! Each triangle of the edge is split into two.
+	EDynamicMeshResult SplitEdge(int EdgeID, EdgeSplitInfo& SplitInfo, double SplitT = 0.5);
+
+	//! rotate an interior edge (A,B) with triangles (A,B,C) and (B,A,D) to (C,D). Fails for boundary edges,
+	//! or if edge (C,D) already exists.
+	EDynamicMeshResult FlipEdge(int EdgeID, EdgeFlipInfo& FlipInfo);
+
+	//! collapse the edge between KeepVertexID and RemoveVertexID, RemoveVertexID and the triangles of the edge are
+	//! removed. The kept vertex is moved to Lerp(Keep, Remove, CollapseT). Fails if the collapse would create
+	//! nonmanifold topology (link condition), or would collapse a tetrahedron or an isolated triangle.
+	EDynamicMeshResult CollapseEdge(int KeepVertexID, int RemoveVertexID, EdgeCollapseInfo& CollapseInfo, double CollapseT = 0);
+
+	//! insert a new vertex at BaryCoords inside TriangleID, and replace the triangle with three triangles.
+	//! The original TriangleID is kept for the triangle (A,B,NewVertex).
+	EDynamicMeshResult PokeTriangle(int TriangleID, const Vector3d& BaryCoords, PokeTriangleInfo& PokeInfo);
+
+	//! check the internal consistency of the mesh, returns false if any problems are found.
+	//! If bAssertOnFailure is true, each failed check also triggers a debug assert.
+	bool CheckValidity(bool bAssertOnFailure = false) const;
+
+	//! compact the VertexEdges lists, which is otherwise done lazily
+	void CompactVertexEdges() { VertexEdges.Compact(); }
+
+protected:
+	int allocate_triangle(const Index3i& TriVertices, int Group);
+	int add_edge(int VertexA, int VertexB, int TriangleA, int TriangleB = InvalidID);
+	void remove_edge(int EdgeID);
+	void add_vertex_edge(int VertexID, int EdgeID);
+	void remove_vertex_edge(int VertexID, int EdgeID);
+	void replace_edge_triangle(int EdgeID, int OldTriangleID, int NewTriangleID);
+	void replace_edge_vertex(int EdgeID, int OldVertexID, int NewVertexID);
+	void replace_tri_edge(int TriangleID, int OldEdgeID, int NewEdgeID);
+	void remove_isolated_vertex(int VertexID);
+	void compact_vertex_edges_if_needed();
+};
+
+
+} // end namespace GS
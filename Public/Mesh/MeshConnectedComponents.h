@@ -0,0 +1,82 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
+#include "Core/FunctionRef.h"
+#include "Math/GSIndex3.h"
+#include "Mesh/MeshView2.h"
+
+namespace GS
+{
+
+class MeshTopology;
+class ConcurrentUnionFind;
+
+
+/**
+ * MeshConnectedComponents computes the connected components of a set of mesh elements (usually triangles),
+ * using a ConcurrentUnionFind that is filled in parallel.
+ *
+ * The result is stored as a per-element ComponentID buffer, and the elements of each component in CSR form,
+ * ie the elements of component c are ComponentElements[ComponentOffsets[c]] to ComponentElements[ComponentOffsets[c+1]-1],
+ * in increasing order. ComponentIDs are compact, and ordered by the smallest element of each component,
+ * so the result is the same for serial and parallel computation.
+ */
+class GRADIENTSPACECORE_API MeshConnectedComponents
+{
+public:
+	//! component index for each element, or -1 for invalid elements
+	unsafe_vector<int> ComponentIDs;
+	//! offsets into ComponentElements for each component, size is NumComponents()+1
+	unsafe_vector<int> ComponentOffsets;
+	//! elements of each component
+	unsafe_vector<int> ComponentElements;
+
+	int NumComponents() const { return (ComponentOffsets.size() > 0) ? (int)ComponentOffsets.size() - 1 : 0; }
+	int NumElements() const { return (int)ComponentIDs.size(); }
+
+	int GetComponentSize(int ComponentID) const {
+		return ComponentOffsets[ComponentID + 1] - ComponentOffsets[ComponentID];
+	}
+	//! elements of the component, in increasing order
+	const_buffer_view<int> GetComponent(int ComponentID) const {
+		return const_buffer_view<int>(ComponentElements.raw_pointer(ComponentOffsets[ComponentID]), GetComponentSize(ComponentID));
+	}
+
+	void Clear();
+
+	//! triangle components connected via TriNeighbours of Topology. Triangles across nonmanifold edges are
+	//! connected if Topology has TriEdges, otherwise nonmanifold edges separate components.
+	void BuildTriangleComponents(
+		const MeshTopology& Topology,
+		int NumTriangleIDs,
+		FunctionRef<bool(int TriangleID)> IsTriangleValidFunc,
+		bool bParallel = true);
+
+	//! triangle components connected via shared vertices. GetTriangleFunc returns false for invalid triangles.
+	void BuildTriangleComponents(
+		int NumVertexIDs,
+		int NumTriangleIDs,
+		FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
+		bool bParallel = true);
+
+	//! triangle components of a 2D mesh connected via shared vertices, eg the UV islands of a UV mesh
+	void BuildTriangleComponents(
+		const ConstMeshView2d& Mesh,
+		bool bParallel = true);
+
+	//! components from a UnionFind where all Union() calls are done. Elements where IsElementValidFunc returns false get ComponentID -1.
+	//! If ElementToUnionFindFunc is provided, element k is in the set of UnionFind element ElementToUnionFindFunc(k),
+	//! otherwise UnionFind elements are the elements.
+	void BuildFromUnionFind(
+		ConcurrentUnionFind& UnionFind,
+		int NumElements,
+		FunctionRef<bool(int ElementID)> IsElementValidFunc,
+		FunctionRef<int(int ElementID)> ElementToUnionFindFunc = nullptr,
+		bool bParallel = true);
+};
+
+
+} // end namespace GS
@@ -0,0 +1,69 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/unsafe_vector.h"
+
+namespace GS
+{
+
+class PolyMesh;
+class DenseMesh;
+
+
+struct PolyMeshToDenseMeshOptions
+{
+	//! PolyMesh group set that is copied to the DenseMesh TriGroups. If the set does not exist, groups are 0.
+	int GroupSet = 0;
+	//! copy the NormalSet normals to the DenseMesh TriVtxNormals, if the set exists
+	bool bCopyNormals = true;
+	int NormalSet = 0;
+	//! copy the PolyMesh UV sets to the DenseMesh UV sets, up to DenseMesh::MaxUVSets
+	bool bCopyUVs = true;
+	//! copy the ColorSet colors to the DenseMesh TriVtxColors, if the set exists
+	bool bCopyColors = true;
+	int ColorSet = 0;
+
+	bool bParallel = true;
+};
+
+/**
+ * Convert a PolyMesh to a DenseMesh. Quads and Polygons are triangulated with TriangulatePolyMeshFace(), and the
+ * triangles of each face are consecutive and in face order. The triangle counts are computed in a first parallel pass, and
+ * after a prefix sum the triangles and attributes are written in a second parallel pass.
+ * Per-face-vertex attributes are converted to per-triangle-vertex TriVtx tuples, with -1 indices mapped to zero/zero/white.
+ * Faces with less than 3 vertices are skipped.
+ * If TriangleToFaceMapOut is provided, it is set to the source face index of each DenseMesh triangle.
+ */
+GRADIENTSPACECORE_API
+void ConvertPolyMeshToDenseMesh(
+	const PolyMesh& MeshIn,
+	DenseMesh& MeshOut,
+	const PolyMeshToDenseMeshOptions& Options = PolyMeshToDenseMeshOptions(),
+	unsafe_vector<int>* TriangleToFaceMapOut = nullptr);
+
+
+struct DenseMeshToPolyMeshOptions
+{
+	bool bCopyNormals = true;
+	bool bCopyUVs = true;
+	bool bCopyColors = true;
+
+	bool bParallel = true;
+};
+
+/**
+ * Convert a DenseMesh to a PolyMesh that only contains triangles, in the same order. TriGroups are copied
+ * to the first group set. Enabled DenseMesh attributes are converted to indexed attribute sets, where equal
+ * per-triangle-vertex values at the same vertex are de-duplicated into a single element (equal values at
+ * different vertices are not merged). The de-duplication is done in parallel after sorting the triangle corners by vertex,
+ * and elements are ordered by vertex, so the result does not depend on bParallel.
+ */
+GRADIENTSPACECORE_API
+void ConvertDenseMeshToPolyMesh(
+	const DenseMesh& MeshIn,
+	PolyMesh& MeshOut,
+	const DenseMeshToPolyMeshOptions& Options = DenseMeshToPolyMeshOptions());
+
+
+} // end namespace GS
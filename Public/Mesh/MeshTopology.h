@@ -3,14 +3,18 @@
 
 #include "GradientspacePlatform.h"
 #include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
 #include "Math/GSIndex2.h"
 #include "Math/GSIndex3.h"
 #include "Core/FunctionRef.h"
 #include "Core/packed_int_lists.h"
+#include "Core/ContentHash.h"
+#include "Core/gs_serializer.h"
 
 namespace GS
 {
 
+class DerivedDataCache;
 
 
 enum class EMeshTopologyTypes : uint8_t
@@ -19,7 +23,10 @@ enum class EMeshTopologyTypes : uint8_t
 	VertexTriangles = 1 << 2,
 	VertexVertices = 1 << 3,
 	VertexEdges = 1 << 4,
-	All = 0xFF
+	//! CornerTable and TriangleEdges are not included in All, and must be requested explicitly (eg All | TriangleEdges)
+	CornerTable = 1 << 5,
+	TriangleEdges = 1 << 6,
+	All = TriangleNeighbours | VertexTriangles | VertexVertices | VertexEdges
 };
 inline EMeshTopologyTypes operator|(EMeshTopologyTypes A, EMeshTopologyTypes B) {
 	return (EMeshTopologyTypes)((uint8_t)A | (uint8_t)B);
@@ -43,23 +50,79 @@ public:
 		Index2i Vertices;		// sorted min, max
 		Index2i TriInfo;		// could be <t0,-1>, <t0,t1> (manifold) or <-1, index> (nonmanifold)
 		bool IsManifold() const { return TriInfo.A >= 0; }
+		bool IsFree() const { return Vertices.A < 0; }		// unused EdgeID, after UpdateTriangles()
 	};
 	unsafe_vector<Edge> Edges;
+	//! unused EdgeIDs in Edges, which are reused by UpdateTriangles()
+	unsafe_vector<int> FreeEdgeIDs;
 	packed_int_lists VertexEdges;
 	packed_int_lists NonManifoldEdgeTriLists;
 
 	unsafe_vector<Index3i> TriNeighbours;
 	packed_int_lists NonManifoldTriTriLists;
 
+	//! EdgeIDs of the edges (TriVertices[j],TriVertices[j+1]) of each triangle, or -1 for invalid triangles. Only built with VertexEdges.
+	unsafe_vector<Index3i> TriEdges;
+
+	//! Corner table. Corner c = 3*TriangleID+j is at vertex TriVertices[j], and CornerOpposites[c] is the corner of
+	//! the adjacent triangle that is opposite the edge (TriVertices[j+1],TriVertices[j+2]). This is -1 for boundary and 
+	//! nonmanifold edges, and for edges where the two triangles have inconsistent orientation.
+	unsafe_vector<int> CornerOpposites;
+	//! one corner at each vertex, or -1 for vertices with no triangles. For boundary vertices this is the first corner of
+	//! a fan, so the one-ring can be enumerated by swinging in one direction. Nonmanifold (bowtie) vertices only reach one fan.
+	unsafe_vector<int> VertexCorners;
+
 public:
+	//! Build the topology parts in WhichParts. If VertexEdges or CornerTable are included, the edges are found by sorting the
+	//! triangle edges, and the build runs in parallel if bParallel is true (GetTriangleFunc must be thread-safe in that case).
+	//! Edge and list orderings are the same as inserting the triangles one at a time in TriangleID order.
+	//! Edges are only kept if VertexEdges are included, so CornerTable alone is the most compact adjacency for manifold meshes.
+	//! IsVertexValidFunc is currently not used, vertices that are not referenced by any triangle get empty lists.
 	void Build(
 		int NumVertexIDs,
 		FunctionRef<bool(int)> IsVertexValidFunc,
 		int NumTriangleIDs,
 		FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
-		EMeshTopologyTypes WhichParts = EMeshTopologyTypes::All
+		EMeshTopologyTypes WhichParts = EMeshTopologyTypes::All,
+		bool bParallel = true
+	);
+
+	//! compute the DerivedDataCache key for a topology built from the mesh identified by MeshHash
+	static ContentHash128 MakeCacheKey(
+		const ContentHash128& MeshHash, int NumVertexIDs, int NumTriangleIDs, EMeshTopologyTypes WhichParts);
+
+	//! Restore from Cache if available, otherwise Build() and add to the Cache. MeshHash must identify the 
+	//! vertices and triangles returned by the Valid/GetTriangle functions. Returns true if restored from the Cache.
+	bool BuildCached(
+		DerivedDataCache& Cache,
+		const ContentHash128& MeshHash,
+		int NumVertexIDs,
+		FunctionRef<bool(int)> IsVertexValidFunc,
+		int NumTriangleIDs,
+		FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc,
+		EMeshTopologyTypes WhichParts = EMeshTopologyTypes::All,
+		bool bParallel = true
+	);
+
+	//! Update the topology after the triangles in ChangedTriangleIDs were added, removed or modified. GetTriangleFunc
+	//! returns the new triangles, and NumVertexIDs/NumTriangleIDs may have increased since the last Build/Update.
+	//! Only Edges, VertexEdges and the one-rings and neighbours of the vertices and triangles adjacent to the changed
+	//! triangles are rewritten. Removed EdgeIDs are added to FreeEdgeIDs and reused, so other EdgeIDs are stable.
+	//! The packed lists are compacted when more than half of their storage is unused.
+	//! Requires VertexEdges and TriangleEdges, returns false if they are not available (eg build with All | TriangleEdges).
+	bool UpdateTriangles(
+		int NumVertexIDs,
+		int NumTriangleIDs,
+		const_buffer_view<int> ChangedTriangleIDs,
+		FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc
 	);
 
+	void Clear();
+
+	bool Store(GS::ISerializer& Serializer) const;
+	bool Restore(GS::ISerializer& Serializer);
+	constexpr const char* SerializeVersionString() const { return "MeshTopology_Version"; }
+
 
 public:
 
@@ -69,6 +132,11 @@ public:
 	bool HasVertexTriangles() const { return VertexTriangles.NumLists() > 0; }
 	bool HasVertexVertices() const { return VertexVertices.NumLists() > 0; }
 	bool HasVertexEdges() const { return VertexEdges.NumLists() > 0; }
+	bool HasCornerTable() const { return CornerOpposites.size() > 0; }
+	bool HasTriEdges() const { return TriEdges.size() > 0; }
+
+	static int NextCorner(int Corner) { return (Corner % 3 == 2) ? (Corner - 2) : (Corner + 1); }
+	static int PrevCorner(int Corner) { return (Corner % 3 == 0) ? (Corner + 2) : (Corner - 1); }
 
 
 	//! return Index into .Edges[], or -1 
@@ -79,6 +147,23 @@ public:
 		return TriNeighbours[TriangleA].Contains(TriangleB);
 	}
 
+	//
+	// one-ring queries that use whichever topology parts are available
+	//
+
+	//! call TriangleFunc for each triangle in the one-ring of VertexID. 
+	//! Uses VertexTriangles if available, otherwise the CornerTable.
+	void EnumerateVertexTriangles(int VertexID, FunctionRef<void(int TriangleID)> TriangleFunc) const;
+
+	//! call VertexFunc for each vertex connected to VertexID by an edge. Uses VertexVertices or VertexEdges if available,
+	//! otherwise the CornerTable, which requires GetTriangleFunc to look up the vertices of the one-ring triangles.
+	void EnumerateVertexVertices(int VertexID, FunctionRef<void(int NbrVertexID)> VertexFunc,
+		FunctionRef<bool(int TriangleID, Index3i& TriVertices)> GetTriangleFunc = nullptr) const;
+
+	//! return the triangle across edge (TriVertices[EdgeIndex],TriVertices[EdgeIndex+1]) of TriangleID, or -1.
+	//! Uses TriNeighbours if available (which may return -2 for nonmanifold edges), otherwise the CornerTable.
+	int GetTriNeighbour(int TriangleID, int EdgeIndex) const;
+
 
 	bool CheckValidity() const;
 
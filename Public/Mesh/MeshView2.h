@@ -5,6 +5,7 @@
 #include "Math/GSVector2.h"
 #include "Math/GSTriangle2.h"
 #include "Math/GSIndex3.h"
+#include "Core/ContentHash.h"
 
 namespace GS
 {
@@ -94,5 +95,32 @@ typedef TConstMeshView2<float> ConstMeshView2f;
 typedef TConstMeshView2<double> ConstMeshView2d;
 
 
+//! compute a content hash of the vertex positions and triangles of a mesh view. Strided buffers are hashed element-wise, so the result does not depend on stride.
+template<typename RealType>
+ContentHash128 ComputeContentHash(const TConstMeshView2<RealType>& MeshView)
+{
+	static constexpr size_t ElementsPerChunk = 16384;
+	ContentHash128 VertexHash = ComputeContentHash((size_t)MeshView.GetNumVertexIDs(), ElementsPerChunk,
+		[&](size_t StartIndex, size_t Count, ContentHasher& Hasher) {
+			for (size_t k = 0; k < Count; ++k) {
+				Vector2<RealType> V = MeshView.GetVertex((int)(StartIndex + k));
+				Hasher.AppendValue(V.X); Hasher.AppendValue(V.Y);
+			}
+		});
+	ContentHash128 TriangleHash = ComputeContentHash((size_t)MeshView.GetNumTriangleIDs(), ElementsPerChunk,
+		[&](size_t StartIndex, size_t Count, ContentHasher& Hasher) {
+			for (size_t k = 0; k < Count; ++k) {
+				Index3i T = MeshView.GetTriangle((int)(StartIndex + k));
+				Hasher.AppendValue(T.A); Hasher.AppendValue(T.B); Hasher.AppendValue(T.C);
+			}
+		});
+	ContentHasher Combined;
+	Combined.AppendValue<uint32_t>(sizeof(RealType));
+	Combined.AppendHash(VertexHash);
+	Combined.AppendHash(TriangleHash);
+	return Combined.Finalize128();
+}
+
+
 
 }
\ No newline at end of file
@@ -6,7 +6,9 @@
 #include "Core/dynamic_buffer.h"
 #include "Core/rle_buffer.h"
 #include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
 #include "Core/gs_serializer.h"
+#include "Core/gs_serialize_sections.h"
 #include "Core/gs_debug.h"
 
 #include "Mesh/MeshTypes.h"
@@ -26,33 +28,62 @@ typedef IndexedPolyMeshAttribute<Vector2d> PolyMeshUVs;
 typedef IndexedPolyMeshAttribute<Vector3f> PolyMeshNormals;
 typedef IndexedPolyMeshAttribute<Vector4f> PolyMeshColors;
 
+//! Stored sections of a PolyMesh, used to select which parts are restored
+enum class EPolyMeshSections : uint32_t
+{
+	None = 0,
+	Positions = 1 << 0,
+	//! Triangles, Quads, Polygons and Face list
+	Faces = 1 << 1,
+	FaceGroups = 1 << 2,
+	MaterialIDs = 1 << 3,
+	//! attribute sections also store polygon attribute indices. For version 1 archives, restoring an attribute section also restores the Faces section
+	Normals = 1 << 4,
+	UVs = 1 << 5,
+	Colors = 1 << 6,
+
+	Geometry = Positions | Faces,
+	All = 0x7F
+};
+inline EPolyMeshSections operator|(EPolyMeshSections A, EPolyMeshSections B) {
+	return (EPolyMeshSections)((uint32_t)A | (uint32_t)B);
+}
+inline bool operator&(EPolyMeshSections Combined, EPolyMeshSections Check) {
+	return ((uint32_t)Combined & (uint32_t)Check) != 0;
+}
+
+struct PolyMeshRestoreOptions
+{
+	//! sections that will be restored, others are skipped
+	EPolyMeshSections Sections = EPolyMeshSections::All;
+	//! if true and the Serializer supports seeking, skipped sections can be restored later via PolyMesh::RestoreDeferredSections()
+	bool bAllowDeferredSections = false;
+};
+
 
 /**
  * PolyMesh stores a 3D Polygon Mesh that supports Triangles and Quads efficiently
- * by storing them in separate 3/4-element buffers, and Polygons in generic-list buffers.
+ * by storing them in separate 3/4-element buffers, and Polygons in a packed index buffer.
  *
  * To preserve ordering and make it simpler to iterate over faces, a list of "Face" elements
  * is also stored. A Face is a pair (Type,TypeIndex), where the type represents Tri/Quad/Poly (0/1/2),
  * and the TypeIndex is an index into the given type-specific arrays.
  * 
- * Multiple FaceGroup Sets are supported. The Group Sets are stored in a single buffer
- * as tuples of per-set values, ie for N faces and 2 Sets, the storage ordering is interleaved,
- * ie [(Face0Set0, Face0Set1), (Face1Set0, Face1Set1), ...]. Because of this ordering, it is
- * not currently possible to add a new Set after mesh construction begins. Note that if groups
- * sets were stored sequentially, the number of triangles would need to be known up front!
- * (q: perhaps it would make more sense to store separate arrays?)
+ * Polygons are stored packed (CSR), ie the vertices of all polygons are stored in a single buffer,
+ * and polygon k has vertices PolygonVertices[PolygonOffsets[k]] to PolygonVertices[PolygonOffsets[k+1]-1].
+ * The Polygon struct is only used to pass polygons to AddPolygon(), AddPolygons() appends many polygons
+ * directly in packed form. Use GetPolygon() to access the vertices of a polygon.
  * 
- * Indexed Normals, UVs, and Colors are supported. For each attribute type, up to 4 sets 
- * can be stored. The attribute values are stored sequentially in a flat buffer, 
- * ie [ Set1Values ... Set2Values ... Set3Values ... Set4Values ]. 
+ * Up to MaxFaceGroupSets FaceGroup Sets are supported. Each Group Set is stored in a separate
+ * per-face buffer, so Sets can be added or removed at any time, new Sets are initialized
+ * with a constant group for the existing faces.
  * 
- * For Tris and Quads the attribute index 3/4-tuples are stored inside each IndexedPolyMeshAttribute 
- * interleaved per-set, ie [Quad0Set0, Quad0Set1, Quad1Set0, Quad1Set1, ...]. Inside each
- * Polygon the attribute indices are stored sequentially, ie [Set0UVIndices, Set1UVIndicesPoly, ...]
- *
- * Because of this structure, it is not possible to add a new Set after mesh construction begins.
- * In addition, the number of attribute values must currently be known up front for all
- * but the last set (which can be appended-to)
+ * Indexed Normals, UVs, and Colors are supported. For each attribute type, up to 4 sets 
+ * can be stored. Each set is stored separately (see PolyMeshAttributeSet), with its own value buffer
+ * and per-Tri/Quad index tuples. The polygon attribute indices of each set are packed in the same
+ * order as the polygon vertices, ie indexed via PolygonOffsets. Attribute Sets can also be
+ * added or removed at any time, and values can be appended to any set. The indices of
+ * existing faces in a new set are initialized to -1.
  * 
  * MaterialIDs are supported, but only one MaterialID per Face
  */
@@ -60,7 +91,7 @@ class GRADIENTSPACECORE_API PolyMesh
 {
 public:
 
-	// todo: maybe we should use some TInlineSmallList-type thing to store these? most could be on stack then...
+	//! polygon passed to AddPolygon(), the lists are copied into the packed polygon storage
 	struct GRADIENTSPACECORE_API Polygon
 	{
 		int VertexCount;
@@ -122,16 +153,20 @@ public:
 		Color = 2
 	};
 
+	static constexpr int MaxFaceGroupSets = 8;
+
 protected:
 
 	unsafe_vector<Vector3d> Positions;
 
 	unsafe_vector<Index3i> Triangles;
 	unsafe_vector<Index4i> Quads;
-	unsafe_vector<Polygon> Polygons;
+	//! offsets into PolygonVertices for each polygon, size is GetPolygonCount()+1
+	unsafe_vector<int> PolygonOffsets;
+	unsafe_vector<int> PolygonVertices;
 	unsafe_vector<Face> Faces;
 
-	unsafe_vector<int> FaceGroups;
+	unsafe_vector<int> FaceGroupSets[MaxFaceGroupSets];
 	uint32_t NumFaceGroupSets;
 
 	unsafe_vector<int> MaterialIDs;
@@ -140,6 +175,11 @@ protected:
 	PolyMeshUVs UVSets;
 	PolyMeshColors ColorSets;
 
+	// section directory of the last Restore(), tracks which sections are loaded or deferred
+	SerializeSectionDirectory RestoredSections;
+	// serialization version of the last Restore(), sets are stored differently in each version
+	uint32_t RestoredVersion = 0;
+
 public:
 	PolyMesh();
 
@@ -166,9 +206,16 @@ public:
 	inline QuadVtxPositions GetQuadVertices(int QuadIndex) const;
 
 	inline int GetPolygonCount() const;
-	inline const Polygon& GetPolygon(int PolygonIndex) const;
-	inline const Polygon& GetPolygon(const Face& Face) const;
-	inline void SetPolygon(int PolygonIndex, Polygon&& NewPolygon);
+	inline int GetPolygonVertexCount(int PolygonIndex) const;
+	//! vertices of the polygon
+	inline const_buffer_view<int> GetPolygon(int PolygonIndex) const;
+	inline const_buffer_view<int> GetPolygon(const Face& Face) const;
+	//! replace the vertices of the polygon, the vertex count cannot change
+	inline void SetPolygon(int PolygonIndex, const_buffer_view<int> NewVertices);
+	//! normal/uv/color indices of the polygon vertices in the given set
+	inline const_buffer_view<int> GetPolygonNormals(int PolygonIndex, int NormalSet = 0) const;
+	inline const_buffer_view<int> GetPolygonUVs(int PolygonIndex, int UVSet = 0) const;
+	inline const_buffer_view<int> GetPolygonColors(int PolygonIndex, int ColorSet = 0) const;
 
 	inline int GetFaceVertexCount(int FaceIndex) const;
 	inline int GetFaceVertexCount(const Face& Face) const;
@@ -177,6 +224,8 @@ public:
 	inline int GetNumFaceGroupSets() const;
 	inline int GetFaceGroup(int FaceIndex, int GroupSet = 0) const;
 	inline void SetFaceGroup(int FaceIndex, int NewGroup, int GroupSet = 0);
+	//! per-face groups of the set
+	inline const_buffer_view<int> GetFaceGroupSet(int GroupSet) const;
 
 	inline int GetNumNormalSets() const;
 	inline int GetNormalCount(int NormalSet) const;
@@ -211,15 +260,32 @@ public:
 	void ReserveFaces(size_t NumFaces);
 	void ReserveTriangles(size_t NumTriangles);
 	void ReserveQuads(size_t NumQuads);
-	void ReservePolygons(size_t NumPolygons);
+	void ReservePolygons(size_t NumPolygons, size_t NumPolygonVertices = 0);
 
 	int AddVertex(const Vector3d& NewPosition);
+	//! append NumVertices vertices with uninitialized positions, returns the index of the first new vertex
+	int AddVertices(int NumVertices);
 
+	//! add an attribute set with the given number of (uninitialized) values. Sets can be added at any time,
+	//! the attribute indices of existing faces are initialized to -1. Returns the new set index, or -1 if the max number of sets exist.
 	int AddNormalSet(size_t NumNormals);
 	int AddUVSet(size_t NumUVs);
 	int AddColorSet(size_t NumColors);
-
+	//! remove an attribute set, the following sets are shifted down
+	void RemoveNormalSet(int NormalSet);
+	void RemoveUVSet(int UVSet);
+	void RemoveColorSet(int ColorSet);
+	//! append a value to an attribute set, returns the new index in the set
+	int AppendNormal(const Vector3f& Normal, int NormalSet = 0);
+	int AppendUV(const Vector2d& UV, int UVSet = 0);
+	int AppendColor(const Vector4f& Color, int ColorSet = 0);
+
+	//! add or remove group sets at the end. New sets are initialized to group 0.
 	void SetNumGroupSets(int NumGroupSets);
+	//! add a group set where all existing faces have InitialGroupID. Returns the new set index, or -1 if MaxFaceGroupSets exist.
+	int AddFaceGroupSet(int InitialGroupID = 0);
+	//! remove a group set, the following sets are shifted down
+	void RemoveFaceGroupSet(int GroupSet);
 
 	//! returns <Face, FaceIndex>
 	std::pair<Face, int> AddTriangle(
@@ -237,10 +303,29 @@ public:
 	std::pair<Face, int> AddPolygon(
 		Polygon&& Polygon,
 		int GroupID = 0);
+	//! append NumTriangles triangles with group GroupID in the first group set. Triangles and attribute indices are
+	//! initialized to -1 unless bSkipInitialization is true. The new triangles can then be set in parallel via 
+	//! SetTriangle() / SetFaceGroup() / InitializeFaceAttributes(). Returns the FaceIndex of the first new triangle.
+	int AddTriangles(
+		int NumTriangles,
+		int GroupID = 0,
+		bool bSkipInitialization = false);
+	//! add a polygon with uninitialized (-1) attribute indices
+	std::pair<Face, int> AddPolygon(
+		const_buffer_view<int> Vertices,
+		int GroupID = 0);
+	//! append polygons in packed form. VertexCounts has an entry for each polygon, and Vertices the concatenated
+	//! polygon vertex lists. GroupIDs is optional, otherwise groups are 0. Attribute indices are initialized to -1.
+	//! returns the FaceIndex of the first new polygon
+	int AddPolygons(
+		const_buffer_view<int> VertexCounts,
+		const_buffer_view<int> Vertices,
+		const_buffer_view<int> GroupIDs = const_buffer_view<int>());
 
 	// this is an extremely unsafe alternative to passing Normals/UVs to the functions
 	// AddTriangle / AddQuad / AddPolygon, the void* pointers will be assumed to be
-	// the correct data type (Index3i* for a Tri, Index4i* for a Quad, or an unsafe_vector<int>* for a Poly).
+	// the correct data type (Index3i* for a Tri, Index4i* for a Quad, or an unsafe_vector<int>* for a Poly,
+	// which must contain NumSets*VertexCount indices ordered per-set, or VertexCount indices if SingleSetIndex is given).
 	// If SingleSetIndex is -1, the pointer will be assumed to contain data for all Attribute Sets
 	bool InitializeFaceAttributes(
 		int FaceIndex,
@@ -257,13 +342,28 @@ public:
 	PolyMeshColors& GetColorSets() { return ColorSets; }
 	const PolyMeshColors& GetColorSets() const { return ColorSets; }
 
-	inline Polygon& GetEditablePolygon(int PolygonIndex) { return Polygons[PolygonIndex]; }
-
 	void Translate(const Vector3d& Translation);
 	void Scale(const Vector3d& Scale);
 
+	bool Store(GS::ISerializer& Serializer) const;
+	bool Restore(GS::ISerializer& Serializer);
+	//! restore the subset of sections selected in Options. Skipped parts are left empty.
+	bool Restore(GS::ISerializer& Serializer, const PolyMeshRestoreOptions& Options);
+	//! restore sections that were deferred by Restore(). Serializer must be the same stream that was passed to Restore().
+	//! Sections that are already loaded are ignored, so this can be called on first access.
+	bool RestoreDeferredSections(GS::ISerializer& Serializer, EPolyMeshSections Sections);
+	//! returns true if all the given Sections are loaded
+	bool HasSections(EPolyMeshSections Sections) const;
+	//! sections that were skipped by Restore() and can still be restored via RestoreDeferredSections()
+	EPolyMeshSections GetDeferredSections() const;
+	constexpr const char* SerializeVersionString() const { return "PolyMesh_Version"; }
+
 protected:
 	void on_append_new_face(int NewGroupID);
+
+	bool store_section(uint32_t SectionID, GS::ISerializer& SectionSerializer) const;
+	bool restore_section(uint32_t SectionID, GS::ISerializer& SectionSerializer);
+	uint32_t add_section_dependencies(uint32_t Sections) const;
 };
 
 
@@ -289,7 +389,7 @@ int PolyMesh::GetNumFaceVertices(const Face& Face) const
 	switch (Face.Type)  {
 		case 0: return 3; 
 		case 1: return 4;
-		case 2: return Polygons[Face.Index].VertexCount;
+		case 2: return GetPolygonVertexCount(Face.Index);
 		default: return 0;
 	}
 }
@@ -333,37 +433,53 @@ QuadVtxPositions PolyMesh::GetQuadVertices(int QuadIndex) const {
 }
 
 int PolyMesh::GetPolygonCount() const {
-	return (int)Polygons.size();
+	return (int)PolygonOffsets.size() - 1;
 }
-const PolyMesh::Polygon& PolyMesh::GetPolygon(int Index) const {
-	return Polygons[Index];
+int PolyMesh::GetPolygonVertexCount(int PolygonIndex) const {
+	return PolygonOffsets[PolygonIndex + 1] - PolygonOffsets[PolygonIndex];
 }
-const PolyMesh::Polygon& PolyMesh::GetPolygon(const Face& Face) const {
+const_buffer_view<int> PolyMesh::GetPolygon(int Index) const {
+	return const_buffer_view<int>(PolygonVertices.raw_pointer(PolygonOffsets[Index]), GetPolygonVertexCount(Index));
+}
+const_buffer_view<int> PolyMesh::GetPolygon(const Face& Face) const {
 	gs_debug_assert(Face.Type == 2);
-	return Polygons[Face.Index];
+	return GetPolygon((int)Face.Index);
+}
+void PolyMesh::SetPolygon(int PolygonIndex, const_buffer_view<int> NewVertices) {
+	int VertexCount = GetPolygonVertexCount(PolygonIndex);
+	gs_debug_assert((int)NewVertices.size() == VertexCount);
+	int* Vertices = PolygonVertices.raw_pointer(PolygonOffsets[PolygonIndex]);
+	for (int j = 0; j < VertexCount; ++j)
+		Vertices[j] = NewVertices[j];
+}
+const_buffer_view<int> PolyMesh::GetPolygonNormals(int PolygonIndex, int NormalSet) const {
+	return const_buffer_view<int>(NormalSets.GetPolygonElementIndices(PolygonOffsets[PolygonIndex], NormalSet), GetPolygonVertexCount(PolygonIndex));
 }
-void PolyMesh::SetPolygon(int PolygonIndex, PolyMesh::Polygon&& NewPolygon) {
-	Polygons[PolygonIndex] = std::move(NewPolygon);
+const_buffer_view<int> PolyMesh::GetPolygonUVs(int PolygonIndex, int UVSet) const {
+	return const_buffer_view<int>(UVSets.GetPolygonElementIndices(PolygonOffsets[PolygonIndex], UVSet), GetPolygonVertexCount(PolygonIndex));
+}
+const_buffer_view<int> PolyMesh::GetPolygonColors(int PolygonIndex, int ColorSet) const {
+	return const_buffer_view<int>(ColorSets.GetPolygonElementIndices(PolygonOffsets[PolygonIndex], ColorSet), GetPolygonVertexCount(PolygonIndex));
 }
 
 
 int PolyMesh::GetFaceVertexCount(int FaceIndex) const
 {
-	gs_debug_assert(FaceIndex >= 0 && FaceIndex < Faces.size());
+	gs_debug_assert(FaceIndex >= 0 && FaceIndex < (int)Faces.size());
 	return GetFaceVertexCount(Faces[FaceIndex]);
 }
 int PolyMesh::GetFaceVertexCount(const Face& Face) const
 {
 	if (Face.Type == 0) return 3;
 	else if (Face.Type == 1) return 4;
-	else if (Face.Type == 2) return Polygons[Face.Index].VertexCount;
+	else if (Face.Type == 2) return GetPolygonVertexCount(Face.Index);
 	return 0;
 }
 int PolyMesh::GetFaceVertex(const Face& Face, int FaceVertexIndex) const
 {
 	if (Face.Type == 0) return Triangles[Face.Index][FaceVertexIndex];
 	else if (Face.Type == 1) return Quads[Face.Index][FaceVertexIndex];
-	else if (Face.Type == 2) return Polygons[Face.Index].Vertices[FaceVertexIndex];
+	else if (Face.Type == 2) return PolygonVertices[PolygonOffsets[Face.Index] + FaceVertexIndex];
 	return -1;
 }
 
@@ -372,10 +488,14 @@ int PolyMesh::GetNumFaceGroupSets() const {
 	return NumFaceGroupSets;
 }
 int PolyMesh::GetFaceGroup(int FaceIndex, int GroupSet) const {
-	return FaceGroups[FaceIndex*NumFaceGroupSets + GroupSet];
+	return FaceGroupSets[GroupSet][FaceIndex];
 }
 void PolyMesh::SetFaceGroup(int FaceIndex, int NewGroup, int GroupSet) {
-	FaceGroups[FaceIndex*NumFaceGroupSets + GroupSet] = NewGroup;
+	FaceGroupSets[GroupSet][FaceIndex] = NewGroup;
+}
+const_buffer_view<int> PolyMesh::GetFaceGroupSet(int GroupSet) const {
+	gs_debug_assert(GroupSet >= 0 && GroupSet < (int)NumFaceGroupSets);
+	return FaceGroupSets[GroupSet].get_view();
 }
 
 int PolyMesh::GetNumNormalSets() const {
@@ -393,8 +513,7 @@ void PolyMesh::SetNormal(int NormalIndex, const Vector3f& NewNormal, int NormalS
 int PolyMesh::GetFaceVertexNormalIndex(const Face& Face, int FaceVertexIndex, int NormalSet) const
 {
 	if (Face.Type == 2) {
-		const Polygon& Poly = Polygons[Face.Index];
-		return Poly.Normals[(Poly.VertexCount*NormalSet) + FaceVertexIndex];
+		return NormalSets.GetPolygonElementIndices(PolygonOffsets[Face.Index], NormalSet)[FaceVertexIndex];
 	}
 	return NormalSets.GetFaceVertexElementIndex(Face.Type, Face.Index, FaceVertexIndex, NormalSet);
 }
@@ -419,9 +538,8 @@ void PolyMesh::SetUV(int UVIndex, const Vector2d& NewUV, int UVSet) {
 }
 int PolyMesh::GetFaceVertexUVIndex(const Face& Face, int FaceVertexIndex, int UVSet) const
 {
-	if (Face.Type == 2)	{
-		const Polygon& Poly = Polygons[Face.Index];
-		return Poly.UVs[(Poly.VertexCount*UVSet) + FaceVertexIndex];
+	if (Face.Type == 2) {
+		return UVSets.GetPolygonElementIndices(PolygonOffsets[Face.Index], UVSet)[FaceVertexIndex];
 	}
 	return UVSets.GetFaceVertexElementIndex(Face.Type, Face.Index, FaceVertexIndex, UVSet);
 }
@@ -448,8 +566,7 @@ void PolyMesh::SetColor(int ColorIndex, const Vector4f& NewColor, int ColorSet)
 int PolyMesh::GetFaceVertexColorIndex(const Face& Face, int FaceVertexIndex, int ColorSet) const
 {
 	if (Face.Type == 2) {
-		const Polygon& Poly = Polygons[Face.Index];
-		return Poly.Colors[(Poly.VertexCount*ColorSet) + FaceVertexIndex];
+		return ColorSets.GetPolygonElementIndices(PolygonOffsets[Face.Index], ColorSet)[FaceVertexIndex];
 	}
 	return ColorSets.GetFaceVertexElementIndex(Face.Type, Face.Index, FaceVertexIndex, ColorSet);
 }
@@ -1,116 +1,146 @@
 // Copyright Gradientspace Corp. All Rights Reserved.
 #pragma once
 
+#include "Core/gs_debug.h"
 #include "Core/unsafe_vector.h"
 #include "Math/GSIndex3.h"
 #include "Math/GSIndex4.h"
 
+#include <utility>
 
-namespace GS 
+
+namespace GS
 {
 
+/**
+ * A single set of an IndexedPolyMeshAttribute. The element values and the per-face element indices
+ * are stored in separate arrays, so a set can be added, removed or iterated independently of other sets.
+ */
 template<typename ElementType>
-struct IndexedAttributeBase
+struct PolyMeshAttributeSet
 {
-	uint8_t NumSets = 0;
-	Index4i SetCounts = Index4i::Zero();
-	Index4i SetOffsets = Index4i::Zero();
 	unsafe_vector<ElementType> Values;
+	//! element index tuple for each triangle
+	unsafe_vector<Index3i> Triangles;
+	//! element index tuple for each quad
+	unsafe_vector<Index4i> Quads;
+	//! element index for each polygon vertex, in the same packed order as the polygon vertices
+	unsafe_vector<int> Polygons;
 
-	void ClearBase()
+	void Clear()
 	{
-		NumSets = 0;
-		SetCounts = Index4i::Zero();
-		SetOffsets = Index4i::Zero();
 		Values.clear();
+		Triangles.clear();
+		Quads.clear();
+		Polygons.clear();
+	}
+
+	//! release all memory. unsafe_vector move-assignment does not free existing storage, so this must be called before moving another set into this one
+	void Reset()
+	{
+		Values.clear(true);
+		Triangles.clear(true);
+		Quads.clear(true);
+		Polygons.clear(true);
+		*this = PolyMeshAttributeSet();
+	}
+};
+
+
+/**
+ * Up to MaxSets sets of indexed per-face-vertex attributes, see PolyMeshAttributeSet.
+ */
+template<typename ElementType>
+struct IndexedPolyMeshAttribute
+{
+	static constexpr int MaxSets = 4;
+
+	uint8_t NumSets = 0;
+	PolyMeshAttributeSet<ElementType> Sets[MaxSets];
+
+	void Clear()
+	{
+		for (int k = 0; k < MaxSets; ++k)
+			Sets[k].Clear();
+		NumSets = 0;
 	}
 
 	int GetNumSets() const {
 		return NumSets;
 	}
 
-	int AddSet(size_t NumElements)
+	//! add a new set with NumElements (uninitialized) values. The element indices of the existing faces are initialized to -1.
+	int AddSet(size_t NumElements, int NumTriangles, int NumQuads, int NumPolygonVertices)
 	{
-		if (NumSets == 4)
+		if (NumSets == MaxSets)
 		{
 			gs_runtime_assert(false);
 			return -1;
 		}
 		int NewSetIndex = NumSets;
 		NumSets++;
-		SetCounts[NewSetIndex] = (int)NumElements;
-		SetOffsets[NewSetIndex] = (int)Values.size();
-		Values.grow(NumElements);
+		PolyMeshAttributeSet<ElementType>& Set = Sets[NewSetIndex];
+		Set.Clear();
+		Set.Values.resize(NumElements);
+		Set.Triangles.initialize(NumTriangles, Index3i(-1));
+		Set.Quads.initialize(NumQuads, Index4i(-1));
+		Set.Polygons.initialize(NumPolygonVertices, -1);
 		return NewSetIndex;
 	}
 
-	//! add an element to the last set, and return it's index, in that set
-	int AppendElementToLastSet(const ElementType& Value)
+	//! remove a set, the following sets are shifted down
+	void RemoveSet(int SetIndex)
 	{
-		uint8_t LastSetIndex = NumSets - 1;
-		SetCounts[LastSetIndex]++;
-		int NewIndex = (int)Values.add(Value);
-		return NewIndex - SetOffsets[LastSetIndex];
+		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets);
+		Sets[SetIndex].Reset();
+		for (int k = SetIndex; k < NumSets - 1; ++k)
+			Sets[k] = std::move(Sets[k + 1]);
+		NumSets--;
 	}
 
-	//! add num elements to last set. return index of first new element, in that set.
-	int AppendElementsToLastSet(int NumNewElements)
+	//! add an element to the set, and return it's index
+	int AppendElement(const ElementType& Value, int SetIndex)
 	{
-		uint8_t LastSetIndex = NumSets - 1;
-		SetCounts[LastSetIndex] += NumNewElements;
-		int StartIndex = (int)Values.size() - SetOffsets[LastSetIndex];
-		Values.grow(NumNewElements);
-		return StartIndex;
+		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets);
+		return (int)Sets[SetIndex].Values.add(Value);
 	}
 
+	//! add num (uninitialized) elements to the set. return index of first new element.
+	int AppendElements(int NumNewElements, int SetIndex)
+	{
+		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets);
+		return (int)Sets[SetIndex].Values.grow(NumNewElements);
+	}
 
 	int GetElementCount(int SetIndex) const
 	{
 		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets);
-		return SetCounts[SetIndex];
+		return (int)Sets[SetIndex].Values.size();
 	}
 
 	const ElementType& GetElement(int ElementIndex, int SetIndex = 0) const {
-		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets && ElementIndex >= 0 && ElementIndex < SetCounts[SetIndex]);
-		int Index = SetOffsets[SetIndex] + ElementIndex;
-		return Values[Index];
+		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets && ElementIndex >= 0 && ElementIndex < (int)Sets[SetIndex].Values.size());
+		return Sets[SetIndex].Values[ElementIndex];
 	}
 
 	void SetElement(int ElementIndex, const ElementType& NewValue, int SetIndex = 0) {
-		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets && ElementIndex >= 0 && ElementIndex < SetCounts[SetIndex]);
-		int Index = SetOffsets[SetIndex] + ElementIndex;
-		Values[Index] = NewValue;
+		gs_debug_assert(SetIndex >= 0 && SetIndex < NumSets && ElementIndex >= 0 && ElementIndex < (int)Sets[SetIndex].Values.size());
+		Sets[SetIndex].Values[ElementIndex] = NewValue;
 	}
-};
-
-template<typename ElementType>
-struct IndexedPolyMeshAttribute : public IndexedAttributeBase<ElementType>
-{
-	using IndexedAttributeBase<ElementType>::NumSets;
-
-	unsafe_vector<Index3i> Triangles;
-	unsafe_vector<Index4i> Quads;
 
-	void Clear()
-	{
-		IndexedAttributeBase<ElementType>::ClearBase();
-		Triangles.clear();
-		Quads.clear();
-	}
 
+	//! AllElementTriangles must contain a tuple for each set, or be null
 	void AddTriangle(const Index3i* AllElementTriangles,
 					 bool bSkipInitialization)
 	{
-		int start_index = (int)Triangles.grow(NumSets);
-		if (AllElementTriangles)
-		{
-			for (int j = 0; j < NumSets; ++j)
-				Triangles[start_index + j] = AllElementTriangles[j];
-		}
-		else if (!bSkipInitialization) 
+		for (int j = 0; j < NumSets; ++j)
 		{
-			for (int j = 0; j < NumSets; ++j)
-				Triangles[start_index + j] = Index3i(-1);
+			if (AllElementTriangles)
+				Sets[j].Triangles.add(AllElementTriangles[j]);
+			else if (!bSkipInitialization)
+				Sets[j].Triangles.add(Index3i(-1));
+			else
+				Sets[j].Triangles.grow(1);
 		}
 	}
 
@@ -118,29 +148,28 @@ struct IndexedPolyMeshAttribute : public IndexedAttributeBase<ElementType>
 	{
 		if (SingleSetIndex == -1) {
 			for (int j = 0; j < NumSets; ++j)
-				Triangles[TriangleIndex*NumSets + j] = ElementTriangles[j];
+				Sets[j].Triangles[TriangleIndex] = ElementTriangles[j];
 		}
 		else
-			Triangles[TriangleIndex*NumSets + SingleSetIndex] = ElementTriangles[0];
+			Sets[SingleSetIndex].Triangles[TriangleIndex] = ElementTriangles[0];
 	}
 	void SetTriangle(int TriangleIndex, const Index3i& ElementTriangle, int SingleSetIndex)
 	{
-		Triangles[TriangleIndex*NumSets + SingleSetIndex] = ElementTriangle;
+		Sets[SingleSetIndex].Triangles[TriangleIndex] = ElementTriangle;
 	}
 
+	//! AllElementQuads must contain a tuple for each set, or be null
 	void AddQuad(const Index4i* AllElementQuads,
 		bool bSkipInitialization)
 	{
-		int start_index = (int)Quads.grow(NumSets);
-		if (AllElementQuads)
+		for (int j = 0; j < NumSets; ++j)
 		{
-			for (int j = 0; j < NumSets; ++j)
-				Quads[start_index + j] = AllElementQuads[j];
-		}
-		else if (!bSkipInitialization)
-		{
-			for (int j = 0; j < NumSets; ++j)
-				Quads[start_index + j] = Index4i(-1);
+			if (AllElementQuads)
+				Sets[j].Quads.add(AllElementQuads[j]);
+			else if (!bSkipInitialization)
+				Sets[j].Quads.add(Index4i(-1));
+			else
+				Sets[j].Quads.grow(1);
 		}
 	}
 
@@ -148,23 +177,59 @@ struct IndexedPolyMeshAttribute : public IndexedAttributeBase<ElementType>
 	{
 		if (SingleSetIndex == -1) {
 			for (int j = 0; j < NumSets; ++j)
-				Quads[QuadIndex*NumSets + j] = ElementQuads[j];
+				Sets[j].Quads[QuadIndex] = ElementQuads[j];
 		}
 		else
-			Quads[QuadIndex*NumSets + SingleSetIndex] = ElementQuads[0];
+			Sets[SingleSetIndex].Quads[QuadIndex] = ElementQuads[0];
 	}
 	void SetQuad(int QuadIndex, const Index4i& ElementQuad, int SingleSetIndex)
 	{
-		Quads[QuadIndex*NumSets + SingleSetIndex] = ElementQuad;
+		Sets[SingleSetIndex].Quads[QuadIndex] = ElementQuad;
+	}
+
+	//! append indices for a polygon. AllSetIndices must contain NumSets*VertexCount indices ordered
+	//! [Set0V0 ... Set0VN, Set1V0, ... Set1VN, ...], or be null
+	void AddPolygon(int VertexCount, const int* AllSetIndices, bool bSkipInitialization)
+	{
+		for (int j = 0; j < NumSets; ++j)
+		{
+			if (AllSetIndices) {
+				Sets[j].Polygons.append(&AllSetIndices[j * VertexCount], VertexCount);
+			} else {
+				int start_index = (int)Sets[j].Polygons.grow(VertexCount);
+				if (!bSkipInitialization) {
+					for (int k = 0; k < VertexCount; ++k)
+						Sets[j].Polygons[start_index + k] = -1;
+				}
+			}
+		}
+	}
+
+	//! ElementIndices must contain NumSets*VertexCount indices ordered per-set, or VertexCount indices if SingleSetIndex is given
+	void SetPolygon(int PolygonOffset, int VertexCount, const int* ElementIndices, int SingleSetIndex = -1)
+	{
+		if (SingleSetIndex == -1) {
+			for (int j = 0; j < NumSets; ++j)
+				for (int k = 0; k < VertexCount; ++k)
+					Sets[j].Polygons[PolygonOffset + k] = ElementIndices[j * VertexCount + k];
+		} else {
+			for (int k = 0; k < VertexCount; ++k)
+				Sets[SingleSetIndex].Polygons[PolygonOffset + k] = ElementIndices[k];
+		}
+	}
+
+	const int* GetPolygonElementIndices(int PolygonOffset, int SetIndex = 0) const
+	{
+		return Sets[SetIndex].Polygons.raw_pointer(PolygonOffset);
 	}
 
 	int GetFaceVertexElementIndex(int FaceType, int FaceTypeIndex, int FaceVertexIndex, int SetIndex = 0) const
 	{
 		if (FaceType == 0) {
-			return Triangles[FaceTypeIndex*NumSets + SetIndex][FaceVertexIndex];
+			return Sets[SetIndex].Triangles[FaceTypeIndex][FaceVertexIndex];
 		}
 		else if (FaceType == 1) {
-			return Quads[FaceTypeIndex*NumSets + SetIndex][FaceVertexIndex];
+			return Sets[SetIndex].Quads[FaceTypeIndex][FaceVertexIndex];
 		}
 		return -1;
 	}
@@ -172,12 +237,12 @@ struct IndexedPolyMeshAttribute : public IndexedAttributeBase<ElementType>
 	bool GetFaceElementIndices(int FaceType, int FaceTypeIndex, int* IndexBuffer, int SetIndex = 0) const
 	{
 		if (FaceType == 0) {
-			const Index3i& Tri = Triangles[FaceTypeIndex*NumSets + SetIndex];
+			const Index3i& Tri = Sets[SetIndex].Triangles[FaceTypeIndex];
 			IndexBuffer[0] = Tri.A; IndexBuffer[1] = Tri.B; IndexBuffer[2] = Tri.C;
 			return true;
 		}
 		else if (FaceType == 1) {
-			const Index4i& Quad = Quads[FaceTypeIndex*NumSets + SetIndex];
+			const Index4i& Quad = Sets[SetIndex].Quads[FaceTypeIndex];
 			IndexBuffer[0] = Quad.A; IndexBuffer[1] = Quad.B; IndexBuffer[2] = Quad.C; IndexBuffer[3] = Quad.D;
 			return true;
 		}
@@ -0,0 +1,90 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/buffer_view.h"
+#include "Core/unsafe_vector.h"
+#include "Math/GSVector2.h"
+#include "Math/GSVector3.h"
+#include "Math/GSIndex3.h"
+
+namespace GS
+{
+
+class PolyMesh;
+
+//! polygons with up to this many vertices are triangulated using stack memory
+constexpr int PolygonTriangulationInlineVertexCount = 64;
+
+/**
+ * Triangulate a simple 2D polygon, of either orientation. Writes VertexCount-2 triangles to TrianglesOut,
+ * as indices into Vertices, and returns the number of triangles written (0 if VertexCount < 3).
+ * The output triangles have the same orientation as the polygon.
+ *
+ * Convex polygons are fan-triangulated from vertex 0. Concave polygons are triangulated by ear clipping,
+ * where only the reflex vertices need to be tested for containment in each candidate ear. If the polygon
+ * is not simple (eg self-intersecting) and no valid ear exists, degenerate ears and then arbitrary vertices
+ * are clipped, so VertexCount-2 triangles are always produced.
+ * Polygons with up to PolygonTriangulationInlineVertexCount vertices do not allocate memory, and test each ear
+ * against all remaining reflex vertices. Larger polygons store the reflex vertices in a uniform grid, so each ear
+ * is only tested against the reflex vertices near its bounding box. Ear clipping is still O(N^2) in the worst case.
+ */
+GRADIENTSPACECORE_API
+int TriangulatePolygon(const_buffer_view<Vector2d> Vertices, Index3i* TrianglesOut);
+
+/**
+ * Triangulate a 3D polygon by projecting it to the axis plane that best matches the polygon normal
+ * (computed with Newell's method), and then triangulating the 2D polygon as above.
+ * Output triangles have the same orientation as the polygon.
+ */
+GRADIENTSPACECORE_API
+int TriangulatePolygon(const_buffer_view<Vector3d> Vertices, Index3i* TrianglesOut);
+
+/**
+ * Triangulate face FaceIndex of Mesh. Writes GetFaceVertexCount(FaceIndex)-2 triangles of face-local
+ * corner indices (ie in range [0,VertexCount)) to TrianglesOut. The triangles have the same orientation as the face.
+ * Returns the number of triangles written.
+ */
+GRADIENTSPACECORE_API
+int TriangulatePolyMeshFace(const PolyMesh& Mesh, int FaceIndex, Index3i* TrianglesOut);
+
+
+struct PolyMeshTriangulationOptions
+{
+	//! if true, TrianglesOut contains mesh vertex indices, otherwise face-local corner indices
+	bool bOutputVertexIndices = true;
+
+	bool bParallel = true;
+};
+
+/**
+ * Compute the triangle offset of each face of Mesh, ie FaceTriangleOffsetsOut[i] is the index of the first
+ * triangle of face i, and FaceTriangleOffsetsOut[FaceCount] is the total triangle count, which is returned.
+ * Faces with less than 3 vertices have no triangles.
+ */
+GRADIENTSPACECORE_API
+int ComputePolyMeshTriangleOffsets(const PolyMesh& Mesh, unsafe_vector<int>& FaceTriangleOffsetsOut, bool bParallel = true);
+
+/**
+ * Triangulate all faces of Mesh in parallel into TrianglesOut, which must be pre-allocated to the total triangle
+ * count returned by ComputePolyMeshTriangleOffsets(). The triangles of face i are written starting at FaceTriangleOffsets[i].
+ */
+GRADIENTSPACECORE_API
+void TriangulatePolyMesh(
+	const PolyMesh& Mesh,
+	const_buffer_view<int> FaceTriangleOffsets,
+	Index3i* TrianglesOut,
+	const PolyMeshTriangulationOptions& Options = PolyMeshTriangulationOptions());
+
+/**
+ * Triangulate all faces of Mesh, resizing TrianglesOut and FaceTriangleOffsetsOut as needed.
+ */
+GRADIENTSPACECORE_API
+void TriangulatePolyMesh(
+	const PolyMesh& Mesh,
+	unsafe_vector<Index3i>& TrianglesOut,
+	unsafe_vector<int>& FaceTriangleOffsetsOut,
+	const PolyMeshTriangulationOptions& Options = PolyMeshTriangulationOptions());
+
+
+} // end namespace GS
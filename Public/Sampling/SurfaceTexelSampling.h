@@ -11,10 +11,15 @@
 #include "Math/GSIntAxisBox2.h"
 #include "Math/GSAxisBox3.h"
 #include "Mesh/MeshView2.h"
+#include "Spatial/PointHashGrid3.h"
+#include "Core/ContentHash.h"
+#include "Core/gs_serializer.h"
 
 namespace GS
 {
 
+class DerivedDataCache;
+
 struct GRADIENTSPACECORE_API TexelPoint3d
 {
 	Vector2i PixelPos;
@@ -36,10 +41,37 @@ public:
 		FunctionRef<Vector3d(int,Vector3d)> ComputeTriBaryPoint3DFUnc
 	);
 
+	//! compute the DerivedDataCache key for samples of UVMesh at the given image dimensions
+	static ContentHash128 MakeCacheKey(const ContentHash128& UVMeshHash, const ContentHash128& SurfaceHash, int ImageWidth, int ImageHeight);
+
+	//! Restore from Cache if available, otherwise Build() and add to the Cache. SurfaceHash must identify the 3D surface
+	//! evaluated by ComputeTriBaryPoint3DFunc, the UV mesh is hashed internally. The UV box tree is also cached.
+	//! Returns true if the samples were restored from the Cache.
+	bool BuildCached(DerivedDataCache& Cache, const ContentHash128& SurfaceHash,
+		ConstMeshView2d UVMesh, int ImageWidth, int ImageHeight,
+		FunctionRef<Vector3d(int,Vector3d)> ComputeTriBaryPoint3DFunc
+	);
+
+	void Clear();
+
+	//! build a hash grid over the SurfacePos of the TexelSamples, with PointIDs equal to sample indices.
+	//! RadiusQuery() on the grid finds the samples inside a brush, eg the StampTexelPoints for SurfacePaintStroke::AppendStrokeStamp().
+	//! CellSize should be close to the typical query radius. If CellSize <= 0, it is estimated from SampleBounds and the sample count.
+	void BuildSampleGrid(PointHashGrid3d& GridOut, double CellSize = 0, bool bParallel = true) const;
+
+	bool Store(GS::ISerializer& Serializer) const;
+	bool Restore(GS::ISerializer& Serializer);
+	constexpr const char* SerializeVersionString() const { return "SurfaceTexelSampling_Version"; }
+
 	int NumSamples() const { return (int)TexelSamples.size(); }
 
 	TexelPoint3d& operator[](int Index) { return TexelSamples[Index]; }
 	const TexelPoint3d& operator[](int Index) const { return TexelSamples[Index]; }
+
+protected:
+	void build_samples(const ConstMeshView2d& UVMesh, int ImageWidth, int ImageHeight,
+		FunctionRef<Vector3d(int,Vector3d)> ComputeTriBaryPoint3DFunc,
+		DerivedDataCache* Cache, const ContentHash128& UVMeshHash);
 };
 
 
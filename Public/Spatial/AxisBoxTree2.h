@@ -4,20 +4,50 @@
 #include "GradientspacePlatform.h"
 #include "Core/FunctionRef.h"
 #include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
+#include "Core/ContentHash.h"
+#include "Core/gs_serializer.h"
 #include "Math/GSVector2.h"
 #include "Math/GSAxisBox2.h"
 #include "Math/GSIndex2.h"
 #include "Math/GSIndex4.h"
 #include "Spatial/SpatialResult2.h"
+#include "Spatial/SpatialQueryTypes.h"
+#include "Core/inline_stack.h"
 
 namespace GS
 {
 
+class DerivedDataCache;
 
-template<typename RealType>
-struct DistanceQueryOptions
+
+enum class EAxisBoxTreeBuildMethod : uint8_t
 {
-	RealType MaxDistance = RealConstants<RealType>::SafeMaxValue();
+	//! split on the longest axis at the center of the group bounds
+	Midpoint = 0,
+	//! binned surface-area-heuristic split (half-perimeter in 2D), better for uneven box distributions
+	BinnedSAH = 1
+};
+
+struct AxisBoxTree2BuildOptions
+{
+	EAxisBoxTreeBuildMethod Method = EAxisBoxTreeBuildMethod::BinnedSAH;
+	//! maximum number of boxes in a leaf, in range [1,15]
+	int MaxLeafSize = 4;
+	//! number of split-candidate bins per axis for BinnedSAH, in range [2,32]
+	int NumSAHBins = 16;
+	//! build with GS::ParallelFor. GetBoxFunc must be thread-safe in this case.
+	bool bParallel = true;
+};
+
+struct AxisBoxTree2UpdateOptions
+{
+	//! UpdateElements() rebuilds a subtree when the summed half-perimeter of its child bounds grows past this multiple of its value at build time
+	double RebuildQualityThreshold = 2.0;
+	//! degraded subtrees with more elements than this are not rebuilt by UpdateElements(), to bound the cost of each update
+	int MaxRebuildElements = 4096;
+	//! if > 0, every N'th call to UpdateElements() rebuilds the whole tree from its current element boxes instead of an incremental update
+	int FullRebuildInterval = 0;
 };
 
 
@@ -32,6 +62,89 @@ public:
 		FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc,
 		int32_t CountHint = 0);
 
+	void Build(
+		int32_t MaxBoxID,
+		FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc,
+		const AxisBoxTree2BuildOptions& Options,
+		int32_t CountHint = 0);
+
+	//! compute the DerivedDataCache key for a tree built from the boxes identified by BoxesHash
+	static ContentHash128 MakeCacheKey(const ContentHash128& BoxesHash, int32_t MaxBoxID, const AxisBoxTree2BuildOptions& Options);
+
+	//! Restore from Cache if available, otherwise Build() and add to the Cache. BoxesHash must identify
+	//! the boxes returned by GetBoxFunc (eg the ContentHash of the source mesh). Returns true if restored from the Cache.
+	bool BuildCached(
+		DerivedDataCache& Cache,
+		const ContentHash128& BoxesHash,
+		int32_t MaxBoxID,
+		FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc,
+		const AxisBoxTree2BuildOptions& Options = AxisBoxTree2BuildOptions(),
+		int32_t CountHint = 0);
+
+	/**
+	 * Find all pairs of elements (ThisID, OtherID) whose boxes in this tree and OtherTree intersect or touch, 
+	 * via simultaneous traversal of both trees. If bParallel is true, the traversal is split into subtree pairs 
+	 * that are processed via ParallelFor, and PairFunc is called concurrently, so it must be thread-safe.
+	 */
+	void FindOverlappingPairs(
+		const AxisBoxTree2& OtherTree,
+		FunctionRef<void(int ThisID, int OtherID)> PairFunc,
+		bool bParallel = true) const;
+
+	/**
+	 * Collect all overlapping pairs (ThisID, OtherID) into PairsOut. Each parallel job collects into its own
+	 * buffer and these are appended in job order, so the output is deterministic. If PairFilterFunc is 
+	 * non-null, only pairs where it returns true are kept (eg for an exact element overlap test), and it 
+	 * is called concurrently if bParallel is true.
+	 */
+	void FindOverlappingPairs(
+		const AxisBoxTree2& OtherTree,
+		unsafe_vector<Index2i>& PairsOut,
+		FunctionRef<bool(int ThisID, int OtherID)> PairFilterFunc = nullptr,
+		bool bParallel = true) const;
+
+	/**
+	 * Find all pairs of elements in this tree whose boxes intersect or touch. Each pair is reported once, as (IDA,IDB) with IDA < IDB.
+	 * PairFunc is called concurrently if bParallel is true.
+	 */
+	void FindSelfOverlaps(
+		FunctionRef<void(int IDA, int IDB)> PairFunc,
+		bool bParallel = true) const;
+
+	//! collect all self-overlapping pairs into PairsOut, see FindOverlappingPairs() and FindSelfOverlaps() above
+	void FindSelfOverlaps(
+		unsafe_vector<Index2i>& PairsOut,
+		FunctionRef<bool(int IDA, int IDB)> PairFilterFunc = nullptr,
+		bool bParallel = true) const;
+
+	/**
+	 * Recompute all element boxes via GetBoxFunc and refit the node bounds bottom-up, without changing the tree topology.
+	 * Subtrees are refit in parallel if bParallel is true, in which case GetBoxFunc must be thread-safe.
+	 * If GetBoxFunc returns false for an element, its previous box is kept.
+	 */
+	void Refit(
+		FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc, 
+		bool bParallel = true);
+
+	/**
+	 * Update the boxes of the given elements via GetBoxFunc and refit the bounds of their ancestor nodes.
+	 * Subtrees whose quality degrades past Options.RebuildQualityThreshold are rebuilt, and the whole tree
+	 * is rebuilt if that leaves too many unused nodes, or every Options.FullRebuildInterval calls.
+	 * ElementIDs that are not in the tree are ignored. The first call builds the element-to-leaf mapping, which is O(N).
+	 * @return true if any subtree, or the whole tree, was rebuilt
+	 */
+	bool UpdateElements(
+		const_buffer_view<int> ElementIDs,
+		FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc,
+		const AxisBoxTree2UpdateOptions& Options = AxisBoxTree2UpdateOptions());
+
+	void Clear();
+
+	//! the build options are stored with the tree, so UpdateElements() rebuilds a restored tree with the same options
+	bool Store(GS::ISerializer& Serializer) const;
+	bool Restore(GS::ISerializer& Serializer);
+	constexpr const char* SerializeVersionString() const { return "AxisBoxTree2_Version"; }
+
 	//! find ElementID of box that contains Point and passes ElementTestFunc
 	int PointContainmentQuery(
 		Vector2<RealType> Point,
@@ -49,6 +162,66 @@ public:
 		FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
 		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>() ) const;
 
+	/**
+	 * Compute PointDistanceQuery() for each point in Points, results are returned in ResultsOut in the same order.
+	 * Points are sorted along a Morton curve and traversed in packets of nearby points that share node culling,
+	 * and packets are processed in parallel tiles if bParallel is true (in which case ElementDistanceSqrFunc must be thread-safe).
+	 */
+	void PointDistanceQueryBatch(
+		const_buffer_view<Vector2<RealType>> Points,
+		FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+		unsafe_vector<DistanceResult2<RealType>>& ResultsOut,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>(),
+		bool bParallel = true) const;
+
+	/**
+	 * Call FoundElementFunc for all ElementIDs with boxes that intersect or touch QueryBox.
+	 * Returns false if no elements were found.
+	 * The templated overload accepts any callable, so that the callback can be inlined.
+	 */
+	bool BoxOverlapQuery(
+		const AxisBox2<RealType>& QueryBox,
+		FunctionRef<void(int)> FoundElementFunc) const;
+	template<typename FoundElementFuncType>
+	bool BoxOverlapQuery(
+		const AxisBox2<RealType>& QueryBox,
+		FoundElementFuncType&& FoundElementFunc) const;
+
+	/**
+	 * Call FoundElementFunc(ElementID, BoxDistanceSqr) for all ElementIDs with boxes within Radius of Point.
+	 * BoxDistanceSqr is the squared distance from Point to the element box, which is a lower bound on
+	 * the distance to the element itself, so the callback should do any exact element test.
+	 * Returns false if no elements were found.
+	 */
+	bool RadiusQuery(
+		Vector2<RealType> Point,
+		RealType Radius,
+		FunctionRef<void(int, RealType)> FoundElementFunc) const;
+	template<typename FoundElementFuncType>
+	bool RadiusQuery(
+		Vector2<RealType> Point,
+		RealType Radius,
+		FoundElementFuncType&& FoundElementFunc) const;
+
+	/**
+	 * Find the (up to) K nearest elements to Point, within Options.MaxDistance.
+	 * ResultsOut must have space for K results, and is used as a bounded priority list during the query.
+	 * Found elements are returned sorted by increasing distance, and the number found is returned.
+	 */
+	int KNearestQuery(
+		Vector2<RealType> Point,
+		int K,
+		FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+		DistanceResult2<RealType>* ResultsOut,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>() ) const;
+	template<typename ElementDistanceSqrFuncType>
+	int KNearestQuery(
+		Vector2<RealType> Point,
+		int K,
+		ElementDistanceSqrFuncType&& ElementDistanceSqrFunc,
+		DistanceResult2<RealType>* ResultsOut,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>() ) const;
+
 	void Validate();
 
 public:
@@ -78,11 +251,211 @@ public:
 
 
 private:
+	void packet_distance_query(
+		const Vector2<RealType>* Points, const int32_t* PointIndices, int NumPoints,
+		FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+		const DistanceQueryOptions<RealType>& Options, DistanceResult2<RealType>* ResultsOut) const;
+
+	void build_midpoint(int32_t MaxBoxID, FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc, int32_t CountHint, int MaxLeafSize);
+	void build_binned_sah(int32_t MaxBoxID, FunctionRef<bool(int, AxisBox2<RealType>& Box)> GetBoxFunc, const AxisBoxTree2BuildOptions& Options);
+
+	// max inline depth of query traversal stacks. Deeper trees spill to the heap.
+	static constexpr int QueryStackSize = 64;
+
+	// AxisBox2::Intersects() excludes touching boxes, queries include them so that degenerate boxes can be found
+	static bool boxes_overlap(const AxisBox2<RealType>& A, const AxisBox2<RealType>& B) {
+		return !((B.Max.X < A.Min.X) || (B.Min.X > A.Max.X) || (B.Max.Y < A.Min.Y) || (B.Min.Y > A.Max.Y));
+	}
+
+	// incremental-update state, built on first UpdateElements() call and discarded by Build()/Clear()/Restore().
+	// parent references are encoded as (NodeIndex<<1)|IsRightChild, -1 is the root and -2 is an unused node
+	int32_t BuildMaxBoxID = 0;
+	AxisBoxTree2BuildOptions LastBuildOptions;
+	bool bUpdateStateValid = false;
+	int NumUpdatesSinceBuild = 0;
+	int32_t NumUnusedNodes = 0;
+	unsafe_vector<int32_t> BoxIDToLeafSlot;
+	unsafe_vector<int32_t> LeafSlotParents;
+	unsafe_vector<int32_t> NodeParents;
+	unsafe_vector<RealType> NodeBuildCost;
+
+	void reset_update_state();
+	void build_update_state();
+	void assign_subtree_parents(ChildIndex SubtreeRoot, int32_t ParentRef);
+	void refit_leaf_ancestors(int32_t LeafSlot, RealType RebuildThreshold, unsafe_vector<int32_t>& RebuildNodes);
+	int32_t count_subtree_elements(int32_t NodeIndex, int32_t MaxCount) const;
+	void rebuild_subtree(int32_t NodeIndex);
+	void rebuild_from_leaves();
+
+	BoxType refit_subtree(ChildIndex Index, FunctionRef<bool(int, AxisBox2<RealType>& Box)>& GetBoxFunc);
+	void collect_refit_subtrees(ChildIndex Index, int Depth, int MaxDepth, unsafe_vector<ChildIndex>& Subtrees) const;
+	BoxType refit_top(ChildIndex Index, int Depth, int MaxDepth, const BoxType* SubtreeBounds, int& NextSubtree);
+
 	void validate_leaf_child(ChildIndex Index, AxisBox2<RealType>& ComputedBounds);
 	void validate_internal_node(ChildIndex Index, AxisBox2<RealType>& ComputedBounds);
 };
 
 
+template<typename RealType>
+template<typename FoundElementFuncType>
+bool AxisBoxTree2<RealType>::BoxOverlapQuery(
+	const AxisBox2<RealType>& QueryBox,
+	FoundElementFuncType&& FoundElementFunc) const
+{
+	if (NodeTree.size() == 0 && LeafBoxLists.size() == 0)
+		return false;
+	if (boxes_overlap(RootBounds, QueryBox) == false)
+		return false;
+
+	inline_stack<ChildIndex, QueryStackSize> stack;
+	int NumFound = 0;
+	stack.push_back(RootIndex);
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox2& Box = LeafBoxLists[next.Index + j];
+				if (boxes_overlap(Box.Box, QueryBox)) {
+					FoundElementFunc(Box.BoxID);
+					NumFound++;
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			if (boxes_overlap(Node.LeftBounds, QueryBox))
+				stack.push_back(Node.LeftChild);
+			if (boxes_overlap(Node.RightBounds, QueryBox))
+				stack.push_back(Node.RightChild);
+		}
+	}
+	return NumFound > 0;
+}
+
+
+template<typename RealType>
+template<typename FoundElementFuncType>
+bool AxisBoxTree2<RealType>::RadiusQuery(
+	Vector2<RealType> QueryPoint,
+	RealType Radius,
+	FoundElementFuncType&& FoundElementFunc) const
+{
+	if (NodeTree.size() == 0 && LeafBoxLists.size() == 0)
+		return false;
+	RealType RadiusSqr = Radius * Radius;
+	if (RootBounds.DistanceSquared(QueryPoint) > RadiusSqr)
+		return false;
+
+	inline_stack<ChildIndex, QueryStackSize> stack;
+	int NumFound = 0;
+	stack.push_back(RootIndex);
+	ChildIndex next;
+	while (stack.pop_back(next))
+	{
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox2& Box = LeafBoxLists[next.Index + j];
+				RealType BoxDistSqr = Box.Box.DistanceSquared(QueryPoint);
+				if (BoxDistSqr <= RadiusSqr) {
+					FoundElementFunc(Box.BoxID, BoxDistSqr);
+					NumFound++;
+				}
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			if (Node.LeftBounds.DistanceSquared(QueryPoint) <= RadiusSqr)
+				stack.push_back(Node.LeftChild);
+			if (Node.RightBounds.DistanceSquared(QueryPoint) <= RadiusSqr)
+				stack.push_back(Node.RightChild);
+		}
+	}
+	return NumFound > 0;
+}
+
+
+template<typename RealType>
+template<typename ElementDistanceSqrFuncType>
+int AxisBoxTree2<RealType>::KNearestQuery(
+	Vector2<RealType> QueryPoint,
+	int K,
+	ElementDistanceSqrFuncType&& ElementDistanceSqrFunc,
+	DistanceResult2<RealType>* ResultsOut,
+	DistanceQueryOptions<RealType> Options) const
+{
+	if (K <= 0 || (NodeTree.size() == 0 && LeafBoxLists.size() == 0))
+		return 0;
+	RealType MaxDistSqr = Options.MaxDistance * Options.MaxDistance;
+	if (RootBounds.DistanceSquared(QueryPoint) > MaxDistSqr)
+		return 0;
+
+	struct StackBox
+	{
+		ChildIndex Index;
+		AxisBox2<RealType> Box;
+	};
+	inline_stack<StackBox, QueryStackSize> stack;
+
+	// ResultsOut is kept sorted by increasing distance. Until it is full, elements are culled by MaxDistSqr,
+	// and after that by the current K'th-nearest distance
+	int NumFound = 0;
+	RealType CullDistSqr = MaxDistSqr;
+
+	stack.push_back( {RootIndex, RootBounds} );
+	StackBox nextBox;
+	while (stack.pop_back(nextBox))
+	{
+		// CullDistSqr may have shrunk while this node was on the stack
+		if (nextBox.Box.DistanceSquared(QueryPoint) > CullDistSqr)
+			continue;
+
+		ChildIndex next = nextBox.Index;
+		if (next.LeafCount > 0) {
+			for (uint32_t j = 0; j < next.LeafCount; ++j) {
+				const SourceBox2& Box = LeafBoxLists[next.Index + j];
+				if (Box.Box.DistanceSquared(QueryPoint) >= CullDistSqr)
+					continue;
+				DistanceResult2<RealType> ElemDistSqrResult = ElementDistanceSqrFunc(Box.BoxID, QueryPoint);
+				if (ElemDistSqrResult.DistanceSqr >= CullDistSqr)
+					continue;
+				ElemDistSqrResult.ElementID = Box.BoxID;
+
+				// insertion-sort into the list, dropping the current K'th result if the list is full
+				int InsertIndex = (NumFound < K) ? NumFound++ : (K - 1);
+				while (InsertIndex > 0 && ResultsOut[InsertIndex-1].DistanceSqr > ElemDistSqrResult.DistanceSqr) {
+					ResultsOut[InsertIndex] = ResultsOut[InsertIndex-1];
+					InsertIndex--;
+				}
+				ResultsOut[InsertIndex] = ElemDistSqrResult;
+				if (NumFound == K)
+					CullDistSqr = ResultsOut[K-1].DistanceSqr;
+			}
+		}
+		else
+		{
+			const InteriorNode& Node = NodeTree[next.Index];
+			StackBox Children[2] = { {Node.LeftChild,Node.LeftBounds},  {Node.RightChild,Node.RightBounds} };
+			RealType ChildDists[2] = { Node.LeftBounds.DistanceSquared(QueryPoint), Node.RightBounds.DistanceSquared(QueryPoint)};
+			if (ChildDists[0] > ChildDists[1]) {
+				GS::SwapTemp(ChildDists[0], ChildDists[1]);
+				GS::SwapTemp(Children[0], Children[1]);
+			}
+			// push farther child first, so that the nearer child is popped first
+			if (ChildDists[0] < CullDistSqr) {
+				if (ChildDists[1] < CullDistSqr)
+					stack.push_back(Children[1]);
+				stack.push_back(Children[0]);
+			}
+		}
+	}
+	return NumFound;
+}
+
+
+
 typedef AxisBoxTree2<float> AxisBoxTree2f;
 typedef AxisBoxTree2<double> AxisBoxTree2d;
 
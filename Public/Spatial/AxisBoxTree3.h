@@ -0,0 +1,188 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/FunctionRef.h"
+#include "Core/unsafe_vector.h"
+#include "Core/gs_serializer.h"
+#include "Math/GSVector3.h"
+#include "Math/GSAxisBox3.h"
+#include "Math/GSRay3.h"
+#include "Spatial/SpatialResult3.h"
+#include "Spatial/SpatialQueryTypes.h"
+
+namespace GS
+{
+
+class DenseMesh;
+class PolyMesh;
+class RayBatch;
+
+
+struct AxisBoxTree3BuildOptions
+{
+	//! maximum number of elements in a leaf, in range [1,15]
+	int MaxLeafSize = 4;
+	//! number of split-candidate bins per axis, in range [2,32]
+	int NumSAHBins = 16;
+	//! build with GS::ParallelFor. GetBoxFunc/GetTriangleFunc must be thread-safe in this case.
+	bool bParallel = true;
+};
+
+
+/**
+ * AxisBoxTree3 is a 3D bounding-box hierarchy, built with a binned surface-area-heuristic, that mirrors AxisBoxTree2.
+ *
+ * The tree can be built over arbitrary elements from their boxes, in which case queries call back to the
+ * client to evaluate elements, or over triangles (from a DenseMesh, PolyMesh or GetTriangleFunc), in which
+ * case the triangle vertices are stored in leaf order and the triangle queries (FindNearestHitTriangle,
+ * TestAnyHitTriangle, FindNearestPoint) can be used. Ray-triangle tests are watertight, ie rays through
+ * shared edges and vertices of a closed mesh cannot pass between triangles.
+ */
+template<typename RealType>
+class AxisBoxTree3
+{
+public:
+	using BoxType = typename GS::AxisBox3<RealType>;
+
+	//! build the tree over the boxes of elements with IDs in range [0,MaxBoxID). GetBoxFunc returns false for missing IDs.
+	void Build(
+		int32_t MaxBoxID,
+		FunctionRef<bool(int, AxisBox3<RealType>& Box)> GetBoxFunc,
+		const AxisBoxTree3BuildOptions& Options = AxisBoxTree3BuildOptions());
+
+	//! build the tree over triangles with IDs in range [0,MaxTriangleID). GetTriangleFunc returns false for missing IDs.
+	void BuildTriangles(
+		int32_t MaxTriangleID,
+		FunctionRef<bool(int, Vector3<RealType>& A, Vector3<RealType>& B, Vector3<RealType>& C)> GetTriangleFunc,
+		const AxisBoxTree3BuildOptions& Options = AxisBoxTree3BuildOptions());
+
+	//! build the tree over the triangles of Mesh, ElementIDs are triangle indices
+	void Build(const DenseMesh& Mesh, const AxisBoxTree3BuildOptions& Options = AxisBoxTree3BuildOptions());
+
+	//! build the tree over the faces of Mesh, ElementIDs are face indices. Faces are triangulated with TriangulatePolyMesh().
+	void Build(const PolyMesh& Mesh, const AxisBoxTree3BuildOptions& Options = AxisBoxTree3BuildOptions());
+
+	void Clear();
+
+	//! returns true if the tree was built over triangles, and so supports the triangle queries
+	bool HasTriangles() const { return bTriangleTree; }
+
+	bool Store(GS::ISerializer& Serializer) const;
+	bool Restore(GS::ISerializer& Serializer);
+	constexpr const char* SerializeVersionString() const { return "AxisBoxTree3_Version"; }
+
+
+	//
+	// generic element queries
+	//
+
+	//! find nearest element to Point, ElementDistanceSqrFunc computes the distance to an element
+	DistanceResult3<RealType> PointDistanceQuery(
+		const Vector3<RealType>& Point,
+		FunctionRef<DistanceResult3<RealType>(int BoxID, const Vector3<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>() ) const;
+
+	//! find nearest element hit by Ray. ElementRayFunc returns true and sets HitOut.RayParameter (and optionally other fields) if the element is hit.
+	RayHitResult3<RealType> FindNearestHit(
+		const Ray3<RealType>& Ray,
+		FunctionRef<bool(int BoxID, const Ray3<RealType>& Ray, RayHitResult3<RealType>& HitOut)> ElementRayFunc,
+		RayQueryOptions<RealType> Options = RayQueryOptions<RealType>() ) const;
+
+	//! call FoundElementFunc for all ElementIDs with boxes that intersect or touch QueryBox. Returns false if no elements were found.
+	bool BoxOverlapQuery(
+		const AxisBox3<RealType>& QueryBox,
+		FunctionRef<void(int)> FoundElementFunc) const;
+
+
+	//
+	// triangle queries, require a tree built over triangles
+	//
+
+	//! find the nearest triangle hit by Ray, within Options.MaxDistance
+	RayHitResult3<RealType> FindNearestHitTriangle(
+		const Ray3<RealType>& Ray,
+		RayQueryOptions<RealType> Options = RayQueryOptions<RealType>() ) const;
+
+	//! returns true if Ray hits any triangle within Options.MaxDistance. Traversal stops at the first hit, so this is cheaper than FindNearestHitTriangle for occlusion tests.
+	bool TestAnyHitTriangle(
+		const Ray3<RealType>& Ray,
+		RayQueryOptions<RealType> Options = RayQueryOptions<RealType>() ) const;
+
+	//! find the nearest point on the triangles to Point, within Options.MaxDistance
+	DistanceResult3<RealType> FindNearestPoint(
+		const Vector3<RealType>& Point,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>() ) const;
+
+
+	//
+	// batched triangle queries. Rays are traversed in packets of 8 consecutive rays of the RayBatch,
+	// with the child boxes of each node tested against the whole packet in float SIMD (see TestRayPacketBoxIntersection).
+	// Triangle tests are the same as the single-ray queries, so results match them.
+	//
+
+	//! find the nearest triangle hit for each ray in Batch, within the per-ray max distances. HitsOut is indexed by input ray index.
+	void FindNearestHitTriangles(
+		const RayBatch& Batch,
+		unsafe_vector<RayHitResult3<RealType>>& HitsOut,
+		bool bParallel = true) const;
+
+	//! test each ray in Batch for any triangle hit within the per-ray max distances. HitsOut is indexed by input ray index, and is 1 for rays that hit.
+	void TestAnyHitTriangles(
+		const RayBatch& Batch,
+		unsafe_vector<uint8_t>& HitsOut,
+		bool bParallel = true) const;
+
+	void Validate();
+
+public:
+
+	struct ChildIndex {
+		uint32_t LeafCount : 4;		// max 16 elements in a leaf. If > 0, Index is a leaf-node-index
+		uint32_t Index : 28;		// max 268M internal or leaf nodes
+	};
+
+	struct InteriorNode {
+		ChildIndex LeftChild;
+		ChildIndex RightChild;
+		BoxType LeftBounds;
+		BoxType RightBounds;
+	};
+
+	struct SourceBox3
+	{
+		AxisBox3<RealType> Box;
+		int32_t BoxID;
+	};
+
+	struct SourceTriangle3
+	{
+		Vector3<RealType> V[3];
+	};
+
+	ChildIndex RootIndex = ChildIndex{ 0, 0 };
+	BoxType RootBounds = BoxType::Empty();
+	unsafe_vector<InteriorNode> NodeTree;
+	unsafe_vector<SourceBox3> LeafBoxLists;
+	//! triangle vertices for each entry in LeafBoxLists, if the tree was built over triangles
+	unsafe_vector<SourceTriangle3> LeafTriangles;
+
+private:
+	bool bTriangleTree = false;
+
+	void build_binned_sah(int32_t MaxBoxID, FunctionRef<bool(int, AxisBox3<RealType>& Box)> GetBoxFunc, const AxisBoxTree3BuildOptions& Options);
+
+	void validate_leaf_child(ChildIndex Index, AxisBox3<RealType>& ComputedBounds);
+	void validate_internal_node(ChildIndex Index, AxisBox3<RealType>& ComputedBounds);
+};
+
+
+typedef AxisBoxTree3<float> AxisBoxTree3f;
+typedef AxisBoxTree3<double> AxisBoxTree3d;
+
+
+// explicit instantiation
+extern template class AxisBoxTree3<float>;
+extern template class AxisBoxTree3<double>;
+
+} // end namespace GS
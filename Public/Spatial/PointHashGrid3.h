@@ -0,0 +1,102 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/FunctionRef.h"
+#include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
+#include "Math/GSVector3.h"
+#include "Math/GSAxisBox3.h"
+
+namespace GS
+{
+
+/**
+ * PointHashGrid3 is a static uniform hash grid over a set of 3D points, for radius and box queries.
+ *
+ * Cells of size CellSize are hashed into a power-of-two table of buckets. Points are sorted by bucket,
+ * and BucketStarts stores the CSR range of each bucket in the sorted PointIDs / Positions arrays, so a
+ * query visits the buckets of the cells it overlaps and scans contiguous position ranges.
+ * Hash collisions only add candidates that are rejected by the distance/box test, and each
+ * bucket is scanned at most once per query, so each point is reported at most once.
+ *
+ * CellSize should be on the order of the typical query radius.
+ */
+template<typename RealType>
+class PointHashGrid3
+{
+public:
+	//! build over points with IDs in range [0,MaxPointID). GetPointFunc returns false for missing IDs.
+	void Build(
+		int32_t MaxPointID,
+		FunctionRef<bool(int, Vector3<RealType>&)> GetPointFunc,
+		RealType CellSize,
+		bool bParallel = true);
+
+	//! build over all Points, PointIDs are indices into Points
+	void Build(
+		const_buffer_view<Vector3<RealType>> Points,
+		RealType CellSize,
+		bool bParallel = true);
+
+	//! build with a known bounding box of the points, which avoids a pass over the points to compute it
+	void Build(
+		int32_t MaxPointID,
+		FunctionRef<bool(int, Vector3<RealType>&)> GetPointFunc,
+		const AxisBox3<RealType>& PointBounds,
+		RealType CellSize,
+		bool bParallel = true);
+
+	void Clear();
+
+	RealType GetCellSize() const { return CellSize; }
+	int GetPointCount() const { return (int)PointIDs.size(); }
+
+	//! call PointFunc for each point within Radius of Center (inclusive), with the squared distance to Center
+	void RadiusQuery(
+		const Vector3<RealType>& Center, RealType Radius,
+		FunctionRef<void(int PointID, RealType DistanceSqr)> PointFunc) const;
+
+	//! append the IDs of all points within Radius of Center to PointIDsOut. Returns the number of points found.
+	int RadiusQuery(
+		const Vector3<RealType>& Center, RealType Radius,
+		unsafe_vector<int>& PointIDsOut) const;
+
+	//! call PointFunc for each point inside QueryBox (inclusive)
+	void BoxQuery(
+		const AxisBox3<RealType>& QueryBox,
+		FunctionRef<void(int PointID)> PointFunc) const;
+
+	//! append the IDs of all points inside QueryBox to PointIDsOut. Returns the number of points found.
+	int BoxQuery(
+		const AxisBox3<RealType>& QueryBox,
+		unsafe_vector<int>& PointIDsOut) const;
+
+public:
+	RealType CellSize = (RealType)1;
+	RealType InvCellSize = (RealType)1;
+	//! cell (0,0,0) has its min corner at GridOrigin
+	Vector3<RealType> GridOrigin = Vector3<RealType>::Zero();
+	uint32_t BucketMask = 0;
+
+	//! points in [BucketStarts[b], BucketStarts[b+1]) are in bucket b. Size is NumBuckets+1.
+	unsafe_vector<int32_t> BucketStarts;
+	//! point IDs, sorted by bucket
+	unsafe_vector<int32_t> PointIDs;
+	//! point positions, in the same order as PointIDs
+	unsafe_vector<Vector3<RealType>> Positions;
+
+protected:
+	// visit the sorted-point range of each bucket overlapped by the cell range of QueryBox, once per bucket
+	void enumerate_buckets(const AxisBox3<RealType>& QueryBox, FunctionRef<void(int32_t Start, int32_t End)> RangeFunc) const;
+};
+
+
+typedef PointHashGrid3<float> PointHashGrid3f;
+typedef PointHashGrid3<double> PointHashGrid3d;
+
+// explicit instantiation
+extern template class PointHashGrid3<float>;
+extern template class PointHashGrid3<double>;
+
+} // end namespace GS
@@ -0,0 +1,149 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/FunctionRef.h"
+#include "Core/unsafe_vector.h"
+#include "Core/buffer_view.h"
+#include "Math/GSVector3.h"
+#include "Spatial/SpatialResult3.h"
+#include "Spatial/SpatialQueryTypes.h"
+
+namespace GS
+{
+
+class DenseMesh;
+
+
+struct PointKDTree3BuildOptions
+{
+	//! maximum number of points in a leaf
+	int MaxLeafSize = 8;
+	//! build with GS::ParallelFor. GetPointFunc must be thread-safe in this case.
+	bool bParallel = true;
+};
+
+
+/**
+ * PointKDTree3 is a static k-d tree over a set of 3D points, for nearest-neighbour, k-nearest and radius queries.
+ *
+ * Nodes are split at the median along the axis of largest extent, so the tree is balanced and its depth is
+ * bounded, which lets queries use a fixed-size stack and no allocations. The top levels of the tree are split
+ * in parallel, and the remaining subtrees are built in parallel and spliced into the flat Nodes array.
+ * Point positions are stored in leaf order, so each leaf is a contiguous range of Points.
+ *
+ * The batch queries run the single-point queries over blocks of query points with GS::ParallelFor.
+ */
+template<typename RealType>
+class PointKDTree3
+{
+public:
+	//! build over all Points, PointIDs are indices into Points
+	void Build(
+		const_buffer_view<Vector3<RealType>> Points,
+		const PointKDTree3BuildOptions& Options = PointKDTree3BuildOptions());
+
+	//! build over points with IDs in range [0,MaxPointID). GetPointFunc returns false for missing IDs.
+	void Build(
+		int32_t MaxPointID,
+		FunctionRef<bool(int, Vector3<RealType>&)> GetPointFunc,
+		const PointKDTree3BuildOptions& Options = PointKDTree3BuildOptions());
+
+	//! build over the vertex positions of Mesh, PointIDs are vertex indices
+	void Build(
+		const DenseMesh& Mesh,
+		const PointKDTree3BuildOptions& Options = PointKDTree3BuildOptions());
+
+	void Clear();
+
+	int GetPointCount() const { return (int)Points.size(); }
+
+	//! find the nearest point to QueryPoint within Options.MaxDistance. ElementID of the result is the PointID, or -1 if none was found.
+	DistanceResult3<RealType> FindNearest(
+		const Vector3<RealType>& QueryPoint,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>()) const;
+
+	//! find the (up to) K nearest points to QueryPoint within Options.MaxDistance. ResultsOut must have space for K results.
+	//! Results are sorted by increasing distance, returns the number of results found.
+	int FindKNearest(
+		const Vector3<RealType>& QueryPoint, int K,
+		DistanceResult3<RealType>* ResultsOut,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>()) const;
+
+	//! call PointFunc for all points within Radius of QueryPoint (inclusive), with the squared distance to QueryPoint
+	void FindInRadius(
+		const Vector3<RealType>& QueryPoint, RealType Radius,
+		FunctionRef<void(int PointID, RealType DistanceSqr)> PointFunc) const;
+
+	//! append the IDs of all points within Radius of QueryPoint to PointIDsOut. Returns the number of points found.
+	int FindInRadius(
+		const Vector3<RealType>& QueryPoint, RealType Radius,
+		unsafe_vector<int>& PointIDsOut) const;
+
+
+	//
+	// batch queries
+	//
+
+	//! FindNearest() for each query point, ResultsOut[i] is the result for QueryPoints[i]
+	void FindNearestBatch(
+		const_buffer_view<Vector3<RealType>> QueryPoints,
+		unsafe_vector<DistanceResult3<RealType>>& ResultsOut,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>(),
+		bool bParallel = true) const;
+
+	//! FindKNearest() for each query point. ResultsOut[i*K + j] is the j'th nearest point to QueryPoints[i],
+	//! unused entries (if fewer than K points were found) have ElementID -1.
+	void FindKNearestBatch(
+		const_buffer_view<Vector3<RealType>> QueryPoints, int K,
+		unsafe_vector<DistanceResult3<RealType>>& ResultsOut,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>(),
+		bool bParallel = true) const;
+
+	//! FindInRadius() for each query point. Results are returned in CSR form, the PointIDs found for
+	//! QueryPoints[i] are PointIDsOut[OffsetsOut[i]] to PointIDsOut[OffsetsOut[i+1]-1].
+	void FindInRadiusBatch(
+		const_buffer_view<Vector3<RealType>> QueryPoints, RealType Radius,
+		unsafe_vector<int>& OffsetsOut,
+		unsafe_vector<int>& PointIDsOut,
+		bool bParallel = true) const;
+
+public:
+	struct Node
+	{
+		//! split coordinate, for interior nodes. Points in the left child are <= SplitValue, points in the right child are >=.
+		RealType SplitValue;
+		//! interior nodes: index of the left child, the right child is Index+1. leaf nodes: index of the first point in Points.
+		int32_t Index;
+		//! split axis for interior nodes, or -1 for leaf nodes
+		int16_t Axis;
+		//! number of points in a leaf node
+		uint16_t Count;
+
+		bool IsLeaf() const { return Axis < 0; }
+	};
+
+	struct SourcePoint
+	{
+		Vector3<RealType> Position;
+		int32_t PointID;
+	};
+
+	//! Nodes[0] is the root node, if there are any points
+	unsafe_vector<Node> Nodes;
+	//! points in leaf order
+	unsafe_vector<SourcePoint> Points;
+
+protected:
+	void build_internal(const PointKDTree3BuildOptions& Options);
+};
+
+
+typedef PointKDTree3<float> PointKDTree3f;
+typedef PointKDTree3<double> PointKDTree3d;
+
+// explicit instantiation
+extern template class PointKDTree3<float>;
+extern template class PointKDTree3<double>;
+
+} // end namespace GS
@@ -0,0 +1,24 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Math/GSMath.h"
+
+namespace GS
+{
+
+template<typename RealType>
+struct DistanceQueryOptions
+{
+	RealType MaxDistance = RealConstants<RealType>::SafeMaxValue();
+};
+
+template<typename RealType>
+struct RayQueryOptions
+{
+	//! hits further than this distance along the ray are ignored
+	RealType MaxDistance = RealConstants<RealType>::SafeMaxValue();
+};
+
+
+}
@@ -0,0 +1,60 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Math/GSMath.h"
+#include "Math/GSVector3.h"
+
+namespace GS
+{
+
+template<typename RealType>
+struct DistanceResult3
+{
+	int ElementID = -1;
+	RealType DistanceSqr = (RealType)0;
+	Vector3<RealType> Point = Vector3<RealType>::Zero();
+	//! barycentric coordinates of Point, for triangle queries
+	Vector3<RealType> BaryCoords = Vector3<RealType>::Zero();
+
+	DistanceResult3() {}
+	DistanceResult3(int element_id) 
+		: ElementID(element_id) {}
+
+	DistanceResult3(int element_id, RealType distanceSqr) 
+		: ElementID(element_id), DistanceSqr(distanceSqr) {}
+
+	DistanceResult3(int element_id, RealType distanceSqr, Vector3<RealType> point)
+		: ElementID(element_id), DistanceSqr(distanceSqr), Point(point) {}
+
+	operator bool() const { return ElementID >= 0; }
+	bool IsValid() const { return ElementID >= 0; }
+
+	RealType Distance() const { return GS::Sqrt(DistanceSqr); }
+};
+typedef DistanceResult3<float> DistanceResult3f;
+typedef DistanceResult3<double> DistanceResult3d;
+
+
+template<typename RealType>
+struct RayHitResult3
+{
+	int ElementID = -1;
+	//! distance along the ray to the hit point
+	RealType RayParameter = RealConstants<RealType>::SafeMaxValue();
+	Vector3<RealType> HitPoint = Vector3<RealType>::Zero();
+	//! barycentric coordinates of HitPoint, for triangle queries
+	Vector3<RealType> BaryCoords = Vector3<RealType>::Zero();
+
+	RayHitResult3() {}
+	RayHitResult3(int element_id, RealType ray_parameter)
+		: ElementID(element_id), RayParameter(ray_parameter) {}
+
+	operator bool() const { return ElementID >= 0; }
+	bool IsValid() const { return ElementID >= 0; }
+};
+typedef RayHitResult3<float> RayHitResult3f;
+typedef RayHitResult3<double> RayHitResult3d;
+
+
+}
@@ -0,0 +1,84 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+#include "GradientspacePlatform.h"
+#include "Core/FunctionRef.h"
+#include "Core/unsafe_vector.h"
+#include "Math/GSVector2.h"
+#include "Math/GSAxisBox2.h"
+#include "Spatial/SpatialResult2.h"
+#include "Spatial/AxisBoxTree2.h"
+
+namespace GS
+{
+
+/**
+ * WideAxisBoxTree2 is a 4- or 8-ary bounding-box hierarchy built by collapsing a binary AxisBoxTree2.
+ * Child bounds of each node are stored as SoA float lanes, so all children of a node are tested 
+ * at once with SSE (or AVX, if enabled at compile time), instead of one double-precision box per step.
+ * Float bounds are rounded outwards, so culling is conservative, and leaf boxes are tested at full precision.
+ * 
+ * The query functions match AxisBoxTree2 and find the same elements, although the order in which
+ * elements are visited (and so the result of PointContainmentQuery if multiple elements pass) may differ.
+ */
+template<typename RealType, int Width = 4>
+class WideAxisBoxTree2
+{
+public:
+	static_assert(Width == 4 || Width == 8, "WideAxisBoxTree2 supports 4 or 8 children per node");
+
+	using BoxType = typename GS::AxisBox2<RealType>;
+	using ChildIndex = typename AxisBoxTree2<RealType>::ChildIndex;
+	using SourceBox2 = typename AxisBoxTree2<RealType>::SourceBox2;
+
+	//! build from an existing binary tree. The binary tree is not referenced after the build.
+	void Build(const AxisBoxTree2<RealType>& BinaryTree);
+
+	void Clear();
+
+	//! find ElementID of box that contains Point and passes ElementTestFunc
+	int PointContainmentQuery(
+		Vector2<RealType> Point,
+		FunctionRef<bool(int)> ElementTestFunc) const;
+
+	//! call FoundElementFunc for all ElementIDs with boxes that contain Point and pass ElementTestFunc
+	//! returns false if no elements found
+	bool PointContainmentQuery_FindAll(
+		Vector2<RealType> Point,
+		FunctionRef<bool(int)> ElementTestFunc,
+		FunctionRef<void(int)> FoundElementFunc ) const;
+
+	DistanceResult2<RealType> PointDistanceQuery(
+		Vector2<RealType> Point,
+		FunctionRef<DistanceResult2<RealType>(int BoxID, const Vector2<RealType>& QueryPoint)> ElementDistanceSqrFunc,
+		DistanceQueryOptions<RealType> Options = DistanceQueryOptions<RealType>() ) const;
+
+public:
+
+	//! unused child slots have empty bounds (Min = +inf, Max = -inf), so they fail all tests
+	struct WideNode
+	{
+		float MinX[Width];
+		float MinY[Width];
+		float MaxX[Width];
+		float MaxY[Width];
+		ChildIndex Children[Width];
+	};
+
+	ChildIndex RootIndex;
+	BoxType RootBounds;
+	unsafe_vector<WideNode> Nodes;
+	unsafe_vector<SourceBox2> LeafBoxLists;
+};
+
+
+typedef WideAxisBoxTree2<float, 4> WideAxisBoxTree2f;
+typedef WideAxisBoxTree2<double, 4> WideAxisBoxTree2d;
+
+// explicit instantiation
+extern template class WideAxisBoxTree2<float, 4>;
+extern template class WideAxisBoxTree2<double, 4>;
+extern template class WideAxisBoxTree2<float, 8>;
+extern template class WideAxisBoxTree2<double, 8>;
+
+} // end namespace GS
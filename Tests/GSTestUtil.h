@@ -0,0 +1,71 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#pragma once
+
+// Minimal support code for the GradientspaceCore regression tests. Each test is a standalone executable
+// that returns nonzero if any GS_TEST_CHECK fails. Test sources are wrapped in #ifdef GSCORE_BUILD_TESTS,
+// which is only defined by Tests/CMakeLists.txt, so that they are ignored if this repository is compiled
+// as an Unreal module (which compiles all source files in the module folder).
+
+#include "GradientspacePlatform.h"
+#include "Core/gs_parallel_api.h"
+#include "Math/GSMath.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace GSTest
+{
+	inline int NumFailedChecks = 0;
+
+	inline void ReportFailedCheck(const char* Expression, const char* File, int Line)
+	{
+		printf("CHECK FAILED: %s  (%s:%d)\n", Expression, File, Line);
+		NumFailedChecks++;
+	}
+
+	// parallel_for implementation on std::threads, so that library code using GS::ParallelFor can be tested
+	class ThreadParallelAPI : public GS::Parallel::gs_parallel_api
+	{
+	public:
+		virtual void parallel_for_jobcount(uint32_t NumJobs, GS::FunctionRef<void(uint32_t JobIndex)> JobFunction, GS::ParallelForFlags Flags) override
+		{
+			uint32_t NumThreads = GS::Max(std::thread::hardware_concurrency(), 2u);
+			if (Flags.bForceSingleThread || NumJobs <= 1)
+				NumThreads = 1;
+			std::atomic<uint32_t> NextJob = 0;
+			auto ThreadFunc = [&]() {
+				for (uint32_t JobIndex = NextJob++; JobIndex < NumJobs; JobIndex = NextJob++)
+					JobFunction(JobIndex);
+			};
+			std::vector<std::thread> Threads;
+			for (uint32_t k = 1; k < NumThreads; ++k)
+				Threads.emplace_back(ThreadFunc);
+			ThreadFunc();
+			for (std::thread& Thread : Threads)
+				Thread.join();
+		}
+
+		virtual GS::TaskContainer launch_task(const char*, std::function<void()> task, GS::TaskFlags) override
+		{
+			task();
+			return GS::TaskContainer();
+		}
+
+		virtual void wait_for_task(GS::TaskContainer&) override {}
+	};
+
+	inline void RegisterParallelAPI()
+	{
+		GS::Parallel::RegisterAPI(GS::UniquePtr<GS::Parallel::gs_parallel_api>(new ThreadParallelAPI()));
+	}
+
+	inline int FinishTest(const char* TestName)
+	{
+		printf("%s: %s\n", TestName, (NumFailedChecks == 0) ? "passed" : "FAILED");
+		return (NumFailedChecks == 0) ? 0 : 1;
+	}
+}
+
+#define GS_TEST_CHECK(Expr) { if (!(Expr)) GSTest::ReportFailedCheck(#Expr, __FILE__, __LINE__); }
@@ -0,0 +1,159 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Spatial/AxisBoxTree2.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace GS;
+
+// Boxes at (2^-i, 2^-i) produce a midpoint-split tree that is a chain, with a small leaf at each level,
+// so the traversal stacks of the queries get much deeper than their inline capacity. A second chain at
+// (-2^-i, -2^-i) is traversed after the stack of the first chain has spilled and unwound again.
+static constexpr int NumChainBoxes = 500;
+static constexpr int NumDeepBoxes = 2 * NumChainBoxes;
+
+static AxisBox2d DeepBox(int i)
+{
+	double t = std::ldexp(1.0, -(i % NumChainBoxes)) * ((i < NumChainBoxes) ? 1.0 : -1.0);
+	return AxisBox2d(Vector2d(t, t), Vector2d(t, t));
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	AxisBoxTree2d Tree;
+	AxisBoxTree2BuildOptions BuildOptions;
+	BuildOptions.Method = EAxisBoxTreeBuildMethod::Midpoint;
+	BuildOptions.MaxLeafSize = 2;
+	Tree.Build(NumDeepBoxes, [&](int i, AxisBox2d& Box) { Box = DeepBox(i); return true; }, BuildOptions);
+
+	auto ElementDistanceSqr = [&](int BoxID, const Vector2d& P) {
+		return DistanceResult2d(BoxID, DeepBox(BoxID).DistanceSquared(P));
+	};
+	auto BruteForceNearest = [&](const Vector2d& P) {
+		int NearestID = -1;
+		double NearestDistSqr = 0;
+		for (int i = 0; i < NumDeepBoxes; ++i) {
+			double DistSqr = DeepBox(i).DistanceSquared(P);
+			if (NearestID < 0 || DistSqr < NearestDistSqr) {
+				NearestID = i; NearestDistSqr = DistSqr;
+			}
+		}
+		return NearestDistSqr;
+	};
+
+	// batch nearest-point queries, points are spread over the chain so packets traverse deep subtrees
+	std::vector<Vector2d> Points;
+	for (int i = 0; i < 256; ++i) {
+		double t = std::ldexp(1.0, -(i % NumChainBoxes)) * ((i % 2 == 0) ? 1.01 : -1.01);
+		Points.push_back(Vector2d(t, (i % 4 < 2) ? t : -t));
+	}
+	for (bool bParallel : { false, true })
+	{
+		unsafe_vector<DistanceResult2d> Results;
+		Tree.PointDistanceQueryBatch(const_buffer_view<Vector2d>(Points.data(), Points.size()), ElementDistanceSqr, Results, DistanceQueryOptions<double>(), bParallel);
+		bool bAllMatch = (Results.size() == Points.size());
+		for (size_t k = 0; k < Points.size() && bAllMatch; ++k)
+			bAllMatch = Results[k].IsValid() && Results[k].DistanceSqr == BruteForceNearest(Points[k]);
+		GS_TEST_CHECK(bAllMatch);
+	}
+
+	// box and radius queries that contain all boxes visit every leaf of the chain
+	int NumOverlapFound = 0;
+	Tree.BoxOverlapQuery(AxisBox2d(Vector2d(-1, -1), Vector2d(2, 2)), [&](int) { NumOverlapFound++; });
+	GS_TEST_CHECK(NumOverlapFound == NumDeepBoxes);
+	int NumRadiusFound = 0;
+	Tree.RadiusQuery(Vector2d(0, 0), 2.0, [&](int, double) { NumRadiusFound++; });
+	GS_TEST_CHECK(NumRadiusFound == NumDeepBoxes);
+
+	// point containment at the deepest boxes of the chains, each point is only contained in its own box
+	for (int ID : { NumChainBoxes - 1, NumDeepBoxes - 1 }) {
+		Vector2d Point = DeepBox(ID).Min;
+		GS_TEST_CHECK(Tree.PointContainmentQuery(Point, [](int) { return true; }) == ID);
+		int NumContaining = 0;
+		GS_TEST_CHECK(Tree.PointContainmentQuery_FindAll(Point, [](int) { return true; }, [&](int) { NumContaining++; }));
+		GS_TEST_CHECK(NumContaining == 1);
+	}
+
+	// nearest elements to the origin are the deepest boxes of the two chains
+	const int K = 8;
+	DistanceResult2d KNearest[K];
+	int NumKFound = Tree.KNearestQuery(Vector2d(0, 0), K, ElementDistanceSqr, KNearest);
+	GS_TEST_CHECK(NumKFound == K);
+	for (int k = 0; k < NumKFound; ++k)
+		GS_TEST_CHECK(KNearest[k].ElementID % NumChainBoxes == NumChainBoxes - 1 - k / 2);
+
+	// simultaneous traversal of the tree with itself, each point box only overlaps itself
+	for (bool bParallel : { false, true })
+	{
+		unsafe_vector<Index2i> Pairs;
+		Tree.FindOverlappingPairs(Tree, Pairs, nullptr, bParallel);
+		bool bAllSelfPairs = (Pairs.size() == NumDeepBoxes);
+		for (const Index2i& Pair : Pairs)
+			bAllSelfPairs = bAllSelfPairs && (Pair.A == Pair.B);
+		GS_TEST_CHECK(bAllSelfPairs);
+	}
+
+	// random overlapping boxes, pair queries must match brute-force pairs. A tree queried against itself via
+	// FindOverlappingPairs reports ordered (ThisID, OtherID) pairs, FindSelfOverlaps reports each pair once as (min,max).
+	{
+		std::mt19937 Random(7);
+		std::uniform_real_distribution<double> Coord(0.0, 10.0), Size(0.1, 1.5);
+		auto MakeBoxes = [&](int Count) {
+			std::vector<AxisBox2d> Boxes;
+			for (int i = 0; i < Count; ++i) {
+				Vector2d Min(Coord(Random), Coord(Random));
+				Boxes.push_back(AxisBox2d(Min, Min + Vector2d(Size(Random), Size(Random))));
+			}
+			return Boxes;
+		};
+		std::vector<AxisBox2d> BoxesA = MakeBoxes(600), BoxesB = MakeBoxes(400);
+		AxisBoxTree2d TreeA, TreeB;
+		AxisBoxTree2BuildOptions PairBuildOptions;
+		PairBuildOptions.MaxLeafSize = 4;
+		TreeA.Build((int)BoxesA.size(), [&](int i, AxisBox2d& Box) { Box = BoxesA[i]; return true; }, PairBuildOptions);
+		TreeB.Build((int)BoxesB.size(), [&](int i, AxisBox2d& Box) { Box = BoxesB[i]; return true; }, PairBuildOptions);
+
+		auto Overlaps = [](const AxisBox2d& A, const AxisBox2d& B) {
+			return !(B.Max.X < A.Min.X || B.Min.X > A.Max.X || B.Max.Y < A.Min.Y || B.Min.Y > A.Max.Y);
+		};
+		auto BruteForcePairs = [&](const std::vector<AxisBox2d>& A, const std::vector<AxisBox2d>& B, bool bSelf) {
+			std::vector<Index2i> Pairs;
+			for (int i = 0; i < (int)A.size(); ++i)
+				for (int j = (bSelf ? i + 1 : 0); j < (int)B.size(); ++j)
+					if (Overlaps(A[i], B[j])) Pairs.push_back(Index2i(i, j));
+			return Pairs;
+		};
+		auto Sorted = [](const unsafe_vector<Index2i>& Pairs) {
+			std::vector<Index2i> Result;
+			for (const Index2i& Pair : Pairs) Result.push_back(Pair);
+			std::sort(Result.begin(), Result.end(), [](const Index2i& P, const Index2i& Q) { return P.A < Q.A || (P.A == Q.A && P.B < Q.B); });
+			return Result;
+		};
+		auto SamePairs = [](const std::vector<Index2i>& P, const std::vector<Index2i>& Q) {
+			bool bSame = P.size() == Q.size();
+			for (size_t k = 0; k < P.size() && bSame; ++k)
+				bSame = P[k] == Q[k];
+			return bSame;
+		};
+
+		for (bool bParallel : { false, true })
+		{
+			unsafe_vector<Index2i> Pairs;
+			TreeA.FindOverlappingPairs(TreeB, Pairs, nullptr, bParallel);
+			GS_TEST_CHECK(SamePairs(Sorted(Pairs), BruteForcePairs(BoxesA, BoxesB, false)));
+			TreeA.FindOverlappingPairs(TreeA, Pairs, nullptr, bParallel);
+			GS_TEST_CHECK(SamePairs(Sorted(Pairs), BruteForcePairs(BoxesA, BoxesA, false)));
+			TreeA.FindSelfOverlaps(Pairs, nullptr, bParallel);
+			GS_TEST_CHECK(SamePairs(Sorted(Pairs), BruteForcePairs(BoxesA, BoxesA, true)));
+		}
+	}
+
+	return GSTest::FinishTest("test_axisboxtree2_queries");
+}
+#endif
@@ -0,0 +1,101 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Spatial/AxisBoxTree2.h"
+#include "Core/gs_serializer.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace GS;
+
+// two chains of boxes at (2^-i, 2^-i) and (-2^-i, -2^-i), see test_axisboxtree2_queries
+static constexpr int NumChainBoxes = 500;
+static constexpr int NumDeepBoxes = 2 * NumChainBoxes;
+
+static AxisBox2d DeepBox(int i)
+{
+	double t = std::ldexp(1.0, -(i % NumChainBoxes)) * ((i < NumChainBoxes) ? 1.0 : -1.0);
+	return AxisBox2d(Vector2d(t, t), Vector2d(t, t));
+}
+
+static int CountOverlaps(const AxisBoxTree2d& Tree, const AxisBox2d& QueryBox)
+{
+	int NumFound = 0;
+	Tree.BoxOverlapQuery(QueryBox, [&](int) { NumFound++; });
+	return NumFound;
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	AxisBoxTree2BuildOptions BuildOptions;
+	BuildOptions.Method = EAxisBoxTreeBuildMethod::Midpoint;
+	BuildOptions.MaxLeafSize = 2;
+	const AxisBox2d AllBox(Vector2d(-10, -10), Vector2d(10, 10));
+
+	// incremental update of the deep tree, building the update state walks both chains
+	{
+		std::vector<AxisBox2d> Boxes;
+		for (int i = 0; i < NumDeepBoxes; ++i)
+			Boxes.push_back(DeepBox(i));
+		AxisBoxTree2d Tree;
+		Tree.Build(NumDeepBoxes, [&](int i, AxisBox2d& Box) { Box = Boxes[i]; return true; }, BuildOptions);
+
+		int UpdateIDs[2] = { NumChainBoxes - 1, NumDeepBoxes - 1 };
+		for (int ID : UpdateIDs)
+			Boxes[ID] = AxisBox2d(Vector2d(5, 5), Vector2d(6, 6));
+		Tree.UpdateElements(const_buffer_view<int>(UpdateIDs, 2), [&](int i, AxisBox2d& Box) { Box = Boxes[i]; return true; });
+		GS_TEST_CHECK(CountOverlaps(Tree, AllBox) == NumDeepBoxes);
+		GS_TEST_CHECK(CountOverlaps(Tree, AxisBox2d(Vector2d(4, 4), Vector2d(7, 7))) == 2);
+	}
+
+	// full rebuild on every update, GetBoxFunc only returns boxes for the updated elements
+	{
+		AxisBoxTree2d Tree;
+		Tree.Build(NumDeepBoxes, [&](int i, AxisBox2d& Box) { Box = DeepBox(i); return true; }, BuildOptions);
+
+		AxisBoxTree2UpdateOptions UpdateOptions;
+		UpdateOptions.FullRebuildInterval = 1;
+		int UpdateIDs[3] = { 0, 10, NumChainBoxes + 10 };
+		auto GetUpdatedBox = [&](int i, AxisBox2d& Box) {
+			for (int ID : UpdateIDs)
+				if (ID == i) { Box = AxisBox2d(Vector2d(5, 5), Vector2d(6, 6)); return true; }
+			return false;
+		};
+		bool bRebuilt = Tree.UpdateElements(const_buffer_view<int>(UpdateIDs, 3), GetUpdatedBox, UpdateOptions);
+		GS_TEST_CHECK(bRebuilt);
+		GS_TEST_CHECK(CountOverlaps(Tree, AllBox) == NumDeepBoxes);
+		int NumMoved = 0;
+		Tree.BoxOverlapQuery(AxisBox2d(Vector2d(4, 4), Vector2d(7, 7)), [&](int ID) {
+			NumMoved++;
+			GS_TEST_CHECK(ID == UpdateIDs[0] || ID == UpdateIDs[1] || ID == UpdateIDs[2]);
+		});
+		GS_TEST_CHECK(NumMoved == 3);
+	}
+
+	// a restored tree is rebuilt by UpdateElements() with the build options of the stored tree
+	{
+		AxisBoxTree2d Tree;
+		Tree.Build(NumDeepBoxes, [&](int i, AxisBox2d& Box) { Box = DeepBox(i); return true; }, BuildOptions);
+		MemorySerializer Serializer;
+		Serializer.BeginWrite();
+		GS_TEST_CHECK(Tree.Store(Serializer));
+		AxisBoxTree2d Restored;
+		Serializer.BeginRead();
+		GS_TEST_CHECK(Restored.Restore(Serializer));
+
+		AxisBoxTree2UpdateOptions UpdateOptions;
+		UpdateOptions.FullRebuildInterval = 1;
+		int UpdateID = 10;
+		auto GetUpdatedBox = [&](int i, AxisBox2d& Box) { Box = AxisBox2d(Vector2d(5, 5), Vector2d(6, 6)); return i == UpdateID; };
+		GS_TEST_CHECK(Tree.UpdateElements(const_buffer_view<int>(&UpdateID, 1), GetUpdatedBox, UpdateOptions));
+		GS_TEST_CHECK(Restored.UpdateElements(const_buffer_view<int>(&UpdateID, 1), GetUpdatedBox, UpdateOptions));
+		GS_TEST_CHECK(Restored.NodeTree.size() == Tree.NodeTree.size());
+		GS_TEST_CHECK(CountOverlaps(Restored, AllBox) == NumDeepBoxes);
+	}
+
+	return GSTest::FinishTest("test_axisboxtree2_update");
+}
+#endif
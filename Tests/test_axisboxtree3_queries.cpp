@@ -0,0 +1,156 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Spatial/AxisBoxTree3.h"
+#include "Intersection/GSRayBatch.h"
+#include "Mesh/PolyMesh.h"
+
+using namespace GS;
+
+// small triangles at (t,t,t) for t = 1,2,...,NumChainTris, and mirrored at (-t,-t,-t)
+static constexpr int NumChainTris = 500;
+static constexpr int NumDeepTris = 2 * NumChainTris;
+
+static void DeepTriangle(int i, Vector3d& A, Vector3d& B, Vector3d& C)
+{
+	double t = (double)(1 + i % NumChainTris);
+	double Sign = (i < NumChainTris) ? 1.0 : -1.0;
+	A = Sign * Vector3d(t, t, t);
+	B = Sign * Vector3d(t + 0.1, t, t);
+	C = Sign * Vector3d(t, t + 0.1, t);
+}
+
+// Append a subtree over leaf slots [FirstSlot,EndSlot) where each interior node has a single leaf as one
+// child, alternating between left and right, and the rest of the subtree as the other child. Traversals
+// in either child order then keep a pending leaf on the stack for every second level.
+static AxisBoxTree3d::ChildIndex AppendCaterpillar(AxisBoxTree3d& Tree, int FirstSlot, int EndSlot, AxisBox3d& BoundsOut)
+{
+	using ChildIndex = AxisBoxTree3d::ChildIndex;
+	ChildIndex Child = ChildIndex{ 1, (uint32_t)(EndSlot - 1) };
+	BoundsOut = Tree.LeafBoxLists[EndSlot - 1].Box;
+	for (int Slot = EndSlot - 2; Slot >= FirstSlot; --Slot)
+	{
+		ChildIndex Leaf = ChildIndex{ 1, (uint32_t)Slot };
+		const AxisBox3d& LeafBounds = Tree.LeafBoxLists[Slot].Box;
+		bool bLeafLeft = (Slot % 2 == 0);
+		AxisBoxTree3d::InteriorNode Node;
+		Node.LeftChild = bLeafLeft ? Leaf : Child;
+		Node.LeftBounds = bLeafLeft ? LeafBounds : BoundsOut;
+		Node.RightChild = bLeafLeft ? Child : Leaf;
+		Node.RightBounds = bLeafLeft ? BoundsOut : LeafBounds;
+		BoundsOut.Contain(LeafBounds);
+		Child = ChildIndex{ 0, (uint32_t)Tree.NodeTree.size() };
+		Tree.NodeTree.add(Node);
+	}
+	return Child;
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	AxisBoxTree3d Tree;
+	AxisBoxTree3BuildOptions BuildOptions;
+	BuildOptions.MaxLeafSize = 1;
+	Tree.BuildTriangles(NumDeepTris, [&](int i, Vector3d& A, Vector3d& B, Vector3d& C) { DeepTriangle(i, A, B, C); return true; }, BuildOptions);
+
+	// Replace the tree with two caterpillars below the root, one per chain. Triangles are stored in order of
+	// decreasing t, so the remaining subtree is nearer to the origin than the leaf at each level. Traversal
+	// stacks spill in the first subtree they visit, and then grow again in the second one.
+	for (int Slot = 0; Slot < NumDeepTris; ++Slot)
+	{
+		int TriangleID = (Slot / NumChainTris) * NumChainTris + (NumChainTris - 1 - Slot % NumChainTris);
+		auto& Tri = Tree.LeafTriangles[Slot];
+		DeepTriangle(TriangleID, Tri.V[0], Tri.V[1], Tri.V[2]);
+		Tree.LeafBoxLists[Slot].Box = AxisBox3d(Tri.V[0], Tri.V[1]);
+		Tree.LeafBoxLists[Slot].Box.Contain(Tri.V[2]);
+		Tree.LeafBoxLists[Slot].BoxID = TriangleID;
+	}
+	Tree.NodeTree.clear();
+	Tree.NodeTree.add(AxisBoxTree3d::InteriorNode());
+	AxisBoxTree3d::InteriorNode Root;
+	Root.LeftChild = AppendCaterpillar(Tree, 0, NumChainTris, Root.LeftBounds);
+	Root.RightChild = AppendCaterpillar(Tree, NumChainTris, NumDeepTris, Root.RightBounds);
+	Tree.NodeTree[0] = Root;
+	Tree.RootIndex = AxisBoxTree3d::ChildIndex{ 0, 0 };
+	Tree.RootBounds = Root.LeftBounds;
+	Tree.RootBounds.Contain(Root.RightBounds);
+	Tree.Validate();
+
+	int NumOverlapFound = 0;
+	Tree.BoxOverlapQuery(AxisBox3d(Vector3d(-1000, -1000, -1000), Vector3d(1000, 1000, 1000)), [&](int) { NumOverlapFound++; });
+	GS_TEST_CHECK(NumOverlapFound == NumDeepTris);
+
+	// nearest triangles to the origin are the first triangles of the two chains
+	DistanceResult3d Nearest = Tree.FindNearestPoint(Vector3d::Zero());
+	GS_TEST_CHECK(Nearest.ElementID % NumChainTris == 0);
+	DistanceResult3d NearestElement = Tree.PointDistanceQuery(Vector3d::Zero(), [&](int i, const Vector3d& P) {
+		Vector3d A, B, C;
+		DeepTriangle(i, A, B, C);
+		return DistanceResult3d(i, (A - P).SquaredLength());
+	});
+	GS_TEST_CHECK(NearestElement.ElementID % NumChainTris == 0);
+
+	// a ray next to the diagonal passes through every triangle of the positive chain, the first hit is triangle 0
+	Vector3d RayOrigin(0.03, 0.03, 0), RayDirection = Normalized(Vector3d(1, 1, 1));
+	Ray3d Ray(RayOrigin, RayDirection);
+	RayHitResult3d Hit = Tree.FindNearestHitTriangle(Ray);
+	GS_TEST_CHECK(Hit.ElementID == 0);
+	RayHitResult3d ElementHit = Tree.FindNearestHit(Ray, [&](int i, const Ray3d&, RayHitResult3d& HitOut) {
+		if (i >= NumChainTris) return false;
+		HitOut.RayParameter = (double)(1 + i) * Vector3d(1, 1, 1).Length();
+		return true;
+	});
+	GS_TEST_CHECK(ElementHit.ElementID == 0);
+	GS_TEST_CHECK(Tree.TestAnyHitTriangle(Ray));
+	GS_TEST_CHECK(Tree.TestAnyHitTriangle(Ray3d(Vector3d(5, -5, 0), RayDirection)) == false);
+
+	// Packet queries must match the single-ray queries. Packets contain rays along both chains, so
+	// they traverse both subtrees. Rays from (0.08,0.08,0) pass through the box of every triangle
+	// of a chain without hitting any, so they are never culled.
+	const Vector3d RayOrigins[4] = { RayOrigin, Vector3d(0.08, 0.08, 0), Vector3d(5, -5, 0), RayOrigin };
+	unsafe_vector<Ray3d> Rays;
+	for (int k = 0; k < 64; ++k) {
+		double Sign = (k % 2 == 0) ? 1.0 : -1.0;
+		Rays.add(Ray3d(Sign * RayOrigins[(k / 2) % 4], Sign * RayDirection));
+	}
+	RayBatch Batch;
+	Batch.Initialize(Rays.get_view());
+	for (bool bParallel : { false, true })
+	{
+		unsafe_vector<RayHitResult3d> Hits;
+		Tree.FindNearestHitTriangles(Batch, Hits, bParallel);
+		unsafe_vector<uint8_t> AnyHits;
+		Tree.TestAnyHitTriangles(Batch, AnyHits, bParallel);
+		bool bAllMatch = (Hits.size() == Rays.size() && AnyHits.size() == Rays.size());
+		for (size_t k = 0; k < Rays.size() && bAllMatch; ++k) {
+			bAllMatch = (Hits[k].ElementID == Tree.FindNearestHitTriangle(Rays[k]).ElementID)
+				&& ((AnyHits[k] != 0) == Tree.TestAnyHitTriangle(Rays[k]));
+		}
+		GS_TEST_CHECK(bAllMatch);
+	}
+
+	// PolyMesh faces are triangulated with ear clipping. Face 1 is an L-shape that starts at a vertex next to
+	// the notch, so a fan from its first vertex would cover the notch.
+	{
+		PolyMesh Mesh;
+		for (Vector3d P : { Vector3d(10, 0, 0), Vector3d(11, 0, 0), Vector3d(10, 1, 0) })
+			Mesh.AddVertex(P);
+		Mesh.AddTriangle(Index3i(0, 1, 2));
+		const Vector2d LShapePositions[6] = { Vector2d(2, 1), Vector2d(1, 1), Vector2d(1, 2), Vector2d(0, 2), Vector2d(0, 0), Vector2d(2, 0) };
+		int LShape[6];
+		for (int k = 0; k < 6; ++k)
+			LShape[k] = Mesh.AddVertex(Vector3d(LShapePositions[k].X, LShapePositions[k].Y, 0));
+		Mesh.AddPolygon(const_buffer_view<int>(LShape, 6));
+		AxisBoxTree3d PolyTree;
+		PolyTree.Build(Mesh);
+		Vector3d Down(0, 0, -1);
+		GS_TEST_CHECK(PolyTree.FindNearestHitTriangle(Ray3d(Vector3d(10.2, 0.2, 1), Down)).ElementID == 0);
+		GS_TEST_CHECK(PolyTree.FindNearestHitTriangle(Ray3d(Vector3d(0.5, 1.5, 1), Down)).ElementID == 1);
+		GS_TEST_CHECK(PolyTree.FindNearestHitTriangle(Ray3d(Vector3d(1.5, 0.5, 1), Down)).ElementID == 1);
+		GS_TEST_CHECK(PolyTree.TestAnyHitTriangle(Ray3d(Vector3d(1.2, 1.2, 1), Down)) == false);
+	}
+
+	return GSTest::FinishTest("test_axisboxtree3_queries");
+}
+#endif
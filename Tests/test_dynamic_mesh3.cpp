@@ -0,0 +1,277 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Mesh/DynamicMesh3.h"
+#include "Mesh/DenseMesh.h"
+
+#include <random>
+#include <vector>
+
+using namespace GS;
+
+// grid of (W+1)x(H+1) vertices with two triangles per cell, triangle groups are the cell x index mod 3.
+// If bAddFin, a last vertex and triangle are added that form a fin on the interior edge (0, W+2).
+static DenseMesh MakeGrid(int W, int H, bool bAddFin = false)
+{
+	DenseMesh Mesh;
+	int NumGridVertices = (W + 1) * (H + 1), NumGridTriangles = 2 * W * H;
+	Mesh.Resize(NumGridVertices + (bAddFin ? 1 : 0), NumGridTriangles + (bAddFin ? 1 : 0));
+	for (int y = 0; y <= H; ++y)
+		for (int x = 0; x <= W; ++x)
+			Mesh.SetPosition(y * (W + 1) + x, Vector3d(x, y, 0));
+	for (int y = 0; y < H; ++y) {
+		for (int x = 0; x < W; ++x) {
+			int v = y * (W + 1) + x, t = 2 * (y * W + x);
+			Mesh.SetTriangle(t, Index3i(v, v + 1, v + W + 2));
+			Mesh.SetTriangle(t + 1, Index3i(v, v + W + 2, v + W + 1));
+			Mesh.SetTriGroup(t, x % 3);
+			Mesh.SetTriGroup(t + 1, x % 3);
+		}
+	}
+	if (bAddFin) {
+		Mesh.SetPosition(NumGridVertices, Vector3d(1, 1, 1));
+		Mesh.SetTriangle(NumGridTriangles, Index3i(W + 2, 0, NumGridVertices));
+		Mesh.SetTriGroup(NumGridTriangles, 0);
+	}
+	return Mesh;
+}
+
+static DenseMesh MakeOctahedron()
+{
+	DenseMesh Mesh;
+	const Vector3d Positions[6] = { Vector3d(1,0,0), Vector3d(-1,0,0), Vector3d(0,1,0), Vector3d(0,-1,0), Vector3d(0,0,1), Vector3d(0,0,-1) };
+	const Index3i Triangles[8] = { Index3i(4,0,2), Index3i(4,2,1), Index3i(4,1,3), Index3i(4,3,0), Index3i(5,2,0), Index3i(5,1,2), Index3i(5,3,1), Index3i(5,0,3) };
+	Mesh.Resize(6, 8);
+	for (int k = 0; k < 6; ++k)
+		Mesh.SetPosition(k, Positions[k]);
+	for (int k = 0; k < 8; ++k)
+		Mesh.SetTriangle(k, Triangles[k]);
+	return Mesh;
+}
+
+static DynamicMesh3 MakeDynamicMesh(const std::vector<Vector3d>& Positions, const std::vector<Index3i>& Triangles)
+{
+	DynamicMesh3 Mesh;
+	for (const Vector3d& Position : Positions)
+		Mesh.AppendVertex(Position);
+	for (const Index3i& Tri : Triangles)
+		Mesh.AppendTriangle(Tri);
+	return Mesh;
+}
+
+// the two triangles of each interior edge traverse it in opposite directions
+static bool IsConsistentlyOriented(const DynamicMesh3& Mesh)
+{
+	auto GetEdgeDirection = [&](int TriangleID, int EdgeID) {
+		const Index3i& TriV = Mesh.GetTriangle(TriangleID);
+		const Index3i& TriE = Mesh.GetTriEdges(TriangleID);
+		for (int j = 0; j < 3; ++j)
+			if (TriE[j] == EdgeID) return Index2i(TriV[j], TriV[(j + 1) % 3]);
+		return Index2i(-1, -1);
+	};
+	for (int EdgeID = 0; EdgeID < Mesh.MaxEdgeID(); ++EdgeID) {
+		if (Mesh.IsEdge(EdgeID) == false || Mesh.IsBoundaryEdge(EdgeID)) continue;
+		Index2i DirA = GetEdgeDirection(Mesh.GetEdgeT(EdgeID).A, EdgeID), DirB = GetEdgeDirection(Mesh.GetEdgeT(EdgeID).B, EdgeID);
+		if (DirA.A < 0 || DirA.A != DirB.B || DirA.B != DirB.A)
+			return false;
+	}
+	return true;
+}
+
+static bool DenseMeshesMatch(const DenseMesh& A, const DenseMesh& B)
+{
+	bool bMatch = A.GetVertexCount() == B.GetVertexCount() && A.GetTriangleCount() == B.GetTriangleCount();
+	for (int k = 0; k < A.GetVertexCount() && bMatch; ++k)
+		bMatch = A.GetPosition(k) == B.GetPosition(k);
+	for (int k = 0; k < A.GetTriangleCount() && bMatch; ++k)
+		bMatch = A.GetTriangle(k) == B.GetTriangle(k) && A.GetTriGroup(k) == B.GetTriGroup(k);
+	return bMatch;
+}
+
+// Random SplitEdge / FlipEdge / CollapseEdge / PokeTriangle / RemoveVertex, with validity, orientation and
+// element count checks after each step. Returns false on the first failed check.
+static bool RandomEdits(DynamicMesh3& Mesh, int NumSteps, unsigned int Seed, int& NumCollapsesOut)
+{
+	std::mt19937 Random(Seed);
+	auto PickID = [&](int MaxID, auto IsValidFunc) {
+		int ID = (int)(Random() % MaxID);
+		while (IsValidFunc(ID) == false)
+			ID = (int)(Random() % MaxID);
+		return ID;
+	};
+	NumCollapsesOut = 0;
+	for (int Step = 0; Step < NumSteps; ++Step)
+	{
+		int NumV = Mesh.VertexCount(), NumT = Mesh.TriangleCount(), NumE = Mesh.EdgeCount();
+		int Operation = (int)(Random() % 20);
+		int EdgeID = PickID(Mesh.MaxEdgeID(), [&](int ID) { return Mesh.IsEdge(ID); });
+		bool bBoundary = Mesh.IsBoundaryEdge(EdgeID);
+		bool bCountsOK = true;
+		if (Operation < 6) {
+			DynamicMesh3::EdgeSplitInfo SplitInfo;
+			bCountsOK = Mesh.SplitEdge(EdgeID, SplitInfo, 0.3) == EDynamicMeshResult::Ok
+				&& Mesh.VertexCount() == NumV + 1 && Mesh.TriangleCount() == NumT + (bBoundary ? 1 : 2) && Mesh.EdgeCount() == NumE + (bBoundary ? 2 : 3);
+		}
+		else if (Operation < 11) {
+			DynamicMesh3::EdgeFlipInfo FlipInfo;
+			if (Mesh.FlipEdge(EdgeID, FlipInfo) == EDynamicMeshResult::Ok)
+				bCountsOK = Mesh.FindEdge(FlipInfo.OpposingVertices.A, FlipInfo.OpposingVertices.B) == EdgeID;
+			bCountsOK = bCountsOK && Mesh.VertexCount() == NumV && Mesh.TriangleCount() == NumT && Mesh.EdgeCount() == NumE;
+		}
+		else if (Operation < 17) {
+			DynamicMesh3::EdgeCollapseInfo CollapseInfo;
+			Index2i EdgeV = Mesh.GetEdgeV(EdgeID);
+			if (Mesh.CollapseEdge(EdgeV.A, EdgeV.B, CollapseInfo, 0.5) == EDynamicMeshResult::Ok) {
+				NumCollapsesOut++;
+				bCountsOK = Mesh.IsVertex(EdgeV.B) == false && Mesh.VertexCount() == NumV - 1
+					&& Mesh.TriangleCount() == NumT - (bBoundary ? 1 : 2) && Mesh.EdgeCount() == NumE - (bBoundary ? 2 : 3);
+			}
+			else
+				bCountsOK = Mesh.VertexCount() == NumV && Mesh.TriangleCount() == NumT && Mesh.EdgeCount() == NumE;
+		}
+		else if (Operation < 19) {
+			DynamicMesh3::PokeTriangleInfo PokeInfo;
+			int TriangleID = PickID(Mesh.MaxTriangleID(), [&](int ID) { return Mesh.IsTriangle(ID); });
+			bCountsOK = Mesh.PokeTriangle(TriangleID, Vector3d(0.2, 0.3, 0.5), PokeInfo) == EDynamicMeshResult::Ok
+				&& Mesh.VertexCount() == NumV + 1 && Mesh.TriangleCount() == NumT + 2 && Mesh.EdgeCount() == NumE + 3;
+		}
+		else if (NumT > 50) {
+			int VertexID = PickID(Mesh.MaxVertexID(), [&](int ID) { return Mesh.IsVertex(ID); });
+			bCountsOK = Mesh.RemoveVertex(VertexID) == EDynamicMeshResult::Ok && Mesh.IsVertex(VertexID) == false;
+		}
+		if (bCountsOK == false || Mesh.CheckValidity() == false || IsConsistentlyOriented(Mesh) == false)
+			return false;
+	}
+	return true;
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	const int W = 12, H = 10;
+
+	// Copy() and ExtractCompactMesh() of a compact mesh give back the same mesh. A fin triangle on an interior edge is skipped.
+	{
+		DenseMesh Grid = MakeGrid(W, H);
+		DynamicMesh3 Mesh;
+		Mesh.Copy(Grid);
+		GS_TEST_CHECK(Mesh.CheckValidity() && IsConsistentlyOriented(Mesh) && Mesh.IsCompact());
+		GS_TEST_CHECK(Mesh.VertexCount() == Grid.GetVertexCount() && Mesh.TriangleCount() == Grid.GetTriangleCount());
+		GS_TEST_CHECK(Mesh.EdgeCount() == W * (H + 1) + H * (W + 1) + W * H);
+		DenseMesh Extracted;
+		Mesh.ExtractCompactMesh(Extracted);
+		GS_TEST_CHECK(DenseMeshesMatch(Extracted, Grid));
+
+		DenseMesh FinGrid = MakeGrid(W, H, true);
+		int FinTriangle = FinGrid.GetTriangleCount() - 1;
+		unsafe_vector<int> Skipped;
+		Mesh.Copy(FinGrid, true, &Skipped);
+		GS_TEST_CHECK(Skipped.size() == 1 && Skipped[0] == FinTriangle);
+		GS_TEST_CHECK(Mesh.CheckValidity() && Mesh.TriangleCount() == FinTriangle);
+	}
+
+	// random edits on an open grid and a closed octahedron
+	DynamicMesh3 GridMesh, ClosedMesh;
+	GridMesh.Copy(MakeGrid(W, H));
+	ClosedMesh.Copy(MakeOctahedron());
+	int NumGridCollapses = 0, NumClosedCollapses = 0;
+	GS_TEST_CHECK(RandomEdits(GridMesh, 3000, 1, NumGridCollapses));
+	GS_TEST_CHECK(RandomEdits(ClosedMesh, 3000, 2, NumClosedCollapses));
+	GS_TEST_CHECK(NumGridCollapses > 100 && NumClosedCollapses > 100);
+	GS_TEST_CHECK(GridMesh.IsCompact() == false);
+
+	// compacting an edited mesh preserves positions, triangles and groups, and copying the result back is lossless
+	{
+		DenseMesh Compacted;
+		unsafe_vector<int> VertexMap, TriangleMap;
+		GridMesh.ExtractCompactMesh(Compacted, &VertexMap, &TriangleMap);
+		GS_TEST_CHECK(Compacted.GetVertexCount() == GridMesh.VertexCount() && Compacted.GetTriangleCount() == GridMesh.TriangleCount());
+		bool bMapped = true;
+		for (int VertexID = 0; VertexID < GridMesh.MaxVertexID(); ++VertexID) {
+			if (GridMesh.IsVertex(VertexID))
+				bMapped = bMapped && Compacted.GetPosition(VertexMap[VertexID]) == GridMesh.GetVertex(VertexID);
+			else
+				bMapped = bMapped && VertexMap[VertexID] == DynamicMesh3::InvalidID;
+		}
+		for (int TriangleID = 0; TriangleID < GridMesh.MaxTriangleID(); ++TriangleID) {
+			if (GridMesh.IsTriangle(TriangleID) == false) {
+				bMapped = bMapped && TriangleMap[TriangleID] == DynamicMesh3::InvalidID;
+				continue;
+			}
+			const Index3i& TriV = GridMesh.GetTriangle(TriangleID);
+			bMapped = bMapped && Compacted.GetTriangle(TriangleMap[TriangleID]) == Index3i(VertexMap[TriV.A], VertexMap[TriV.B], VertexMap[TriV.C])
+				&& Compacted.GetTriGroup(TriangleMap[TriangleID]) == GridMesh.GetTriangleGroup(TriangleID);
+		}
+		GS_TEST_CHECK(bMapped);
+
+		DynamicMesh3 CopiedBack;
+		unsafe_vector<int> Skipped;
+		CopiedBack.Copy(Compacted, true, &Skipped);
+		GS_TEST_CHECK(Skipped.size() == 0 && CopiedBack.IsCompact() && CopiedBack.CheckValidity());
+		GS_TEST_CHECK(CopiedBack.EdgeCount() == GridMesh.EdgeCount());
+		DenseMesh CompactedAgain;
+		CopiedBack.ExtractCompactMesh(CompactedAgain);
+		GS_TEST_CHECK(DenseMeshesMatch(CompactedAgain, Compacted));
+	}
+
+	// IDs freed by CollapseEdge and RemoveVertex are reused by SplitEdge and PokeTriangle, so the ID ranges do not grow
+	{
+		DynamicMesh3 Mesh;
+		Mesh.Copy(MakeGrid(W, H));
+		int MaxV = Mesh.MaxVertexID(), MaxT = Mesh.MaxTriangleID(), MaxE = Mesh.MaxEdgeID();
+		int Center = (H / 2) * (W + 1) + W / 2;
+		DynamicMesh3::EdgeCollapseInfo CollapseInfo;
+		GS_TEST_CHECK(Mesh.CollapseEdge(Center, Center + 1, CollapseInfo) == EDynamicMeshResult::Ok);
+		DynamicMesh3::EdgeSplitInfo SplitInfo;
+		GS_TEST_CHECK(Mesh.SplitEdge(CollapseInfo.KeptEdges.A, SplitInfo) == EDynamicMeshResult::Ok);
+		GS_TEST_CHECK(SplitInfo.NewVertex == CollapseInfo.RemovedVertex);
+		GS_TEST_CHECK(SplitInfo.NewTriangles.Contains(CollapseInfo.RemovedTriangles.A) && SplitInfo.NewTriangles.Contains(CollapseInfo.RemovedTriangles.B));
+		GS_TEST_CHECK(Mesh.MaxVertexID() == MaxV && Mesh.MaxTriangleID() == MaxT && Mesh.MaxEdgeID() == MaxE);
+
+		int RemovedVertex = 2 * (W + 1) + 2;
+		int NumTrianglesBefore = Mesh.TriangleCount();
+		GS_TEST_CHECK(Mesh.RemoveVertex(RemovedVertex) == EDynamicMeshResult::Ok);
+		int NumRemovedTriangles = NumTrianglesBefore - Mesh.TriangleCount();
+		GS_TEST_CHECK(NumRemovedTriangles == 6);
+		DynamicMesh3::PokeTriangleInfo PokeInfo;
+		int PokedTriangle = 0;
+		GS_TEST_CHECK(Mesh.PokeTriangle(PokedTriangle, Vector3d(1.0 / 3.0, 1.0 / 3.0, 1.0 / 3.0), PokeInfo) == EDynamicMeshResult::Ok);
+		GS_TEST_CHECK(PokeInfo.NewVertex == RemovedVertex);
+		GS_TEST_CHECK(Mesh.MaxVertexID() == MaxV && Mesh.MaxTriangleID() == MaxT && Mesh.MaxEdgeID() == MaxE);
+		GS_TEST_CHECK(Mesh.CheckValidity() && IsConsistentlyOriented(Mesh));
+	}
+
+	// collapses that fail leave the mesh unchanged
+	{
+		auto CheckCollapseFails = [](DynamicMesh3& Mesh, int KeepV, int RemoveV, EDynamicMeshResult ExpectedResult) {
+			int NumV = Mesh.VertexCount(), NumT = Mesh.TriangleCount(), NumE = Mesh.EdgeCount();
+			DynamicMesh3::EdgeCollapseInfo CollapseInfo;
+			return Mesh.CollapseEdge(KeepV, RemoveV, CollapseInfo) == ExpectedResult && Mesh.CheckValidity()
+				&& Mesh.VertexCount() == NumV && Mesh.TriangleCount() == NumT && Mesh.EdgeCount() == NumE;
+		};
+		std::vector<Vector3d> Corners = { Vector3d(0,0,0), Vector3d(1,0,0), Vector3d(0,1,0), Vector3d(0,0,1) };
+
+		DynamicMesh3 Tetrahedron = MakeDynamicMesh(Corners, { Index3i(0,2,1), Index3i(0,1,3), Index3i(0,3,2), Index3i(1,2,3) });
+		GS_TEST_CHECK(Tetrahedron.TriangleCount() == 4 && IsConsistentlyOriented(Tetrahedron));
+		GS_TEST_CHECK(CheckCollapseFails(Tetrahedron, 0, 1, EDynamicMeshResult::Failed_CollapseTetrahedron));
+
+		DynamicMesh3 IsolatedTriangle = MakeDynamicMesh(Corners, { Index3i(0,1,2) });
+		GS_TEST_CHECK(CheckCollapseFails(IsolatedTriangle, 0, 1, EDynamicMeshResult::Failed_CollapseTriangle));
+
+		// open tetrahedron, the vertices of boundary edge (0,1) share neighbours 2 and 3, so the link condition fails
+		DynamicMesh3 OpenTetrahedron = MakeDynamicMesh(Corners, { Index3i(0,1,2), Index3i(0,2,3), Index3i(2,1,3) });
+		GS_TEST_CHECK(OpenTetrahedron.TriangleCount() == 3 && OpenTetrahedron.IsBoundaryEdge(OpenTetrahedron.FindEdge(0, 1)));
+		GS_TEST_CHECK(CheckCollapseFails(OpenTetrahedron, 0, 1, EDynamicMeshResult::Failed_InvalidNeighbourhood));
+
+		// interior grid edge between two boundary vertices
+		DynamicMesh3 Grid;
+		Grid.Copy(MakeGrid(W, H));
+		GS_TEST_CHECK(Grid.IsBoundaryEdge(Grid.FindEdge(W - 1, 2 * W + 1)) == false);
+		GS_TEST_CHECK(CheckCollapseFails(Grid, W - 1, 2 * W + 1, EDynamicMeshResult::Failed_InvalidNeighbourhood));
+		GS_TEST_CHECK(CheckCollapseFails(Grid, 0, W + 5, EDynamicMeshResult::Failed_NotAnEdge));
+	}
+
+	return GSTest::FinishTest("test_dynamic_mesh3");
+}
+#endif
@@ -0,0 +1,51 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Core/inline_stack.h"
+
+using namespace GS;
+
+int main()
+{
+	// push and pop across the inline capacity, interleaved the way a depth-first traversal does,
+	// and check that values pushed after the spill are the ones popped
+	inline_stack<int, 8> stack;
+	int Expected[256];
+	int ExpectedSize = 0;
+	bool bAllMatched = true;
+	for (int k = 0; k < 200; ++k)
+	{
+		int NumPush = (k % 3 == 2) ? 1 : 3;
+		for (int j = 0; j < NumPush && ExpectedSize < 256; ++j) {
+			stack.push_back(k * 10 + j);
+			Expected[ExpectedSize++] = k * 10 + j;
+		}
+		int Value = -1;
+		GS_TEST_CHECK(stack.pop_back(Value));
+		bAllMatched = bAllMatched && (Value == Expected[--ExpectedSize]);
+	}
+	GS_TEST_CHECK(bAllMatched);
+	GS_TEST_CHECK(stack.is_heap_allocated());
+	GS_TEST_CHECK(stack.size() == ExpectedSize);
+
+	// drain below the inline capacity and push again, values must not be lost
+	int Value = -1;
+	while (stack.size() > 4)
+		stack.pop_back(Value);
+	stack.push_back(12345);
+	GS_TEST_CHECK(stack.pop_back(Value) && Value == 12345);
+	GS_TEST_CHECK(stack.pop_back(Value) && Value == Expected[3]);
+
+	stack.clear(true);
+	GS_TEST_CHECK(stack.empty() && stack.is_heap_allocated() == false);
+	GS_TEST_CHECK(stack.pop_back(Value) == false);
+
+	// small stacks never allocate
+	inline_stack<int, 64> small_stack;
+	for (int k = 0; k < 64; ++k)
+		small_stack.push_back(k);
+	GS_TEST_CHECK(small_stack.is_heap_allocated() == false);
+
+	return GSTest::FinishTest("test_inline_stack");
+}
+#endif
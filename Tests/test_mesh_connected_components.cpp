@@ -0,0 +1,197 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Core/ConcurrentUnionFind.h"
+#include "Core/ParallelFor.h"
+#include "Mesh/MeshConnectedComponents.h"
+#include "Mesh/MeshTopology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace GS;
+
+// serial union-find, used as the reference
+struct ReferenceUnionFind
+{
+	std::vector<int> Parents;
+	explicit ReferenceUnionFind(int N) : Parents(N) {
+		for (int k = 0; k < N; ++k) Parents[k] = k;
+	}
+	int Find(int k) {
+		while (Parents[k] != k) k = Parents[k];
+		return k;
+	}
+	void Union(int a, int b) {
+		a = Find(a); b = Find(b);
+		if (a != b) Parents[std::max(a, b)] = std::min(a, b);
+	}
+	//! component of each element, numbered in order of the smallest element of each component, or -1 if invalid
+	std::vector<int> ComponentIDs(const std::vector<bool>& Valid, const std::vector<int>& ElementToSet) {
+		std::map<int, int> SetToComponent;
+		std::vector<int> Result(Valid.size(), -1);
+		for (size_t k = 0; k < Valid.size(); ++k) {
+			if (Valid[k] == false) continue;
+			int Set = Find(ElementToSet[k]);
+			if (SetToComponent.count(Set) == 0) {
+				int NewComponentID = (int)SetToComponent.size();
+				SetToComponent[Set] = NewComponentID;
+			}
+			Result[k] = SetToComponent[Set];
+		}
+		return Result;
+	}
+};
+
+// ComponentIDs match Expected, and the CSR lists contain each valid element once, in increasing order, in the list of its component
+static bool ComponentsMatch(const MeshConnectedComponents& Components, const std::vector<int>& Expected)
+{
+	int NumElements = (int)Expected.size();
+	int NumComponents = (NumElements > 0) ? *std::max_element(Expected.begin(), Expected.end()) + 1 : 0;
+	int NumValid = (int)std::count_if(Expected.begin(), Expected.end(), [](int c) { return c >= 0; });
+	bool bMatch = Components.NumElements() == NumElements && Components.NumComponents() == NumComponents
+		&& Components.ComponentOffsets.size() == (size_t)NumComponents + 1 && (int)Components.ComponentElements.size() == NumValid
+		&& Components.ComponentOffsets[0] == 0 && Components.ComponentOffsets[NumComponents] == NumValid;
+	for (int k = 0; k < NumElements && bMatch; ++k)
+		bMatch = Components.ComponentIDs[k] == Expected[k];
+	std::vector<int> Seen(NumElements, 0);
+	for (int c = 0; c < NumComponents && bMatch; ++c) {
+		bMatch = Components.GetComponentSize(c) > 0;
+		int Prev = -1;
+		for (int ElementID : Components.GetComponent(c)) {
+			bMatch = bMatch && ElementID > Prev && ElementID < NumElements && Expected[ElementID] == c;
+			if (bMatch) Seen[ElementID]++;
+			Prev = ElementID;
+		}
+	}
+	for (int k = 0; k < NumElements && bMatch; ++k)
+		bMatch = Seen[k] == ((Expected[k] >= 0) ? 1 : 0);
+	return bMatch;
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	// concurrent unions from many threads give the same sets as serial unions, with the smallest element as root
+	{
+		const int N = 100000, NumPairs = 80000;
+		std::mt19937 Random(7);
+		std::vector<std::pair<int, int>> Pairs(NumPairs);
+		for (auto& Pair : Pairs)
+			Pair = std::make_pair((int)(Random() % N), (int)(Random() % N));
+		ReferenceUnionFind Reference(N);
+		for (auto& Pair : Pairs)
+			Reference.Union(Pair.first, Pair.second);
+
+		ConcurrentUnionFind UnionFind;
+		UnionFind.Initialize(N);
+		std::atomic<int> NumMerges = 0;
+		const int PairsPerJob = 1000;
+		GS::ParallelFor(NumPairs / PairsPerJob, [&](uint32_t JobIndex) {
+			for (int k = (int)JobIndex * PairsPerJob; k < ((int)JobIndex + 1) * PairsPerJob; ++k)
+				NumMerges += UnionFind.Union(Pairs[k].first, Pairs[k].second) ? 1 : 0;
+		});
+		int NumSets = 0;
+		bool bRootsMatch = true;
+		for (int k = 0; k < N; ++k) {
+			NumSets += (Reference.Find(k) == k) ? 1 : 0;
+			bRootsMatch = bRootsMatch && UnionFind.Find(k) == Reference.Find(k);
+		}
+		GS_TEST_CHECK(bRootsMatch);
+		GS_TEST_CHECK(NumMerges == N - NumSets);
+		UnionFind.Flatten();
+		bool bFlat = true;
+		for (int k = 0; k < N; ++k)
+			bFlat = bFlat && UnionFind.Parents[k] == Reference.Find(k);
+		GS_TEST_CHECK(bFlat);
+	}
+
+	// Separate grid patches, with more triangles than one block (16k). A column of invalid triangles splits patch 4.
+	// Two fin triangles on a boundary edge of patch 0 make it nonmanifold, and a bowtie triangle touches patch 3 at one vertex.
+	const int NumPatches = 40, W = 20, H = 12;
+	int NumVertices = 0;
+	std::vector<Index3i> Triangles;
+	std::vector<bool> TriangleValid;
+	for (int p = 0; p < NumPatches; ++p) {
+		int Base = NumVertices;
+		NumVertices += (W + 1) * (H + 1);
+		for (int y = 0; y < H; ++y) {
+			for (int x = 0; x < W; ++x) {
+				int v = Base + y * (W + 1) + x;
+				bool bValid = !(p == 4 && x == W / 2);
+				Triangles.push_back(Index3i(v, v + 1, v + W + 2));
+				Triangles.push_back(Index3i(v, v + W + 2, v + W + 1));
+				TriangleValid.push_back(bValid);
+				TriangleValid.push_back(bValid);
+			}
+		}
+	}
+	int FinVertex = NumVertices;
+	NumVertices += 2;
+	Triangles.push_back(Index3i(1, 0, FinVertex));
+	Triangles.push_back(Index3i(0, 1, FinVertex + 1));
+	int BowtieVertex = NumVertices;
+	NumVertices += 2;
+	Triangles.push_back(Index3i(3 * (W + 1) * (H + 1), BowtieVertex, BowtieVertex + 1));
+	for (int k = 0; k < 3; ++k)
+		TriangleValid.push_back(true);
+	int NumTriangles = (int)Triangles.size();
+
+	auto GetTriangle = [&](int TriangleID, Index3i& TriVertices) {
+		TriVertices = Triangles[TriangleID];
+		return (bool)TriangleValid[TriangleID];
+	};
+	auto IsTriangleValid = [&](int TriangleID) { return (bool)TriangleValid[TriangleID]; };
+
+	// expected components connected via edges, with and without the triangles of nonmanifold edges, and via vertices
+	std::map<std::pair<int, int>, std::vector<int>> EdgeTriangles;
+	for (int TriangleID = 0; TriangleID < NumTriangles; ++TriangleID)
+		for (int j = 0; j < 3 && TriangleValid[TriangleID]; ++j) {
+			int A = Triangles[TriangleID][j], B = Triangles[TriangleID][(j + 1) % 3];
+			EdgeTriangles[std::make_pair(std::min(A, B), std::max(A, B))].push_back(TriangleID);
+		}
+	std::vector<int> Identity(NumTriangles), FirstVertex(NumTriangles);
+	for (int TriangleID = 0; TriangleID < NumTriangles; ++TriangleID) {
+		Identity[TriangleID] = TriangleID;
+		FirstVertex[TriangleID] = Triangles[TriangleID].A;
+	}
+	ReferenceUnionFind ManifoldSets(NumTriangles), NonManifoldSets(NumTriangles), VertexSets(NumVertices);
+	for (const auto& Edge : EdgeTriangles) {
+		const std::vector<int>& EdgeTris = Edge.second;
+		for (size_t k = 1; k < EdgeTris.size(); ++k) {
+			if (EdgeTris.size() == 2)
+				ManifoldSets.Union(EdgeTris[0], EdgeTris[k]);
+			NonManifoldSets.Union(EdgeTris[0], EdgeTris[k]);
+		}
+		VertexSets.Union(Edge.first.first, Edge.first.second);
+	}
+	std::vector<int> ExpectedManifold = ManifoldSets.ComponentIDs(TriangleValid, Identity);
+	std::vector<int> ExpectedNonManifold = NonManifoldSets.ComponentIDs(TriangleValid, Identity);
+	std::vector<int> ExpectedVertex = VertexSets.ComponentIDs(TriangleValid, FirstVertex);
+	// patch 4 is split, fins are separate or joined to patch 0, and the bowtie is only joined to patch 3 via its vertex
+	GS_TEST_CHECK(*std::max_element(ExpectedManifold.begin(), ExpectedManifold.end()) + 1 == NumPatches + 4);
+	GS_TEST_CHECK(*std::max_element(ExpectedNonManifold.begin(), ExpectedNonManifold.end()) + 1 == NumPatches + 2);
+	GS_TEST_CHECK(*std::max_element(ExpectedVertex.begin(), ExpectedVertex.end()) + 1 == NumPatches + 1);
+
+	MeshTopology Topology, TopologyWithTriEdges;
+	Topology.Build(NumVertices, [](int) { return true; }, NumTriangles, GetTriangle, EMeshTopologyTypes::All);
+	TopologyWithTriEdges.Build(NumVertices, [](int) { return true; }, NumTriangles, GetTriangle, EMeshTopologyTypes::All | EMeshTopologyTypes::TriangleEdges);
+
+	for (bool bParallel : { false, true })
+	{
+		MeshConnectedComponents Components;
+		Components.BuildTriangleComponents(Topology, NumTriangles, IsTriangleValid, bParallel);
+		GS_TEST_CHECK(ComponentsMatch(Components, ExpectedManifold));
+		Components.BuildTriangleComponents(TopologyWithTriEdges, NumTriangles, IsTriangleValid, bParallel);
+		GS_TEST_CHECK(ComponentsMatch(Components, ExpectedNonManifold));
+		Components.BuildTriangleComponents(NumVertices, NumTriangles, GetTriangle, bParallel);
+		GS_TEST_CHECK(ComponentsMatch(Components, ExpectedVertex));
+	}
+
+	return GSTest::FinishTest("test_mesh_connected_components");
+}
+#endif
@@ -0,0 +1,126 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Mesh/PolyMesh.h"
+#include "Mesh/DenseMesh.h"
+#include "Mesh/MeshConversion.h"
+
+#include <cmath>
+
+using namespace GS;
+
+// corner UVs and groups of each DenseMesh triangle must match face TriIndex of the PolyMesh
+static bool TrianglesMatch(const DenseMesh& Dense, const PolyMesh& Poly)
+{
+	bool bMatch = (Poly.GetFaceCount() == Dense.GetTriangleCount());
+	for (int TriIndex = 0; TriIndex < Dense.GetTriangleCount() && bMatch; ++TriIndex) {
+		const PolyMesh::Face& Face = Poly.GetFace(TriIndex);
+		bMatch = Poly.GetFaceVertexCount(Face) == 3 && Poly.GetFaceGroup(TriIndex) == Dense.GetTriGroup(TriIndex);
+		for (int j = 0; j < 3 && bMatch; ++j) {
+			bMatch = Poly.GetFaceVertex(Face, j) == Dense.GetTriangle(TriIndex)[j]
+				&& (Vector2f)Poly.GetFaceVertexUV(Face, j) == Dense.GetTriVtxUVs(TriIndex)[j];
+		}
+	}
+	return bMatch;
+}
+
+static bool UVIndicesMatch(const PolyMesh& A, const PolyMesh& B)
+{
+	bool bMatch = (A.GetFaceCount() == B.GetFaceCount() && A.GetUVCount(0) == B.GetUVCount(0));
+	for (int FaceIndex = 0; FaceIndex < A.GetFaceCount() && bMatch; ++FaceIndex)
+		for (int j = 0; j < A.GetFaceVertexCount(FaceIndex) && bMatch; ++j)
+			bMatch = A.GetFaceVertexUVIndex(A.GetFace(FaceIndex), j) == B.GetFaceVertexUVIndex(B.GetFace(FaceIndex), j);
+	return bMatch;
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	DenseMeshToPolyMeshOptions SerialOptions;
+	SerialOptions.bParallel = false;
+
+	// grid of quads with per-vertex UVs, and a separate pentagon without UVs
+	{
+		const int N = 20;
+		PolyMesh Mesh;
+		Mesh.SetNumGroupSets(1);
+		Mesh.AddUVSet(0);
+		for (int y = 0; y <= N; ++y) {
+			for (int x = 0; x <= N; ++x) {
+				Mesh.AddVertex(Vector3d(x, y, 0));
+				Mesh.AppendUV(Vector2d(x * 0.1, y * 0.1));
+			}
+		}
+		for (int y = 0; y < N; ++y) {
+			for (int x = 0; x < N; ++x) {
+				int v = y * (N + 1) + x;
+				Index4i Quad(v, v + 1, v + N + 2, v + N + 1);
+				Mesh.AddQuad(Quad, (x + y) % 3, nullptr, &Quad);
+			}
+		}
+		int Pentagon[5];
+		for (int k = 0; k < 5; ++k)
+			Pentagon[k] = Mesh.AddVertex(Vector3d(100 + std::cos(k * 1.2566), std::sin(k * 1.2566), 0));
+		Mesh.AddPolygon(const_buffer_view<int>(Pentagon, 5), 7);
+
+		DenseMesh Dense;
+		unsafe_vector<int> TriangleToFace;
+		ConvertPolyMeshToDenseMesh(Mesh, Dense, PolyMeshToDenseMeshOptions(), &TriangleToFace);
+		GS_TEST_CHECK(Dense.GetVertexCount() == Mesh.GetVertexCount());
+		GS_TEST_CHECK(Dense.GetTriangleCount() == 2 * N * N + 3);
+		GS_TEST_CHECK(Dense.GetNumUVSets() == 1);
+		bool bFacesMatch = true;
+		for (int TriIndex = 0; TriIndex < Dense.GetTriangleCount(); ++TriIndex)
+			bFacesMatch = bFacesMatch && Dense.GetTriGroup(TriIndex) == Mesh.GetFaceGroup(TriangleToFace[TriIndex]);
+		GS_TEST_CHECK(bFacesMatch);
+
+		PolyMesh Poly, SerialPoly;
+		ConvertDenseMeshToPolyMesh(Dense, Poly);
+		ConvertDenseMeshToPolyMesh(Dense, SerialPoly, SerialOptions);
+		GS_TEST_CHECK(Poly.GetVertexCount() == Mesh.GetVertexCount());
+		GS_TEST_CHECK(TrianglesMatch(Dense, Poly));
+		// UVs are welded back to one per vertex
+		GS_TEST_CHECK(Poly.GetUVCount(0) == (N + 1) * (N + 1) + 5);
+		GS_TEST_CHECK(UVIndicesMatch(Poly, SerialPoly));
+	}
+
+	// high-valence fan with float positions, the corners of the center vertex have three distinct UVs, one of
+	// them as both +0 and -0. Rim vertices have one UV each.
+	{
+		const int NumRim = 3000;
+		DenseMesh Dense;
+		Dense.SetFloatPositions(true);
+		Dense.Resize(NumRim + 1, NumRim);
+		Dense.SetPosition(0, Vector3d::Zero());
+		for (int k = 0; k < NumRim; ++k)
+			Dense.SetPosition(k + 1, Vector3d(std::cos(k * 0.002), std::sin(k * 0.002), 0));
+		const Vector2f CenterUVs[4] = { Vector2f(0, 0), Vector2f(1, 0), Vector2f(-0.0f, 0), Vector2f(0, 1) };
+		for (int k = 0; k < NumRim; ++k) {
+			int Next = (k + 1) % NumRim;
+			Dense.SetTriangle(k, Index3i(0, k + 1, Next + 1));
+			Dense.SetTriVtxUVs(k, TriVtxUVs(CenterUVs[k % 4], Vector2f((float)k, 1), Vector2f((float)Next, 1)));
+		}
+
+		PolyMesh Poly, SerialPoly;
+		ConvertDenseMeshToPolyMesh(Dense, Poly);
+		ConvertDenseMeshToPolyMesh(Dense, SerialPoly, SerialOptions);
+		GS_TEST_CHECK(TrianglesMatch(Dense, Poly));
+		GS_TEST_CHECK(Poly.GetUVCount(0) == 3 + NumRim);
+		GS_TEST_CHECK(UVIndicesMatch(Poly, SerialPoly));
+		GS_TEST_CHECK(Poly.GetPosition(NumRim) == (Vector3d)(Vector3f)Dense.GetPosition(NumRim));
+
+		DenseMesh RoundTrip;
+		ConvertPolyMeshToDenseMesh(Poly, RoundTrip, PolyMeshToDenseMeshOptions());
+		bool bSame = RoundTrip.GetTriangleCount() == NumRim && RoundTrip.GetNumUVSets() == 1;
+		for (int k = 0; k < NumRim && bSame; ++k) {
+			bSame = RoundTrip.GetTriangle(k) == Dense.GetTriangle(k);
+			for (int j = 0; j < 3; ++j)
+				bSame = bSame && RoundTrip.GetTriVtxUVs(k)[j] == Dense.GetTriVtxUVs(k)[j];
+		}
+		GS_TEST_CHECK(bSame);
+	}
+
+	return GSTest::FinishTest("test_mesh_conversion");
+}
+#endif
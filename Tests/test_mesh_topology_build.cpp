@@ -0,0 +1,183 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Mesh/MeshTopology.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace GS;
+
+// Reference topology built by inserting the edges of each triangle one at a time, in TriangleID order.
+// This is the serial algorithm that MeshTopology::Build used before the sort-based build. Nonmanifold edges
+// have no VertexTriangles and give -2 TriNeighbours, as in Build().
+struct ReferenceTopology
+{
+	std::vector<MeshTopology::Edge> Edges;
+	std::vector<std::vector<int>> VertexEdges;
+	std::vector<std::vector<int>> NonManifoldEdgeTriLists;
+	std::vector<std::vector<int>> VertexTriangles;
+	std::vector<std::vector<int>> VertexVertices;
+	std::vector<Index3i> TriNeighbours;
+
+	int FindEdgeID(int VertA, int VertB) const
+	{
+		for (int EdgeID : VertexEdges[VertA])
+			if (Edges[EdgeID].Vertices == Index2i(VertA, VertB))
+				return EdgeID;
+		return -1;
+	}
+
+	void Build(int NumVertexIDs, const std::vector<Index3i>& Triangles, const std::vector<bool>& TriangleValid)
+	{
+		int NumTriangleIDs = (int)Triangles.size();
+		auto IsValid = [&](int TriangleID) {
+			const Index3i& TriV = Triangles[TriangleID];
+			return TriangleValid[TriangleID] && TriV.A >= 0 && TriV.B >= 0 && TriV.C >= 0;
+		};
+		VertexEdges.resize(NumVertexIDs);
+		for (int TriangleID = 0; TriangleID < NumTriangleIDs; ++TriangleID) {
+			if (IsValid(TriangleID) == false) continue;
+			for (int j = 0; j < 3; ++j) {
+				int VertA = Triangles[TriangleID][j], VertB = Triangles[TriangleID][(j + 1) % 3];
+				if (VertB < VertA) std::swap(VertA, VertB);
+				int EdgeID = FindEdgeID(VertA, VertB);
+				if (EdgeID < 0) {
+					Edges.push_back(MeshTopology::Edge{ Index2i(VertA, VertB), Index2i(TriangleID, -1) });
+					VertexEdges[VertA].push_back((int)Edges.size() - 1);
+					VertexEdges[VertB].push_back((int)Edges.size() - 1);
+					continue;
+				}
+				Index2i& TriInfo = Edges[EdgeID].TriInfo;
+				if (TriInfo.A == -1)
+					NonManifoldEdgeTriLists[TriInfo.B].push_back(TriangleID);
+				else if (TriInfo.B != -1) {
+					NonManifoldEdgeTriLists.push_back({ TriInfo.A, TriInfo.B, TriangleID });
+					TriInfo = Index2i(-1, (int)NonManifoldEdgeTriLists.size() - 1);
+				}
+				else
+					TriInfo.B = TriangleID;
+			}
+		}
+
+		VertexTriangles.resize(NumVertexIDs);
+		VertexVertices.resize(NumVertexIDs);
+		for (int VertexID = 0; VertexID < NumVertexIDs; ++VertexID) {
+			std::vector<int>& OneRingTris = VertexTriangles[VertexID];
+			auto AddUnique = [&](int TriangleID) {
+				for (int Existing : OneRingTris)
+					if (Existing == TriangleID) return;
+				OneRingTris.push_back(TriangleID);
+			};
+			for (int EdgeID : VertexEdges[VertexID]) {
+				const MeshTopology::Edge& Edge = Edges[EdgeID];
+				VertexVertices[VertexID].push_back(Edge.Vertices.GetOtherValue(VertexID));
+				if (Edge.IsManifold() == false) continue;
+				AddUnique(Edge.TriInfo.A);
+				if (Edge.TriInfo.B >= 0)
+					AddUnique(Edge.TriInfo.B);
+			}
+		}
+
+		TriNeighbours.assign(NumTriangleIDs, Index3i(-1, -1, -1));
+		for (int TriangleID = 0; TriangleID < NumTriangleIDs; ++TriangleID) {
+			if (IsValid(TriangleID) == false) continue;
+			for (int j = 0; j < 3; ++j) {
+				int VertA = Triangles[TriangleID][j], VertB = Triangles[TriangleID][(j + 1) % 3];
+				const MeshTopology::Edge& Edge = Edges[FindEdgeID(std::min(VertA, VertB), std::max(VertA, VertB))];
+				TriNeighbours[TriangleID][j] = (Edge.IsManifold()) ? Edge.TriInfo.GetOtherValue(TriangleID) : -2;
+			}
+		}
+	}
+};
+
+static bool ListsMatch(const packed_int_lists& Lists, const std::vector<std::vector<int>>& Expected)
+{
+	if (Lists.NumLists() != (int)Expected.size())
+		return false;
+	for (int ListID = 0; ListID < Lists.NumLists(); ++ListID) {
+		std::vector<int> Items;
+		if (Lists.HasList(ListID))
+			for (int Value : Lists.GetListView(ListID))
+				Items.push_back(Value);
+		if (Items != Expected[ListID])
+			return false;
+	}
+	return true;
+}
+
+static bool TopologyMatchesReference(const MeshTopology& Topology, const ReferenceTopology& Reference)
+{
+	bool bMatch = Topology.Edges.size() == Reference.Edges.size();
+	for (size_t EdgeID = 0; EdgeID < Topology.Edges.size() && bMatch; ++EdgeID) {
+		bMatch = Topology.Edges[EdgeID].Vertices == Reference.Edges[EdgeID].Vertices
+			&& Topology.Edges[EdgeID].TriInfo == Reference.Edges[EdgeID].TriInfo;
+	}
+	bMatch = bMatch && ListsMatch(Topology.VertexEdges, Reference.VertexEdges);
+	bMatch = bMatch && ListsMatch(Topology.VertexTriangles, Reference.VertexTriangles);
+	bMatch = bMatch && ListsMatch(Topology.VertexVertices, Reference.VertexVertices);
+	if (Reference.NonManifoldEdgeTriLists.empty() == false)
+		bMatch = bMatch && ListsMatch(Topology.NonManifoldEdgeTriLists, Reference.NonManifoldEdgeTriLists);
+	bMatch = bMatch && Topology.TriNeighbours.size() == Reference.TriNeighbours.size();
+	for (size_t TriangleID = 0; TriangleID < Topology.TriNeighbours.size() && bMatch; ++TriangleID)
+		bMatch = Topology.TriNeighbours[TriangleID] == Reference.TriNeighbours[TriangleID];
+	return bMatch;
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	// Grid with more triangles than one build block (16k), with holes, so there are inner and outer boundaries.
+	// Degenerate triangles repeat a vertex, and either use new vertices or share a grid boundary edge, which
+	// makes that edge nonmanifold. A fin on an interior grid edge, invalid triangles and unreferenced vertices are added too.
+	const int N = 100;
+	int NumVertices = N * N;
+	std::vector<Index3i> Triangles;
+	std::vector<bool> TriangleValid;
+	for (int y = 0; y < N - 1; ++y) {
+		for (int x = 0; x < N - 1; ++x) {
+			int v = y * N + x;
+			bool bHole = (x % 17 == 5 && y % 13 == 7);
+			Triangles.push_back(Index3i(v, v + 1, v + N + 1));
+			Triangles.push_back(Index3i(v, v + N + 1, v + N));
+			TriangleValid.push_back(!bHole);
+			TriangleValid.push_back(!bHole);
+		}
+	}
+	int NewV = NumVertices;
+	NumVertices += 4;
+	for (Index3i Degenerate : { Index3i(NewV, NewV, NewV + 1), Index3i(NewV + 2, NewV + 2, NewV + 2), Index3i(NewV + 3, NewV + 1, NewV + 3),
+		Index3i(0, 1, 1), Index3i(N - 1, N - 1, N - 1) })
+	{
+		Triangles.push_back(Degenerate);
+		TriangleValid.push_back(true);
+	}
+	int FinV = NumVertices++;
+	Triangles.push_back(Index3i(N + 1, 2 * N + 2, FinV));
+	TriangleValid.push_back(true);
+	Triangles.push_back(Index3i(-1, 3, 4));
+	TriangleValid.push_back(true);
+	Triangles.push_back(Index3i(5, 6, 7));
+	TriangleValid.push_back(false);
+	NumVertices += 3;
+
+	auto GetTriangle = [&](int TriangleID, Index3i& TriVertices) {
+		TriVertices = Triangles[TriangleID];
+		return (bool)TriangleValid[TriangleID];
+	};
+
+	ReferenceTopology Reference;
+	Reference.Build(NumVertices, Triangles, TriangleValid);
+	GS_TEST_CHECK(Reference.NonManifoldEdgeTriLists.size() >= 3);
+
+	for (bool bParallel : { false, true })
+	{
+		MeshTopology Topology;
+		Topology.Build(NumVertices, [](int) { return true; }, (int)Triangles.size(), GetTriangle, EMeshTopologyTypes::All, bParallel);
+		GS_TEST_CHECK(TopologyMatchesReference(Topology, Reference));
+	}
+
+	return GSTest::FinishTest("test_mesh_topology_build");
+}
+#endif
@@ -0,0 +1,135 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Mesh/MeshTopology.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace GS;
+
+static const EMeshTopologyTypes UpdateParts = EMeshTopologyTypes::All | EMeshTopologyTypes::TriangleEdges | EMeshTopologyTypes::CornerTable;
+
+struct TestMesh
+{
+	int NumVertices = 0;
+	std::vector<Index3i> Triangles;
+	std::vector<bool> TriangleValid;
+
+	bool GetTriangle(int TriangleID, Index3i& TriVertices) const {
+		if (TriangleValid[TriangleID] == false) return false;
+		TriVertices = Triangles[TriangleID];
+		return true;
+	}
+	void Build(MeshTopology& Topology) const {
+		Topology.Build(NumVertices, [](int) { return true; }, (int)Triangles.size(),
+			[this](int TriangleID, Index3i& TriVertices) { return GetTriangle(TriangleID, TriVertices); }, UpdateParts, false);
+	}
+	bool Update(MeshTopology& Topology, const std::vector<int>& ChangedTriangleIDs) const {
+		return Topology.UpdateTriangles(NumVertices, (int)Triangles.size(), const_buffer_view<int>(ChangedTriangleIDs.data(), ChangedTriangleIDs.size()),
+			[this](int TriangleID, Index3i& TriVertices) { return GetTriangle(TriangleID, TriVertices); });
+	}
+};
+
+static std::vector<int> SortedList(const packed_int_lists& Lists, int ListID)
+{
+	std::vector<int> Result;
+	if (ListID < Lists.NumLists() && Lists.HasList(ListID))
+		for (int Value : Lists.GetListView(ListID))
+			Result.push_back(Value);
+	std::sort(Result.begin(), Result.end());
+	return Result;
+}
+
+// EdgeIDs of an updated topology differ from a full build because freed EdgeIDs are reused, so compare the edge-independent parts
+static bool TopologiesMatch(const MeshTopology& Updated, const MeshTopology& Built, const TestMesh& Mesh)
+{
+	bool bMatch = true;
+	for (int VertexID = 0; VertexID < Mesh.NumVertices; ++VertexID) {
+		bMatch = bMatch && SortedList(Updated.VertexTriangles, VertexID) == SortedList(Built.VertexTriangles, VertexID);
+		bMatch = bMatch && SortedList(Updated.VertexVertices, VertexID) == SortedList(Built.VertexVertices, VertexID);
+		bMatch = bMatch && SortedList(Updated.VertexEdges, VertexID).size() == SortedList(Built.VertexEdges, VertexID).size();
+		bMatch = bMatch && Updated.VertexCorners[VertexID] == Built.VertexCorners[VertexID];
+	}
+	for (int TriangleID = 0; TriangleID < (int)Mesh.Triangles.size(); ++TriangleID) {
+		bMatch = bMatch && Updated.TriNeighbours[TriangleID] == Built.TriNeighbours[TriangleID];
+		for (int j = 0; j < 3; ++j)
+			bMatch = bMatch && Updated.CornerOpposites[3 * TriangleID + j] == Built.CornerOpposites[3 * TriangleID + j];
+	}
+	int NumUsedEdges = 0;
+	for (const MeshTopology::Edge& Edge : Updated.Edges)
+		NumUsedEdges += Edge.IsFree() ? 0 : 1;
+	return bMatch && NumUsedEdges == (int)Built.Edges.size();
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	// removing a triangle leaves vertex 0 with no triangles
+	{
+		TestMesh Mesh;
+		Mesh.NumVertices = 4;
+		Mesh.Triangles = { Index3i(0, 1, 2), Index3i(1, 3, 2) };
+		Mesh.TriangleValid = { true, true };
+		MeshTopology Topology;
+		Mesh.Build(Topology);
+		Mesh.TriangleValid[0] = false;
+		GS_TEST_CHECK(Mesh.Update(Topology, { 0 }));
+		GS_TEST_CHECK(SortedList(Topology.VertexTriangles, 0).empty());
+		GS_TEST_CHECK(SortedList(Topology.VertexVertices, 0).empty());
+		GS_TEST_CHECK(SortedList(Topology.VertexTriangles, 1) == std::vector<int>{ 1 });
+		MeshTopology Built;
+		Mesh.Build(Built);
+		GS_TEST_CHECK(TopologiesMatch(Topology, Built, Mesh));
+	}
+
+	// random removals, re-additions and new triangles on a grid, compared to a full build after each update
+	{
+		const int N = 12;
+		TestMesh Mesh;
+		Mesh.NumVertices = N * N;
+		for (int y = 0; y < N - 1; ++y) {
+			for (int x = 0; x < N - 1; ++x) {
+				int v = y * N + x;
+				Mesh.Triangles.push_back(Index3i(v, v + 1, v + N + 1));
+				Mesh.Triangles.push_back(Index3i(v, v + N + 1, v + N));
+			}
+		}
+		Mesh.TriangleValid.assign(Mesh.Triangles.size(), true);
+		MeshTopology Topology;
+		Mesh.Build(Topology);
+
+		std::mt19937 Random(31337);
+		bool bAllMatch = true;
+		for (int Round = 0; Round < 40 && bAllMatch; ++Round)
+		{
+			std::vector<int> Changed;
+			for (int k = 0; k < 8; ++k) {
+				int TriangleID = (int)(Random() % Mesh.Triangles.size());
+				Mesh.TriangleValid[TriangleID] = !Mesh.TriangleValid[TriangleID];
+				Changed.push_back(TriangleID);
+			}
+			// re-add a removed triangle under a new TriangleID
+			if (Round % 4 == 0) {
+				for (int TriangleID = 0; TriangleID < (int)Mesh.Triangles.size(); ++TriangleID) {
+					if (Mesh.TriangleValid[TriangleID] == false) {
+						Mesh.Triangles.push_back(Mesh.Triangles[TriangleID]);
+						Mesh.TriangleValid.push_back(true);
+						Changed.push_back((int)Mesh.Triangles.size() - 1);
+						break;
+					}
+				}
+			}
+			bAllMatch = Mesh.Update(Topology, Changed);
+			MeshTopology Built;
+			Mesh.Build(Built);
+			bAllMatch = bAllMatch && TopologiesMatch(Topology, Built, Mesh);
+		}
+		GS_TEST_CHECK(bAllMatch);
+	}
+
+	return GSTest::FinishTest("test_mesh_topology_update");
+}
+#endif
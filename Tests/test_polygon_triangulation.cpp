@@ -0,0 +1,134 @@
+// Copyright Gradientspace Corp. All Rights Reserved.
+#ifdef GSCORE_BUILD_TESTS
+#include "GSTestUtil.h"
+#include "Mesh/PolygonTriangulation.h"
+#include "Mesh/PolyMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace GS;
+
+static double SignedArea(const std::vector<Vector2d>& Polygon)
+{
+	double Area = 0;
+	for (size_t i = 0, j = Polygon.size() - 1; i < Polygon.size(); j = i++)
+		Area += DotPerp(Polygon[j], Polygon[i]);
+	return Area * 0.5;
+}
+
+// A triangulation of a simple polygon has N-2 triangles with the orientation of the polygon, and their areas sum to the polygon area
+static bool IsValidTriangulation(const std::vector<Vector2d>& Polygon)
+{
+	int N = (int)Polygon.size();
+	std::vector<Index3i> Triangles(N);
+	int NumTriangles = TriangulatePolygon(const_buffer_view<Vector2d>(Polygon.data(), Polygon.size()), Triangles.data());
+	if (NumTriangles != N - 2)
+		return false;
+	double PolygonArea = SignedArea(Polygon), AreaSum = 0;
+	for (int k = 0; k < NumTriangles; ++k) {
+		const Index3i& Tri = Triangles[k];
+		if (Tri.A < 0 || Tri.A >= N || Tri.B < 0 || Tri.B >= N || Tri.C < 0 || Tri.C >= N)
+			return false;
+		double Area = SignedArea({ Polygon[Tri.A], Polygon[Tri.B], Polygon[Tri.C] });
+		if (Area * PolygonArea < 0)
+			return false;
+		AreaSum += Area;
+	}
+	return std::abs(AreaSum - PolygonArea) <= 1e-9 * std::abs(PolygonArea);
+}
+
+// number of triangles returned for a polygon that may not be simple, all indices must be valid
+static int CountTriangles(const std::vector<Vector2d>& Polygon)
+{
+	int N = (int)Polygon.size();
+	std::vector<Index3i> Triangles(N);
+	int NumTriangles = TriangulatePolygon(const_buffer_view<Vector2d>(Polygon.data(), Polygon.size()), Triangles.data());
+	for (int k = 0; k < NumTriangles; ++k)
+		for (int j = 0; j < 3; ++j)
+			if (Triangles[k][j] < 0 || Triangles[k][j] >= N) return -1;
+	return NumTriangles;
+}
+
+int main()
+{
+	GSTest::RegisterParallelAPI();
+
+	// random star-shaped polygons of both orientations, below and above PolygonTriangulationInlineVertexCount
+	{
+		std::mt19937 Random(1);
+		std::uniform_real_distribution<double> Radius(0.2, 1.0);
+		bool bAllValid = true;
+		for (int Iteration = 0; Iteration < 2000 && bAllValid; ++Iteration) {
+			int N = 4 + (int)(Random() % ((Iteration % 10 == 0) ? 1000 : 60));
+			std::vector<Vector2d> Polygon(N);
+			for (int i = 0; i < N; ++i) {
+				double Angle = 2.0 * RealConstants<double>::Pi() * i / N;
+				double r = Radius(Random);
+				Polygon[i] = Vector2d(r * std::cos(Angle), r * std::sin(Angle));
+			}
+			if (Iteration % 2 == 1)
+				std::reverse(Polygon.begin(), Polygon.end());
+			bAllValid = IsValidTriangulation(Polygon);
+		}
+		GS_TEST_CHECK(bAllValid);
+	}
+
+	// comb with thin teeth, most vertices are reflex or only have ears between the teeth
+	for (int NumTeeth : { 4, 200 })
+	{
+		std::vector<Vector2d> Polygon;
+		Polygon.push_back(Vector2d(0, 1));
+		for (int i = 0; i < NumTeeth; ++i) {
+			Polygon.push_back(Vector2d(2 * i, 0));
+			Polygon.push_back(Vector2d(2 * i, -5));
+			Polygon.push_back(Vector2d(2 * i + 1, -5));
+			Polygon.push_back(Vector2d(2 * i + 1, 0));
+		}
+		Polygon.push_back(Vector2d(2 * NumTeeth, 1));
+		GS_TEST_CHECK(IsValidTriangulation(Polygon));
+		std::reverse(Polygon.begin(), Polygon.end());
+		GS_TEST_CHECK(IsValidTriangulation(Polygon));
+	}
+
+	// polygons that are not simple still produce N-2 triangles
+	{
+		std::vector<Vector2d> Bowtie = { Vector2d(0, 0), Vector2d(1, 1), Vector2d(1, 0), Vector2d(0, 1), Vector2d(0.5, 2), Vector2d(-1, 3) };
+		GS_TEST_CHECK(CountTriangles(Bowtie) == 4);
+		std::vector<Vector2d> Coincident(7, Vector2d(1, 1));
+		GS_TEST_CHECK(CountTriangles(Coincident) == 5);
+		std::vector<Vector2d> Collinear;
+		for (int i = 0; i < 100; ++i)
+			Collinear.push_back(Vector2d((i < 50) ? i : 99 - i, 0));
+		GS_TEST_CHECK(CountTriangles(Collinear) == 98);
+		std::vector<Vector2d> Spiral;
+		for (int i = 0; i < 300; ++i)
+			Spiral.push_back(Vector2d((1 + 0.01 * i) * std::cos(0.3 * i), (1 + 0.01 * i) * std::sin(0.3 * i)));
+		GS_TEST_CHECK(CountTriangles(Spiral) == 298);
+	}
+
+	// concave 3D face in a tilted plane, triangles must have the orientation of the face
+	{
+		PolyMesh Mesh;
+		Vector3d AxisX(0.3, 0.8, -0.2), AxisY(-0.5, 0.1, 0.7);
+		const Vector2d LShape[6] = { Vector2d(0, 0), Vector2d(2, 0), Vector2d(2, 1), Vector2d(1, 1), Vector2d(1, 2), Vector2d(0, 2) };
+		int Vertices[6];
+		for (int i = 0; i < 6; ++i)
+			Vertices[i] = Mesh.AddVertex(AxisX * LShape[i].X + AxisY * LShape[i].Y);
+		Mesh.AddPolygon(const_buffer_view<int>(Vertices, 6));
+		Index3i Triangles[4];
+		GS_TEST_CHECK(TriangulatePolyMeshFace(Mesh, 0, Triangles) == 4);
+		Vector3d FaceNormal = Cross(AxisX, AxisY);
+		bool bOriented = true;
+		for (const Index3i& Tri : Triangles) {
+			Vector3d A = Mesh.GetPosition(Vertices[Tri.A]), B = Mesh.GetPosition(Vertices[Tri.B]), C = Mesh.GetPosition(Vertices[Tri.C]);
+			bOriented = bOriented && Dot(Cross(B - A, C - A), FaceNormal) > 0;
+		}
+		GS_TEST_CHECK(bOriented);
+	}
+
+	return GSTest::FinishTest("test_polygon_triangulation");
+}
+#endif